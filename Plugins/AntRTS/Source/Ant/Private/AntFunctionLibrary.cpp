@@ -23,6 +23,17 @@ void UAntFunctionLibrary::SortAgentsBySquare(const UObject *WorldContextObject,
 	}
 }
 
+void UAntFunctionLibrary::AssignAgentsToFormation(const UObject *WorldContextObject, const FVector &DestLocation, EAntFormationShape Shape, float Facing, const TArray<FAntHandle> &Agents, float SplitSpace,
+	TArray<FAntHandle> &SortedAgents, TArray<FVector> &ResultLocations)
+{
+	auto *ant = GetAntSubsystem(WorldContextObject);
+	if (ant && ant->IsValidAgents(Agents))
+	{
+		SortedAgents = Agents;
+		UAntUtil::AssignAgentsToFormation(WorldContextObject->GetWorld(), DestLocation, Shape, Facing, SortedAgents, SplitSpace, ResultLocations);
+	}
+}
+
 FAntHandle UAntFunctionLibrary::AddAgentAdvanced(const UObject *WorldContextObject, const FVector &NavLocation, float Radius, float ExtraQueryRadius, float Height,
 	float FaceAngle, float TurnRate, float MoveAngleThreshold,
 	bool TurnByPreferred, bool CanPierce, bool UseNavigation, float MaxOverlapForce, int32 Flags, int32 IgnoreFlag, EAntAvoidanceTypes CollisionAvoidance, TSubclassOf<UNavigationQueryFilter> FilterClass)
@@ -535,7 +546,7 @@ void UAntFunctionLibrary::GetAsyncQueryResult(const UObject *WorldContextObject,
 {
 	auto *ant = GetAntSubsystem(WorldContextObject);
 	if (ant && ant->IsValidAsyncQuery(QueryHandle))
-		for (const auto &it : ant->GetAsyncQueryData(QueryHandle).Result)
+		for (const auto &it : ant->GetAsyncQueryResult(QueryHandle))
 			QueryResult.Add(it.Handle);
 }
 
@@ -4,6 +4,8 @@
 #include "AntModule.h"
 #include "AntUtil.h"
 #include "ConvexVolume.h"
+#include "Async/ParallelFor.h"
+#include "Algo/Sort.h"
 #include <limits>
 
 #define IND_2D_TO_1D(x, y) ((y) * CellNumber) + (x)
@@ -44,9 +46,20 @@ void FAntGrid::Reset(uint32 cellNumber, float cellSize, float shiftSize)
 	Grid.Reset();
 	GridNodes.Reset();
 	GridData.Reset();
+	BulkItems.Reset();
+	BulkBaseX.Reset();
+	BulkBaseY.Reset();
+	BulkBaseZ.Reset();
+	BulkRadius.Reset();
+	BulkHeight.Reset();
+	BulkFlag.Reset();
+	BulkItemSlotStart.Reset();
+	BulkItemSlots.Reset();
 
 	// resize grid
 	Grid.Init(INDEX_NONE, cellNumber * cellNumber);
+	BulkCellStart.Init(0, cellNumber * cellNumber + 1);
+	Count = 0;
 
 	CellNumber = cellNumber;
 	CellSize = cellSize;
@@ -81,6 +94,8 @@ int32 FAntGrid::AddCylinder(const FAntHandle &Handle, const FVector3f &Base, flo
 	nodeData.Cylinder.height = Height;
 	nodeData.Cylinder.Radius = Radius;
 	nodeData.bMultiCell = (ystart != yend) || (xstart != xend);
+	nodeData.bBulk = false;
+	nodeData.bRemoved = false;
 	const auto nodeDataIdx = GridData.Add(nodeData);
 
 	// iterate overlapped cells
@@ -119,43 +134,276 @@ int32 FAntGrid::AddCylinder(const FAntHandle &Handle, const FVector3f &Base, flo
 			}
 		}
 
+	// the data keeps the list of its nodes, the handle is the data itself
+	GridData[nodeDataIdx].FirstNodeIdx = lastNodeIdx;
+
 	++Count;
 	++Version;
 
-	return lastNodeIdx;
+	return nodeDataIdx;
+}
+
+void FAntGrid::Rebuild(const TArray<FBulkCylinder> &Items, TArray<int32> &OutGridHandles)
+{
+	check(CellNumber != 0 && CellSize != 0.0f && ShiftSize != 0.0f && "Grid is not initialized!");
+
+	const auto numItems = Items.Num();
+	const auto landscapeRect = FBox2f{ {0.0f, 0.0f}, {CellSize * CellNumber, CellSize * CellNumber} };
+
+	// 1. overlapped cell rect and number of overlapped cells of each item (parallel)
+	TArray<FIntRect> itemRects;
+	TArray<int32> itemOffsets;
+	itemRects.SetNumUninitialized(numItems);
+	itemOffsets.SetNumUninitialized(numItems + 1);
+
+	ParallelFor(numItems, [&](int32 idx)
+		{
+			const auto &item = Items[idx];
+			const auto circleRect = FBox2f{ FVector2f((item.Base - item.Radius) + ShiftSize), FVector2f((item.Base + item.Radius) + ShiftSize) };
+			const auto overlapRect = landscapeRect.Overlap(circleRect);
+
+			itemOffsets[idx + 1] = 0;
+			if (!overlapRect.bIsValid)
+			{
+				itemRects[idx] = FIntRect(0, 0, -1, -1);
+				return;
+			}
+
+			auto &rect = itemRects[idx];
+			rect.Min.X = FMath::Min(overlapRect.Min.X / CellSize, CellNumber - 1);
+			rect.Max.X = FMath::Min(overlapRect.Max.X / CellSize, CellNumber - 1);
+			rect.Min.Y = FMath::Min(overlapRect.Min.Y / CellSize, CellNumber - 1);
+			rect.Max.Y = FMath::Min(overlapRect.Max.Y / CellSize, CellNumber - 1);
+
+			for (auto y = rect.Min.Y; y <= rect.Max.Y; ++y)
+				for (auto x = rect.Min.X; x <= rect.Max.X; ++x)
+					if (FAntMath::RectCircle({ {x * CellSize, y * CellSize}, {x * CellSize + CellSize, y * CellSize + CellSize} }, FVector2f(item.Base) + ShiftSize, item.Radius))
+						++itemOffsets[idx + 1];
+		});
+
+	// 2. reset containers, item i owns node data i
+	for (auto &head : Grid)
+		head = INDEX_NONE;
+
+	GridNodes.Reset();
+	GridData.Reset();
+	GridData.Reserve(numItems);
+	OutGridHandles.SetNumUninitialized(numItems);
+	Count = 0;
+
+	itemOffsets[0] = 0;
+	for (int32 idx = 0; idx < numItems; ++idx)
+	{
+		const auto &item = Items[idx];
+		const auto &rect = itemRects[idx];
+		const bool bInside = itemOffsets[idx + 1] > 0;
+
+		FNodeData nodeData;
+		nodeData.Flag = item.Flags;
+		nodeData.Handle = item.Handle;
+		nodeData.InstanceID = FAntMath::GetUniqueNumber();
+		nodeData.Cylinder.Base = item.Base;
+		nodeData.Cylinder.height = item.Height;
+		nodeData.Cylinder.Radius = item.Radius;
+		nodeData.bMultiCell = (rect.Min.X != rect.Max.X) || (rect.Min.Y != rect.Max.Y);
+		nodeData.bBulk = true;
+		nodeData.bRemoved = !bInside;
+		GridData.Add(nodeData);
+
+		if (!bInside)
+			UE_LOG(LogAnt, Warning, TEXT("[ID: %i] Circle center is out of landscape bound!"), item.Handle.Idx);
+
+		OutGridHandles[idx] = bInside ? idx : INDEX_NONE;
+		Count += bInside ? 1 : 0;
+
+		// prefix sum of overlapped cells
+		itemOffsets[idx + 1] += itemOffsets[idx];
+	}
+
+	// 3. cell key of every (item, cell) pair (parallel)
+	TArray<int32> pairCells;
+	pairCells.SetNumUninitialized(itemOffsets[numItems]);
+
+	ParallelFor(numItems, [&](int32 idx)
+		{
+			const auto &item = Items[idx];
+			const auto &rect = itemRects[idx];
+			auto pairIdx = itemOffsets[idx];
+
+			for (auto y = rect.Min.Y; y <= rect.Max.Y; ++y)
+				for (auto x = rect.Min.X; x <= rect.Max.X; ++x)
+					if (FAntMath::RectCircle({ {x * CellSize, y * CellSize}, {x * CellSize + CellSize, y * CellSize + CellSize} }, FVector2f(item.Base) + ShiftSize, item.Radius))
+						pairCells[pairIdx++] = IND_2D_TO_1D(x, y);
+		});
+
+	// 4. counting sort the pairs by cell into contiguous ranges, stable so each cell stays ordered by item
+	for (auto &start : BulkCellStart)
+		start = 0;
+
+	for (const auto cellIdx : pairCells)
+		++BulkCellStart[cellIdx + 1];
+
+	for (int32 cellIdx = 0; cellIdx < CellNumber * CellNumber; ++cellIdx)
+		BulkCellStart[cellIdx + 1] += BulkCellStart[cellIdx];
+
+	TArray<int32> cursor(BulkCellStart.GetData(), CellNumber * CellNumber);
+	BulkItems.SetNumUninitialized(pairCells.Num());
+	BulkItemSlots.SetNumUninitialized(pairCells.Num());
+
+	for (int32 idx = 0; idx < numItems; ++idx)
+		for (auto pairIdx = itemOffsets[idx]; pairIdx < itemOffsets[idx + 1]; ++pairIdx)
+		{
+			const auto slot = cursor[pairCells[pairIdx]]++;
+			BulkItems[slot] = idx;
+			BulkItemSlots[pairIdx] = slot;
+		}
+
+	// item pair ranges are kept to patch the columns on flag/height updates
+	BulkItemSlotStart = MoveTemp(itemOffsets);
+
+	// 5. packed columns of the bulk level
+	const auto numSlots = BulkItems.Num();
+	BulkBaseX.SetNumZeroed(numSlots + BulkColumnPadding);
+	BulkBaseY.SetNumZeroed(numSlots + BulkColumnPadding);
+	BulkBaseZ.SetNumZeroed(numSlots + BulkColumnPadding);
+	BulkRadius.SetNumZeroed(numSlots + BulkColumnPadding);
+	BulkHeight.SetNumZeroed(numSlots + BulkColumnPadding);
+	BulkFlag.SetNumZeroed(numSlots + BulkColumnPadding);
+
+	for (int32 slot = 0; slot < numSlots; ++slot)
+	{
+		const auto &nodeData = GridData[BulkItems[slot]];
+		BulkBaseX[slot] = nodeData.Cylinder.Base.X;
+		BulkBaseY[slot] = nodeData.Cylinder.Base.Y;
+		BulkBaseZ[slot] = nodeData.Cylinder.Base.Z;
+		BulkRadius[slot] = nodeData.Cylinder.Radius;
+		BulkHeight[slot] = nodeData.Cylinder.height;
+		BulkFlag[slot] = nodeData.Flag;
+	}
+
+	++Version;
+}
+
+template <typename FuncType>
+void FAntGrid::ForEachNodeData(int32 CellIdx, FuncType &&Func) const
+{
+	// bulk level
+	for (auto itemIdx = BulkCellStart[CellIdx]; itemIdx < BulkCellStart[CellIdx + 1]; ++itemIdx)
+	{
+		const auto &nodeData = GridData[BulkItems[itemIdx]];
+		if (!nodeData.bRemoved)
+			Func(nodeData);
+	}
+
+	// linked level
+	ForEachLinkedNodeData(CellIdx, Func);
+}
+
+template <typename FuncType>
+void FAntGrid::ForEachLinkedNodeData(int32 CellIdx, FuncType &&Func) const
+{
+	auto beginIdx = Grid[CellIdx];
+	while (beginIdx != INDEX_NONE)
+	{
+		const auto &node = GridNodes[beginIdx];
+		beginIdx = node.NextIdx;
+		Func(GridData[node.DataIdx]);
+	}
+}
+
+template <typename TestFuncType, typename HitFuncType>
+void FAntGrid::ForEachBulkHit(int32 CellIdx, int32 Flags, TestFuncType &&TestFunc, HitFuncType &&HitFunc) const
+{
+	const auto flags = VectorIntSet1(Flags);
+	const auto endIdx = BulkCellStart[CellIdx + 1];
+
+	for (auto slot = BulkCellStart[CellIdx]; slot < endIdx; slot += 4)
+	{
+		// lanes past the cell belong to the next cell (or the padding)
+		uint32 hitMask = (1u << FMath::Min(4, endIdx - slot)) - 1;
+
+		// masked flag filter, removed objects have a zero flag
+		const auto noFlag = VectorIntCompareEQ(VectorIntAnd(VectorIntLoad(&BulkFlag[slot]), flags), GlobalVectorConstants::IntZero);
+		hitMask &= ~uint32(VectorMaskBits(VectorCast4IntTo4Float(noFlag)));
+		if (hitMask == 0)
+			continue;
+
+		// shape test
+		VectorRegister4Float values;
+		hitMask &= VectorMaskBits(TestFunc(VectorLoad(&BulkBaseX[slot]), VectorLoad(&BulkBaseY[slot]), VectorLoad(&BulkBaseZ[slot]),
+			VectorLoad(&BulkRadius[slot]), VectorLoad(&BulkHeight[slot]), values));
+		if (hitMask == 0)
+			continue;
+
+		alignas(16) float laneValues[4];
+		VectorStoreAligned(values, laneValues);
+
+		for (; hitMask != 0; hitMask &= hitMask - 1)
+		{
+			const auto lane = FMath::CountTrailingZeros(hitMask);
+			HitFunc(GridData[BulkItems[slot + lane]], laneValues[lane]);
+		}
+	}
+}
+
+void FAntGrid::UpdateBulkColumns(int32 GridHandle)
+{
+	const auto &nodeData = GridData[GridHandle];
+	for (auto pairIdx = BulkItemSlotStart[GridHandle]; pairIdx < BulkItemSlotStart[GridHandle + 1]; ++pairIdx)
+	{
+		const auto slot = BulkItemSlots[pairIdx];
+		BulkFlag[slot] = nodeData.bRemoved ? 0 : nodeData.Flag;
+		BulkHeight[slot] = nodeData.Cylinder.height;
+	}
 }
 
 void FAntGrid::UpdateFlag(int32 GridHandle, int32 NewFlags)
 {
-	check(GridNodes.IsValidIndex(GridHandle) && "Invalid handle");
+	check(GridData.IsValidIndex(GridHandle) && !GridData[GridHandle].bRemoved && "Invalid handle");
 
 	// update grid version
-	Version = GridData[GridNodes[GridHandle].DataIdx].Flag == NewFlags ? Version : Version + 1;
+	Version = GridData[GridHandle].Flag == NewFlags ? Version : Version + 1;
 
 	// update flag
-	GridData[GridNodes[GridHandle].DataIdx].Flag = NewFlags;
+	GridData[GridHandle].Flag = NewFlags;
+
+	if (GridData[GridHandle].bBulk)
+		UpdateBulkColumns(GridHandle);
 }
 
 void FAntGrid::UpdateHeight(int32 GridHandle, float NewHeight)
 {
-	check(GridNodes.IsValidIndex(GridHandle) && "Invalid handle");
+	check(GridData.IsValidIndex(GridHandle) && !GridData[GridHandle].bRemoved && "Invalid handle");
 
 	// update grid version
-	Version = GridData[GridNodes[GridHandle].DataIdx].Cylinder.height == NewHeight ? Version : Version + 1;
+	Version = GridData[GridHandle].Cylinder.height == NewHeight ? Version : Version + 1;
 
 	// update flag
-	GridData[GridNodes[GridHandle].DataIdx].Cylinder.height = NewHeight;
+	GridData[GridHandle].Cylinder.height = NewHeight;
+
+	if (GridData[GridHandle].bBulk)
+		UpdateBulkColumns(GridHandle);
 }
 
 void FAntGrid::Remove(int32 GridHandle)
 {
-	check(GridNodes.IsValidIndex(GridHandle) && "Invalid handle");
+	check(GridData.IsValidIndex(GridHandle) && !GridData[GridHandle].bRemoved && "Invalid handle");
+
+	// bulk ranges are immutable, mark the data as removed and keep its slot until the next rebuild
+	if (GridData[GridHandle].bBulk)
+	{
+		GridData[GridHandle].bRemoved = true;
+		UpdateBulkColumns(GridHandle);
+		--Count;
+		++Version;
+		return;
+	}
 
 	// remove node data
-	GridData.RemoveAt(GridNodes[GridHandle].DataIdx);
+	auto firstIdx = GridData[GridHandle].FirstNodeIdx;
+	GridData.RemoveAt(GridHandle);
 
 	// remove node itself
-	auto firstIdx = GridHandle;
 	while (firstIdx != INDEX_NONE)
 	{
 		auto &node = GridNodes[firstIdx];
@@ -182,10 +430,8 @@ void FAntGrid::Remove(int32 GridHandle)
 	++Version;
 }
 
-void FAntGrid::QueryCylinder(const FVector3f &Base, float Radius, float Height, int32 Flags, bool MustIncludeCenter, TArray<FAntContactInfo> &OutCollided, const TArray<FAntHandle> *IgnoreList) const
+void FAntGrid::CollectCylinderCells(const FVector3f &Base, float Radius, TArray<int32, TInlineAllocator<32>> &OutCells) const
 {
-	check(CellNumber != 0 && CellSize != 0.0f && ShiftSize != 0.0f && "Grid is not initialized!");
-
 	// checking boundaries
 	const FBox2f landscapeRect{ {0.0f, 0.0f}, {CellSize * CellNumber, CellSize * CellNumber} };
 	const FBox2f circleRect{ FVector2f((Base - Radius) + ShiftSize), FVector2f((Base + Radius) + ShiftSize) };
@@ -202,45 +448,107 @@ void FAntGrid::QueryCylinder(const FVector3f &Base, float Radius, float Height,
 	const int32 yend = FMath::Min(overlapRect.Max.Y / CellSize, CellNumber - 1);
 
 	// store overlapped cells
-	TArray<TPair<int32, int32>, TInlineAllocator<32>> cells;
 	for (auto y = ystart; y <= yend; ++y)
 		for (auto x = xstart; x <= xend; ++x)
 			if (FAntMath::RectCircle({ {x * CellSize, y * CellSize}, {x * CellSize + CellSize, y * CellSize + CellSize} }, FVector2f(Base) + ShiftSize, Radius))
-				cells.Add({ x, y });
+				OutCells.Add(IND_2D_TO_1D(x, y));
+}
+
+template <typename HitFuncType>
+void FAntGrid::ForEachBulkCylinderHit(int32 CellIdx, const FVector3f &Base, float Radius, float Height, int32 Flags, bool MustIncludeCenter, HitFuncType &&HitFunc) const
+{
+	const auto queryX = VectorSetFloat1(Base.X);
+	const auto queryY = VectorSetFloat1(Base.Y);
+	const auto queryMinZ = VectorSetFloat1(Base.Z);
+	const auto queryMaxZ = VectorSetFloat1(Base.Z + Height);
+	const auto queryRadius = VectorSetFloat1(Radius);
+	ForEachBulkHit(CellIdx, Flags,
+		[&](const VectorRegister4Float &X, const VectorRegister4Float &Y, const VectorRegister4Float &Z, const VectorRegister4Float &R, const VectorRegister4Float &H, VectorRegister4Float &OutSqDist)
+		{
+			const auto dx = VectorSubtract(X, queryX);
+			const auto dy = VectorSubtract(Y, queryY);
+			const auto sumRadius = MustIncludeCenter ? queryRadius : VectorAdd(queryRadius, R);
+			OutSqDist = VectorMultiplyAdd(dx, dx, VectorMultiply(dy, dy));
+
+			// vertical overlap and 2d distance
+			const auto overlapZ = VectorBitwiseAnd(VectorCompareGE(VectorAdd(Z, H), queryMinZ), VectorCompareLE(Z, queryMaxZ));
+			return VectorBitwiseAnd(overlapZ, VectorCompareLT(OutSqDist, VectorMultiply(sumRadius, sumRadius)));
+		},
+		HitFunc);
+}
+
+void FAntGrid::SortContacts(TArrayView<FAntContactInfo> Contacts)
+{
+	Algo::Sort(Contacts, [](const FAntContactInfo &A, const FAntContactInfo &B)
+		{
+			return A.Handle.Idx != B.Handle.Idx ? A.Handle.Idx < B.Handle.Idx : A.InstanceID < B.InstanceID;
+		});
+}
+
+void FAntGrid::QueryCylinder(const FVector3f &Base, float Radius, float Height, int32 Flags, bool MustIncludeCenter, TArray<FAntContactInfo> &OutCollided, const TArray<FAntHandle> *IgnoreList) const
+{
+	check(CellNumber != 0 && CellSize != 0.0f && ShiftSize != 0.0f && "Grid is not initialized!");
+	const FSortedContactsScope sortedScope{ *this, OutCollided, OutCollided.Num() };
+
+	TArray<int32, TInlineAllocator<32>> cells;
+	CollectCylinderCells(Base, Radius, cells);
 
 	// in case of pre-filled OutCollided, we store the size
 	const auto preSize = OutCollided.Num();
+
+	// bulk level, 4 cylinders per test
+	for (const auto cellIdx : cells)
+		ForEachBulkCylinderHit(cellIdx, Base, Radius, Height, Flags, MustIncludeCenter,
+			[&](const FNodeData &nodeData, float SqDist)
+			{
+				// check ignore list
+				if (IgnoreList && AntInternal::IndexOfElement(*IgnoreList, nodeData.Handle, 0) != INDEX_NONE)
+					return;
+
+				FAntContactInfo info;
+				info.Flag = nodeData.Flag;
+				info.Handle = nodeData.Handle;
+				info.InstanceID = nodeData.InstanceID;
+
+				// duplication check for multi-cell nodes
+				if (nodeData.bMultiCell && AntInternal::IndexOfElement(OutCollided, info, preSize) != INDEX_NONE)
+					return;
+
+				info.SqDist = SqDist;
+				info.Cylinder.Base = nodeData.Cylinder.Base;
+				info.Cylinder.Radius = nodeData.Cylinder.Radius;
+				info.Cylinder.Height = nodeData.Cylinder.height;
+				OutCollided.Push(info);
+			});
+
+	// linked level
+	// bulk and linked objects never overlap so duplication checks can start after the bulk contacts
+	const auto linkedSize = OutCollided.Num();
 	// we can't use session counter in multi thread scenario so
 	// we iterate over nodes 2 times, 1 for multi-cell (shared) nodes and 1 for single-cell nodes
 	// this way we can use OutCollided array efficiently for checking duplication.
 	bool multiCellPhase = true;
 	do {
-		for (const auto &it : cells)
+		for (const auto cellIdx : cells)
 		{
-			const auto cellInd = IND_2D_TO_1D(it.Key, it.Value);
 			// check nodes
-			auto beginIdx = Grid[cellInd];
-			while (beginIdx != INDEX_NONE)
+			ForEachLinkedNodeData(cellIdx, [&](const FNodeData &nodeData)
 			{
-				auto &node = GridNodes[beginIdx];
-				const auto &nodeData = GridData[node.DataIdx];
-				beginIdx = node.NextIdx;
-
 				// skip single-cell nodes in first phase
 				if (multiCellPhase && !nodeData.bMultiCell)
-					continue;
+					return;
 
 				// skip multi-cell nodes in second phase
 				if (!multiCellPhase && nodeData.bMultiCell)
-					continue;
+					return;
 
 				// check flag and disbality
 				if (!CHECK_BIT_ANY(Flags, nodeData.Flag))
-					continue;
+					return;
 
 				// check ignore list
 				if (IgnoreList && AntInternal::IndexOfElement(*IgnoreList, nodeData.Handle, 0) != INDEX_NONE)
-					continue;
+					return;
 
 				// init contact info
 				FAntContactInfo info;
@@ -249,12 +557,12 @@ void FAntGrid::QueryCylinder(const FVector3f &Base, float Radius, float Height,
 				info.InstanceID = nodeData.InstanceID;
 
 				// duplication check for multi-cell nodes
-				if (nodeData.bMultiCell && AntInternal::IndexOfElement(OutCollided, info, preSize) != INDEX_NONE)
-					continue;
+				if (nodeData.bMultiCell && AntInternal::IndexOfElement(OutCollided, info, linkedSize) != INDEX_NONE)
+					return;
 
 				// check collision
 				if ((nodeData.Cylinder.Base.Z + nodeData.Cylinder.height < Base.Z) || (nodeData.Cylinder.Base.Z > Base.Z + Height))
-					continue;
+					return;
 
 				const auto sumRadius = Radius + (MustIncludeCenter ? 0 : nodeData.Cylinder.Radius);
 				const auto sqRadius = sumRadius * sumRadius;
@@ -267,8 +575,7 @@ void FAntGrid::QueryCylinder(const FVector3f &Base, float Radius, float Height,
 
 					OutCollided.Push(info);
 				}
-				continue;
-			}
+			});
 		}
 
 		// switch phase
@@ -276,9 +583,164 @@ void FAntGrid::QueryCylinder(const FVector3f &Base, float Radius, float Height,
 	} while (!multiCellPhase);
 }
 
+void FAntGrid::QueryCylinders(TConstArrayView<FCylinderQuery> InQueries, TArray<FAntContactInfo> &OutCollided, TArray<int32> &OutStart) const
+{
+	check(CellNumber != 0 && CellSize != 0.0f && ShiftSize != 0.0f && "Grid is not initialized!");
+
+	const auto numQueries = InQueries.Num();
+	OutCollided.Reset();
+	OutStart.SetNumUninitialized(numQueries + 1);
+	OutStart[0] = 0;
+	if (numQueries == 0)
+		return;
+
+	// (cell, query) pairs in query order, the cell is the high half so sorting the keys buckets them by cell
+	TArray<int64> pairs;
+	TArray<int32> queryPairStart;
+	queryPairStart.SetNumUninitialized(numQueries + 1);
+	TArray<int32, TInlineAllocator<32>> cells;
+	for (int32 queryIdx = 0; queryIdx < numQueries; ++queryIdx)
+	{
+		queryPairStart[queryIdx] = pairs.Num();
+		cells.Reset();
+		CollectCylinderCells(InQueries[queryIdx].Base, InQueries[queryIdx].Radius, cells);
+		for (const auto cellIdx : cells)
+			pairs.Add((int64(cellIdx) << 32) | queryIdx);
+	}
+	queryPairStart[numQueries] = pairs.Num();
+
+	const auto numPairs = pairs.Num();
+	TArray<int32> sortedPairs;
+	sortedPairs.SetNumUninitialized(numPairs);
+	for (int32 idx = 0; idx < numPairs; ++idx)
+		sortedPairs[idx] = idx;
+	Algo::Sort(sortedPairs, [&pairs](int32 A, int32 B) { return pairs[A] < pairs[B]; });
+
+	// runs of the same cell
+	TArray<int32> cellGroupStart;
+	for (int32 idx = 0; idx < numPairs; ++idx)
+		if (idx == 0 || (pairs[sortedPairs[idx]] >> 32) != (pairs[sortedPairs[idx - 1]] >> 32))
+			cellGroupStart.Add(idx);
+	const auto numGroups = cellGroupStart.Num();
+	cellGroupStart.Add(numPairs);
+
+	// hits of each pair, contiguous inside the buffer of its cell
+	struct FCellHit
+	{
+		FAntContactInfo Info;
+		bool bMultiCell;
+	};
+	TArray<TArray<FCellHit>> groupHits;
+	groupHits.SetNum(numGroups);
+	TArray<int32> pairGroup, pairHitStart, pairHitNum;
+	pairGroup.SetNumUninitialized(numPairs);
+	pairHitStart.SetNumUninitialized(numPairs);
+	pairHitNum.SetNumUninitialized(numPairs);
+
+	// visit each touched cell once and test its content against all of the queries overlapping it
+	ParallelFor(numGroups, [&](int32 groupIdx)
+		{
+			auto &hits = groupHits[groupIdx];
+			const int32 cellIdx = pairs[sortedPairs[cellGroupStart[groupIdx]]] >> 32;
+			for (auto sortedIdx = cellGroupStart[groupIdx]; sortedIdx < cellGroupStart[groupIdx + 1]; ++sortedIdx)
+			{
+				const auto pairIdx = sortedPairs[sortedIdx];
+				const auto &query = InQueries[pairs[pairIdx] & 0xffffffff];
+				pairGroup[pairIdx] = groupIdx;
+				pairHitStart[pairIdx] = hits.Num();
+
+				const auto addHit = [&](const FNodeData &nodeData, float SqDist)
+					{
+						auto &hit = hits.AddDefaulted_GetRef();
+						hit.Info.Flag = nodeData.Flag;
+						hit.Info.Handle = nodeData.Handle;
+						hit.Info.InstanceID = nodeData.InstanceID;
+						hit.Info.SqDist = SqDist;
+						hit.Info.Cylinder.Base = nodeData.Cylinder.Base;
+						hit.Info.Cylinder.Radius = nodeData.Cylinder.Radius;
+						hit.Info.Cylinder.Height = nodeData.Cylinder.height;
+						hit.bMultiCell = nodeData.bMultiCell;
+					};
+
+				// bulk level
+				ForEachBulkCylinderHit(cellIdx, query.Base, query.Radius, query.Height, query.Flags, query.MustIncludeCenter, addHit);
+
+				// linked level
+				const auto sqBase = FVector2f(query.Base);
+				ForEachLinkedNodeData(cellIdx, [&](const FNodeData &nodeData)
+					{
+						if (!CHECK_BIT_ANY(query.Flags, nodeData.Flag))
+							return;
+
+						if ((nodeData.Cylinder.Base.Z + nodeData.Cylinder.height < query.Base.Z) || (nodeData.Cylinder.Base.Z > query.Base.Z + query.Height))
+							return;
+
+						const auto sumRadius = query.Radius + (query.MustIncludeCenter ? 0 : nodeData.Cylinder.Radius);
+						const auto sqDist = FVector2f::DistSquared(sqBase, FVector2f(nodeData.Cylinder.Base));
+						if (sqDist < sumRadius * sumRadius)
+							addHit(nodeData, sqDist);
+					});
+
+				pairHitNum[pairIdx] = hits.Num() - pairHitStart[pairIdx];
+			}
+		});
+
+	// upper bound of each query span
+	for (int32 queryIdx = 0; queryIdx < numQueries; ++queryIdx)
+	{
+		int32 num = 0;
+		for (auto pairIdx = queryPairStart[queryIdx]; pairIdx < queryPairStart[queryIdx + 1]; ++pairIdx)
+			num += pairHitNum[pairIdx];
+		OutStart[queryIdx + 1] = OutStart[queryIdx] + num;
+	}
+	OutCollided.SetNumUninitialized(OutStart[numQueries]);
+
+	// gather the cell hits of each query, multi-cell objects may show up in more than one cell
+	TArray<int32> queryNum;
+	queryNum.SetNumUninitialized(numQueries);
+	ParallelFor(numQueries, [&](int32 queryIdx)
+		{
+			const auto start = OutStart[queryIdx];
+			const bool bSingleCell = queryPairStart[queryIdx + 1] - queryPairStart[queryIdx] == 1;
+			int32 num = 0;
+			for (auto pairIdx = queryPairStart[queryIdx]; pairIdx < queryPairStart[queryIdx + 1]; ++pairIdx)
+			{
+				const auto &hits = groupHits[pairGroup[pairIdx]];
+				for (auto hitIdx = pairHitStart[pairIdx]; hitIdx < pairHitStart[pairIdx] + pairHitNum[pairIdx]; ++hitIdx)
+				{
+					const auto &hit = hits[hitIdx];
+					if (!bSingleCell && hit.bMultiCell && MakeArrayView(OutCollided.GetData() + start, num).Contains(hit.Info))
+						continue;
+
+					OutCollided[start + num++] = hit.Info;
+				}
+			}
+
+			if (bSortedContacts)
+				SortContacts(MakeArrayView(OutCollided.GetData() + start, num));
+
+			queryNum[queryIdx] = num;
+		});
+
+	// close the gaps left by the duplicates
+	int32 writeIdx = 0;
+	for (int32 queryIdx = 0; queryIdx < numQueries; ++queryIdx)
+	{
+		const auto readIdx = OutStart[queryIdx];
+		if (readIdx != writeIdx && queryNum[queryIdx] > 0)
+			FMemory::Memmove(OutCollided.GetData() + writeIdx, OutCollided.GetData() + readIdx, queryNum[queryIdx] * sizeof(FAntContactInfo));
+
+		OutStart[queryIdx] = writeIdx;
+		writeIdx += queryNum[queryIdx];
+	}
+	OutStart[numQueries] = writeIdx;
+	OutCollided.SetNum(writeIdx, EAllowShrinking::No);
+}
+
 void FAntGrid::QueryRay(const FVector3f &Start, const FVector3f &End, int32 Flags, TArray<FAntContactInfo> &OutCollided, const TArray<FAntHandle> *IgnoreList) const
 {
 	check(CellNumber != 0 && CellSize != 0.0f && ShiftSize != 0.0f && "Grid is not initialized!");
+	const FSortedContactsScope sortedScope{ *this, OutCollided, OutCollided.Num() };
 
 	// checking boundaries
 	const FBox2f landscapeRect{ {0.0f, 0.0f}, {CellSize * CellNumber, CellSize * CellNumber} };
@@ -293,6 +755,29 @@ void FAntGrid::QueryRay(const FVector3f &Start, const FVector3f &End, int32 Flag
 
 	//DrawDebugLine(DebugDraw, FVector(Start.X, Start.Y, 40), FVector(End.X, End.Y, 40), FColor::Black, false);
 
+	// bulk level broad test, 2d distance to the segment and vertical overlap, padded by 1 unit
+	const auto segDir = FVector2f(End - Start);
+	const auto segX = VectorSetFloat1(Start.X);
+	const auto segY = VectorSetFloat1(Start.Y);
+	const auto segDirX = VectorSetFloat1(segDir.X);
+	const auto segDirY = VectorSetFloat1(segDir.Y);
+	const auto segInvSqLen = VectorSetFloat1(segDir.IsNearlyZero() ? 0.0f : 1.0f / segDir.SizeSquared());
+	const auto segMinZ = VectorSetFloat1(FMath::Min(Start.Z, End.Z));
+	const auto segMaxZ = VectorSetFloat1(FMath::Max(Start.Z, End.Z));
+	const auto bulkTest = [&](const VectorRegister4Float &X, const VectorRegister4Float &Y, const VectorRegister4Float &Z, const VectorRegister4Float &R, const VectorRegister4Float &H, VectorRegister4Float &OutValues)
+	{
+		const auto cx = VectorSubtract(X, segX);
+		const auto cy = VectorSubtract(Y, segY);
+		const auto t = VectorMin(VectorMax(VectorMultiply(VectorMultiplyAdd(cx, segDirX, VectorMultiply(cy, segDirY)), segInvSqLen), VectorZeroFloat()), VectorOneFloat());
+		const auto ex = VectorNegateMultiplyAdd(t, segDirX, cx);
+		const auto ey = VectorNegateMultiplyAdd(t, segDirY, cy);
+		const auto radius = VectorAdd(R, VectorOneFloat());
+		OutValues = VectorZeroFloat();
+
+		const auto overlapZ = VectorBitwiseAnd(VectorCompareGE(VectorAdd(Z, H), segMinZ), VectorCompareLE(Z, segMaxZ));
+		return VectorBitwiseAnd(overlapZ, VectorCompareLE(VectorMultiplyAdd(ex, ex, VectorMultiply(ey, ey)), VectorMultiply(radius, radius)));
+	};
+
 	// in case of pre-filled OutCollided, we store the size
 	const auto preSize = OutCollided.Num();
 	// we can't use session counter in multi thread scenario so
@@ -357,33 +842,54 @@ void FAntGrid::QueryRay(const FVector3f &Start, const FVector3f &End, int32 Flag
 		// iterate over involved cells
 		if (x >= 0 && y >= 0 && x < CellNumber && y < CellNumber)
 		{
-			do
+			const auto cellInd = IND_2D_TO_1D(x, y);
+
+			// bulk objects passing the broad test get the exact cylinder test
+			ForEachBulkHit(cellInd, Flags, bulkTest, [&](const FNodeData &nodeData, float)
 			{
-				const auto cellInd = IND_2D_TO_1D(x, y);
-				auto beginIdx = Grid[cellInd];
+				// check ignore list
+				if (IgnoreList && AntInternal::IndexOfElement(*IgnoreList, nodeData.Handle, 0) != INDEX_NONE)
+					return;
+
+				FAntContactInfo info;
+				info.Flag = nodeData.Flag;
+				info.Handle = nodeData.Handle;
+				info.InstanceID = nodeData.InstanceID;
+
+				// duplication check for multi-cell nodes
+				if (nodeData.bMultiCell && AntInternal::IndexOfElement(OutCollided, info, preSize) != INDEX_NONE)
+					return;
 
-				// itertae over objects inside each cell
-				while (beginIdx != INDEX_NONE)
+				float timeOfImpact = 0.0f;
+				if (FAntMath::CylinderSegment({ nodeData.Cylinder.Base, nodeData.Cylinder.Base + FVector3f(0.0f, 0.0f, nodeData.Cylinder.height) }, nodeData.Cylinder.Radius, { Start, End }, timeOfImpact))
 				{
-					auto &node = GridNodes[beginIdx];
-					const auto &nodeData = GridData[node.DataIdx];
-					beginIdx = node.NextIdx;
+					info.Cylinder.Base = nodeData.Cylinder.Base;
+					info.Cylinder.Radius = nodeData.Cylinder.Radius;
+					info.SqDist = 0;
+					OutCollided.Push(info);
+				}
+			});
 
+			do
+			{
+				// itertae over linked objects inside each cell
+				ForEachLinkedNodeData(cellInd, [&](const FNodeData &nodeData)
+				{
 					// skip single-cell nodes in first phase
 					if (multiCellPhase && !nodeData.bMultiCell)
-						continue;
+						return;
 
 					// skip multi-cell nodes in second phase
 					if (!multiCellPhase && nodeData.bMultiCell)
-						continue;
+						return;
 
 					// check flag and disbality
 					if (!CHECK_BIT_ANY(Flags, nodeData.Flag))
-						continue;
+						return;
 
 					// check ignore list
 					if (IgnoreList && AntInternal::IndexOfElement(*IgnoreList, nodeData.Handle, 0) != INDEX_NONE)
-						continue;
+						return;
 
 					// init contact info
 					FAntContactInfo info;
@@ -393,19 +899,18 @@ void FAntGrid::QueryRay(const FVector3f &Start, const FVector3f &End, int32 Flag
 
 					// duplication check for multi-cell nodes
 					if (nodeData.bMultiCell && AntInternal::IndexOfElement(OutCollided, info, preSize) != INDEX_NONE)
-						continue;
+						return;
 
 					// check collision against cylinder
 					float timeOfImpact = 0.0f;
-					if (FAntMath::CylinderSegment({ nodeData.Cylinder.Base, nodeData.Cylinder.Base + nodeData.Cylinder.height }, nodeData.Cylinder.Radius, { Start, End }, timeOfImpact))
+					if (FAntMath::CylinderSegment({ nodeData.Cylinder.Base, nodeData.Cylinder.Base + FVector3f(0.0f, 0.0f, nodeData.Cylinder.height) }, nodeData.Cylinder.Radius, { Start, End }, timeOfImpact))
 					{
 						info.Cylinder.Base = nodeData.Cylinder.Base;
 						info.Cylinder.Radius = nodeData.Cylinder.Radius;
 						info.SqDist = 0;
 						OutCollided.Push(info);
 					}
-					continue;
-				}
+				});
 
 				// switch phase
 				multiCellPhase = !multiCellPhase;
@@ -431,6 +936,8 @@ void FAntGrid::QueryRay(const FVector3f &Start, const FVector3f &End, int32 Flag
 
 void FAntGrid::QueryConvexVolume(const TStaticArray<FVector, 4> &NearPlane, const TStaticArray<FVector, 4> &FarPlane, int32 Flags, TArray<FAntContactInfo> &OutCollided, const TArray<FAntHandle> *IgnoreList) const
 {
+	const FSortedContactsScope sortedScope{ *this, OutCollided, OutCollided.Num() };
+
 	// create 2d list of the coordinates to compute convex hull
 	TArray<FVector> pointLists;
 	TArray<FVector2f> sortedPointLists;
@@ -508,28 +1015,23 @@ void FAntGrid::QueryConvexVolume(const TStaticArray<FVector, 4> &NearPlane, cons
 		{
 			const auto cellInd = IND_2D_TO_1D(it.Key, it.Value);
 			// check nodes
-			auto beginIdx = Grid[cellInd];
-			while (beginIdx != INDEX_NONE)
+			ForEachNodeData(cellInd, [&](const FNodeData &nodeData)
 			{
-				auto &node = GridNodes[beginIdx];
-				const auto &nodeData = GridData[node.DataIdx];
-				beginIdx = node.NextIdx;
-
 				// skip single-cell nodes in first phase
 				if (multiCellPhase && !nodeData.bMultiCell)
-					continue;
+					return;
 
 				// skip multi-cell nodes in second phase
 				if (!multiCellPhase && nodeData.bMultiCell)
-					continue;
+					return;
 
 				// check flag and disbality
 				if (!CHECK_BIT_ANY(Flags, nodeData.Flag))
-					continue;
+					return;
 
 				// check ignore list
 				if (IgnoreList && AntInternal::IndexOfElement(*IgnoreList, nodeData.Handle, 0) != INDEX_NONE)
-					continue;
+					return;
 
 				// init contact info
 				FAntContactInfo info;
@@ -539,7 +1041,7 @@ void FAntGrid::QueryConvexVolume(const TStaticArray<FVector, 4> &NearPlane, cons
 
 				// duplication check for multi-cell nodes
 				if (nodeData.bMultiCell && AntInternal::IndexOfElement(OutCollided, info, preSize) != INDEX_NONE)
-					continue;
+					return;
 
 				if (FAntMath::PolygonCircle(sortedPointLists, FVector2f(nodeData.Cylinder.Base), nodeData.Cylinder.Radius))
 				{
@@ -550,7 +1052,7 @@ void FAntGrid::QueryConvexVolume(const TStaticArray<FVector, 4> &NearPlane, cons
 					if (convexVolume.IntersectPoint(FVector(nodeData.Cylinder.Base)))
 						OutCollided.Push(info);
 				}
-			}
+			});
 		}
 		// switch phase
 		multiCellPhase = !multiCellPhase;
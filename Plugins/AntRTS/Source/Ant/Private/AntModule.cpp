@@ -13,11 +13,14 @@ DEFINE_STAT(STAT_ANT_MovementsUpdate);
 DEFINE_STAT(STAT_ANT_Pathfinding);
 DEFINE_STAT(STAT_ANT_Queries);
 DEFINE_STAT(STAT_ANT_PostPX);
+DEFINE_STAT(STAT_ANT_Replication);
+DEFINE_STAT(STAT_ANT_Formation);
 DEFINE_STAT(STAT_ANT_TotalFrame);
 DEFINE_STAT(STAT_ANT_NumAgents);
 DEFINE_STAT(STAT_ANT_NumMovingAgents);
 DEFINE_STAT(STAT_ANT_NumPaths);
 DEFINE_STAT(STAT_ANT_NumAsyncQueries);
+DEFINE_STAT(STAT_ANT_ReplicatedBytes);
 
 void FAntModule::StartupModule()
 {
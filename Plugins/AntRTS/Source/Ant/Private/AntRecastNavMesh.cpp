@@ -1,13 +1,66 @@
 // Copyright 2024 Lazy Marmot Games. All Rights Reserved.
 
 #include "AntRecastNavMesh.h"
+#include "AntUtil.h"
 #include "NavigationSystem.h"
 #include "NavigationDataHandler.h"
 #include "AI/Navigation/NavigationElement.h"
 #include "NavMesh/PImplRecastNavMesh.h"
 #include "NavMesh/RecastNavMeshGenerator.h"
+#include "NavMesh/RecastHelpers.h"
+#include "Detour/DetourNavMesh.h"
+#include "Misc/ScopeRWLock.h"
 #include "Runtime/Core/Public/Async/ParallelFor.h"
 
+// 2d side of the point relative to the edge, same sign for all the edges means inside a convex poly
+static float EdgeSide2D(const FVector3f &A, const FVector3f &B, const FVector3f &Point)
+{
+	return (B.X - A.X) * (Point.Y - A.Y) - (B.Y - A.Y) * (Point.X - A.X);
+}
+
+static bool IsInsidePoly2D(TConstArrayView<FVector3f> Verts, const FVector3f &Point)
+{
+	bool hasPos = false, hasNeg = false;
+	for (int32 idx = 0; idx < Verts.Num(); ++idx)
+	{
+		const auto side = EdgeSide2D(Verts[idx], Verts[(idx + 1) % Verts.Num()], Point);
+		hasPos |= side > UE_KINDA_SMALL_NUMBER;
+		hasNeg |= side < -UE_KINDA_SMALL_NUMBER;
+	}
+
+	return !(hasPos && hasNeg);
+}
+
+// height of the point on a triangle list, three vertices per triangle
+static bool GetTrianglesHeight2D(TConstArrayView<FVector3f> Tris, const FVector3f &Point, float &OutHeight)
+{
+	for (int32 idx = 0; idx + 2 < Tris.Num(); idx += 3)
+	{
+		const auto &a = Tris[idx], &b = Tris[idx + 1], &c = Tris[idx + 2];
+		const auto area = EdgeSide2D(a, b, c);
+		if (FMath::Abs(area) < UE_KINDA_SMALL_NUMBER)
+			continue;
+
+		const auto u = EdgeSide2D(b, c, Point) / area;
+		const auto v = EdgeSide2D(c, a, Point) / area;
+		const auto w = 1.0f - u - v;
+		if (u >= -UE_KINDA_SMALL_NUMBER && v >= -UE_KINDA_SMALL_NUMBER && w >= -UE_KINDA_SMALL_NUMBER)
+		{
+			OutHeight = u * a.Z + v * b.Z + w * c.Z;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool SegmentsIntersect2D(const FVector3f &A, const FVector3f &B, const FVector3f &C, const FVector3f &D)
+{
+	const auto abC = EdgeSide2D(A, B, C), abD = EdgeSide2D(A, B, D);
+	const auto cdA = EdgeSide2D(C, D, A), cdB = EdgeSide2D(C, D, B);
+	return ((abC >= 0.0f) != (abD >= 0.0f)) && ((cdA >= 0.0f) != (cdB >= 0.0f));
+}
+
 // a little trick to get access to protected members.
 class UNavSysAccessor : public UNavigationSystemV1
 {
@@ -52,6 +105,18 @@ void AAntRecastNavMesh::OnNavMeshTilesUpdated(const TArray<FNavTileRef> &Changed
 	// update path replan list
 	UpdateAntPaths(UpdatedTiles);
 
+	// drop cached polys of the rebuilt tiles and the polys linked to them
+	{
+		FWriteScopeLock lock(PolyCacheLock);
+		for (auto it = PolyCache.CreateIterator(); it; ++it)
+			for (const auto tileIdx : it->Value->Tiles)
+				if (UpdatedTiles.Contains(tileIdx))
+				{
+					it.RemoveCurrent();
+					break;
+				}
+	}
+
 	// reset list
 	UpdatedTiles.Reset();
 }
@@ -110,7 +175,7 @@ void AAntRecastNavMesh::RemoveAgentNavModifier(FAntHandle AgentHandle)
 	OnAgentRemoved(AgentHandle);
 }
 
-void AAntRecastNavMesh::AddPathToReplanList(FAntHandle PathHandle, const FNavigationPath *Path)
+void AAntRecastNavMesh::AddPathToReplanList(FAntHandle PathHandle, const FNavigationPath *Path, bool bSpliced)
 {
 	auto *ant = GetWorld()->GetSubsystem<UAntSubsystem>();
 	check(ant && "Ant is not available.");
@@ -118,18 +183,41 @@ void AAntRecastNavMesh::AddPathToReplanList(FAntHandle PathHandle, const FNaviga
 	if (!ant->IsValidPath(PathHandle) || !Path)
 		return;
 
-	// check if the path is already in the plan list, we remove it first
+	// check if the path is already in the plan list, we remove it first.
+	// spliced paths are registered again as a whole, so the replaced section doesn't keep its old tiles
 	auto &antPathData = ant->GetMutablePathData(PathHandle);
 	if (antPathData.TileNodeIdx != INDEX_NONE)
 		OnPathRemoved(PathHandle);
 
-	// register path in the list by its tiles
+	// collect path tiles
 	const FNavMeshPath *path = Path ? Path->CastPath<FNavMeshPath>() : nullptr;
-	int32 prevPathIdx = INDEX_NONE;
+	TArray<int32> tiles;
 	for (auto it : path->PathCorridor)
+		tiles.AddUnique(GetRecastNavMeshImpl()->GetTileIndexFromPolyRef(it));
+
+	// a spliced path carries only the new section's corridor, the tiles under the kept portals are found by their segments
+	if (bSpliced)
 	{
-		const auto tileID = GetRecastNavMeshImpl()->GetTileIndexFromPolyRef(it);
+		TArray<FBox> segments;
+		segments.Reserve(antPathData.Data.Num());
+		for (int32 pidx = 0; pidx + 1 < antPathData.Data.Num(); ++pidx)
+		{
+			FBox segment(ForceInit);
+			segment += antPathData.Data[pidx].Location;
+			segment += antPathData.Data[pidx + 1].Location;
+			segments.Add(segment.ExpandBy(antPathData.Width));
+		}
+
+		TArray<int32> segmentTiles;
+		GetNavMeshTilesIn(segments, segmentTiles);
+		for (const auto it : segmentTiles)
+			tiles.AddUnique(it);
+	}
 
+	// register path in the list by its tiles
+	int32 prevPathIdx = INDEX_NONE;
+	for (const auto tileID : tiles)
+	{
 		FTileData nodeData;
 		nodeData.Path = PathHandle;
 		nodeData.TileIDX = tileID;
@@ -165,99 +253,267 @@ void AAntRecastNavMesh::UpdateAntPaths(const TArray<uint32> &ChangedTiles)
 	if (GetWorld()->WorldType != EWorldType::PIE && GetWorld()->WorldType != EWorldType::Game)
 		return;
 
-	auto *ant = GetWorld()->GetSubsystem<UAntSubsystem>();
-	check(ant && "Ant is not available.");
-
-	static TArray<FAntHandle> uniqList;
-	uniqList.Reset();
-
-	// collect path on changed tiles
+	// queue paths on changed tiles, paths already in the queue grow their changed bounds
 	for (const auto it : ChangedTiles)
 	{
+		const auto tileBounds = GetNavMeshTileBounds(it);
+
 		// coollect paths on this tile
 		int32 firstIndex = TileGrid[it];
 		while (firstIndex != INDEX_NONE)
 		{
-			uniqList.AddUnique(TileData[firstIndex].Path);
+			const auto pathHandle = TileData[firstIndex].Path;
+			auto *request = ReplanQueue.FindByPredicate([&pathHandle](const FReplanRequest &Request) { return Request.Path == pathHandle; });
+			if (!request)
+			{
+				request = &ReplanQueue.AddDefaulted_GetRef();
+				request->Path = pathHandle;
+			}
+
+			request->ChangedBounds += tileBounds;
 			firstIndex = TileData[firstIndex].NextIdx;
 		}
 	}
+}
+
+void AAntRecastNavMesh::ProcessReplanQueue()
+{
+	if (ReplanQueue.IsEmpty())
+		return;
 
-	// rebuild affected paths
-	struct FData { FAntHandle Handle; FNavMeshPath Path; ENavigationQueryResult::Type Result = ENavigationQueryResult::Type::Invalid; };
+	auto *ant = GetWorld()->GetSubsystem<UAntSubsystem>();
+	if (!ant)
+		return;
+
+	// drop removed paths
+	ReplanQueue.RemoveAll([ant](const FReplanRequest &Request) { return !ant->IsValidPath(Request.Path); });
+
+	// priority, busiest paths first then the ones with agents closer to the change
+	TMap<int32, int32> requestIdx;
+	for (int32 idx = 0; idx < ReplanQueue.Num(); ++idx)
+	{
+		ReplanQueue[idx].NumUsers = 0;
+		ReplanQueue[idx].MinDistSq = MAX_dbl;
+		requestIdx.Add(ReplanQueue[idx].Path.Idx, idx);
+	}
+
+	for (const auto &movement : ant->Movements)
+		if (const auto *idx = requestIdx.Find(movement.GetPath().Idx))
+		{
+			auto &request = ReplanQueue[*idx];
+			++request.NumUsers;
+			if (ant->IsValidAgent(movement.GetHandle()))
+				request.MinDistSq = FMath::Min(request.MinDistSq, request.ChangedBounds.ComputeSquaredDistanceToPoint(FVector(ant->GetAgentData(movement.GetHandle()).GetLocation())));
+		}
+
+	ReplanQueue.Sort([](const FReplanRequest &A, const FReplanRequest &B)
+		{
+			return A.NumUsers != B.NumUsers ? A.NumUsers > B.NumUsers : A.MinDistSq < B.MinDistSq;
+		});
+
+	// replan in waves of one path per worker until the budget is spent, at least one wave per frame.
+	// deterministic mode replans a fixed number of paths per step, so every peer replans the same paths at the same tick
+	struct FData { FNavMeshPath Path; ENavigationQueryResult::Type Result = ENavigationQueryResult::Type::Invalid; FPathSplice Splice; };
+	TMap<int32, int32> splicedIdx;
 	TArray<FData> results;
-	results.SetNum(uniqList.Num());
-	ParallelFor(uniqList.Num(), [&](int32 idx)
+	const auto isDeterministic = ant->Settings->bDeterministic;
+	const auto fixedCount = ant->Settings->DeterministicReplansPerStep > 0 ? FMath::Min(ant->Settings->DeterministicReplansPerStep, ReplanQueue.Num()) : ReplanQueue.Num();
+	const auto budget = ant->Settings->ReplanBudgetMs * 0.001;
+	const auto waveSize = FMath::Max(1, FTaskGraphInterface::Get().GetNumWorkerThreads());
+	const auto startTime = FPlatformTime::Seconds();
+	int32 numDone = 0;
+
+	do
+	{
+		const auto count = FMath::Min(waveSize, (isDeterministic ? fixedCount : ReplanQueue.Num()) - numDone);
+		results.Reset();
+		results.SetNum(count);
+
+		ParallelFor(count, [&](int32 idx)
+			{
+				results[idx].Result = ReplanPath(ant, ReplanQueue[numDone + idx], results[idx].Path, results[idx].Splice);
+			});
+
+		// re-add path to the replan list, spliced paths are registered by the section and the kept portals
+		splicedIdx.Reset();
+		for (int32 idx = 0; idx < count; ++idx)
+			if (results[idx].Result == ENavigationQueryResult::Type::Success)
+			{
+				AddPathToReplanList(ReplanQueue[numDone + idx].Path, &results[idx].Path, results[idx].Splice.IsSpliced());
+				if (results[idx].Splice.IsSpliced())
+					splicedIdx.Add(ReplanQueue[numDone + idx].Path.Idx, idx);
+			}
+
+		// followers of a spliced path keep their place, the kept portals before the splice include the ones they already passed
+		if (!splicedIdx.IsEmpty())
+			for (auto &movement : ant->Movements)
+				if (const auto *idx = splicedIdx.Find(movement.Path.Idx))
+				{
+					const auto &pathData = ant->GetPathData(movement.Path);
+					if (uint16(movement.PathVer + 1) == pathData.Ver)
+					{
+						movement.PathIndex = FMath::Clamp(results[*idx].Splice.Remap(movement.PathIndex), 0, pathData.Data.Num() - 1);
+						movement.PathVer = pathData.Ver;
+					}
+				}
+
+		numDone += count;
+	} while (isDeterministic ? numDone < fixedCount : (numDone < ReplanQueue.Num() && (budget <= 0.0 || FPlatformTime::Seconds() - startTime < budget)));
+
+	ReplanQueue.RemoveAt(0, numDone, EAllowShrinking::No);
+}
+
+// convert corridor portals to ant path portals
+static void ConvertCorridorPortals(const FNavMeshPath &Path, const FNavCorridor &Corridor, TArray<FAntPathData::Portal> &OutPortals)
+{
+	OutPortals.SetNum(Corridor.Portals.Num());
+	uint8 linkCounter = 0;
+	for (int32 pidx = 0; pidx < Corridor.Portals.Num(); ++pidx)
+	{
+		memcpy(&OutPortals[pidx], &Corridor.Portals[pidx], sizeof(FNavCorridorPortal));
+
+		// because of buggy UE implenetation, we can't rely on the navigation API (IsPathSegmentANavLink) to find out which point is a NavLink, 
+		// so we have to check portal left-right to make sure this is a nav link.
+		const auto isLink = Path.IsPathSegmentANavLink(pidx) || OutPortals[pidx].Left == OutPortals[pidx].Right;
+		if (linkCounter == 0 && isLink)
+			linkCounter = 4;
+
+		if (linkCounter > 0 || isLink)
 		{
-			auto &pathData = ant->GetMutablePathData(uniqList[idx]);
-			if (pathData.Data.IsEmpty())
-				return;
+			OutPortals[pidx].Type = FAntPathData::Portal::Link;
+			OutPortals[pidx].Left = OutPortals[pidx].Right = OutPortals[pidx].Location;
+			--linkCounter;
+		}
+
+		// fix incorrect portals location
+		if (!isLink && (OutPortals[pidx].Location == OutPortals[pidx].Left || OutPortals[pidx].Location == OutPortals[pidx].Right))
+			OutPortals[pidx].Location = FMath::Lerp(OutPortals[pidx].Left, OutPortals[pidx].Right, 0.5f);
+	}
+}
 
-			const auto startLoc = ant->IsValidAgent(pathData.GetOwner()) ? FVector(ant->GetAgentData(pathData.GetOwner()).GetLocation()) : pathData.Data[0].Location;
+ENavigationQueryResult::Type AAntRecastNavMesh::ReplanPath(UAntSubsystem *Ant, const FReplanRequest &Request, FNavMeshPath &OutPath, FPathSplice &OutSplice) const
+{
+	auto &pathData = Ant->GetMutablePathData(Request.Path);
+	OutSplice = FPathSplice();
+	if (pathData.Data.IsEmpty())
+		return ENavigationQueryResult::Type::Invalid;
+
+	FNavCorridorParams params;
+	params.SetFromWidth(pathData.Width);
+
+	// portals whose segments cross the changed bounds (2d)
+	const auto &bounds = Request.ChangedBounds;
+	const FBox changedBounds(FVector(bounds.Min.X - pathData.Width, bounds.Min.Y - pathData.Width, -UE_OLD_HALF_WORLD_MAX), FVector(bounds.Max.X + pathData.Width, bounds.Max.Y + pathData.Width, UE_OLD_HALF_WORLD_MAX));
+	int32 firstChanged = INDEX_NONE, lastChanged = INDEX_NONE;
+	for (int32 pidx = 0; pidx + 1 < pathData.Data.Num(); ++pidx)
+	{
+		const auto &start = pathData.Data[pidx].Location;
+		const auto &end = pathData.Data[pidx + 1].Location;
+		if (changedBounds.IsInside(start) || changedBounds.IsInside(end) || FMath::LineBoxIntersection(changedBounds, start, end, end - start))
+		{
+			firstChanged = firstChanged == INDEX_NONE ? pidx : firstChanged;
+			lastChanged = pidx + 1;
+		}
+	}
 
-			results[idx].Handle = uniqList[idx];
-			// prepare path
-			results[idx].Path.SetNavigationDataUsed(this);
-			results[idx].Path.SetTimeStamp(GetWorldTimeStamp());
+	// splice a new section between the last portal before and the first portal after the change
+	const auto spliceStart = firstChanged - 1;
+	const auto spliceEnd = lastChanged + 1;
+	if (Ant->Settings->bSplicePathReplan && firstChanged > 0 && spliceEnd < pathData.Data.Num()
+		&& pathData.Data[spliceStart].Type != FAntPathData::Portal::Link && pathData.Data[spliceEnd].Type != FAntPathData::Portal::Link)
+	{
+		OutPath.SetNavigationDataUsed(this);
+		OutPath.SetTimeStamp(GetWorldTimeStamp());
 
-			// query path
-			results[idx].Result = AntFindPath(startLoc, pathData.Data.Last().Location, TNumericLimits<FVector::FReal>::Max(), true, results[idx].Path, *pathData.FilterClass);
+		if (AntFindPath(pathData.Data[spliceStart].Location, pathData.Data[spliceEnd].Location, TNumericLimits<FVector::FReal>::Max(), true, OutPath, *pathData.FilterClass) == ENavigationQueryResult::Type::Success)
+		{
+			FNavCorridor corridor;
+			corridor.BuildFromPath(OutPath, pathData.FilterClass, params);
+
+			TArray<FAntPathData::Portal> section;
+			ConvertCorridorPortals(OutPath, corridor, section);
+
+			// old portals up to the splice start, the inner portals of the new section, old portals from the splice end
+			TArray<FAntPathData::Portal> spliced;
+			spliced.Reserve(spliceStart + 1 + FMath::Max(0, section.Num() - 2) + pathData.Data.Num() - spliceEnd);
+			spliced.Append(pathData.Data.GetData(), spliceStart + 1);
+			if (section.Num() > 2)
+				spliced.Append(section.GetData() + 1, section.Num() - 2);
+			spliced.Append(pathData.Data.GetData() + spliceEnd, pathData.Data.Num() - spliceEnd);
+
+			FPathSplice splice;
+			splice.Start = spliceStart;
+			splice.OldEnd = spliceEnd;
+			splice.NewEnd = spliceStart + 1 + FMath::Max(0, section.Num() - 2);
+
+			// like a full replan, the cost of an owned path is measured from the owner and not from the portals it already passed
+			int32 costStart = 0;
+			float length = 0.0f;
+			if (Ant->IsValidAgent(pathData.GetOwner()) && Ant->IsValidMovement(pathData.GetOwner()) && Ant->GetAgentMovement(pathData.GetOwner()).GetPath() == Request.Path)
+			{
+				costStart = FMath::Clamp(splice.Remap(Ant->GetAgentMovement(pathData.GetOwner()).PathIndex), 0, spliced.Num() - 1);
+				length = FVector::Distance(FVector(Ant->GetAgentData(pathData.GetOwner()).GetLocation()), spliced[costStart].Location);
+			}
 
-			// path blocked
-			pathData.Status = results[idx].Result == ENavigationQueryResult::Type::Success ? EAntPathStatus::Ready : EAntPathStatus::Blocked;
+			for (int32 pidx = costStart + 1; pidx < spliced.Num(); ++pidx)
+				length += FVector::Distance(spliced[pidx - 1].Location, spliced[pidx].Location);
 
 			// increase path version
 			++pathData.Ver;
 
 			// replan cost threshold
-			if (results[idx].Result == ENavigationQueryResult::Type::Success && pathData.ReplanCostThreshold >= 0.0f && pathData.ReplanCostThreshold < results[idx].Path.GetLength())
+			if (pathData.ReplanCostThreshold >= 0.0f && pathData.ReplanCostThreshold < length)
 			{
 				pathData.Status = EAntPathStatus::HighCost;
-				results[idx].Result = ENavigationQueryResult::Type::Fail;
+				return ENavigationQueryResult::Type::Fail;
 			}
 
-			if (results[idx].Result != ENavigationQueryResult::Type::Success)
-				return;
+			pathData.Status = EAntPathStatus::Ready;
+			pathData.Data = MoveTemp(spliced);
+			pathData.RebuildDistanceList();
+			OutSplice = splice;
+			return ENavigationQueryResult::Type::Success;
+		}
 
-			// build corridor
-			FNavCorridor corridor;
-			FNavCorridorParams params;
-			params.SetFromWidth(pathData.Width);
-			corridor.BuildFromPath(results[idx].Path, pathData.FilterClass, params);
-
-			// convert corridor data to ant path data
-			pathData.Data.SetNum(corridor.Portals.Num());
-			uint8 linkCounter = 0;
-			for (int32 pidx = 0; pidx < corridor.Portals.Num(); ++pidx)
-			{
-				memcpy(&pathData.Data[pidx], &corridor.Portals[pidx], sizeof(FNavCorridorPortal));
+		// no way around the change, replan the whole path
+		OutPath = FNavMeshPath();
+	}
 
-				// because of buggy UE implenetation, we can't rely on the navigation API (IsPathSegmentANavLink) to find out which point is a NavLink, 
-				// so we have to check portal left-right to make sure this is a nav link.
-				const auto isLink = results[idx].Path.IsPathSegmentANavLink(pidx) || pathData.Data[pidx].Left == pathData.Data[pidx].Right;
-				if (linkCounter == 0 && isLink)
-					linkCounter = 4;
+	const auto startLoc = Ant->IsValidAgent(pathData.GetOwner()) ? FVector(Ant->GetAgentData(pathData.GetOwner()).GetLocation()) : pathData.Data[0].Location;
 
-				if (linkCounter > 0 || isLink)
-				{
-					pathData.Data[pidx].Type = FAntPathData::Portal::Link;
-					pathData.Data[pidx].Left = pathData.Data[pidx].Right = pathData.Data[pidx].Location;
-					--linkCounter;
-				}
+	// prepare path
+	OutPath.SetNavigationDataUsed(this);
+	OutPath.SetTimeStamp(GetWorldTimeStamp());
 
-				// fix incorrect portals location
-				if (!isLink && (pathData.Data[pidx].Location == pathData.Data[pidx].Left || pathData.Data[pidx].Location == pathData.Data[pidx].Right))
-					pathData.Data[pidx].Location = FMath::Lerp(pathData.Data[pidx].Left, pathData.Data[pidx].Right, 0.5f);
-			}
+	// query path
+	auto result = AntFindPath(startLoc, pathData.Data.Last().Location, TNumericLimits<FVector::FReal>::Max(), true, OutPath, *pathData.FilterClass);
 
-			// re-build distance list
-			pathData.RebuildDistanceList();
-		});
+	// path blocked
+	pathData.Status = result == ENavigationQueryResult::Type::Success ? EAntPathStatus::Ready : EAntPathStatus::Blocked;
+
+	// increase path version
+	++pathData.Ver;
+
+	// replan cost threshold
+	if (result == ENavigationQueryResult::Type::Success && pathData.ReplanCostThreshold >= 0.0f && pathData.ReplanCostThreshold < OutPath.GetLength())
+	{
+		pathData.Status = EAntPathStatus::HighCost;
+		result = ENavigationQueryResult::Type::Fail;
+	}
+
+	if (result != ENavigationQueryResult::Type::Success)
+		return result;
+
+	// build corridor
+	FNavCorridor corridor;
+	corridor.BuildFromPath(OutPath, pathData.FilterClass, params);
 
-	// re-add path to the replan list
-	for (const auto &it : results)
-		if (it.Result == ENavigationQueryResult::Type::Success)
-			AddPathToReplanList(it.Handle, &it.Path);
+	// convert corridor data to ant path data
+	ConvertCorridorPortals(OutPath, corridor, pathData.Data);
+
+	// re-build distance list
+	pathData.RebuildDistanceList();
+	return result;
 }
 
 void AAntRecastNavMesh::OnAgentRemoved(FAntHandle Agent)
@@ -322,60 +578,195 @@ void AAntRecastNavMesh::OnAntPxPostUpdate()
 	auto *ant = GetWorld()->GetSubsystem<UAntSubsystem>();
 	check(ant && "Ant is not available.");
 
-	ParallelFor(ant->GetMutableUnderlyingAgentsList().GetMaxIndex(), [&](int32 idx)
-		{
-			auto &Agents = ant->GetMutableUnderlyingAgentsList();
-
-			if (!Agents.IsValidIndex(idx))
-				return;
+	auto &Agents = ant->GetMutableUnderlyingAgentsList();
+	const auto &denseAgents = ant->GetDenseAgentsList();
 
-			auto &agentData = Agents[idx];
-			auto oldLoc = agentData.Location;
-
-			if (agentData.bDisabled)
-				return;
-
-			if (agentData.Velocity != FVector3f::ZeroVector || agentData.NodeRef == INVALID_NAVNODEREF)
+	ant->ParallelForAgentBatches([&](int32 begin, int32 end)
+		{
+			for (int32 denseIdx = begin; denseIdx < end; ++denseIdx)
 			{
-				FNavLocation newLoc(FVector(agentData.Location + agentData.Velocity));
+				auto &agentData = Agents[denseAgents[denseIdx]];
+				auto oldLoc = agentData.Location;
 
-				// agent is using navigation
-				if (agentData.bUseNavigation && !agentData.bIsOnNavLink)
-				{
-					// we need to get a valid navigation node ref at the first time
-					FNavLocation currentLoc(FVector(agentData.Location), agentData.NodeRef);
-					if (agentData.NodeRef == INVALID_NAVNODEREF
-						&& GetRecastNavMeshImpl()->ProjectPointToNavMesh(FVector(agentData.Location), currentLoc, ant->Settings->NavLocationExtent,
-							agentData.QueryFilterClass ? *agentData.QueryFilterClass : *GetDefaultQueryFilter(), nullptr))
-						{
-							agentData.NodeRef = currentLoc.NodeRef;
-							agentData.Location = oldLoc = FVector3f(currentLoc.Location);
-						}
+				if (agentData.bDisabled)
+					continue;
 
+				if (agentData.Velocity != FVector3f::ZeroVector || agentData.NodeRef == INVALID_NAVNODEREF)
+				{
+					FNavLocation newLoc(FVector(agentData.Location + agentData.Velocity));
 
-					// find new location
-					if (!GetRecastNavMeshImpl()->FindMoveAlongSurface(currentLoc, FVector(agentData.Location + agentData.Velocity), newLoc,
-						agentData.QueryFilterClass ? *agentData.QueryFilterClass : *GetDefaultQueryFilter(), nullptr))
+					// agent is using navigation
+					if (agentData.bUseNavigation && !agentData.bIsOnNavLink)
 					{
-						newLoc.NodeRef = INVALID_NAVNODEREF;
-						newLoc.Location = FVector(agentData.Location + agentData.Velocity);
+						// we need to get a valid navigation node ref at the first time
+						FNavLocation currentLoc(FVector(agentData.Location), agentData.NodeRef);
+						if (agentData.NodeRef == INVALID_NAVNODEREF
+							&& GetRecastNavMeshImpl()->ProjectPointToNavMesh(FVector(agentData.Location), currentLoc, ant->Settings->NavLocationExtent,
+								agentData.QueryFilterClass ? *agentData.QueryFilterClass : *GetDefaultQueryFilter(), nullptr))
+							{
+								agentData.NodeRef = currentLoc.NodeRef;
+								agentData.Location = oldLoc = FVector3f(currentLoc.Location);
+							}
+
+
+						// find new location, cached poly boundaries first
+						const auto &queryFilter = agentData.QueryFilterClass ? *agentData.QueryFilterClass : *GetDefaultQueryFilter();
+						const auto cacheHit = ant->Settings->bNavSurfaceCache && currentLoc.NodeRef != INVALID_NAVNODEREF
+							&& MoveAlongCachedSurface(currentLoc.NodeRef, agentData.Location, agentData.Location + agentData.Velocity, queryFilter, newLoc);
+
+						if (!cacheHit && !GetRecastNavMeshImpl()->FindMoveAlongSurface(currentLoc, FVector(agentData.Location + agentData.Velocity), newLoc, queryFilter, nullptr))
+						{
+							newLoc.NodeRef = INVALID_NAVNODEREF;
+							newLoc.Location = FVector(agentData.Location + agentData.Velocity);
 
-						// apply gravity
-						//newLoc.Location.Z -= ant->Settings->Gravity;
+							// apply gravity
+							//newLoc.Location.Z -= ant->Settings->Gravity;
+						}
 					}
+
+					agentData.NodeRef = newLoc.NodeRef;
+					agentData.Location = FVector3f(newLoc.Location);
+					agentData.Velocity = agentData.Location - oldLoc;
 				}
 
-				agentData.NodeRef = newLoc.NodeRef;
-				agentData.Location = FVector3f(newLoc.Location);
-				agentData.Velocity = agentData.Location - oldLoc;
+				agentData.bUpdateGrid = oldLoc != agentData.Location;
+				agentData.bSleep = agentData.OverlapForce == FVector2f::ZeroVector && !agentData.bUpdateGrid;
+				agentData.LocationLerped = ant->Settings->EnableLerp ? FMath::Lerp(agentData.LocationLerped, agentData.Location, agentData.LerpAlpha) : agentData.Location;
 			}
-
-			agentData.bUpdateGrid = oldLoc != agentData.Location;
-			agentData.bSleep = agentData.OverlapForce == FVector2f::ZeroVector && !agentData.bUpdateGrid;
-			agentData.LocationLerped = ant->Settings->EnableLerp ? FMath::Lerp(agentData.LocationLerped, agentData.Location, agentData.LerpAlpha) : agentData.Location;
 		});
 }
 
+const AAntRecastNavMesh::FPolyCache *AAntRecastNavMesh::FindPolyCache(NavNodeRef NodeRef)
+{
+	{
+		FReadScopeLock lock(PolyCacheLock);
+		if (const auto *cache = PolyCache.Find(NodeRef))
+			return cache->Get();
+	}
+
+	// build it outside of the lock, only ground polys
+	const auto *detourMesh = GetRecastNavMeshImpl()->DetourNavMesh;
+	const dtMeshTile *tile = nullptr;
+	const dtPoly *poly = nullptr;
+	if (!detourMesh || dtStatusFailed(detourMesh->getTileAndPolyByRef(NodeRef, &tile, &poly)) || poly->getType() != DT_POLYTYPE_GROUND)
+		return nullptr;
+
+	auto cache = MakeUnique<FPolyCache>();
+	for (int32 idx = 0; idx < poly->vertCount; ++idx)
+		cache->Verts.Add(FVector3f(Recast2UnrealPoint(&tile->verts[poly->verts[idx] * 3])));
+
+	// heights come from the detail mesh, the poly itself can be far from the real surface on slopes and stairs
+	if (tile->detailMeshes)
+	{
+		const auto &detail = tile->detailMeshes[poly - tile->polys];
+		for (int32 triIdx = 0; triIdx < detail.triCount; ++triIdx)
+		{
+			const auto *tri = &tile->detailTris[(detail.triBase + triIdx) * 4];
+			for (int32 idx = 0; idx < 3; ++idx)
+			{
+				const auto *vert = tri[idx] < poly->vertCount ? &tile->verts[poly->verts[tri[idx]] * 3] : &tile->detailVerts[(detail.vertBase + tri[idx] - poly->vertCount) * 3];
+				cache->DetailTris.Add(FVector3f(Recast2UnrealPoint(vert)));
+			}
+		}
+	}
+	else
+	{
+		for (int32 idx = 1; idx + 1 < poly->vertCount; ++idx)
+		{
+			cache->DetailTris.Add(cache->Verts[0]);
+			cache->DetailTris.Add(cache->Verts[idx]);
+			cache->DetailTris.Add(cache->Verts[idx + 1]);
+		}
+	}
+
+	// tile border edges can be split between several polys, each link only covers its bmin/bmax part of the edge
+	cache->Tiles.Add(GetRecastNavMeshImpl()->GetTileIndexFromPolyRef(NodeRef));
+	for (auto linkIdx = poly->firstLink; linkIdx != DT_NULL_LINK; linkIdx = tile->links[linkIdx].next)
+	{
+		const auto &link = tile->links[linkIdx];
+		if (link.edge >= poly->vertCount)
+			continue;
+
+		auto &portal = cache->Portals.AddDefaulted_GetRef();
+		portal.Ref = link.ref;
+		portal.Edge = link.edge;
+		if (link.side != 0xff)
+		{
+			portal.TMin = link.bmin / 255.0f;
+			portal.TMax = link.bmax / 255.0f;
+		}
+
+		cache->Tiles.AddUnique(GetRecastNavMeshImpl()->GetTileIndexFromPolyRef(link.ref));
+	}
+
+	FWriteScopeLock lock(PolyCacheLock);
+
+	// another thread may have built it meanwhile
+	if (const auto *existing = PolyCache.Find(NodeRef))
+		return existing->Get();
+
+	return PolyCache.Add(NodeRef, MoveTemp(cache)).Get();
+}
+
+bool AAntRecastNavMesh::MoveAlongCachedSurface(NavNodeRef StartRef, const FVector3f &Start, const FVector3f &End, const FNavigationQueryFilter &QueryFilter, FNavLocation &OutLocation)
+{
+	const auto *startPoly = FindPolyCache(StartRef);
+	if (!startPoly || !IsInsidePoly2D(startPoly->Verts, Start))
+		return false;
+
+	float height = 0.0f;
+
+	// small step inside the same poly
+	if (IsInsidePoly2D(startPoly->Verts, End))
+	{
+		if (!GetTrianglesHeight2D(startPoly->DetailTris, End, height))
+			return false;
+
+		OutLocation = FNavLocation(FVector(End.X, End.Y, height), StartRef);
+		return true;
+	}
+
+	// crossing one edge through a portal into a poly accepted by the filter
+	const auto numVerts = startPoly->Verts.Num();
+	for (int32 idx = 0; idx < numVerts; ++idx)
+	{
+		const auto &edgeA = startPoly->Verts[idx];
+		const auto &edgeB = startPoly->Verts[(idx + 1) % numVerts];
+		if (!SegmentsIntersect2D(Start, End, edgeA, edgeB))
+			continue;
+
+		// where the move crosses the edge, 0 at edgeA and 1 at edgeB
+		const auto sideA = EdgeSide2D(Start, End, edgeA);
+		const auto sideB = EdgeSide2D(Start, End, edgeB);
+		const auto crossT = sideA / (sideA - sideB);
+
+		const FPolyPortal *portal = startPoly->Portals.FindByPredicate([idx, crossT](const FPolyPortal &it)
+			{
+				return it.Edge == idx && crossT >= it.TMin && crossT <= it.TMax;
+			});
+
+		// wall, Detour slides along it
+		if (!portal)
+			return false;
+
+		const auto nextRef = portal->Ref;
+		const auto *filter = static_cast<const FRecastQueryFilter *>(QueryFilter.GetImplementation());
+		const dtMeshTile *tile = nullptr;
+		const dtPoly *poly = nullptr;
+		if (!filter || dtStatusFailed(GetRecastNavMeshImpl()->DetourNavMesh->getTileAndPolyByRef(nextRef, &tile, &poly)) || !filter->passFilter(nextRef, tile, poly))
+			return false;
+
+		const auto *nextPoly = FindPolyCache(nextRef);
+		if (!nextPoly || !IsInsidePoly2D(nextPoly->Verts, End) || !GetTrianglesHeight2D(nextPoly->DetailTris, End, height))
+			return false;
+
+		OutLocation = FNavLocation(FVector(End.X, End.Y, height), nextRef);
+		return true;
+	}
+
+	return false;
+}
+
 bool AAntRecastNavMesh::GetHeightAt(const FVector &NavLocation, const FNavigationQueryFilter &QueryFilter, const FVector &Extent, FVector &Result) const
 {
 	FNavLocation result;
@@ -398,6 +789,8 @@ void AAntRecastNavMesh::EndPlay(const EEndPlayReason::Type EndPlayReason)
 	TileData.Reset();
 	TileGrid.Reset();
 	NavModifiers.Reset();
+	PolyCache.Reset();
+	ReplanQueue.Reset();
 }
 
 void AAntRecastNavMesh::BeginPlay()
@@ -423,4 +816,59 @@ void AAntRecastNavMesh::BeginPlay()
 	// bind to get notify about navigation update
 	if (!ant->OnUpdateNav.IsBoundToObject(this))
 		ant->OnUpdateNav.BindUObject(this, &AAntRecastNavMesh::OnAntPxPostUpdate);
-}
\ No newline at end of file
+
+	// bind to resolve path work on the fixed steps
+	if (!ant->OnPxPostUpdate.IsBoundToObject(this))
+		ant->OnPxPostUpdate.AddUObject(this, &AAntRecastNavMesh::OnAntFixedStep);
+}
+
+void AAntRecastNavMesh::TickActor(float DeltaTime, enum ELevelTick TickType, FActorTickFunction &ThisTickFunction)
+{
+	Super::TickActor(DeltaTime, TickType, ThisTickFunction);
+
+	// deterministic mode resolves path work on the fixed steps, see OnAntFixedStep
+	auto *ant = GetWorld()->GetSubsystem<UAntSubsystem>();
+	if (ant && ant->Settings->bDeterministic)
+		return;
+
+	if (GetWorld()->WorldType == EWorldType::PIE || GetWorld()->WorldType == EWorldType::Game)
+	{
+		ProcessReplanQueue();
+		ProcessSquadStragglers();
+	}
+}
+
+void AAntRecastNavMesh::OnAntFixedStep(float DeltaMul)
+{
+	auto *ant = GetWorld()->GetSubsystem<UAntSubsystem>();
+	if (!ant || !ant->Settings->bDeterministic)
+		return;
+
+	if (GetWorld()->WorldType == EWorldType::PIE || GetWorld()->WorldType == EWorldType::Game)
+	{
+		ProcessReplanQueue();
+		ProcessSquadStragglers();
+	}
+}
+
+void AAntRecastNavMesh::ProcessSquadStragglers()
+{
+	auto *ant = GetWorld()->GetSubsystem<UAntSubsystem>();
+	if (!ant || ant->SquadStragglers.IsEmpty())
+		return;
+
+	// copy, moving the agents releases their squad paths
+	const auto stragglers = ant->SquadStragglers;
+	ant->SquadStragglers.Reset();
+	for (const auto &handle : stragglers)
+	{
+		if (!ant->IsValidMovement(handle) || !ant->GetAgentMovement(handle).bSquad || !ant->IsValidPath(ant->GetAgentMovement(handle).GetPath()))
+			continue;
+
+		const auto &moveData = ant->GetAgentMovement(handle);
+		const auto &pathData = ant->GetPathData(moveData.GetPath());
+		UAntUtil::MoveAgentsToLocations(GetWorld(), { handle }, { moveData.GetDestinationLocation() }, { moveData.MaxSpeed }, { moveData.Acceleration }, { moveData.Deceleration },
+			FMath::Sqrt(moveData.TargetRadiusSquared), FMath::Sqrt(moveData.PathNodeRadiusSquared), EAntPathFollowerType::FlowField, pathData.SquadMemberWidth, moveData.MissingVelocityTimeout,
+			pathData.bSquadPathReplan, pathData.ReplanCostThreshold, pathData.SquadFilterClass);
+	}
+}
@@ -0,0 +1,747 @@
+// Copyright 2024 Lazy Marmot Games. All Rights Reserved.
+
+#include "AntReplicationComponent.h"
+#include "AntSubsystem.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "Serialization/BitReader.h"
+#include "Serialization/BitWriter.h"
+#include "HAL/IConsoleManager.h"
+
+int32 Ant_ReplicationStats = 0;
+FAutoConsoleVariableRef CVar_ReplicationStats(TEXT("ant.ReplicationStats"), Ant_ReplicationStats,
+	TEXT("Log replication bandwidth and refresh latency of each replication component once per second."), ECVF_Default);
+
+namespace
+{
+	enum ERecordType : uint8
+	{
+		RecordDelta = 0,
+		RecordFull,
+		RecordSpawn,
+		RecordDespawn
+	};
+
+	// sequence (16 bits) + number of records (16 bits)
+	constexpr int32 BunchHeaderBytes = 4;
+	constexpr int32 MaxBunchesPerSend = 8;
+	constexpr int32 SentRingSize = 128;
+
+	// delta records carry the low bits of their baseline sequence
+	constexpr int32 BaselineSeqBits = 6;
+	constexpr uint32 BaselineSeqMask = (1u << BaselineSeqBits) - 1;
+
+	// worst case of an index gap, and the budget estimate of a sorted one
+	constexpr int32 MaxGapBits = 33;
+	constexpr int32 EstimatedGapBits = 8;
+	constexpr int32 MaxRecordBits = 512;
+
+	constexpr int32 MaxVelocityValue = (1 << 20) - 1;
+	constexpr float DropRadiusScale = 1.1f;
+	constexpr float NearPriorityScale = 0.05f;
+	constexpr float SpawnPriorityScale = 4.0f;
+	constexpr float ViewReportInterval = 0.25f;
+
+	// zigzag value in one of four widths, zero costs a single bit
+	constexpr int32 ValueWidths[4] = { 4, 8, 14, 32 };
+
+	FORCEINLINE bool IsNewerSeq(uint16 A, uint16 B)
+	{
+		return int16(uint16(A - B)) > 0;
+	}
+
+	void WriteValue(FBitWriter &Writer, int32 Value)
+	{
+		uint32 zigzag = (uint32(Value) << 1) ^ uint32(Value >> 31);
+		Writer.WriteBit(zigzag != 0);
+		if (zigzag == 0)
+			return;
+
+		uint32 width = 0;
+		while (width < 3 && zigzag >= (1u << ValueWidths[width]))
+			++width;
+
+		Writer.SerializeBits(&width, 2);
+		Writer.SerializeBits(&zigzag, ValueWidths[width]);
+	}
+
+	int32 ReadValue(FBitReader &Reader)
+	{
+		if (!Reader.ReadBit())
+			return 0;
+
+		uint32 width = 0;
+		Reader.SerializeBits(&width, 2);
+
+		uint32 zigzag = 0;
+		Reader.SerializeBits(&zigzag, ValueWidths[width]);
+		return int32(zigzag >> 1) ^ -int32(zigzag & 1);
+	}
+
+	void WriteVector(FBitWriter &Writer, const FIntVector &Value)
+	{
+		WriteValue(Writer, Value.X);
+		WriteValue(Writer, Value.Y);
+		WriteValue(Writer, Value.Z);
+	}
+
+	FIntVector ReadVector(FBitReader &Reader)
+	{
+		FIntVector value;
+		value.X = ReadValue(Reader);
+		value.Y = ReadValue(Reader);
+		value.Z = ReadValue(Reader);
+		return value;
+	}
+}
+
+UAntReplicationComponent::UAntReplicationComponent()
+{
+	PrimaryComponentTick.bCanEverTick = true;
+	SetIsReplicatedByDefault(true);
+	SentBunches.SetNum(SentRingSize);
+}
+
+void UAntReplicationComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction *ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	auto *antSubsystem = GetWorld()->GetSubsystem<UAntSubsystem>();
+	auto *playerController = Cast<APlayerController>(GetOwner());
+	if (!antSubsystem || !playerController)
+		return;
+
+	UpdateStats(DeltaTime);
+
+	// server: stream agents to the owning client within the bandwidth budget
+	if (IsRemoteServer())
+	{
+		ByteCredit = FMath::Min(ByteCredit + MaxBytesPerSecond * DeltaTime, MaxBytesPerSecond * FMath::Max(SendInterval, DeltaTime) * 2.0f);
+		SendTimer += DeltaTime;
+		if (SendTimer < SendInterval || ByteCredit <= 0.0f)
+			return;
+
+		// until the client reports its view
+		if (!bHasView)
+		{
+			FRotator viewRotation;
+			playerController->GetPlayerViewPoint(ViewLocation, viewRotation);
+		}
+
+		SendAgents(antSubsystem, SendTimer);
+		SendTimer = 0.0f;
+		return;
+	}
+
+	if (GetNetMode() != NM_Client)
+		return;
+
+	// client: move the mirrors between updates
+	ExtrapolateMirrors(antSubsystem, DeltaTime);
+
+	// client: acknowledge received bunches, report the view meanwhile
+	ViewTimer += DeltaTime;
+	if (!bPendingAck && ViewTimer < ViewReportInterval)
+		return;
+
+	FVector viewLocation;
+	FRotator viewRotation;
+	playerController->GetPlayerViewPoint(viewLocation, viewRotation);
+	if (bPendingAck)
+		ServerAckAgents(LatestSeq, AckBits, viewLocation);
+	else
+		ServerUpdateView(viewLocation);
+
+	bPendingAck = false;
+	ViewTimer = 0.0f;
+}
+
+void UAntReplicationComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (auto *antSubsystem = GetWorld()->GetSubsystem<UAntSubsystem>())
+		ClearMirrors(antSubsystem);
+
+	Super::EndPlay(EndPlayReason);
+}
+
+FAntHandle UAntReplicationComponent::GetLocalAgent(int32 ServerIdx) const
+{
+	const auto *mirror = Mirrors.Find(ServerIdx);
+	return mirror ? mirror->Local : FAntHandle();
+}
+
+UAntReplicationComponent::FRepState UAntReplicationComponent::Quantize(const FAntAgentData &Agent, float LocationQuantum) const
+{
+	FRepState state;
+	const auto location = Agent.GetLocation() / LocationQuantum;
+	state.Location = FIntVector(FMath::RoundToInt(location.X), FMath::RoundToInt(location.Y), FMath::RoundToInt(location.Z));
+
+	const auto velocity = Agent.GetVelocity() / FMath::Max(VelocityQuantum, UE_KINDA_SMALL_NUMBER);
+	state.Velocity.X = FMath::Clamp(FMath::RoundToInt(velocity.X), -MaxVelocityValue, MaxVelocityValue);
+	state.Velocity.Y = FMath::Clamp(FMath::RoundToInt(velocity.Y), -MaxVelocityValue, MaxVelocityValue);
+	state.Velocity.Z = FMath::Clamp(FMath::RoundToInt(velocity.Z), -MaxVelocityValue, MaxVelocityValue);
+
+	state.FaceAngle = uint8(FMath::RoundToInt(Agent.FaceAngle * 256.0f / UE_TWO_PI) & 0xFF);
+	return state;
+}
+
+void UAntReplicationComponent::ApplyState(UAntSubsystem *AntSubsystem, const FMirror &Mirror, const FRepState &State, float LocationQuantum) const
+{
+	AntSubsystem->SetAgentLocation(Mirror.Local, FVector(State.Location) * LocationQuantum);
+
+	auto &agent = AntSubsystem->GetMutableAgentData(Mirror.Local);
+	agent.FaceAngle = agent.FinalFaceAngle = FMath::UnwindRadians(State.FaceAngle * UE_TWO_PI / 256.0f);
+	agent.Velocity = FVector3f(State.Velocity) * FMath::Max(VelocityQuantum, UE_KINDA_SMALL_NUMBER);
+}
+
+float UAntReplicationComponent::GetLocationQuantum(const UAntSubsystem *AntSubsystem) const
+{
+	return AntSubsystem->GetSettings()->CollisionCellSize / float(1 << FMath::Clamp(LocationSubBits, 0, 12));
+}
+
+bool UAntReplicationComponent::IsExtrapolated(const FRepAgent &Rep, const FRepState &State, const FAntAgentData &Agent, double Time, float LocationQuantum, float StepInterval) const
+{
+	// a turn shows up as a face angle change before the location drifts
+	if (FMath::Abs(int32(int8(State.FaceAngle - Rep.Baseline.FaceAngle))) > 2)
+		return false;
+
+	// same prediction as ExtrapolateMirrors, the velocity is the displacement of one collision step
+	const auto elapsed = FMath::Clamp(Time - Rep.BaselineTime, 0.0, double(MaxExtrapolationTime));
+	const auto predicted = FVector(Rep.Baseline.Location) * LocationQuantum + FVector(Rep.Baseline.Velocity) * FMath::Max(VelocityQuantum, UE_KINDA_SMALL_NUMBER) * (elapsed / StepInterval);
+	return FVector::DistSquared(predicted, FVector(Agent.GetLocation())) <= FMath::Square(ExtrapolationTolerance);
+}
+
+bool UAntReplicationComponent::IsRemoteServer() const
+{
+	const auto *playerController = Cast<APlayerController>(GetOwner());
+	return playerController && GetOwnerRole() == ROLE_Authority && !playerController->IsLocalController();
+}
+
+void UAntReplicationComponent::SendAgents(UAntSubsystem *AntSubsystem, float Delta)
+{
+	SCOPE_CYCLE_COUNTER(STAT_ANT_Replication);
+
+	const auto &agents = AntSubsystem->GetUnderlyingAgentsList();
+	const auto locQuantum = GetLocationQuantum(AntSubsystem);
+	const auto radius = FMath::Max(RelevancyRadius, 1.0f);
+	const auto radiusSq = FMath::Square(radius);
+	const auto dropRadiusSq = FMath::Square(radius * DropRadiusScale);
+	const auto now = GetWorld()->GetTimeSeconds();
+	const auto stepInterval = FMath::Max(AntSubsystem->GetSettings()->CollisionTickInterval, UE_KINDA_SMALL_NUMBER);
+	++CurrentStamp;
+
+	// relevancy and priority by view distance
+	Candidates.Reset();
+	for (auto it = agents.CreateConstIterator(); it; ++it)
+	{
+		const auto &agent = *it;
+		if ((agent.GetFlag() & ReplicatedFlags) == 0)
+			continue;
+
+		const auto handle = agent.GetHandle();
+		if (handle.Idx >= RepAgents.Num())
+			RepAgents.SetNum(handle.Idx + 1);
+
+		// slot reused by a new agent, its spawn replaces the old mirror
+		auto &rep = RepAgents[handle.Idx];
+		if (rep.Ver != handle.Ver)
+		{
+			const auto wasKnown = rep.bKnown;
+			const auto epoch = uint16(rep.Epoch + 1);
+			rep = FRepAgent();
+			rep.Ver = handle.Ver;
+			rep.Epoch = epoch;
+			rep.bKnown = wasKnown;
+		}
+
+		rep.Stamp = CurrentStamp;
+
+		// known agents get a larger radius so the ones on the edge don't flicker
+		const auto distSq = FVector::DistSquared(FVector(agent.GetLocation()), ViewLocation);
+		if (distSq > (rep.bKnown && !rep.bDespawning ? dropRadiusSq : radiusSq))
+		{
+			if (rep.bKnown && !rep.bDespawning)
+			{
+				rep.bDespawning = true;
+				rep.Priority = 0.0f;
+				++rep.Epoch;
+			}
+			continue;
+		}
+
+		// relevant again before the despawn was acknowledged
+		if (rep.bDespawning)
+		{
+			rep.bDespawning = rep.bSpawnAcked = rep.bHasBaseline = false;
+			++rep.Epoch;
+		}
+
+		// the client already has the current state, or extrapolates it close enough
+		if (rep.bHasBaseline && rep.NumSent == rep.BaselineSendIdx)
+		{
+			const auto state = Quantize(agent, locQuantum);
+			if (state == rep.Baseline || IsExtrapolated(rep, state, agent, now, locQuantum, stepInterval))
+			{
+				rep.Priority = 0.0f;
+				continue;
+			}
+		}
+
+		// closer agents and unacknowledged spawns are refreshed more often
+		auto weight = radius / (FMath::Sqrt(distSq) + radius * NearPriorityScale);
+		if (!rep.bSpawnAcked)
+			weight *= SpawnPriorityScale;
+
+		rep.Priority += weight * Delta;
+		Candidates.Emplace(rep.Priority, it.GetIndex());
+	}
+
+	// removed agents, despawns are repeated until acknowledged
+	const auto budgetBits = FMath::Min<int64>(int64(ByteCredit) * 8, int64(MaxBunchesPerSend) * MaxBunchBytes * 8);
+	int64 usedBits = 0;
+	Outgoing.Reset();
+	for (int32 idx = 0; idx < RepAgents.Num(); ++idx)
+	{
+		auto &rep = RepAgents[idx];
+		if (rep.bKnown && !rep.bDespawning && rep.Stamp != CurrentStamp)
+		{
+			rep.bDespawning = true;
+			++rep.Epoch;
+		}
+
+		if (!rep.bDespawning || usedBits >= budgetBits)
+			continue;
+
+		auto &record = Outgoing.AddDefaulted_GetRef();
+		record.Idx = idx;
+		record.Ver = rep.Ver;
+		record.Epoch = rep.Epoch;
+		record.Type = RecordDespawn;
+		usedBits += EstimatedGapBits + 2;
+	}
+
+	// highest priority first until the budget is spent
+	Candidates.Sort([](const TPair<float, int32> &A, const TPair<float, int32> &B) { return A.Key > B.Key; });
+	FBitWriter scratch(MaxRecordBits, true);
+	for (const auto &candidate : Candidates)
+	{
+		const auto &agent = agents[candidate.Value];
+		const auto handle = agent.GetHandle();
+		auto &rep = RepAgents[handle.Idx];
+
+		FSentRecord record;
+		record.State = Quantize(agent, locQuantum);
+		record.Idx = handle.Idx;
+		record.AgentIdx = candidate.Value;
+		record.Ver = rep.Ver;
+		record.Epoch = rep.Epoch;
+
+		// delta only if the client still keeps the baseline in its history
+		if (!rep.bSpawnAcked)
+			record.Type = RecordSpawn;
+		else if (rep.bHasBaseline && rep.NumSent - rep.BaselineSendIdx < FMirror::HistorySize && uint16(NextSeq + MaxBunchesPerSend - rep.BaselineSeq) <= BaselineSeqMask)
+			record.Type = RecordDelta;
+		else
+			record.Type = RecordFull;
+
+		scratch.Reset();
+		WriteRecord(scratch, record, &agent, locQuantum);
+		usedBits += scratch.GetNumBits() + EstimatedGapBits;
+		if (usedBits > budgetBits)
+			break;
+
+		record.SendIdx = ++rep.NumSent;
+		rep.Priority = 0.0f;
+		rep.bKnown = true;
+		Outgoing.Add(record);
+	}
+
+	if (Outgoing.IsEmpty())
+		return;
+
+	// sorted by index so gaps stay small
+	Outgoing.Sort([](const FSentRecord &A, const FSentRecord &B) { return A.Idx < B.Idx; });
+
+	const auto bunchBits = int64(FMath::Max(MaxBunchBytes - BunchHeaderBytes, 64)) * 8;
+	FBitWriter writer(bunchBits, true);
+	TArray<FSentRecord> records;
+	int32 prevIdx = 0;
+	for (const auto &record : Outgoing)
+	{
+		scratch.Reset();
+		WriteRecord(scratch, record, record.AgentIdx != INDEX_NONE ? &agents[record.AgentIdx] : nullptr, locQuantum);
+		if (!records.IsEmpty() && writer.GetNumBits() + MaxGapBits + scratch.GetNumBits() > bunchBits)
+		{
+			FlushBunch(writer, records);
+			prevIdx = 0;
+		}
+
+		WriteValue(writer, record.Idx - prevIdx);
+		writer.SerializeBits(scratch.GetData(), scratch.GetNumBits());
+		prevIdx = record.Idx;
+		records.Add(record);
+	}
+
+	FlushBunch(writer, records);
+}
+
+void UAntReplicationComponent::WriteRecord(FBitWriter &Writer, const FSentRecord &Record, const FAntAgentData *Agent, float LocationQuantum) const
+{
+	uint32 type = Record.Type;
+	Writer.SerializeBits(&type, 2);
+	if (Record.Type == RecordDespawn)
+		return;
+
+	const auto &state = Record.State;
+	if (Record.Type == RecordDelta)
+	{
+		const auto &rep = RepAgents[Record.Idx];
+		const auto &baseline = rep.Baseline;
+
+		uint32 baselineSeq = rep.BaselineSeq & BaselineSeqMask;
+		Writer.SerializeBits(&baselineSeq, BaselineSeqBits);
+		WriteVector(Writer, state.Location - baseline.Location);
+
+		const auto faceChanged = state.FaceAngle != baseline.FaceAngle;
+		Writer.WriteBit(faceChanged);
+		if (faceChanged)
+		{
+			auto faceAngle = state.FaceAngle;
+			Writer.SerializeBits(&faceAngle, 8);
+		}
+
+		const auto velocityChanged = state.Velocity != baseline.Velocity;
+		Writer.WriteBit(velocityChanged);
+		if (velocityChanged)
+			WriteVector(Writer, state.Velocity - baseline.Velocity);
+
+		return;
+	}
+
+	WriteVector(Writer, state.Location);
+	auto faceAngle = state.FaceAngle;
+	Writer.SerializeBits(&faceAngle, 8);
+	WriteVector(Writer, state.Velocity);
+
+	if (Record.Type == RecordSpawn)
+	{
+		WriteValue(Writer, FMath::RoundToInt(Agent->GetRadius() / LocationQuantum));
+		WriteValue(Writer, FMath::RoundToInt(Agent->GetHeight() / LocationQuantum));
+		uint32 flag = Agent->GetFlag();
+		Writer.SerializeBits(&flag, 32);
+	}
+}
+
+void UAntReplicationComponent::FlushBunch(FBitWriter &Writer, TArray<FSentRecord> &Records)
+{
+	if (Records.IsEmpty())
+		return;
+
+	const auto seq = NextSeq++;
+	TArray<uint8> bunch;
+	bunch.Reserve(BunchHeaderBytes + Writer.GetNumBytes());
+	bunch.Add(uint8(seq));
+	bunch.Add(uint8(seq >> 8));
+	bunch.Add(uint8(Records.Num()));
+	bunch.Add(uint8(Records.Num() >> 8));
+	bunch.Append(Writer.GetData(), Writer.GetNumBytes());
+
+	ClientReceiveAgents(bunch);
+	ByteCredit -= bunch.Num();
+	INC_DWORD_STAT_BY(STAT_ANT_ReplicatedBytes, bunch.Num());
+	StatsBytes += bunch.Num();
+
+	// kept until acknowledged, an overwritten slot is a lost bunch
+	auto &sent = SentBunches[seq % SentRingSize];
+	sent.Records = MoveTemp(Records);
+	sent.Seq = seq;
+	sent.SendTime = GetWorld()->GetTimeSeconds();
+	sent.bPending = true;
+
+	Records.Reset();
+	Writer.Reset();
+}
+
+void UAntReplicationComponent::ProcessAck(uint16 Seq)
+{
+	auto &bunch = SentBunches[Seq % SentRingSize];
+	if (!bunch.bPending || bunch.Seq != Seq)
+		return;
+
+	bunch.bPending = false;
+	StatsLatencySum += GetWorld()->GetTimeSeconds() - bunch.SendTime;
+	++StatsLatencyNum;
+
+	for (const auto &record : bunch.Records)
+	{
+		// records of a previous agent or relevancy period
+		auto &rep = RepAgents[record.Idx];
+		if (rep.Ver != record.Ver || rep.Epoch != record.Epoch)
+			continue;
+
+		if (record.Type == RecordDespawn)
+		{
+			const auto ver = rep.Ver;
+			const auto epoch = uint16(rep.Epoch + 1);
+			rep = FRepAgent();
+			rep.Ver = ver;
+			rep.Epoch = epoch;
+			continue;
+		}
+
+		rep.bSpawnAcked = true;
+		if (!rep.bHasBaseline || IsNewerSeq(Seq, rep.BaselineSeq))
+		{
+			rep.Baseline = record.State;
+			rep.BaselineTime = bunch.SendTime;
+			rep.BaselineSeq = Seq;
+			rep.BaselineSendIdx = record.SendIdx;
+			rep.bHasBaseline = true;
+		}
+	}
+}
+
+void UAntReplicationComponent::ServerAckAgents_Implementation(uint16 InLatestSeq, uint32 InAckBits, FVector_NetQuantize InViewLocation)
+{
+	ViewLocation = InViewLocation;
+	bHasView = true;
+
+	ProcessAck(InLatestSeq);
+	for (int32 bit = 0; bit < 32; ++bit)
+		if (InAckBits & (1u << bit))
+			ProcessAck(uint16(InLatestSeq - 1 - bit));
+}
+
+void UAntReplicationComponent::ServerUpdateView_Implementation(FVector_NetQuantize InViewLocation)
+{
+	ViewLocation = InViewLocation;
+	bHasView = true;
+}
+
+void UAntReplicationComponent::ClientReceiveAgents_Implementation(const TArray<uint8> &Bunch)
+{
+	auto *antSubsystem = GetWorld()->GetSubsystem<UAntSubsystem>();
+	if (!antSubsystem || Bunch.Num() < BunchHeaderBytes)
+		return;
+
+	SCOPE_CYCLE_COUNTER(STAT_ANT_Replication);
+	StatsBytes += Bunch.Num();
+
+	const auto seq = uint16(Bunch[0] | (Bunch[1] << 8));
+	const auto numRecords = int32(Bunch[2] | (Bunch[3] << 8));
+	const auto locQuantum = GetLocationQuantum(antSubsystem);
+	FBitReader reader(Bunch.GetData() + BunchHeaderBytes, int64(Bunch.Num() - BunchHeaderBytes) * 8);
+
+	// a record without its baseline leaves the bunch unacknowledged, the server falls back to full records
+	auto complete = true;
+	int32 idx = 0;
+	for (int32 recordIdx = 0; recordIdx < numRecords && !reader.IsError(); ++recordIdx)
+	{
+		idx += ReadValue(reader);
+		uint32 type = 0;
+		reader.SerializeBits(&type, 2);
+
+		FRepState state;
+		FIntVector velocityDelta = FIntVector::ZeroValue;
+		uint16 baselineSeq = 0;
+		uint32 flag = 0;
+		auto radius = 0.0f;
+		auto height = 0.0f;
+		auto faceChanged = false;
+		auto velocityChanged = false;
+		if (type == RecordDelta)
+		{
+			uint32 baselineLow = 0;
+			reader.SerializeBits(&baselineLow, BaselineSeqBits);
+			baselineSeq = uint16(seq - ((seq - baselineLow) & BaselineSeqMask));
+			state.Location = ReadVector(reader);
+
+			faceChanged = reader.ReadBit() != 0;
+			if (faceChanged)
+				reader.SerializeBits(&state.FaceAngle, 8);
+
+			velocityChanged = reader.ReadBit() != 0;
+			if (velocityChanged)
+				velocityDelta = ReadVector(reader);
+		}
+		else if (type != RecordDespawn)
+		{
+			state.Location = ReadVector(reader);
+			reader.SerializeBits(&state.FaceAngle, 8);
+			state.Velocity = ReadVector(reader);
+
+			if (type == RecordSpawn)
+			{
+				radius = ReadValue(reader) * locQuantum;
+				height = ReadValue(reader) * locQuantum;
+				reader.SerializeBits(&flag, 32);
+			}
+		}
+
+		if (reader.IsError())
+			break;
+
+		// despawned mirrors stay as tombstones so late records can't bring them back
+		auto &mirror = Mirrors.FindOrAdd(idx);
+		const auto newer = !mirror.bSeen || IsNewerSeq(seq, mirror.LastSeq);
+		const auto alive = antSubsystem->IsValidAgent(mirror.Local);
+		if (type == RecordDespawn)
+		{
+			if (newer)
+			{
+				if (alive)
+					antSubsystem->RemoveAgent(mirror.Local);
+
+				mirror.Local = FAntHandle();
+				mirror.HistoryNum = mirror.HistoryHead = 0;
+				mirror.LastSeq = seq;
+				mirror.bSeen = true;
+			}
+			continue;
+		}
+
+		if (type == RecordSpawn)
+		{
+			if (!alive && !newer)
+				continue;
+
+			if (!alive)
+			{
+				mirror.Local = antSubsystem->AddAgent(FVector(state.Location) * locQuantum, radius, height, 0.0f, flag);
+				auto &mirrorAgent = antSubsystem->GetMutableAgentData(mirror.Local);
+				mirrorAgent.bDisabled = true;
+				mirrorAgent.bReplicatedMirror = true;
+				mirror.HistoryNum = mirror.HistoryHead = 0;
+			}
+			else if (newer)
+			{
+				antSubsystem->SetAgentRadius(mirror.Local, radius);
+				antSubsystem->SetAgentHeight(mirror.Local, height);
+				antSubsystem->SetAgentFlag(mirror.Local, flag);
+			}
+		}
+		else if (!alive)
+		{
+			complete = false;
+			continue;
+		}
+		else if (type == RecordDelta)
+		{
+			const FRepState *baseline = nullptr;
+			for (int32 historyIdx = 0; historyIdx < mirror.HistoryNum && !baseline; ++historyIdx)
+				if (mirror.HistorySeq[historyIdx] == baselineSeq)
+					baseline = &mirror.History[historyIdx];
+
+			if (!baseline)
+			{
+				complete = false;
+				continue;
+			}
+
+			state.Location += baseline->Location;
+			state.Velocity = baseline->Velocity + velocityDelta;
+			if (!faceChanged)
+				state.FaceAngle = baseline->FaceAngle;
+		}
+
+		// every received state is a possible baseline, only the latest one is applied
+		mirror.History[mirror.HistoryHead] = state;
+		mirror.HistorySeq[mirror.HistoryHead] = seq;
+		mirror.HistoryHead = uint8((mirror.HistoryHead + 1) % FMirror::HistorySize);
+		mirror.HistoryNum = uint8(FMath::Min(mirror.HistoryNum + 1, FMirror::HistorySize));
+
+		if (newer)
+		{
+			mirror.LastSeq = seq;
+			if (mirror.bSeen)
+			{
+				StatsLatencySum += mirror.SinceUpdate;
+				++StatsLatencyNum;
+			}
+
+			mirror.SinceUpdate = 0.0f;
+			mirror.bSeen = true;
+			ApplyState(antSubsystem, mirror, state, locQuantum);
+		}
+	}
+
+	if (!complete || reader.IsError())
+		return;
+
+	// latest sequence and a mask of the 32 previous ones
+	if (!bHasLatestSeq)
+	{
+		LatestSeq = seq;
+		AckBits = 0;
+		bHasLatestSeq = true;
+	}
+	else if (IsNewerSeq(seq, LatestSeq))
+	{
+		const uint32 shift = uint16(seq - LatestSeq);
+		AckBits = shift < 32 ? (AckBits << shift) | (1u << (shift - 1)) : (shift == 32 ? 1u << 31 : 0);
+		LatestSeq = seq;
+	}
+	else
+	{
+		const uint32 age = uint16(LatestSeq - seq);
+		if (age >= 1 && age <= 32)
+			AckBits |= 1u << (age - 1);
+	}
+
+	bPendingAck = true;
+}
+
+void UAntReplicationComponent::ExtrapolateMirrors(UAntSubsystem *AntSubsystem, float Delta)
+{
+	// the velocity is the displacement of one collision step
+	const auto step = FMath::Max(AntSubsystem->GetSettings()->CollisionTickInterval, UE_KINDA_SMALL_NUMBER);
+	for (auto &it : Mirrors)
+	{
+		auto &mirror = it.Value;
+		if (!AntSubsystem->IsValidAgent(mirror.Local))
+			continue;
+
+		// stop after MaxExtrapolationTime, the mirror waits for its next update
+		const auto delta = FMath::Clamp(MaxExtrapolationTime - mirror.SinceUpdate, 0.0f, Delta);
+		mirror.SinceUpdate += Delta;
+
+		const auto &agent = AntSubsystem->GetAgentData(mirror.Local);
+		if (delta > 0.0f && agent.GetVelocity() != FVector3f::ZeroVector)
+			AntSubsystem->SetAgentLocation(mirror.Local, FVector(agent.GetLocation() + agent.GetVelocity() * (delta / step)));
+	}
+}
+
+void UAntReplicationComponent::UpdateStats(float Delta)
+{
+	if (Ant_ReplicationStats <= 0)
+	{
+		StatsTime = StatsLatencySum = 0.0;
+		StatsBytes = 0;
+		StatsLatencyNum = 0;
+		return;
+	}
+
+	StatsTime += Delta;
+	if (StatsTime < 1.0)
+		return;
+
+	// server: sent bytes and bunch round trip until acknowledged, client: received bytes and time between two updates of a mirror
+	const auto latencyMs = StatsLatencyNum > 0 ? StatsLatencySum / StatsLatencyNum * 1000.0 : 0.0;
+	if (IsRemoteServer())
+		UE_LOG(LogAnt, Log, TEXT("[%s] Replication sent %.0f bytes/s, ack round trip %.1f ms"), *GetOwner()->GetName(), StatsBytes / StatsTime, latencyMs);
+	else if (GetNetMode() == NM_Client)
+		UE_LOG(LogAnt, Log, TEXT("[%s] Replication received %.0f bytes/s, %i mirrors, refresh interval %.1f ms"), *GetOwner()->GetName(), StatsBytes / StatsTime, Mirrors.Num(), latencyMs);
+
+	StatsTime = StatsLatencySum = 0.0;
+	StatsBytes = 0;
+	StatsLatencyNum = 0;
+}
+
+void UAntReplicationComponent::ClearMirrors(UAntSubsystem *AntSubsystem)
+{
+	for (const auto &it : Mirrors)
+		if (AntSubsystem->IsValidAgent(it.Value.Local))
+			AntSubsystem->RemoveAgent(it.Value.Local);
+
+	Mirrors.Empty();
+}
@@ -55,6 +55,12 @@ constexpr uint8 SlotQry = 0;
 //	}
 //}
 
+// paths with fewer portals than this are scanned linearly
+constexpr int32 MinIndexedCorridorPortals = 16;
+
+// maximum number of the corridor index cells per axis
+constexpr int32 MaxCorridorIndexCells = 64;
+
 FAntCorridorLocation FAntPathData::FindNearestLocationOnCorridor(const FVector &NavLocation, int32 StartIndex) const
 {
 	using FReal = FVector::FReal;
@@ -67,31 +73,137 @@ FAntCorridorLocation FAntPathData::FindNearestLocationOnCorridor(const FVector &
 	FReal NearestDistanceSq = MAX_dbl;
 	FAntCorridorLocation Result;
 
-	for (int32 PortalIndex = StartIndex; PortalIndex < Data.Num() - 1; PortalIndex++)
+	// test one portal quad, ties go to the lower portal index like the linear scan
+	const auto TestPortal = [&](int32 PortalIndex)
 	{
 		const auto &CurrPortal = Data[PortalIndex];
 		const auto &NextPortal = Data[PortalIndex + 1];
 
 		const auto UV = UE::AI::InvBilinear2D(NavLocation, CurrPortal.Left, CurrPortal.Right, NextPortal.Right, NextPortal.Left);
 		const FVector NearestSectionLocation = UE::AI::Bilinear(UV.ClampAxes(0.0, 1.0), CurrPortal.Left, CurrPortal.Right, NextPortal.Right, NextPortal.Left);
-		const FReal SectionDistanceSq = FVector::DistSquared(NavLocation, NearestSectionLocation);
+		FReal SectionDistanceSq = FVector::DistSquared(NavLocation, NearestSectionLocation);
+		SectionDistanceSq = SectionDistanceSq < UE_KINDA_SMALL_NUMBER ? 0.0 : SectionDistanceSq;
 
-		if (SectionDistanceSq < NearestDistanceSq)
+		if (SectionDistanceSq < NearestDistanceSq || (SectionDistanceSq == NearestDistanceSq && PortalIndex < Result.PortalIndex))
 		{
 			NearestDistanceSq = SectionDistanceSq;
 			Result.VertT = static_cast<float>(UV.Y);
 			Result.HoriT = static_cast<float>(UV.X);
 			Result.NavLocation = NearestSectionLocation;
 			Result.PortalIndex = PortalIndex;
+		}
+	};
 
+	// fast path, still inside the hinted portal
+	StartIndex = FMath::Clamp(StartIndex, 0, Data.Num() - 2);
+	TestPortal(StartIndex);
+	if (NearestDistanceSq < UE_KINDA_SMALL_NUMBER)
+		return Result;
+
+	// short or not indexed path
+	if (CorridorIndex.CellStart.IsEmpty())
+	{
+		for (int32 PortalIndex = StartIndex + 1; PortalIndex < Data.Num() - 1; PortalIndex++)
+		{
+			TestPortal(PortalIndex);
 			if (NearestDistanceSq < UE_KINDA_SMALL_NUMBER)
 				break;
 		}
+
+		return Result;
+	}
+
+	// visit the index in rings around the cell of the location, until no farther ring can hold a closer quad
+	const auto local = (FVector2D(NavLocation) - CorridorIndex.Origin) / CorridorIndex.CellSize;
+	const auto cellX = FMath::Clamp(FMath::FloorToInt32(local.X), 0, CorridorIndex.NumX - 1);
+	const auto cellY = FMath::Clamp(FMath::FloorToInt32(local.Y), 0, CorridorIndex.NumY - 1);
+	const auto maxRing = FMath::Max(FMath::Max(cellX, CorridorIndex.NumX - 1 - cellX), FMath::Max(cellY, CorridorIndex.NumY - 1 - cellY));
+
+	for (int32 ring = 0; ring <= maxRing; ++ring)
+	{
+		for (int32 y = cellY - ring; y <= cellY + ring; ++y)
+			for (int32 x = cellX - ring; x <= cellX + ring; ++x)
+			{
+				// ring border only
+				if ((y != cellY - ring && y != cellY + ring && x != cellX - ring && x != cellX + ring) || x < 0 || y < 0 || x >= CorridorIndex.NumX || y >= CorridorIndex.NumY)
+					continue;
+
+				const auto cellIdx = y * CorridorIndex.NumX + x;
+				for (int32 itemIdx = CorridorIndex.CellStart[cellIdx]; itemIdx < CorridorIndex.CellStart[cellIdx + 1]; ++itemIdx)
+					if (CorridorIndex.Items[itemIdx] > StartIndex)
+						TestPortal(CorridorIndex.Items[itemIdx]);
+			}
+
+		// the distance from the location to anything outside of the visited block is at least ring * CellSize
+		const auto safeDist = ring * CorridorIndex.CellSize;
+		if (NearestDistanceSq < UE_KINDA_SMALL_NUMBER || NearestDistanceSq <= safeDist * safeDist)
+			break;
 	}
 
 	return Result;
 }
 
+void FAntPathData::RebuildCorridorIndex()
+{
+	CorridorIndex = FCorridorIndex();
+
+	const auto numQuads = Data.Num() - 1;
+	if (numQuads < MinIndexedCorridorPortals)
+		return;
+
+	// bounds of the portal quads
+	TArray<FBox2D> quadBounds;
+	quadBounds.SetNumUninitialized(numQuads);
+	FBox2D bounds(ForceInit);
+	for (int32 idx = 0; idx < numQuads; ++idx)
+	{
+		quadBounds[idx] = FBox2D(ForceInit);
+		quadBounds[idx] += FVector2D(Data[idx].Left);
+		quadBounds[idx] += FVector2D(Data[idx].Right);
+		quadBounds[idx] += FVector2D(Data[idx + 1].Left);
+		quadBounds[idx] += FVector2D(Data[idx + 1].Right);
+		bounds += quadBounds[idx];
+	}
+
+	const auto size = bounds.GetSize();
+	CorridorIndex.Origin = bounds.Min;
+	CorridorIndex.CellSize = FMath::Max3(static_cast<double>(Width), FMath::Max(size.X, size.Y) / MaxCorridorIndexCells, 1.0);
+	CorridorIndex.NumX = FMath::Clamp(FMath::CeilToInt32(size.X / CorridorIndex.CellSize), 1, MaxCorridorIndexCells);
+	CorridorIndex.NumY = FMath::Clamp(FMath::CeilToInt32(size.Y / CorridorIndex.CellSize), 1, MaxCorridorIndexCells);
+
+	// cell rect of a quad
+	const auto quadCells = [this, &quadBounds](int32 QuadIdx)
+	{
+		const auto min = (quadBounds[QuadIdx].Min - CorridorIndex.Origin) / CorridorIndex.CellSize;
+		const auto max = (quadBounds[QuadIdx].Max - CorridorIndex.Origin) / CorridorIndex.CellSize;
+		return FIntRect(FMath::Clamp(FMath::FloorToInt32(min.X), 0, CorridorIndex.NumX - 1), FMath::Clamp(FMath::FloorToInt32(min.Y), 0, CorridorIndex.NumY - 1),
+			FMath::Clamp(FMath::FloorToInt32(max.X), 0, CorridorIndex.NumX - 1), FMath::Clamp(FMath::FloorToInt32(max.Y), 0, CorridorIndex.NumY - 1));
+	};
+
+	// count, prefix sum and fill, quads stay sorted by index inside each cell
+	CorridorIndex.CellStart.Init(0, CorridorIndex.NumX * CorridorIndex.NumY + 1);
+	for (int32 idx = 0; idx < numQuads; ++idx)
+	{
+		const auto rect = quadCells(idx);
+		for (auto y = rect.Min.Y; y <= rect.Max.Y; ++y)
+			for (auto x = rect.Min.X; x <= rect.Max.X; ++x)
+				++CorridorIndex.CellStart[y * CorridorIndex.NumX + x + 1];
+	}
+
+	for (int32 cellIdx = 0; cellIdx < CorridorIndex.NumX * CorridorIndex.NumY; ++cellIdx)
+		CorridorIndex.CellStart[cellIdx + 1] += CorridorIndex.CellStart[cellIdx];
+
+	TArray<int32> cursor(CorridorIndex.CellStart.GetData(), CorridorIndex.NumX * CorridorIndex.NumY);
+	CorridorIndex.Items.SetNumUninitialized(CorridorIndex.CellStart.Last());
+	for (int32 idx = 0; idx < numQuads; ++idx)
+	{
+		const auto rect = quadCells(idx);
+		for (auto y = rect.Min.Y; y <= rect.Max.Y; ++y)
+			for (auto x = rect.Min.X; x <= rect.Max.X; ++x)
+				CorridorIndex.Items[cursor[y * CorridorIndex.NumX + x]++] = idx;
+	}
+}
+
 void FAntPathData::RebuildDistanceList()
 {
 	// calculate distance of the each waypoint on the path (reverse)
@@ -104,6 +216,9 @@ void FAntPathData::RebuildDistanceList()
 		if (idx > 0)
 			traveledDist += FVector::Distance(Data[idx - 1].Location, Data[idx].Location);
 	}
+
+	// portals changed
+	RebuildCorridorIndex();
 }
 
 UAntSubsystem::UAntSubsystem()
@@ -128,6 +243,7 @@ void UAntSubsystem::Initialize(FSubsystemCollectionBase &Collection)
 	BroadphaseGrid = new FAntGrid;
 	ShiftSize = Settings->CollisionCellSize * (Settings->NumCells / 2);
 	BroadphaseGrid->Reset(Settings->NumCells, Settings->CollisionCellSize, ShiftSize);
+	BroadphaseGrid->SetSortedContacts(Settings->bDeterministic);
 }
 
 void UAntSubsystem::Deinitialize()
@@ -146,6 +262,13 @@ void UAntSubsystem::Tick(float Delta)
 {
 	Super::Tick(Delta);
 
+	// lockstep mode runs whole fixed steps only
+	if (Settings->bDeterministic)
+	{
+		TickDeterministic(Delta);
+		return;
+	}
+
 	// checking for collsion update rate
 	// increase elapsed delta time
 	PxDeltaTime += Delta;
@@ -190,6 +313,63 @@ void UAntSubsystem::Tick(float Delta)
 		DebugDraw();
 }
 
+void UAntSubsystem::TickDeterministic(float Delta)
+{
+	const auto step = Settings->CollisionTickInterval;
+	PxDeltaTime += Delta;
+	for (int32 numSteps = 0; PxDeltaTime >= step && numSteps < Settings->MaxDeterministicSteps; ++numSteps)
+	{
+		PxDeltaTime -= step;
+
+		// pre-collision handler, lockstep inputs of this step go here
+		OnPxPreUpdate.Broadcast(1.0f);
+
+		{
+			SCOPE_CYCLE_COUNTER(STAT_ANT_TotalFrame);
+			UpdateMovements(step, 1.0f);
+			UpdateCollisionsAndQueries(step, true);
+		}
+
+		// post-collision handler
+		{
+			SCOPE_CYCLE_COUNTER(STAT_ANT_PostPX);
+			OnPxPostUpdate.Broadcast(1.0f);
+		}
+
+		DispatchAsyncQueries(step);
+		++SimulationTick;
+	}
+
+	// 
+	if (Ant_DebugDraw > 0 || Ant_DebugHeightSamp > 0)
+		DebugDraw();
+}
+
+uint32 UAntSubsystem::GetStateChecksum() const
+{
+	// agents in index order, each record is hashed field by field to skip the padding
+	uint32 crc = FCrc::MemCrc32(&SimulationTick, sizeof(SimulationTick));
+	for (auto it = Agents.CreateConstIterator(); it; ++it)
+	{
+		const auto idx = it.GetIndex();
+		crc = FCrc::MemCrc32(&idx, sizeof(idx), crc);
+		crc = FCrc::MemCrc32(&it->Location, sizeof(it->Location), crc);
+		crc = FCrc::MemCrc32(&it->Velocity, sizeof(it->Velocity), crc);
+		crc = FCrc::MemCrc32(&it->FaceAngle, sizeof(it->FaceAngle), crc);
+		crc = FCrc::MemCrc32(&it->Flag, sizeof(it->Flag), crc);
+	}
+
+	for (auto it = Movements.CreateConstIterator(); it; ++it)
+	{
+		const auto idx = it.GetIndex();
+		crc = FCrc::MemCrc32(&idx, sizeof(idx), crc);
+		crc = FCrc::MemCrc32(&it->Speed, sizeof(it->Speed), crc);
+		crc = FCrc::MemCrc32(&it->PathIndex, sizeof(it->PathIndex), crc);
+	}
+
+	return crc;
+}
+
 bool UAntSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
 {
 	return (WorldType == EWorldType::Game || WorldType == EWorldType::PIE);
@@ -204,6 +384,11 @@ FAntHandle UAntSubsystem::AddAgent(const FVector &Location, float Radius, float
 	Agents[dataIdx].Flag = Flags;
 	Agents[dataIdx].Height = Height;
 	Agents[dataIdx].FaceAngle = Agents[dataIdx].FinalFaceAngle = FaceAngle;
+	Agents[dataIdx].DenseIdx = DenseAgents.Add(dataIdx);
+
+	// default element in the typed user-data columns
+	for (auto &it : UserColumns)
+		it.Value->ResetElement(dataIdx);
 
 	// set it to the storage
 	const auto handle = AgentStorage.Add();
@@ -234,6 +419,13 @@ FInstancedStruct &UAntSubsystem::GetAgentUserData(FAntHandle Handle)
 	return UserData[dataIdx];
 }
 
+int32 UAntSubsystem::GetAgentIndex(FAntHandle Handle) const
+{
+	check(AgentStorage.IsValid(Handle) && "Invalid handle!");
+
+	return AgentStorage.Get(Handle, SlotAgt);
+}
+
 void UAntSubsystem::RemoveAgent(FAntHandle Handle)
 {
 	check(IsValidAgent(Handle) && "Invalid handle!");
@@ -251,9 +443,19 @@ void UAntSubsystem::RemoveAgent(FAntHandle Handle)
 	// remove agent from the grid
 	BroadphaseGrid->Remove(Agents[dataIdx].GridHandle);
 
+	// remove agent from the packed list, the last agent fills its place
+	const auto denseIdx = Agents[dataIdx].DenseIdx;
+	DenseAgents.RemoveAtSwap(denseIdx, EAllowShrinking::No);
+	if (DenseAgents.IsValidIndex(denseIdx))
+		Agents[DenseAgents[denseIdx]].DenseIdx = denseIdx;
+
 	// remove agent from the list
 	Agents.RemoveAt(dataIdx);
 
+	// release its typed user-data
+	for (auto &it : UserColumns)
+		it.Value->ResetElement(dataIdx);
+
 	// remove user data
 	if (userIdx != INDEX_NONE)
 		UserData.RemoveAt(userIdx);
@@ -269,6 +471,9 @@ void UAntSubsystem::ClearAgents()
 			RemoveAgent(Agents[idx].Handle);
 
 	Agents.Reset();
+	DenseAgents.Reset();
+	for (auto &it : UserColumns)
+		it.Value->Empty();
 }
 
 const FAntAgentData &UAntSubsystem::GetAgentData(FAntHandle Handle) const
@@ -455,6 +660,10 @@ void UAntSubsystem::RemoveAgentMovement(FAntHandle Handle, bool ShouldNotify)
 	if (IsValidPath(Movements[dataIdx].Path) && GetPathData(Movements[dataIdx].Path).Owner == Handle)
 		RemovePath(Movements[dataIdx].Path);
 
+	// release squad path
+	if (Movements[dataIdx].bSquad)
+		ReleaseSquadPath(Movements[dataIdx].Path);
+
 	// remove movement data
 	Movements.RemoveAt(dataIdx);
 
@@ -498,6 +707,10 @@ void UAntSubsystem::ClearMovements()
 		const auto dataIdx = AgentStorage.Get(it.Handle, SlotMov);
 		AgentStorage.Set(it.Handle, SlotMov, INDEX_NONE);
 
+		// release squad path
+		if (it.bSquad)
+			ReleaseSquadPath(it.Path);
+
 		// remove movement data
 		Movements.RemoveAt(dataIdx);
 	}
@@ -510,6 +723,12 @@ void UAntSubsystem::ClearMovements()
 	}
 }
 
+void UAntSubsystem::ReleaseSquadPath(FAntHandle PathHandle)
+{
+	if (IsValidPath(PathHandle) && --GetMutablePathData(PathHandle).SquadUsers <= 0)
+		RemovePath(PathHandle);
+}
+
 bool UAntSubsystem::IsValidMovement(FAntHandle Handle) const
 {
 	return (IsValidAgent(Handle) && AgentStorage.Get(Handle, SlotMov) != INDEX_NONE);
@@ -689,6 +908,12 @@ const FAntQueryData &UAntSubsystem::GetAsyncQueryData(FAntHandle Handle) const
 	return Queries[dataIdx];
 }
 
+TConstArrayView<FAntContactInfo> UAntSubsystem::GetAsyncQueryResult(FAntHandle Handle) const
+{
+	const auto &queryData = GetAsyncQueryData(Handle);
+	return MakeArrayView(QueryResults.GetData() + queryData.ResultStart, queryData.ResultNum);
+}
+
 FAntQueryData &UAntSubsystem::GetMutableAsyncQueryData(FAntHandle Handle)
 {
 	check(QueryStorage.IsValid(Handle) && "Invalid handle!");
@@ -804,7 +1029,7 @@ FVector3f UAntSubsystem::DefaultSolver(FAntAgentData &Agent)
 			if (it.SqDist < sqRadiusEx)
 			{
 				// mark collided agent to wake it up for next frame
-				auto &collidedAgent = GetMutableAgentData(it.Handle);
+				const auto collidedIdx = GetAgentIndex(it.Handle);
 
 				// stacking
 				const auto distDelta = sqRadiusEx - it.SqDist;
@@ -819,10 +1044,10 @@ FVector3f UAntSubsystem::DefaultSolver(FAntAgentData &Agent)
 				// non-stacking 
 				//else if (!CHECK_BIT_ANY(Agent.Flag, collidedAgent.StackFlag) || Agent.StackPriority == collidedAgent.StackPriority)
 				{
-					collidedAgent.bCollided = true;
+					MarkCollided(collidedIdx);
 
 					// skip ignored agents
-					if (CHECK_BIT_ANY(collidedAgent.Flag, Agent.IgnoreButWakeUpFlag))
+					if (CHECK_BIT_ANY(SolverColumns.Flag[collidedIdx], Agent.IgnoreButWakeUpFlag))
 					{
 						it.bIgnored = true;
 						continue;
@@ -989,9 +1214,9 @@ FVector3f UAntSubsystem::ORCASolver(FAntAgentData &Agent)
 	{
 		if (it.Handle != Agent.Handle)
 		{
-			const auto &neighbourAgent = GetAgentData(it.Handle);
+			const auto neighbourIdx = GetAgentIndex(it.Handle);
 			const auto relativePosition = FVector2f(it.Cylinder.Base) - pos2D;
-			const auto relativeVelocity = vel2D - FVector2f(neighbourAgent.Velocity);
+			const auto relativeVelocity = vel2D - FVector2f(SolverColumns.Velocity[neighbourIdx]);
 			const auto distSq = it.SqDist;
 			const float combinedRadius = Agent.Radius + it.Cylinder.Radius;
 			const float combinedRadiusSq = combinedRadius * combinedRadius;
@@ -1066,11 +1291,10 @@ FVector3f UAntSubsystem::ORCASolver(FAntAgentData &Agent)
 				u = (combinedRadius * invTimeStep - wLength) * unitW;
 
 				// mark collided agent to wake it up for next frame
-				auto &collidedAgent = GetMutableAgentData(it.Handle);
-				collidedAgent.bCollided = true;
+				MarkCollided(neighbourIdx);
 
 				// skip ignored agents
-				if (!CHECK_BIT_ANY(collidedAgent.Flag, Agent.IgnoreButWakeUpFlag))
+				if (!CHECK_BIT_ANY(SolverColumns.Flag[neighbourIdx], Agent.IgnoreButWakeUpFlag))
 				{
 					// a collision happened, so we try to get away from collided agent
 					// in case of equal centers, we use owner.idx to produce a unique normal
@@ -1251,114 +1475,81 @@ void UAntSubsystem::UpdateCollisionsAndQueries(float Delta, bool CollisionCanTic
 		INC_DWORD_STAT_BY(STAT_ANT_NumAsyncQueries, Queries.Num());
 		SCOPE_CYCLE_COUNTER(STAT_ANT_QPS);
 
-		// run colllison solver tasks
-		ParallelFor(Agents.GetMaxIndex(), [&](int32 idx)
+		// solvers read their neighbours from the hot columns, collision marks are applied after the pass
+		if (CollisionCanTick)
+		{
+			const auto maxIdx = Agents.GetMaxIndex();
+			SolverColumns.Velocity.SetNumUninitialized(maxIdx, EAllowShrinking::No);
+			SolverColumns.Flag.SetNumUninitialized(maxIdx, EAllowShrinking::No);
+			SolverColumns.Collided.SetNumUninitialized(maxIdx, EAllowShrinking::No);
+			FMemory::Memzero(SolverColumns.Collided.GetData(), SolverColumns.Collided.Num());
+			for (const auto idx : DenseAgents)
 			{
-				SCOPE_CYCLE_COUNTER(STAT_ANT_PxUpdate);
+				const auto &agent = Agents[idx];
+				SolverColumns.Velocity[idx] = agent.Velocity;
+				SolverColumns.Flag[idx] = agent.Flag;
+			}
+		}
 
-				if (!Agents.IsValidIndex(idx))
-					return;
+		// run colllison solver tasks over packed batches
+		ParallelForAgentBatches([&](int32 begin, int32 end)
+			{
+				SCOPE_CYCLE_COUNTER(STAT_ANT_PxUpdate);
 
-				auto &agent = Agents[idx];
-				// skip idle sleep units
-				if (CollisionCanTick && (agent.PreferredVelocity != FVector3f::ZeroVector || agent.OverlapForce != FVector2f::ZeroVector || !agent.bSleep || agent.bIsOnNavLink))
+				for (int32 denseIdx = begin; denseIdx < end; ++denseIdx)
 				{
-					auto newPos = agent.Location;
-
-					// swip to final position
-					if (!agent.bDisabled)
+					auto &agent = Agents[DenseAgents[denseIdx]];
+					// skip idle sleep units
+					if (CollisionCanTick && (agent.PreferredVelocity != FVector3f::ZeroVector || agent.OverlapForce != FVector2f::ZeroVector || !agent.bSleep || agent.bIsOnNavLink))
 					{
-						newPos = agent.AvoidanceType == EAntAvoidanceTypes::AntDefault ? DefaultSolver(agent) : ORCASolver(agent);
-
-						// reset lerp alpha after each new swip
-						agent.LerpAlpha = 0.0f;
-					}
+						auto newPos = agent.Location;
 
-					// collison phase velocity
-					agent.Velocity = newPos - agent.Location;
-
-					// current face angle from preferred velocity
-					if (agent.bTurnByPreferred && FVector2f(agent.PreferredVelocity) != FVector2f::ZeroVector)
-					{
-						const auto norm = agent.PreferredVelocity.GetSafeNormal();
-						agent.FinalFaceAngle = FMath::Atan2(norm.Y, norm.X);
-					}
-
-					// current face angle from current velocity
-					if (!agent.bTurnByPreferred && agent.Velocity.X != 0 && agent.Velocity.Y != 0)
-					{
-						const auto norm = FVector2f(agent.Velocity).GetSafeNormal();
-						agent.FinalFaceAngle = FMath::Atan2(norm.Y, norm.X);
-					}
-
-					// in case of turn before move we will reset the location to its old location if agent is not at the final face angle
-					// note: if you changed that radian threshold, you have to update it in the movementUpdate() also.
-					if (FMath::Abs(agent.FinalFaceAngle - agent.FaceAngle) > (agent.MoveAngleThreshold + RAD_5))
-						agent.Velocity = FVector3f::ZeroVector;
-
-					agent.bKnocked = false;
-				}
-
-				// update face direction interpolation
-				UpdateFaceDirection(agent);
-
-				// lerp alpha
-				agent.LerpAlpha = FMath::Min(1.0f, agent.LerpAlpha + lerpAlpha);
-			});
-
-		// run query tasks
-		ParallelFor(Queries.GetMaxIndex(), [&](int32 idx)
-			{
-				SCOPE_CYCLE_COUNTER(STAT_ANT_Queries);
-
-				if (!Queries.IsValidIndex(idx))
-					return;
+						// swip to final position
+						if (!agent.bDisabled)
+						{
+							newPos = agent.AvoidanceType == EAntAvoidanceTypes::AntDefault ? DefaultSolver(agent) : ORCASolver(agent);
 
-				auto &queryData = Queries[idx];
+							// reset lerp alpha after each new swip
+							agent.LerpAlpha = 0.0f;
+						}
 
-				// check interval
-				queryData.ElapsedTime += Delta;
-				if (queryData.ElapsedTime >= queryData.Interval)
-				{
-					// clear old query result
-					queryData.Result.Reset(0);
+						// collison phase velocity, replicated mirrors keep the velocity they were given
+						if (!agent.bReplicatedMirror)
+							agent.Velocity = newPos - agent.Location;
 
-					// 
-					queryData.ElapsedTime = 0;
+						// current face angle from preferred velocity
+						if (agent.bTurnByPreferred && FVector2f(agent.PreferredVelocity) != FVector2f::ZeroVector)
+						{
+							const auto norm = agent.PreferredVelocity.GetSafeNormal();
+							agent.FinalFaceAngle = FMath::Atan2(norm.Y, norm.X);
+						}
 
-					// agent position query
-					if (queryData.Type == EAntQueryType::CylinderAttached)
-					{
-						// agent refrence is invalid so we mark this query for destroy
-						if (!IsValidAgent(queryData.Data.CylinderAttached.Handle))
+						// current face angle from current velocity
+						if (!agent.bTurnByPreferred && agent.Velocity.X != 0 && agent.Velocity.Y != 0)
 						{
-							queryData.Interval = -1;
-							return;
+							const auto norm = FVector2f(agent.Velocity).GetSafeNormal();
+							agent.FinalFaceAngle = FMath::Atan2(norm.Y, norm.X);
 						}
 
-						// 
-						BroadphaseGrid->QueryCylinder(queryData.Data.CylinderAttached.Base, queryData.Data.CylinderAttached.Radius, queryData.Data.CylinderAttached.Height,
-							queryData.Flag, queryData.MustIncludeCenter, queryData.Result);
-						return;
-					}
+						// in case of turn before move we will reset the location to its old location if agent is not at the final face angle
+						// note: if you changed that radian threshold, you have to update it in the movementUpdate() also.
+						if (!agent.bReplicatedMirror && FMath::Abs(agent.FinalFaceAngle - agent.FaceAngle) > (agent.MoveAngleThreshold + RAD_5))
+							agent.Velocity = FVector3f::ZeroVector;
 
-					// point query
-					if (queryData.Type == EAntQueryType::Cylinder)
-					{
-						BroadphaseGrid->QueryCylinder(queryData.Data.Cylinder.Base, queryData.Data.Cylinder.Radius, queryData.Data.Cylinder.Height,
-							queryData.Flag, queryData.MustIncludeCenter, queryData.Result);
-						return;
+						agent.bKnocked = false;
 					}
 
-					// ray query
-					if (queryData.Type == EAntQueryType::Ray)
-					{
-						BroadphaseGrid->QueryRay(queryData.Data.Ray.Start, queryData.Data.Ray.End, queryData.Flag, queryData.Result);
-						return;
-					}
+					// update face direction interpolation
+					UpdateFaceDirection(agent);
+
+					// lerp alpha
+					agent.LerpAlpha = FMath::Min(1.0f, agent.LerpAlpha + lerpAlpha);
 				}
 			});
 
+		// run query tasks
+		UpdateAsyncQueries(Delta);
+
 		// run navigation tasks
 		if (CollisionCanTick)
 			OnUpdateNav.ExecuteIfBound();
@@ -1368,21 +1559,55 @@ void UAntSubsystem::UpdateCollisionsAndQueries(float Delta, bool CollisionCanTic
 	{
 		SCOPE_CYCLE_COUNTER(STAT_ANT_BFUpdate);
 		if (CollisionCanTick)
-			for (auto &agent : Agents)
+		{
+			int32 numMoved = 0;
+			for (auto it = Agents.CreateIterator(); it; ++it)
 			{
+				auto &agent = *it;
+				if (SolverColumns.Collided[it.GetIndex()] != 0)
+					agent.bCollided = true;
+
 				// in case of collision from other thread with this agent, we have to wake it up for the next frame
 				agent.bSleep = agent.bCollided || agent.bIsOnNavLink ? false : agent.bSleep;
 				agent.bCollided = false;
+				numMoved += agent.bUpdateGrid ? 1 : 0;
+			}
+
+			if (numMoved > 0 && numMoved >= Agents.Num() * Settings->BulkGridRebuildRatio)
+			{
+				// rebuild the whole grid in bulk
+				BulkGridItems.Reset(Agents.Num());
+				BulkGridAgents.Reset(Agents.Num());
+				for (auto it = Agents.CreateIterator(); it; ++it)
+				{
+					BulkGridItems.Add({ it->Handle, it->Location, it->Radius, it->Height, it->Flag });
+					BulkGridAgents.Add(it.GetIndex());
+				}
 
-				// update agent in the grid
-				if (agent.bUpdateGrid)
+				BroadphaseGrid->Rebuild(BulkGridItems, BulkGridHandles);
+
+				for (int32 idx = 0; idx < BulkGridAgents.Num(); ++idx)
 				{
-					// remove agent from current place
-					BroadphaseGrid->Remove(agent.GridHandle);
-					agent.GridHandle = BroadphaseGrid->AddCylinder(agent.Handle, agent.Location, agent.Radius, agent.Height, agent.Flag);
+					auto &agent = Agents[BulkGridAgents[idx]];
+					agent.GridHandle = BulkGridHandles[idx];
 					agent.bUpdateGrid = false;
 				}
 			}
+			else if (numMoved > 0)
+			{
+				for (auto &agent : Agents)
+				{
+					// update agent in the grid
+					if (agent.bUpdateGrid)
+					{
+						// remove agent from current place
+						BroadphaseGrid->Remove(agent.GridHandle);
+						agent.GridHandle = BroadphaseGrid->AddCylinder(agent.Handle, agent.Location, agent.Radius, agent.Height, agent.Flag);
+						agent.bUpdateGrid = false;
+					}
+				}
+			}
+		}
 	}
 }
 
@@ -1437,7 +1662,7 @@ void UAntSubsystem::UpdateMovements(float Delta, float DeltaMul)
 			}
 
 			const FVector3f currentPos = agent.GetLocation();
-			const FVector3f targetPos = followAgent ? GetAgentData(moveData.Followee).Location : FVector3f(GetPathData(moveData.Path).Data.Last().Location);
+			const FVector3f targetPos = followAgent ? GetAgentData(moveData.Followee).Location : FVector3f(GetPathData(moveData.Path).Data.Last().Location) + moveData.GoalOffset;
 			FVector3f dist(targetPos - currentPos);
 			FVector3f dir = FVector3f::ZeroVector;
 			auto distToEnd = 0.0f;
@@ -1536,6 +1761,7 @@ void UAntSubsystem::UpdateMovements(float Delta, float DeltaMul)
 				{
 					nearestLoc.VertT = FMath::Clamp(nearestLoc.VertT, 0.0f, 1.0f);
 					nearestLoc.HoriT = FMath::Clamp(nearestLoc.HoriT, 0.0f, 1.0f);
+					moveData.OutOfCorridorTime = 0.0f;
 
 					distToEnd = FMath::Lerp(pathData.Data[nearestLoc.PortalIndex].Distance, pathData.Data[nearestLoc.PortalIndex + 1].Distance, nearestLoc.VertT);
 
@@ -1548,7 +1774,7 @@ void UAntSubsystem::UpdateMovements(float Delta, float DeltaMul)
 					// we are in the last corridor sector, so we move toward the target pos
 					if (nearestLoc.PortalIndex == pathData.Data.Num() - 2)
 					{
-						dist = FVector3f(pathData.Data.Last().Location) - currentPos;
+						dist = targetPos - currentPos;
 						const auto distLen = dist.Size();
 						dir = dist / distLen;
 						distToEnd = distLen;
@@ -1556,24 +1782,55 @@ void UAntSubsystem::UpdateMovements(float Delta, float DeltaMul)
 					// we are in one of middle corridor sector, so we can move by flow
 					else
 					{
-						const auto backPortalPos = FMath::Lerp(pathData.Data[nearestLoc.PortalIndex].Left, pathData.Data[nearestLoc.PortalIndex].Right, nearestLoc.HoriT);
-						const auto frontPortalPos = FMath::Lerp(pathData.Data[nearestLoc.PortalIndex + 1].Left, pathData.Data[nearestLoc.PortalIndex + 1].Right, nearestLoc.HoriT);
+						// squad members flow along their own lane
+						const auto laneT = moveData.bSquad ? moveData.LaneT : nearestLoc.HoriT;
+						const auto backPortalPos = FMath::Lerp(pathData.Data[nearestLoc.PortalIndex].Left, pathData.Data[nearestLoc.PortalIndex].Right, laneT);
+						const auto frontPortalPos = FMath::Lerp(pathData.Data[nearestLoc.PortalIndex + 1].Left, pathData.Data[nearestLoc.PortalIndex + 1].Right, laneT);
 						dist = FVector3f(frontPortalPos) - currentPos;
 						//dist = moveData.MaxSpeed * FVector3f::OneVector;
 
 						// we can compute direction by (frontPortalPos - currentPos), but to avoid inaccurate normal due to very samll distance, we find it with back and front portals.
 						dir = FVector3f(frontPortalPos - backPortalPos).GetSafeNormal();
+
+						// steer toward the lane
+						if (moveData.bSquad)
+							dir = (dir + dist.GetSafeNormal()).GetSafeNormal();
 						//dir = FMath::Lerp(agent.Velocity, FVector3f(frontPortalPos - backPortalPos), 0.001f).GetSafeNormal();
 					}
 				}
 				// we are pushed out of the flow path, try to move to the next waypoint
 				else if (!isInsideCorridor)
 				{
-					const auto portalCenter = FMath::Lerp(pathData.Data[nearestLoc.PortalIndex + 1].Left, pathData.Data[nearestLoc.PortalIndex + 1].Right, 0.5f);
-					dist = FVector3f(portalCenter) - currentPos;
-					const auto distLen = dist.Size();
-					dir = dist / distLen;
-					distToEnd = distLen + pathData.Data[nearestLoc.PortalIndex + 1].Distance;
+					// squad members leave the corridor on purpose in the last sector, or near a goal offset outside of it
+					const auto isLastSector = nearestLoc.PortalIndex >= pathData.Data.Num() - 2;
+					const auto isLeavingToGoal = moveData.bSquad && (isLastSector
+						|| (moveData.bGoalOutsideCorridor && FVector3f::DistSquared2D(currentPos, targetPos) <= moveData.GoalOffset.SizeSquared2D()));
+
+					// squad members that stay out of the corridor get their own path
+					if (isLeavingToGoal)
+						moveData.OutOfCorridorTime = 0.0f;
+					else
+						moveData.OutOfCorridorTime += Delta;
+
+					if (moveData.bSquad && moveData.OutOfCorridorTime >= Settings->SquadStragglerTimeout)
+						moveData.bStraggler = true;
+
+					// head to the own goal, it may be outside of the corridor
+					if (isLeavingToGoal)
+					{
+						dist = targetPos - currentPos;
+						const auto distLen = dist.Size();
+						dir = dist / distLen;
+						distToEnd = distLen;
+					}
+					else
+					{
+						const auto portalCenter = FMath::Lerp(pathData.Data[nearestLoc.PortalIndex + 1].Left, pathData.Data[nearestLoc.PortalIndex + 1].Right, 0.5f);
+						dist = FVector3f(portalCenter) - currentPos;
+						const auto distLen = dist.Size();
+						dir = dist / distLen;
+						distToEnd = distLen + pathData.Data[nearestLoc.PortalIndex + 1].Distance;
+					}
 				}
 			}
 
@@ -1608,6 +1865,14 @@ void UAntSubsystem::UpdateMovements(float Delta, float DeltaMul)
 		if (!Movements.IsValidIndex(idx))
 			continue;
 
+		// squad members that need their own path, kept until the navmesh consumes them
+		if (Movements[idx].bStraggler)
+		{
+			Movements[idx].bStraggler = false;
+			Movements[idx].OutOfCorridorTime = 0.0f;
+			SquadStragglers.AddUnique(Movements[idx].Handle);
+		}
+
 		const auto updateResult = Movements[idx].UpdateResult;
 		const auto owner = Movements[idx].Handle;
 
@@ -1662,33 +1927,111 @@ void UAntSubsystem::UpdateMovements(float Delta, float DeltaMul)
 	}
 }
 
+void UAntSubsystem::UpdateAsyncQueries(float Delta)
+{
+	SCOPE_CYCLE_COUNTER(STAT_ANT_Queries);
+
+	// collect due queries, slot is the index of the query inside the cylinder list then the ray list
+	CylinderQueries.Reset();
+	RayQueries.Reset();
+	QuerySlots.Init(INDEX_NONE, Queries.GetMaxIndex());
+	for (auto it = Queries.CreateIterator(); it; ++it)
+	{
+		auto &queryData = *it;
+
+		// check interval
+		queryData.ElapsedTime += Delta;
+		if (queryData.ElapsedTime < queryData.Interval)
+			continue;
+
+		queryData.ElapsedTime = 0;
+		queryData.ResultNum = 0;
+
+		// agent position query
+		if (queryData.Type == EAntQueryType::CylinderAttached)
+		{
+			// agent refrence is invalid so we mark this query for destroy
+			if (!IsValidAgent(queryData.Data.CylinderAttached.Handle))
+			{
+				queryData.Interval = -1;
+				continue;
+			}
+
+			QuerySlots[it.GetIndex()] = CylinderQueries.Num();
+			CylinderQueries.Add({ queryData.Data.CylinderAttached.Base, queryData.Data.CylinderAttached.Radius, queryData.Data.CylinderAttached.Height, queryData.Flag, queryData.MustIncludeCenter });
+		}
+
+		// point query
+		if (queryData.Type == EAntQueryType::Cylinder)
+		{
+			QuerySlots[it.GetIndex()] = CylinderQueries.Num();
+			CylinderQueries.Add({ queryData.Data.Cylinder.Base, queryData.Data.Cylinder.Radius, queryData.Data.Cylinder.Height, queryData.Flag, queryData.MustIncludeCenter });
+		}
+
+		// ray query
+		if (queryData.Type == EAntQueryType::Ray)
+			RayQueries.Add(it.GetIndex());
+	}
+	for (int32 idx = 0; idx < RayQueries.Num(); ++idx)
+		QuerySlots[RayQueries[idx]] = CylinderQueries.Num() + idx;
+
+	// cylinder queries, each touched cell is tested once against all of its queries
+	BroadphaseGrid->QueryCylinders(CylinderQueries, CylinderResults, CylinderResultStart);
+
+	// ray queries
+	RayResults.SetNum(RayQueries.Num(), EAllowShrinking::No);
+	ParallelFor(RayQueries.Num(), [&](int32 idx)
+		{
+			const auto &queryData = Queries[RayQueries[idx]];
+			RayResults[idx].Reset();
+			BroadphaseGrid->QueryRay(queryData.Data.Ray.Start, queryData.Data.Ray.End, queryData.Flag, RayResults[idx]);
+		});
+
+	// rebuild the pooled results, queries that did not run this frame keep their previous contacts
+	Swap(QueryResults, PrevQueryResults);
+	QueryResults.Reset();
+	for (auto it = Queries.CreateIterator(); it; ++it)
+	{
+		auto &queryData = *it;
+		const auto slot = QuerySlots[it.GetIndex()];
+		const auto start = QueryResults.Num();
+		if (slot == INDEX_NONE)
+			QueryResults.Append(PrevQueryResults.GetData() + queryData.ResultStart, queryData.ResultNum);
+		else if (slot < CylinderQueries.Num())
+			QueryResults.Append(CylinderResults.GetData() + CylinderResultStart[slot], CylinderResultStart[slot + 1] - CylinderResultStart[slot]);
+		else
+			QueryResults.Append(RayResults[slot - CylinderQueries.Num()]);
+
+		queryData.ResultStart = start;
+		queryData.ResultNum = QueryResults.Num() - start;
+	}
+}
+
 void UAntSubsystem::DispatchAsyncQueries(float Delta)
 {
 	// proceed query list
-	static TArray <FAntHandle> proceedQueries;
-	static TArray <FAntHandle> tempQueries;
-	proceedQueries.Reset(0);
-	tempQueries.Reset(0);
+	ProceedQueries.Reset();
+	TempQueries.Reset();
 
 	// collect proceed queries
 	for (const auto &it : Queries)
 	{
 		if (it.ElapsedTime == 0)
-			proceedQueries.Add(it.Handle);
+			ProceedQueries.Add(it.Handle);
 
 		if (it.Interval < 0)
-			tempQueries.Add(it.Handle);
+			TempQueries.Add(it.Handle);
 	}
 
 	// notify proceed queries
-	if (!proceedQueries.IsEmpty())
+	if (!ProceedQueries.IsEmpty())
 	{
-		OnQueryFinished.Broadcast(proceedQueries);
-		OnQueryFinished_BP.Broadcast(proceedQueries);
+		OnQueryFinished.Broadcast(ProceedQueries);
+		OnQueryFinished_BP.Broadcast(ProceedQueries);
 	}
 
 	// remove temporary queries
-	for (const auto &it : tempQueries)
+	for (const auto &it : TempQueries)
 		if (IsValidAsyncQuery(it))
 			RemoveAsyncQuery(it);
 
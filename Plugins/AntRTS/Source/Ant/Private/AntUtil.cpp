@@ -130,6 +130,250 @@ static ENavigationQueryResult::Type BuildPath(UWorld *World, AAntRecastNavMesh *
 	return result;
 }
 
+namespace
+{
+
+// groups up to this size keep the old SortAgentsBy* heuristics
+constexpr int32 SmallFormationGroup = 64;
+
+// pairwise swap passes after the greedy assignment
+constexpr int32 FormationSwapPasses = 2;
+
+// uniform bucket grid over 2d points, items can be taken out one by one
+struct FFormationHash
+{
+	FVector2f Origin;
+	float CellSize = 1.0f;
+	int32 NumX = 0;
+	int32 NumY = 0;
+	// Items[CellStart[cell]] .. Items[CellStart[cell] + CellNum[cell]] are the items left in the cell
+	TArray<int32> CellStart;
+	TArray<int32> CellNum;
+	TArray<int32> Items;
+	// items left per block of 2^level x 2^level cells, level 0 is CellNum, the last level is a single block
+	TArray<TArray<int32>> LevelNum;
+	TArray<FIntPoint> LevelSize;
+	// best-first search scratch, reused between the picks
+	TArray<TPair<float, FIntVector>> Frontier;
+
+	void Build(TConstArrayView<FVector2f> Points, float InCellSize)
+	{
+		FBox2f bounds(ForceInit);
+		for (const auto &it : Points)
+			bounds += it;
+
+		// grow the cells of sparse point sets, so the grid stays proportional to the number of points
+		Origin = bounds.Min;
+		CellSize = InCellSize;
+		const auto maxCells = FMath::Max(64, Points.Num() * 4);
+		do
+		{
+			NumX = FMath::Max(1, FMath::CeilToInt32(bounds.GetSize().X / CellSize) + 1);
+			NumY = FMath::Max(1, FMath::CeilToInt32(bounds.GetSize().Y / CellSize) + 1);
+			if (static_cast<int64>(NumX) * NumY <= maxCells)
+				break;
+
+			CellSize *= 2;
+		} while (true);
+
+		// counting sort of the points by cell
+		CellStart.Init(0, NumX * NumY + 1);
+		CellNum.Init(0, NumX * NumY);
+		for (const auto &it : Points)
+			++CellNum[GetCell(it)];
+
+		for (int32 idx = 0; idx < CellNum.Num(); ++idx)
+			CellStart[idx + 1] = CellStart[idx] + CellNum[idx];
+
+		Items.SetNumUninitialized(Points.Num());
+		TArray<int32> cursor(CellStart.GetData(), CellNum.Num());
+		for (int32 idx = 0; idx < Points.Num(); ++idx)
+			Items[cursor[GetCell(Points[idx])]++] = idx;
+
+		// count pyramid, each level halves the previous one
+		LevelNum.Reset();
+		LevelSize.Reset();
+		LevelNum.Add(CellNum);
+		LevelSize.Add(FIntPoint(NumX, NumY));
+		while (LevelSize.Last().X > 1 || LevelSize.Last().Y > 1)
+		{
+			const auto prevSize = LevelSize.Last();
+			const FIntPoint size((prevSize.X + 1) / 2, (prevSize.Y + 1) / 2);
+			TArray<int32> num;
+			num.Init(0, size.X * size.Y);
+			for (int32 y = 0; y < prevSize.Y; ++y)
+				for (int32 x = 0; x < prevSize.X; ++x)
+					num[(y / 2) * size.X + x / 2] += LevelNum.Last()[y * prevSize.X + x];
+
+			LevelNum.Add(MoveTemp(num));
+			LevelSize.Add(size);
+		}
+	}
+
+	FIntPoint GetCoord(const FVector2f &Point) const
+	{
+		return { FMath::Clamp(FMath::FloorToInt32((Point.X - Origin.X) / CellSize), 0, NumX - 1),
+			FMath::Clamp(FMath::FloorToInt32((Point.Y - Origin.Y) / CellSize), 0, NumY - 1) };
+	}
+
+	int32 GetCell(const FVector2f &Point) const
+	{
+		const auto coord = GetCoord(Point);
+		return coord.Y * NumX + coord.X;
+	}
+
+	void Take(int32 Cell, int32 Item)
+	{
+		const auto begin = CellStart[Cell];
+		for (int32 idx = begin; idx < begin + CellNum[Cell]; ++idx)
+			if (Items[idx] == Item)
+			{
+				Items[idx] = Items[begin + CellNum[Cell] - 1];
+				--CellNum[Cell];
+
+				// update the pyramid
+				const auto x = Cell % NumX;
+				const auto y = Cell / NumX;
+				LevelNum[0][Cell] = CellNum[Cell];
+				for (int32 level = 1; level < LevelNum.Num(); ++level)
+					--LevelNum[level][(y >> level) * LevelSize[level].X + (x >> level)];
+
+				return;
+			}
+	}
+
+	// visit items of the cells on the square ring of the given radius
+	template<typename FuncType>
+	void ForEachInRing(const FIntPoint &Center, int32 Ring, FuncType &&Func) const
+	{
+		for (int32 y = Center.Y - Ring; y <= Center.Y + Ring; ++y)
+		{
+			if (y < 0 || y >= NumY)
+				continue;
+
+			const auto fullRow = (y == Center.Y - Ring || y == Center.Y + Ring);
+			for (int32 x = Center.X - Ring; x <= Center.X + Ring; x += (fullRow || Ring == 0) ? 1 : 2 * Ring)
+			{
+				if (x < 0 || x >= NumX)
+					continue;
+
+				const auto cell = y * NumX + x;
+				for (int32 idx = CellStart[cell]; idx < CellStart[cell] + CellNum[cell]; ++idx)
+					Func(Items[idx]);
+			}
+		}
+	}
+
+	// squared distance from the point to a block of the given level
+	float GetBlockDistSq(const FVector2f &Point, int32 Level, int32 X, int32 Y) const
+	{
+		const auto blockSize = CellSize * (1 << Level);
+		const auto min = Origin + FVector2f(X, Y) * blockSize;
+		const auto dx = FMath::Max3(min.X - Point.X, 0.0f, Point.X - (min.X + blockSize));
+		const auto dy = FMath::Max3(min.Y - Point.Y, 0.0f, Point.Y - (min.Y + blockSize));
+		return dx * dx + dy * dy;
+	}
+
+	// nearest item left in the grid, INDEX_NONE if it is empty.
+	// best-first descent of the count pyramid, empty blocks are never entered so taken slots don't cost any scan
+	int32 FindNearest(const FVector2f &Point, TConstArrayView<FVector2f> Points)
+	{
+		const auto closer = [](const TPair<float, FIntVector> &A, const TPair<float, FIntVector> &B) { return A.Key < B.Key; };
+		const auto top = LevelNum.Num() - 1;
+		Frontier.Reset();
+		if (LevelNum[top][0] > 0)
+			Frontier.HeapPush({ GetBlockDistSq(Point, top, 0, 0), FIntVector(0, 0, top) }, closer);
+
+		int32 nearest = INDEX_NONE;
+		float nearestDistSq = TNumericLimits<float>::Max();
+		while (!Frontier.IsEmpty())
+		{
+			TPair<float, FIntVector> block;
+			Frontier.HeapPop(block, closer, EAllowShrinking::No);
+
+			// every block left is farther than the nearest item
+			if (block.Key >= nearestDistSq)
+				break;
+
+			const auto level = block.Value.Z;
+			if (level == 0)
+			{
+				const auto cell = block.Value.Y * NumX + block.Value.X;
+				for (int32 idx = CellStart[cell]; idx < CellStart[cell] + CellNum[cell]; ++idx)
+				{
+					const auto distSq = FVector2f::DistSquared(Point, Points[Items[idx]]);
+					if (distSq < nearestDistSq)
+					{
+						nearestDistSq = distSq;
+						nearest = Items[idx];
+					}
+				}
+
+				continue;
+			}
+
+			// non-empty children
+			const auto childSize = LevelSize[level - 1];
+			for (int32 y = block.Value.Y * 2; y <= FMath::Min(block.Value.Y * 2 + 1, childSize.Y - 1); ++y)
+				for (int32 x = block.Value.X * 2; x <= FMath::Min(block.Value.X * 2 + 1, childSize.X - 1); ++x)
+					if (LevelNum[level - 1][y * childSize.X + x] > 0)
+						Frontier.HeapPush({ GetBlockDistSq(Point, level - 1, x, y), FIntVector(x, y, level - 1) }, closer);
+		}
+
+		return nearest;
+	}
+};
+
+// formation slot offsets around the origin, front of the formation is +X
+void BuildFormationSlots(EAntFormationShape Shape, int32 Num, float Spacing, TArray<FVector2f> &OutSlots)
+{
+	OutSlots.Reset(Num);
+	switch (Shape)
+	{
+	case EAntFormationShape::Square:
+	{
+		const auto numRows = FMath::CeilToInt32(FMath::Sqrt(static_cast<float>(Num)));
+		for (int32 idx = 0; idx < Num; ++idx)
+			OutSlots.Add(FVector2f(-static_cast<float>(idx / numRows), static_cast<float>(idx % numRows)) * Spacing);
+	}
+	break;
+
+	case EAntFormationShape::Circle:
+	{
+		// sunflower spiral, evenly filled disc
+		const auto goldenAngle = UE_PI * (3.0f - FMath::Sqrt(5.0f));
+		const auto scale = Spacing * 0.6f;
+		for (int32 idx = 0; idx < Num; ++idx)
+		{
+			const auto radius = scale * FMath::Sqrt(idx + 0.5f);
+			const auto angle = idx * goldenAngle;
+			OutSlots.Add(FVector2f(FMath::Cos(angle), FMath::Sin(angle)) * radius);
+		}
+	}
+	break;
+
+	case EAntFormationShape::Wedge:
+	{
+		// row r holds 2r + 1 slots behind the tip
+		for (int32 row = 0; OutSlots.Num() < Num; ++row)
+			for (int32 col = -row; col <= row && OutSlots.Num() < Num; ++col)
+				OutSlots.Add(FVector2f(-static_cast<float>(row), static_cast<float>(col)) * Spacing);
+	}
+	break;
+	}
+
+	// center the slots
+	FVector2f center = FVector2f::ZeroVector;
+	for (const auto &it : OutSlots)
+		center += it;
+
+	center /= FMath::Max(1, OutSlots.Num());
+	for (auto &it : OutSlots)
+		it -= center;
+}
+
+}
+
 bool UAntUtil::MoveAgentsToLocations(UWorld *World, const TArray<FAntHandle> &AgentsToMove, const TArray<FVector> &Locations,
 	const TArray<float> &MaxSpeeds, const TArray<float> &Accelerations, const TArray<float> &Decelerations,
 	float TargetAcceptanceRadius, float PathAcceptanceRadius, EAntPathFollowerType PathFollowerType, float PathWidth,
@@ -203,6 +447,92 @@ bool UAntUtil::MoveAgentsToLocations(UWorld *World, const TArray<FAntHandle> &Ag
 	return !anyFail;
 }
 
+FAntHandle UAntUtil::MoveSquadToLocation(UWorld *World, const TArray<FAntHandle> &Agents, const FVector &DestLocation, const TArray<FVector> &FormationOffsets,
+	float MaxSpeed, float Acceleration, float Deceleration, float TargetAcceptanceRadius, float PathAcceptanceRadius, float PathWidth,
+	float MissingVelocityTimeout, bool PathReplan, float ReplanCostThreshold, TSubclassOf<UNavigationQueryFilter> FilterClass)
+{
+	auto *ant = World->GetSubsystem<UAntSubsystem>();
+	check(ant && "Ant is not available.");
+
+	if (Agents.IsEmpty() || !ant->IsValidAgents(Agents))
+		return FAntHandle();
+
+	// find center of the squad
+	FVector centerOfCrowd = FVector::ZeroVector;
+	for (const auto &handle : Agents)
+		centerOfCrowd += FVector(ant->GetAgentData(handle).GetLocation());
+
+	centerOfCrowd /= Agents.Num();
+
+	// the path starts from the agent nearest to the center, the center itself may be off the navmesh
+	FVector start = centerOfCrowd;
+	double nearestDistSq = TNumericLimits<double>::Max();
+	for (const auto &handle : Agents)
+	{
+		const auto location = FVector(ant->GetAgentData(handle).GetLocation());
+		if (FVector::DistSquared2D(location, centerOfCrowd) < nearestDistSq)
+		{
+			nearestDistSq = FVector::DistSquared2D(location, centerOfCrowd);
+			start = location;
+		}
+	}
+
+	// one corridor for the whole squad, at least as wide as the squad itself
+	double squadRadius = 0.0;
+	for (const auto &handle : Agents)
+	{
+		const auto &agentData = ant->GetAgentData(handle);
+		squadRadius = FMath::Max(squadRadius, FVector::Dist2D(FVector(agentData.GetLocation()), centerOfCrowd) + agentData.GetRadius());
+	}
+
+	const auto squadWidth = FMath::Max(PathWidth, static_cast<float>(squadRadius * 2.0));
+	const auto pathHandle = CreateSharedPath(World, start, DestLocation, squadWidth, PathReplan, ReplanCostThreshold, FilterClass);
+	if (!ant->IsValidPath(pathHandle))
+		return FAntHandle();
+
+	// stragglers get their own path with the same settings
+	auto &squadPathData = ant->GetMutablePathData(pathHandle);
+	squadPathData.SquadFilterClass = FilterClass;
+	squadPathData.SquadMemberWidth = PathWidth;
+	squadPathData.bSquadPathReplan = PathReplan;
+
+	// lateral axis of the corridor at its start, from the left to the right side of the first portals
+	const auto &portals = ant->GetPathData(pathHandle).GetData();
+	FVector2D sideAxis = FVector2D::ZeroVector;
+	for (int32 pidx = 0; pidx < portals.Num() && sideAxis.IsNearlyZero(); ++pidx)
+		sideAxis = FVector2D(portals[pidx].Right - portals[pidx].Left).GetSafeNormal();
+
+	// lanes keep the lateral order of the agents, spread over the inner part of the corridor
+	TArray<float> sides;
+	sides.SetNumUninitialized(Agents.Num());
+	double maxSide = 0.0;
+	for (int32 idx = 0; idx < Agents.Num(); ++idx)
+	{
+		sides[idx] = FVector2D::DotProduct(FVector2D(FVector(ant->GetAgentData(Agents[idx]).GetLocation()) - centerOfCrowd), sideAxis);
+		maxSide = FMath::Max(maxSide, FMath::Abs(sides[idx]));
+	}
+
+	const auto pathEnd = portals.Last().Location;
+	for (int32 idx = 0; idx < Agents.Num(); ++idx)
+	{
+		const auto &handle = Agents[idx];
+		const auto offset = FormationOffsets.IsValidIndex(idx) ? FormationOffsets[idx] : FVector(ant->GetAgentData(handle).GetLocation()) - centerOfCrowd;
+
+		ant->MoveAgentByPath(handle, pathHandle, EAntPathFollowerType::FlowField, MaxSpeed, Acceleration, Deceleration, TargetAcceptanceRadius, PathAcceptanceRadius, 0, MissingVelocityTimeout);
+
+		auto &moveData = ant->GetMutableAgentMovement(handle);
+		moveData.bSquad = true;
+		moveData.LaneT = maxSide > UE_KINDA_SMALL_NUMBER ? 0.5f + 0.4f * static_cast<float>(sides[idx] / maxSide) : 0.5f;
+		moveData.GoalOffset = FVector3f(offset.X, offset.Y, 0.0f);
+		moveData.Destination = pathEnd + FVector(moveData.GoalOffset);
+		const auto goalLoc = ant->GetPathData(pathHandle).FindNearestLocationOnCorridor(moveData.Destination, FMath::Max(0, portals.Num() - 2));
+		moveData.bGoalOutsideCorridor = goalLoc.HoriT < 0.0f || goalLoc.HoriT > 1.0f;
+		++ant->GetMutablePathData(pathHandle).SquadUsers;
+	}
+
+	return pathHandle;
+}
+
 FAntHandle UAntUtil::CreateSharedPath(UWorld *World, const FVector &Start, const FVector &End, float PathWidth, bool PathReplan, float ReplanCostThreshold, TSubclassOf<UNavigationQueryFilter> FilterClass)
 {
 	auto *ant = World->GetSubsystem<UAntSubsystem>();
@@ -627,6 +957,119 @@ void UAntUtil::SortAgentsByCirclePack(UWorld *World, const FVector &DestLocation
 		ResultLocations.Add(FVector(nodeList[idx].x + DestLocation.X, nodeList[idx].y + DestLocation.Y, DestLocation.Z));
 }
 
+void UAntUtil::AssignAgentsToFormation(UWorld *World, const FVector &DestLocation, EAntFormationShape Shape, float Facing, TArray<FAntHandle> &Agents, float SplitSpace, TArray<FVector> &ResultLocations)
+{
+	auto *ant = World->GetSubsystem<UAntSubsystem>();
+	check(ant && "Ant is not available.");
+
+	ResultLocations.Empty(Agents.Num());
+
+	// 
+	if (Agents.IsEmpty() || !ant->IsValidAgents(Agents))
+		return;
+
+	SCOPE_CYCLE_COUNTER(STAT_ANT_Formation);
+
+	// small groups keep the old heuristics, turned to the formation facing like the large ones
+	if (Agents.Num() <= SmallFormationGroup && Shape != EAntFormationShape::Wedge)
+	{
+		float squareDimension = 0.0f;
+		if (Shape == EAntFormationShape::Square)
+			SortAgentsBySquare(World, DestLocation, Agents, SplitSpace, squareDimension, ResultLocations);
+		else
+			SortAgentsByCirclePack(World, DestLocation, Agents, SplitSpace, ResultLocations);
+
+		const auto rotator = FVector2D(FMath::Cos(Facing), FMath::Sin(Facing));
+		for (auto &it : ResultLocations)
+		{
+			const auto offset = FVector2D(it - DestLocation);
+			it.X = DestLocation.X + offset.X * rotator.X - offset.Y * rotator.Y;
+			it.Y = DestLocation.Y + offset.X * rotator.Y + offset.Y * rotator.X;
+		}
+
+		return;
+	}
+
+	const auto numAgents = Agents.Num();
+
+	// agent locations and their crowd center
+	TArray<FVector2f> agentLocations;
+	agentLocations.SetNumUninitialized(numAgents);
+	FVector2f centerOfCrowd = FVector2f::ZeroVector;
+	float averageRadius = 0.f;
+	for (int32 idx = 0; idx < numAgents; ++idx)
+	{
+		const auto &agentData = ant->GetAgentData(Agents[idx]);
+		agentLocations[idx] = FVector2f(agentData.GetLocation());
+		centerOfCrowd += agentLocations[idx];
+		averageRadius += agentData.GetRadius();
+	}
+
+	centerOfCrowd /= numAgents;
+	averageRadius /= numAgents;
+
+	// move the crowd onto the destination, so the cost of a slot is how much an agent leaves its place inside the crowd
+	const FVector2f dest(DestLocation);
+	for (auto &it : agentLocations)
+		it += dest - centerOfCrowd;
+
+	// build the slots around the destination
+	const auto spacing = averageRadius * 2 + SplitSpace;
+	TArray<FVector2f> slots;
+	BuildFormationSlots(Shape, numAgents, spacing, slots);
+	const auto rotator = FVector2f(FMath::Cos(Facing), FMath::Sin(Facing));
+	for (auto &it : slots)
+		it = dest + FVector2f(it.X * rotator.X - it.Y * rotator.Y, it.X * rotator.Y + it.Y * rotator.X);
+
+	// greedy matching, outermost agents pick first so the ones inside are not left with far slots
+	TArray<int32> order;
+	order.SetNumUninitialized(numAgents);
+	for (int32 idx = 0; idx < numAgents; ++idx)
+		order[idx] = idx;
+
+	order.Sort([&](int32 First, int32 Second)
+		{
+			return FVector2f::DistSquared(agentLocations[First], dest) > FVector2f::DistSquared(agentLocations[Second], dest);
+		});
+
+	FFormationHash slotHash;
+	slotHash.Build(slots, spacing * 2);
+	TArray<int32> agentSlot;
+	agentSlot.SetNumUninitialized(numAgents);
+	for (const auto agentIdx : order)
+	{
+		const auto slotIdx = slotHash.FindNearest(agentLocations[agentIdx], slots);
+		check(slotIdx != INDEX_NONE);
+		slotHash.Take(slotHash.GetCell(slots[slotIdx]), slotIdx);
+		agentSlot[agentIdx] = slotIdx;
+	}
+
+	// swap slots of nearby agents whenever it lowers the squared cost, this also untangles crossing paths
+	FFormationHash agentHash;
+	agentHash.Build(agentLocations, spacing * 2);
+	for (int32 pass = 0; pass < FormationSwapPasses; ++pass)
+		for (int32 agentIdx = 0; agentIdx < numAgents; ++agentIdx)
+		{
+			const auto center = agentHash.GetCoord(agentLocations[agentIdx]);
+			for (int32 ring = 0; ring <= 1; ++ring)
+				agentHash.ForEachInRing(center, ring, [&](int32 Other)
+					{
+						if (Other == agentIdx)
+							return;
+
+						const auto &a = agentLocations[agentIdx];
+						const auto &b = agentLocations[Other];
+						const auto &slotA = slots[agentSlot[agentIdx]];
+						const auto &slotB = slots[agentSlot[Other]];
+						if (FVector2f::DistSquared(a, slotB) + FVector2f::DistSquared(b, slotA) < FVector2f::DistSquared(a, slotA) + FVector2f::DistSquared(b, slotB))
+							Swap(agentSlot[agentIdx], agentSlot[Other]);
+					});
+		}
+
+	for (int32 idx = 0; idx < numAgents; ++idx)
+		ResultLocations.Add(FVector(slots[agentSlot[idx]].X, slots[agentSlot[idx]].Y, DestLocation.Z));
+}
+
 void UAntUtil::GetCorridorPortalAlpha(const TArray<FVector> &SourceLocations, const FVector &DestLocation, TArray<float> &ResultAlpha)
 {
 	ResultAlpha.SetNum(SourceLocations.Num());
@@ -29,6 +29,17 @@ public:
 	static void SortAgentsBySquare(const UObject *WorldContextObject, const FVector &DestLocation, const TArray<FAntHandle> &Agents, float SplitSpace, float &SquareDimension,
 		TArray<FAntHandle> &SortedAgents, TArray<FVector> &ResultLocations);
 
+	/**
+	 * Build a formation at the destination and assign one slot to each agent without crossing paths. scales to thousands of agents.
+	 * This function may alter order of the Agents array.
+	 * @param DestLocation Destination location (center of the formation).
+	 * @param Facing Yaw of the formation front in radians.
+	 * @param SplitSpace Space between each agent
+	*/
+	UFUNCTION(BlueprintCallable, Category = "Ant Movement", meta = (WorldContext = "WorldContextObject"))
+	static void AssignAgentsToFormation(const UObject *WorldContextObject, const FVector &DestLocation, EAntFormationShape Shape, float Facing, const TArray<FAntHandle> &Agents, float SplitSpace,
+		TArray<FAntHandle> &SortedAgents, TArray<FVector> &ResultLocations);
+
 	/**
 	 * Add a new agent at the given location.
 	 * @param Location Agent location.
@@ -52,6 +52,25 @@ public:
 	*/
 	int32 AddCylinder(const FAntHandle &Handle, const FVector3f &Base, float Radius, float Height, int32 Flags);
 
+	/** Cylinder description for the bulk Rebuild. */
+	struct FBulkCylinder
+	{
+		FAntHandle Handle;
+		FVector3f Base;
+		float Radius = 0.0f;
+		float Height = 0.0f;
+		int32 Flags = 0;
+	};
+
+	/**
+	 * Replace the whole content of the grid at once.
+	 * Cell keys are computed in parallel and counting-sorted into contiguous per-cell ranges,
+	 * so it is much cheaper than removing and adding every object one by one.
+	 * All previous grid handles become invalid. Objects added later on still use the linked cells until the next rebuild.
+	 * @param OutGridHandles Receives the grid handle of each item, INDEX_NONE for items out of bound.
+	*/
+	void Rebuild(const TArray<FBulkCylinder> &Items, TArray<int32> &OutGridHandles);
+
 	/** Update flag */
 	void UpdateFlag(int32 GridHandle, int32 NewFlags);
 
@@ -64,12 +83,32 @@ public:
 	/** Thread safe and lock-free */
 	void QueryCylinder(const FVector3f &Base, float Radius, float Height, int32 Flags, bool MustIncludeCenter, TArray<FAntContactInfo> &OutCollided, const TArray<FAntHandle> *IgnoreList = nullptr) const;
 
+	/** Cylinder description for the coalesced QueryCylinders. */
+	struct FCylinderQuery
+	{
+		FVector3f Base;
+		float Radius = 0.0f;
+		float Height = 0.0f;
+		int32 Flags = 0;
+		bool MustIncludeCenter = false;
+	};
+
+	/**
+	 * Run many cylinder queries at once.
+	 * Queries are bucketed by the cells they touch and each touched cell is visited once for all of its queries.
+	 * Contacts of query i are OutCollided[OutStart[i]] .. OutCollided[OutStart[i + 1]], same contacts as QueryCylinder.
+	*/
+	void QueryCylinders(TConstArrayView<FCylinderQuery> InQueries, TArray<FAntContactInfo> &OutCollided, TArray<int32> &OutStart) const;
+
 	/** Thread safe and lock-free */
 	void QueryRay(const FVector3f &Start, const FVector3f &End, int32 Flags, TArray<FAntContactInfo> &OutCollided, const TArray<FAntHandle> *IgnoreList = nullptr) const;
 
 	/** Thread safe and lock-free */
 	void QueryConvexVolume(const TStaticArray<FVector, 4> &NearPlane, const TStaticArray<FVector, 4> &FarPlane, int32 Flags, TArray<FAntContactInfo> &OutCollided, const TArray<FAntHandle> *IgnoreList = nullptr) const;
 
+	/** Sort the contacts of every query by handle and instance, so the order doesn't depend on how objects are stored inside the cells. */
+	FORCEINLINE void SetSortedContacts(bool bSorted) { bSortedContacts = bSorted; }
+
 	/** Get last version. each non-const operation will increase the version. */
 	FORCEINLINE unsigned int GetVersion() const { return Version; }
 
@@ -77,6 +116,51 @@ public:
 	FORCEINLINE unsigned int GetCount() const { return Count; }
 
 private:
+	struct FNodeData;
+
+	/** Visit every live object of the given cell, bulk ranges first then linked nodes. */
+	template <typename FuncType>
+	void ForEachNodeData(int32 CellIdx, FuncType &&Func) const;
+
+	/** Visit the linked nodes of the given cell only. */
+	template <typename FuncType>
+	void ForEachLinkedNodeData(int32 CellIdx, FuncType &&Func) const;
+
+	/**
+	 * Test the bulk objects of the given cell 4 at a time over the packed columns.
+	 * TestFunc receives base X/Y/Z, radius and height of 4 objects, returns the hit mask and may write one value per lane.
+	 * HitFunc is called with the node data and the lane value of every hit whose flag matches Flags.
+	 */
+	template <typename TestFuncType, typename HitFuncType>
+	void ForEachBulkHit(int32 CellIdx, int32 Flags, TestFuncType &&TestFunc, HitFuncType &&HitFunc) const;
+
+	/** Cells overlapped by a vertical cylinder. */
+	void CollectCylinderCells(const FVector3f &Base, float Radius, TArray<int32, TInlineAllocator<32>> &OutCells) const;
+
+	/** ForEachBulkHit with the cylinder overlap test of QueryCylinder. */
+	template <typename HitFuncType>
+	void ForEachBulkCylinderHit(int32 CellIdx, const FVector3f &Base, float Radius, float Height, int32 Flags, bool MustIncludeCenter, HitFuncType &&HitFunc) const;
+
+	/** Sort OutCollided[Start..] by handle and instance. */
+	static void SortContacts(TArrayView<FAntContactInfo> Contacts);
+
+	/** Sorts the contacts a query appended when it goes out of scope, only if bSortedContacts is set. */
+	struct FSortedContactsScope
+	{
+		const FAntGrid &Grid;
+		TArray<FAntContactInfo> &Contacts;
+		const int32 Start;
+
+		~FSortedContactsScope()
+		{
+			if (Grid.bSortedContacts)
+				SortContacts(MakeArrayView(Contacts.GetData() + Start, Contacts.Num() - Start));
+		}
+	};
+
+	/** Copy the flag and height of a bulk object into its column slots. */
+	void UpdateBulkColumns(int32 GridHandle);
+
 	/** Internal grid node */
 	struct FGridNode
 	{
@@ -93,7 +177,13 @@ private:
 		int32 Flag = 0;
 		uint32 InstanceID = 0;
 		FAntHandle Handle;
+		/** First node of the linked cells, INDEX_NONE for bulk objects */
+		int32 FirstNodeIdx = INDEX_NONE;
 		uint8 bMultiCell : 1;
+		/** Object lives inside the bulk ranges. */
+		uint8 bBulk : 1;
+		/** Removed bulk object, skipped until the next rebuild. */
+		uint8 bRemoved : 1;
 		struct { FVector3f Base; float Radius; float height; } Cylinder;
 	};
 
@@ -106,6 +196,27 @@ private:
 	/** Shared node data. */
 	TSparseArray<FNodeData> GridData;
 
+	/** Bulk level, BulkCellStart[cell] .. BulkCellStart[cell + 1] is the range of the cell inside BulkItems. */
+	TArray<int32> BulkCellStart;
+
+	/** Node data indices of the bulk level, sorted by cell. */
+	TArray<int32> BulkItems;
+
+	/** Packed columns of the bulk level, same order as BulkItems. removed objects have a zero flag. */
+	TArray<float> BulkBaseX;
+	TArray<float> BulkBaseY;
+	TArray<float> BulkBaseZ;
+	TArray<float> BulkRadius;
+	TArray<float> BulkHeight;
+	TArray<int32> BulkFlag;
+
+	/** Extra zero-flag entries at the end of the columns, so the last group of a cell can always load 4 lanes. */
+	static constexpr int32 BulkColumnPadding = 3;
+
+	/** BulkItemSlots[BulkItemSlotStart[handle]] .. BulkItemSlots[BulkItemSlotStart[handle + 1]] are the column slots of a bulk object. */
+	TArray<int32> BulkItemSlotStart;
+	TArray<int32> BulkItemSlots;
+
 	/** Number of the cells inside the grid. */
 	int32 CellNumber = 0;
 
@@ -120,4 +231,7 @@ private:
 
 	/** Number of the objects inside the grid. */
 	uint32 Count = 0;
+
+	/** Queries return their contacts sorted, see SetSortedContacts. */
+	bool bSortedContacts = false;
 };
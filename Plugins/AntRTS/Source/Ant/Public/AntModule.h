@@ -17,11 +17,14 @@ DECLARE_CYCLE_STAT_EXTERN(TEXT("Ant - AsyncQueries"), STAT_ANT_Queries, STATGROU
 DECLARE_CYCLE_STAT_EXTERN(TEXT("Ant - BroadPhase"), STAT_ANT_BFUpdate, STATGROUP_ANT, ANT_API);
 DECLARE_CYCLE_STAT_EXTERN(TEXT("Ant - Movements"), STAT_ANT_MovementsUpdate, STATGROUP_ANT, ANT_API);
 DECLARE_CYCLE_STAT_EXTERN(TEXT("Ant - PostPxUpdate"), STAT_ANT_PostPX, STATGROUP_ANT, ANT_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Ant - Replication"), STAT_ANT_Replication, STATGROUP_ANT, ANT_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Ant - FormationAssignment"), STAT_ANT_Formation, STATGROUP_ANT, ANT_API);
 DECLARE_CYCLE_STAT_EXTERN(TEXT("Ant - TotalAntFrame"), STAT_ANT_TotalFrame, STATGROUP_ANT, ANT_API);
 DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Ant - NumAgents"), STAT_ANT_NumAgents, STATGROUP_ANT, ANT_API);
 DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Ant - NumMovingAgents"), STAT_ANT_NumMovingAgents, STATGROUP_ANT, ANT_API);
 DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Ant - NumPaths"), STAT_ANT_NumPaths, STATGROUP_ANT, ANT_API);
 DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Ant - NumAsyncQueries"), STAT_ANT_NumAsyncQueries, STATGROUP_ANT, ANT_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Ant - ReplicatedBytes"), STAT_ANT_ReplicatedBytes, STATGROUP_ANT, ANT_API);
 
 class FAntModule : public IModuleInterface
 {
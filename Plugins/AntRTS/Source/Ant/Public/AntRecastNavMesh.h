@@ -44,8 +44,11 @@ public:
 	/** Remove navigation modifier related to the given agent. */
 	void RemoveAgentNavModifier(FAntHandle AgentHandle);
 
-	/** Add a path to replan list. */
-	void AddPathToReplanList(FAntHandle PathHandle, const FNavigationPath *Path);
+	/**
+	 * Add a path to replan list.
+	 * @param bSpliced The given path is only the section spliced into the path data, the tiles under the rest of the portals are registered from the path data.
+	 */
+	void AddPathToReplanList(FAntHandle PathHandle, const FNavigationPath *Path, bool bSpliced = false);
 
 	/** Get kandscape height at the given location. */
 	bool GetHeightAt(const FVector &NavLocation, const FNavigationQueryFilter &QueryFilter, const FVector &Extent, FVector &Result) const;
@@ -56,6 +59,7 @@ public:
 
 	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	virtual void BeginPlay() override;
+	virtual void TickActor(float DeltaTime, enum ELevelTick TickType, FActorTickFunction &ThisTickFunction) override;
 
 private:
 	struct FTileData
@@ -73,14 +77,101 @@ private:
 		int32 NextIdx = INDEX_NONE;
 	};
 
+	/** Walkable part of a poly edge and the poly linked across it. */
+	struct FPolyPortal
+	{
+		NavNodeRef Ref = 0;
+		int32 Edge = INDEX_NONE;
+
+		/** Range along the edge, tile border links may only cover a part of it. */
+		float TMin = 0.0f;
+		float TMax = 1.0f;
+	};
+
+	/** 2D boundary of a navmesh poly, to walk small steps without Detour queries. */
+	struct FPolyCache
+	{
+		/** Poly vertices in world space, edge i is Verts[i] -> Verts[i + 1]. */
+		TArray<FVector3f, TInlineAllocator<8>> Verts;
+
+		/** Detail mesh triangles in world space, three vertices each, for the height of the surface. */
+		TArray<FVector3f, TInlineAllocator<24>> DetailTris;
+
+		/** Links to the neighbor polys, edges without any portal are walls. */
+		TArray<FPolyPortal, TInlineAllocator<8>> Portals;
+
+		/** Tiles of the poly and its neighbors, the entry is dropped when any of them is rebuilt. */
+		TArray<uint32, TInlineAllocator<4>> Tiles;
+	};
+
+	/** Path waiting for a replan after some of its tiles were rebuilt. */
+	struct FReplanRequest
+	{
+		FAntHandle Path;
+
+		/** Bounds of the rebuilt tiles crossed by the path. */
+		FBox ChangedBounds = FBox(ForceInit);
+
+		/** Number of the agents moving on the path, sort key. */
+		int32 NumUsers = 0;
+
+		/** Squared distance of the closest user to the changed bounds, secondary sort key. */
+		double MinDistSq = MAX_dbl;
+	};
+
+	/** Portals replaced by a spliced replan, maps the portal index of the followers from the old to the new corridor. */
+	struct FPathSplice
+	{
+		/** Last old portal kept before the new section, INDEX_NONE if the path was not spliced. */
+		int32 Start = INDEX_NONE;
+
+		/** First old portal kept after the new section, and its index in the new corridor. */
+		int32 OldEnd = INDEX_NONE;
+		int32 NewEnd = INDEX_NONE;
+
+		FORCEINLINE bool IsSpliced() const { return Start != INDEX_NONE; }
+
+		/** Followers inside the replaced part continue from the first portal of the new section. */
+		FORCEINLINE int32 Remap(int32 PortalIndex) const
+		{
+			return PortalIndex <= Start ? PortalIndex : (PortalIndex >= OldEnd ? PortalIndex - OldEnd + NewEnd : FMath::Min(Start + 1, NewEnd));
+		}
+	};
+
+	/** Queue the paths crossing the given tiles for replanning. */
 	void UpdateAntPaths(const TArray<uint32> &TileIds);
 
+	/** Replan queued paths, busiest first, until AAntWorldSettings::ReplanBudgetMs is spent, or DeterministicReplansPerStep paths in deterministic mode. */
+	void ProcessReplanQueue();
+
+	/** Give squad members that left their shared corridor their own path to their formation slot. */
+	void ProcessSquadStragglers();
+
+	/**
+	 * Replan a single path. Thread safe.
+	 * Paths that enter and leave the changed bounds get only the changed part of their corridor replaced.
+	 * @param OutSplice Replaced portals if OutPath only covers the replaced part.
+	 */
+	ENavigationQueryResult::Type ReplanPath(UAntSubsystem *Ant, const FReplanRequest &Request, FNavMeshPath &OutPath, FPathSplice &OutSplice) const;
+
 	void OnAgentRemoved(FAntHandle Agent);
 
 	void OnPathRemoved(FAntHandle Path);
 
 	void OnAntPxPostUpdate();
 
+	/** Deterministic mode, resolve path work on the fixed step instead of the actor tick. */
+	void OnAntFixedStep(float DeltaMul);
+
+	/** Find the cached boundary of the given poly, building it on first use. Thread safe. */
+	const FPolyCache *FindPolyCache(NavNodeRef NodeRef);
+
+	/**
+	 * Move from Start to End inside the cached start poly or across one of its shared edges.
+	 * @return False if the move needs a full Detour query.
+	 */
+	bool MoveAlongCachedSurface(NavNodeRef StartRef, const FVector3f &Start, const FVector3f &End, const FNavigationQueryFilter &QueryFilter, FNavLocation &OutLocation);
+
 	/** data inside each tile */
 	TSparseArray<FTileData> TileData;
 
@@ -90,6 +181,13 @@ private:
 	/** updated tiles */
 	TArray<uint32> UpdatedTiles;
 
+	/** paths waiting for replan */
+	TArray<FReplanRequest> ReplanQueue;
+
+	/** poly boundaries used by the navigation pass, values are stable while other threads insert */
+	TMap<NavNodeRef, TUniquePtr<FPolyCache>> PolyCache;
+	FRWLock PolyCacheLock;
+
 	/** Nav relevant list */
 	UPROPERTY()
 	TArray<UAntNavRelevant *> NavModifiers;
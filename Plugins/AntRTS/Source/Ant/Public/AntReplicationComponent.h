@@ -0,0 +1,208 @@
+// Copyright 2024 Lazy Marmot Games. All Rights Reserved.
+
+#pragma once
+
+#include "AntHandle.h"
+#include "Components/ActorComponent.h"
+#include "Engine/NetSerialization.h"
+#include "AntReplicationComponent.generated.h"
+
+class UAntSubsystem;
+class FBitWriter;
+struct FAntAgentData;
+
+/**
+ * Optional server to client replication of Ant agents.
+ * Add it to the player controller, the server streams quantized location, face angle and velocity of the agents around the client view
+ * and the client mirrors them as disabled local agents, moved along their replicated velocity between updates.
+ * Records are delta-compressed against the last state acknowledged by the client and packed into a few large unreliable bunches per send.
+ */
+UCLASS(ClassGroup = (Ant), meta = (BlueprintSpawnableComponent))
+class ANT_API UAntReplicationComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UAntReplicationComponent();
+
+	void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction *ThisTickFunction) override;
+
+	void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	/**
+	 * Client only. Get the local agent that mirrors the given server agent.
+	 * @param ServerIdx Index of the server agent handle.
+	 * @return Local agent handle, invalid if the agent is not replicated to this client.
+	 */
+	FAntHandle GetLocalAgent(int32 ServerIdx) const;
+
+	/** Outgoing bandwidth budget of this client in bytes per second. */
+	UPROPERTY(EditAnywhere, meta = (UIMin = 1024), Category = "Ant")
+	int32 MaxBytesPerSecond = 32000;
+
+	/** Seconds between two sends. */
+	UPROPERTY(EditAnywhere, meta = (UIMin = 0.0f), Category = "Ant")
+	float SendInterval = 0.05f;
+
+	/** Maximum payload of a single bunch, keep it under the packet size so a lost packet costs one bunch only. */
+	UPROPERTY(EditAnywhere, meta = (UIMin = 64), Category = "Ant")
+	int32 MaxBunchBytes = 1000;
+
+	/** Agents farther than this from the client view are not relevant. */
+	UPROPERTY(EditAnywhere, meta = (UIMin = 0.0f), Category = "Ant")
+	float RelevancyRadius = 15000.0f;
+
+	/** Location precision as a fraction of the collision cell size: quantum = CollisionCellSize / 2^LocationSubBits. */
+	UPROPERTY(EditAnywhere, meta = (UIMin = 0, UIMax = 12), Category = "Ant")
+	int32 LocationSubBits = 7;
+
+	/** Velocity precision. */
+	UPROPERTY(EditAnywhere, meta = (UIMin = 0.001f), Category = "Ant")
+	float VelocityQuantum = 0.25f;
+
+	/** Seconds a mirror keeps moving along its last replicated velocity without a new update, the server predicts the mirrors with the same limit. */
+	UPROPERTY(EditAnywhere, meta = (UIMin = 0.0f), Category = "Ant")
+	float MaxExtrapolationTime = 1.0f;
+
+	/** Agents the client extrapolates within this distance of their real location are not refreshed, so steadily moving crowds cost no bandwidth. */
+	UPROPERTY(EditAnywhere, meta = (UIMin = 0.0f), Category = "Ant")
+	float ExtrapolationTolerance = 20.0f;
+
+	/** Only agents with any of these flags are replicated. */
+	UPROPERTY(EditAnywhere, Category = "Ant")
+	int32 ReplicatedFlags = -1;
+
+protected:
+	/** Server to client, one bunch of agent records. */
+	UFUNCTION(Client, Unreliable)
+	void ClientReceiveAgents(const TArray<uint8> &Bunch);
+
+	/** Client to server, received bunches (latest sequence and a mask of the 32 previous ones) and the current view. */
+	UFUNCTION(Server, Unreliable)
+	void ServerAckAgents(uint16 InLatestSeq, uint32 InAckBits, FVector_NetQuantize InViewLocation);
+
+	/** Client to server, current view while there is nothing to acknowledge. */
+	UFUNCTION(Server, Unreliable)
+	void ServerUpdateView(FVector_NetQuantize InViewLocation);
+
+private:
+	/** Quantized agent state. */
+	struct FRepState
+	{
+		FIntVector Location = FIntVector::ZeroValue;
+		FIntVector Velocity = FIntVector::ZeroValue;
+		uint8 FaceAngle = 0;
+
+		FORCEINLINE bool operator==(const FRepState &Other) const
+		{
+			return Location == Other.Location && Velocity == Other.Velocity && FaceAngle == Other.FaceAngle;
+		}
+	};
+
+	/** Server side view of one agent for this client. */
+	struct FRepAgent
+	{
+		FRepState Baseline;
+		double BaselineTime = 0.0;
+		float Priority = 0.0f;
+		uint32 NumSent = 0;
+		uint32 BaselineSendIdx = 0;
+		uint32 Stamp = 0;
+		uint16 Ver = 0;
+		uint16 Epoch = 0;
+		uint16 BaselineSeq = 0;
+		uint8 bKnown : 1;
+		uint8 bSpawnAcked : 1;
+		uint8 bHasBaseline : 1;
+		uint8 bDespawning : 1;
+
+		FRepAgent() : bKnown(false), bSpawnAcked(false), bHasBaseline(false), bDespawning(false) {}
+	};
+
+	/** A record sent in a bunch, applied to the baseline once the bunch is acknowledged. */
+	struct FSentRecord
+	{
+		FRepState State;
+		int32 Idx = INDEX_NONE;
+		int32 AgentIdx = INDEX_NONE;
+		uint32 SendIdx = 0;
+		uint16 Ver = 0;
+		uint16 Epoch = 0;
+		uint8 Type = 0;
+	};
+
+	struct FSentBunch
+	{
+		TArray<FSentRecord> Records;
+		double SendTime = 0.0;
+		uint16 Seq = 0;
+		bool bPending = false;
+	};
+
+	/** Client side mirror of one server agent, keeps the last received states as delta baselines. */
+	struct FMirror
+	{
+		static constexpr int32 HistorySize = 8;
+
+		FRepState History[HistorySize];
+		uint16 HistorySeq[HistorySize] = {};
+		FAntHandle Local;
+		float SinceUpdate = 0.0f;
+		uint16 LastSeq = 0;
+		uint8 HistoryHead = 0;
+		uint8 HistoryNum = 0;
+		bool bSeen = false;
+	};
+
+	FRepState Quantize(const FAntAgentData &Agent, float LocationQuantum) const;
+
+	void ApplyState(UAntSubsystem *AntSubsystem, const FMirror &Mirror, const FRepState &State, float LocationQuantum) const;
+
+	float GetLocationQuantum(const UAntSubsystem *AntSubsystem) const;
+
+	bool IsRemoteServer() const;
+
+	/** Whether the client extrapolation of the acknowledged baseline is still close to the agent. */
+	bool IsExtrapolated(const FRepAgent &Rep, const FRepState &State, const FAntAgentData &Agent, double Time, float LocationQuantum, float StepInterval) const;
+
+	void SendAgents(UAntSubsystem *AntSubsystem, float Delta);
+
+	void WriteRecord(FBitWriter &Writer, const FSentRecord &Record, const FAntAgentData *Agent, float LocationQuantum) const;
+
+	void FlushBunch(FBitWriter &Writer, TArray<FSentRecord> &Records);
+
+	void ProcessAck(uint16 Seq);
+
+	void ClearMirrors(UAntSubsystem *AntSubsystem);
+
+	void ExtrapolateMirrors(UAntSubsystem *AntSubsystem, float Delta);
+
+	/** Log bandwidth and refresh latency once per second while ant.ReplicationStats is set. */
+	void UpdateStats(float Delta);
+
+	// server
+	TArray<FRepAgent> RepAgents;
+	TArray<FSentBunch> SentBunches;
+	TArray<TPair<float, int32>> Candidates;
+	TArray<FSentRecord> Outgoing;
+	FVector ViewLocation = FVector::ZeroVector;
+	float SendTimer = 0.0f;
+	float ByteCredit = 0.0f;
+	uint32 CurrentStamp = 0;
+	uint16 NextSeq = 0;
+	bool bHasView = false;
+
+	// client
+	TMap<int32, FMirror> Mirrors;
+	uint16 LatestSeq = 0;
+	uint32 AckBits = 0;
+	bool bHasLatestSeq = false;
+	float ViewTimer = 0.0f;
+	bool bPendingAck = false;
+
+	// measurement, see ant.ReplicationStats
+	double StatsTime = 0.0;
+	double StatsLatencySum = 0.0;
+	int64 StatsBytes = 0;
+	int32 StatsLatencyNum = 0;
+};
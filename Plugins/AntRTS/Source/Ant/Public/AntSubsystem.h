@@ -7,6 +7,7 @@
 #include "AntGrid.h"
 #include "NavCorridor.h"
 #include "Containers/Map.h"
+#include "Async/ParallelFor.h"
 #include "AI/Navigation/NavigationTypes.h"
 #include "AI/Navigation/NavQueryFilter.h"
 #include "Subsystems/WorldSubsystem.h"
@@ -90,6 +91,20 @@ enum class EAntAvoidanceTypes : uint8
 	RVO
 };
 
+/** Formation shapes of UAntUtil::AssignAgentsToFormation. */
+UENUM(BlueprintType)
+enum class EAntFormationShape : uint8
+{
+	/** Rows and columns. */
+	Square = 0,
+
+	/** Evenly filled disc. */
+	Circle,
+
+	/** Triangle with its tip at the front. */
+	Wedge
+};
+
 /** Async query types. */
 enum class EAntQueryType : uint8
 {
@@ -126,6 +141,7 @@ struct ANT_API FAntAgentData
 	friend class UAntSubsystem;
 	friend class UAntUtil;
 	friend class AAntRecastNavMesh;
+	friend class UAntReplicationComponent;
 
 public:
 	FAntAgentData() :
@@ -133,7 +149,8 @@ public:
 		bCanPierce(false), bUseNavigation(true),
 		bDisabled(false), bUpdateGrid(true), 
 		bCollided(false), bSleep(false),
-		bIsOnNavLink(false), bNavLinkUpdated(false)
+		bIsOnNavLink(false), bNavLinkUpdated(false),
+		bReplicatedMirror(false)
 	{}
 
 	/** Get current agent location in the current px step. */
@@ -253,6 +270,9 @@ private:
 
 	int32 GridHandle = INDEX_NONE;
 
+	/** Index of this agent in the packed agents list. */
+	int32 DenseIdx = INDEX_NONE;
+
 	/** Navigation node refrenve */
 	NavNodeRef NodeRef = INVALID_NAVNODEREF;
 
@@ -273,6 +293,9 @@ private:
 	uint8 bIsOnNavLink : 1;
 
 	uint8 bNavLinkUpdated : 1;
+
+	/** Client mirror of a replicated agent, the collision pass keeps the velocity it was given. see UAntReplicationComponent. */
+	uint8 bReplicatedMirror : 1;
 };
 
 /**
@@ -316,12 +339,21 @@ public:
 	/** Get underlying path data. */
 	TArray<Portal> &GetMutableData() { return Data; }
 
-	/** Utility function to find nearest location on the path corridor. */
+	/**
+	 * Utility function to find nearest location on the path corridor.
+	 * The portal at StartIndex is tested first, then long paths look up their corridor index instead of scanning every portal.
+	 */
 	FAntCorridorLocation FindNearestLocationOnCorridor(const FVector &NavLocation, int32 StartIndex = 0) const;
 
-	/** Rebuilding distance list for each waypoint according to its distance to the end of the path. it is mandatory for moving with acceleration. */
+	/**
+	 * Rebuilding distance list for each waypoint according to its distance to the end of the path. it is mandatory for moving with acceleration.
+	 * It also rebuilds the corridor index, so it has to be called after any change of the portals.
+	 */
 	void RebuildDistanceList();
 
+	/** Rebuild the uniform grid over the portal quads used by FindNearestLocationOnCorridor. */
+	void RebuildCorridorIndex();
+
 	/** Nav query filter to generate this path. */
 	FSharedConstNavQueryFilter FilterClass;
 
@@ -350,8 +382,31 @@ private:
 	/** Path version. will be changed after replan. */
 	uint16 Ver = 0;
 
+	/** Number of squad members moving on this path, the path is removed once the last one stops. always 0 for regular paths. */
+	int32 SquadUsers = 0;
+
+	/** Query filter class of the squad moving on this path, its stragglers get their own path with the same filter. */
+	TSubclassOf<class UNavigationQueryFilter> SquadFilterClass;
+
+	/** Path width requested for the squad, the corridor itself is widened to the squad extent. */
+	float SquadMemberWidth = 0.0f;
+
+	/** Whether the squad path is replanned, so are the paths of its stragglers. */
+	bool bSquadPathReplan = false;
+
 	/** Path data. */
 	TArray<Portal> Data;
+
+	/** Uniform 2D grid over the portal quads, Items[CellStart[cell]] .. Items[CellStart[cell + 1]] are the quads overlapping a cell. */
+	struct FCorridorIndex
+	{
+		FVector2D Origin = FVector2D::ZeroVector;
+		double CellSize = 0.0;
+		int32 NumX = 0;
+		int32 NumY = 0;
+		TArray<int32> CellStart;
+		TArray<int32> Items;
+	} CorridorIndex;
 };
 
 /**
@@ -361,8 +416,13 @@ struct ANT_API FAntMovementData
 {
 	friend class UAntSubsystem;
 	friend class UAntUtil;
+	friend class AAntRecastNavMesh;
 
 public:
+	FAntMovementData() :
+		bSquad(false), bStraggler(false), bGoalOutsideCorridor(false)
+	{}
+
 	/** Get path handle. */
 	FAntHandle GetPath() const { return Path; }
 
@@ -433,6 +493,24 @@ private:
 
 	/** Current path version */
 	uint16 PathVer = 0;
+
+	/** Goal offset from the end of the path, each squad member arrives at its own formation slot. */
+	FVector3f GoalOffset = FVector3f::ZeroVector;
+
+	/** Lateral lane of a squad member inside the corridor, 0 is the left and 1 is the right side of the portals. */
+	float LaneT = 0.5f;
+
+	/** Time spent outside of the corridor by a squad member. */
+	float OutOfCorridorTime = 0.0f;
+
+	/** Agent moves on a squad path, see UAntUtil::MoveSquadToLocation. */
+	uint8 bSquad : 1;
+
+	/** Squad member left the corridor for too long and needs its own path. */
+	uint8 bStraggler : 1;
+
+	/** Goal offset of the squad member lies outside the corridor, it leaves the corridor on purpose near the end. */
+	uint8 bGoalOutsideCorridor : 1;
 };
 
 /**
@@ -456,9 +534,6 @@ public:
 	/** Get query type. */
 	FORCEINLINE EAntQueryType GetType() const { return Type; }
 
-	/** Query result array. */
-	TArray<FAntContactInfo> Result;
-
 	/** Query execution interval. -1 means one-time (single frame) query. 0 Means each-frame query. */
 	float Interval = -1;
 
@@ -478,6 +553,10 @@ private:
 	/** Query type. */
 	EAntQueryType Type = EAntQueryType::Cylinder;
 
+	/** Span of the last result inside the pooled query results. */
+	int32 ResultStart = 0;
+	int32 ResultNum = 0;
+
 	/** Internal query data. */
 	union QueryData
 	{
@@ -543,6 +622,91 @@ public:
 	/** Extra debug draw height. */
 	UPROPERTY(EditAnywhere, Category = "Ant")
 	float DebugDrawHeight = 0;
+
+	/**
+	* Rebuild the whole collision grid in bulk once at least this fraction of the agents moved in a collision tick.
+	* Below it, moved agents are re-inserted one by one. 0 always rebuilds, values above 1 never do.
+	*/
+	UPROPERTY(EditAnywhere, meta = (UIMin = 0.0f), Category = "Ant")
+	float BulkGridRebuildRatio = 0.25f;
+
+	/** Number of packed agents processed by each parallel task of the collision and navigation passes. */
+	UPROPERTY(EditAnywhere, meta = (UIMin = 1), Category = "Ant")
+	int32 AgentBatchSize = 64;
+
+	/**
+	* Move navigation agents inside their current navmesh poly, or across one shared edge, from a cached poly boundary.
+	* Detour surface queries only run for the other moves.
+	*/
+	UPROPERTY(EditAnywhere, Category = "Ant")
+	bool bNavSurfaceCache = true;
+
+	/**
+	* Time budget (ms) per frame to replan paths crossing rebuilt navmesh tiles, the rest waits for the next frames. 0 replans all at once.
+	* Agents keep following the old corridor until their path is replanned. Not used in deterministic mode, see DeterministicReplansPerStep.
+	*/
+	UPROPERTY(EditAnywhere, meta = (UIMin = 0.0f), Category = "Ant")
+	float ReplanBudgetMs = 2.0f;
+
+	/** Replace only the changed part of the corridor of the paths that enter and leave the rebuilt tiles. */
+	UPROPERTY(EditAnywhere, Category = "Ant")
+	bool bSplicePathReplan = true;
+
+	/**
+	* Lockstep mode. The simulation only runs whole fixed steps of CollisionTickInterval, grid queries return their contacts in handle order
+	* and the parallel solvers only read the state of the previous step, so results don't depend on the number of threads.
+	* Floating point results match only between the same build on the same platform.
+	* Path replans and squad stragglers are resolved on the fixed steps, but the navmesh rebuilds themselves are not synchronized:
+	* peers stay in sync only if their navmesh tiles change at the same simulation tick (static navmesh, or modifiers applied in lockstep with a synchronous rebuild).
+	*/
+	UPROPERTY(EditAnywhere, Category = "Ant")
+	bool bDeterministic = false;
+
+	/** Maximum fixed steps per frame in deterministic mode, the remaining time is carried over to the next frames. */
+	UPROPERTY(EditAnywhere, meta = (UIMin = 1, EditCondition = "bDeterministic"), Category = "Ant")
+	int32 MaxDeterministicSteps = 4;
+
+	/** Paths replanned per fixed step in deterministic mode, replaces the wall clock ReplanBudgetMs. 0 replans all at once. */
+	UPROPERTY(EditAnywhere, meta = (UIMin = 0, EditCondition = "bDeterministic"), Category = "Ant")
+	int32 DeterministicReplansPerStep = 4;
+
+	/** Seconds a squad member can stay out of the shared corridor before it gets its own path. */
+	UPROPERTY(EditAnywhere, meta = (UIMin = 0.0f), Category = "Ant")
+	float SquadStragglerTimeout = 2.0f;
+};
+
+/**
+ * Type erased typed user-data column, one element per underlying agent index.
+ */
+class FAntUserColumnBase
+{
+public:
+	virtual ~FAntUserColumnBase() = default;
+
+	/** Make Idx a valid element and reset it to its default value. */
+	virtual void ResetElement(int32 Idx) = 0;
+
+	virtual void Empty() = 0;
+};
+
+/**
+ * Contiguous user-data column of one struct type, indexed like UAntSubsystem::GetUnderlyingAgentsList().
+ */
+template<typename T>
+class TAntUserColumn : public FAntUserColumnBase
+{
+public:
+	virtual void ResetElement(int32 Idx) override
+	{
+		if (Idx < Data.Num())
+			Data[Idx] = T();
+		else
+			Data.SetNum(Idx + 1);
+	}
+
+	virtual void Empty() override { Data.Empty(); }
+
+	TArray<T> Data;
 };
 
 /**
@@ -630,6 +794,105 @@ public:
 	*/
 	UFUNCTION(BlueprintCallable)
 	FInstancedStruct &GetAgentUserData(FAntHandle Handle);
+
+	/**
+	 * Get index of the given agent inside the underlying agents list and the typed user-data columns.
+	 * @param Handle Agent handle
+	 * @return Agent index.
+	*/
+	int32 GetAgentIndex(FAntHandle Handle) const;
+
+	/**
+	 * Register a typed user-data column, one element of T per agent in a single contiguous array.
+	 * Unlike GetAgentUserData there is no type check or pointer chase per access, bulk passes walk the column next to the agents list.
+	 * New agents get a default constructed element and removed agents reset theirs. T must be a USTRUCT.
+	 * Registering the same type again returns the existing column.
+	 * The returned view is invalidated when AddAgent() grows the column, fetch it again with GetAgentUserColumn() after adding agents.
+	 * @return Column indexed like GetUnderlyingAgentsList().
+	*/
+	template<typename T>
+	TArrayView<T> RegisterAgentUserColumn()
+	{
+		auto &column = UserColumns.FindOrAdd(T::StaticStruct());
+		if (!column.IsValid())
+		{
+			column = MakeUnique<TAntUserColumn<T>>();
+			static_cast<TAntUserColumn<T> *>(column.Get())->Data.SetNum(Agents.GetMaxIndex());
+		}
+
+		return static_cast<TAntUserColumn<T> *>(column.Get())->Data;
+	}
+
+	/**
+	 * Checksum of the simulation state (agents and their movements) for lockstep desync detection.
+	 * Peers compare it after the same GetSimulationTick(), for example from OnPxPostUpdate.
+	*/
+	uint32 GetStateChecksum() const;
+
+	/** Number of fixed steps simulated in deterministic mode. */
+	FORCEINLINE uint32 GetSimulationTick() const { return SimulationTick; }
+
+	/** Whether a typed user-data column of T is registered. */
+	template<typename T>
+	bool HasAgentUserColumn() const { return UserColumns.Contains(T::StaticStruct()); }
+
+	/**
+	 * Get a registered typed user-data column.
+	 * The view is invalidated when AddAgent() grows the column, don't keep it across agent additions.
+	 * @return Column indexed like GetUnderlyingAgentsList(), holes belong to removed agents.
+	*/
+	template<typename T>
+	TArrayView<T> GetAgentUserColumn()
+	{
+		return static_cast<TAntUserColumn<T> *>(UserColumns.FindChecked(T::StaticStruct()).Get())->Data;
+	}
+
+	/**
+	 * Get a registered typed user-data column.
+	 * The view is invalidated when AddAgent() grows the column, don't keep it across agent additions.
+	 * @return Column indexed like GetUnderlyingAgentsList(), holes belong to removed agents.
+	*/
+	template<typename T>
+	TConstArrayView<T> GetAgentUserColumn() const
+	{
+		return static_cast<const TAntUserColumn<T> *>(UserColumns.FindChecked(T::StaticStruct()).Get())->Data;
+	}
+
+	/**
+	 * Get the element of a registered typed user-data column that belongs to the given agent.
+	 * The reference is invalidated when AddAgent() grows the column.
+	 * @param Handle Agent handle.
+	 * @return Refrence to the data.
+	*/
+	template<typename T>
+	T &GetAgentUserColumnData(FAntHandle Handle)
+	{
+		return GetAgentUserColumn<T>()[GetAgentIndex(Handle)];
+	}
+
+	/**
+	 * Get the element of a registered typed user-data column that belongs to the given agent.
+	 * The reference is invalidated when AddAgent() grows the column.
+	 * @param Handle Agent handle.
+	 * @return Refrence to the data.
+	*/
+	template<typename T>
+	const T &GetAgentUserColumnData(FAntHandle Handle) const
+	{
+		return GetAgentUserColumn<T>()[GetAgentIndex(Handle)];
+	}
+
+	/**
+	 * Run Func over every agent and its element of a registered typed user-data column, in the packed agents list order.
+	 * Func is called as Func(FAntAgentData &, T &).
+	*/
+	template<typename T, typename FuncType>
+	void ForEachAgentUserColumn(FuncType &&Func)
+	{
+		const auto column = GetAgentUserColumn<T>();
+		for (const auto idx : DenseAgents)
+			Func(Agents[idx], column[idx]);
+	}
 	
 
 	/**
@@ -682,6 +945,25 @@ public:
 	FORCEINLINE const TSparseArray<FAntAgentData> &GetUnderlyingAgentsList() const { return Agents; }
 	FORCEINLINE TSparseArray<FAntAgentData> &GetMutableUnderlyingAgentsList() { return Agents; }
 
+	/** Valid indices of the underlying agents list without holes. order changes whenever an agent is removed. */
+	FORCEINLINE const TArray<int32> &GetDenseAgentsList() const { return DenseAgents; }
+
+	/**
+	 * Run Func over the packed agents list on the task graph, AAntWorldSettings::AgentBatchSize agents per task.
+	 * Func is called once per batch with the [Begin, End) range of GetDenseAgentsList().
+	 */
+	template<typename FuncType>
+	void ParallelForAgentBatches(FuncType &&Func) const
+	{
+		const auto batchSize = FMath::Max(1, Settings->AgentBatchSize);
+		const auto numAgents = DenseAgents.Num();
+		ParallelFor(FMath::DivideAndRoundUp(numAgents, batchSize), [&](int32 batchIdx)
+			{
+				const auto begin = batchIdx * batchSize;
+				Func(begin, FMath::Min(begin + batchSize, numAgents));
+			});
+	}
+
 	/**
 	 * Move an agent through the given path.
 	 * MissingVelocity = (Agent.PreferredVelocity - Agent.CurrentVelocity)
@@ -871,6 +1153,14 @@ public:
 	*/
 	FAntQueryData &GetMutableAsyncQueryData(FAntHandle Handle);
 
+	/**
+	 * Get the last result of an async query.
+	 * The view points into a pooled buffer and stays valid until the next tick.
+	 * @param Handle Async query handle.
+	 * @return Query result.
+	*/
+	TConstArrayView<FAntContactInfo> GetAsyncQueryResult(FAntHandle Handle) const;
+
 	/**
 	 * Get custom user data that specified to the given async query.
 	 * @param Handle Async query handle.
@@ -982,6 +1272,18 @@ protected:
 
 	void DispatchAsyncQueries(float Delta);
 
+	/** Fixed-step tick of the deterministic mode. */
+	void TickDeterministic(float Delta);
+
+	/** Wake up an agent touched by the solver of another agent. */
+	FORCEINLINE void MarkCollided(int32 AgentIdx) { SolverColumns.Collided[AgentIdx] = 1; }
+
+	/** Drop one squad member from a squad path, the path is removed with its last member. */
+	void ReleaseSquadPath(FAntHandle PathHandle);
+
+	/** Run the due async queries, cylinders are coalesced by the grid cells they touch. */
+	void UpdateAsyncQueries(float Delta);
+
 	/** Solve collisions and find best locations according to the preffered velocity. */
 	FVector3f DefaultSolver(FAntAgentData &AgentData);
 
@@ -1023,6 +1325,9 @@ protected:
 	TSparseArray<FAntAgentData> Agents;
 	TSparseArray<FAntMovementData> Movements;
 
+	/** Packed indices of Agents, each agent keeps its own position in DenseIdx. */
+	TArray<int32> DenseAgents;
+
 	FAntIndexer<2, static_cast<uint8>(EAntHandleTypes::Path)> PathStorage;
 	TSparseArray<FAntPathData> Paths;
 
@@ -1031,8 +1336,48 @@ protected:
 
 	TSparseArray<FInstancedStruct> UserData;
 
+	/** Typed user-data columns of the agents, keyed by their struct. */
+	TMap<const UScriptStruct *, TUniquePtr<FAntUserColumnBase>> UserColumns;
+
 	FAntGrid *BroadphaseGrid = nullptr;
 
+	/** Scratch of the bulk grid rebuild, reused between frames. */
+	TArray<FAntGrid::FBulkCylinder> BulkGridItems;
+	TArray<int32> BulkGridAgents;
+	TArray<int32> BulkGridHandles;
+
+	/** Pooled contacts of the async queries, see FAntQueryData::ResultStart. previous buffer is kept for the queries that did not run. */
+	TArray<FAntContactInfo> QueryResults;
+	TArray<FAntContactInfo> PrevQueryResults;
+
+	/** Scratch of the async query pass, reused between frames. */
+	TArray<FAntGrid::FCylinderQuery> CylinderQueries;
+	TArray<FAntContactInfo> CylinderResults;
+	TArray<int32> CylinderResultStart;
+	TArray<int32> RayQueries;
+	TArray<TArray<FAntContactInfo>> RayResults;
+	TArray<int32> QuerySlots;
+	TArray<FAntHandle> ProceedQueries;
+	TArray<FAntHandle> TempQueries;
+
+	/**
+	* Hot neighbour columns indexed like Agents, filled before each solver pass.
+	* Solvers read the previous step velocity and the flag of their neighbours from here instead of the agent records,
+	* and leave collision marks in a separate byte since the bit fields of other agents share bytes with fields their owner thread writes.
+	*/
+	struct FSolverColumns
+	{
+		TArray<FVector3f> Velocity;
+		TArray<int32> Flag;
+		TArray<uint8> Collided;
+	};
+	FSolverColumns SolverColumns;
+
+	uint32 SimulationTick = 0;
+
+	/** Squad members that left their shared corridor, collected over the steps until AAntRecastNavMesh gives them their own path and resets the list. */
+	TArray<FAntHandle> SquadStragglers;
+
 	int32 NumAvailThreads = 0;
 
 	float ShiftSize = 0.0f;
@@ -28,6 +28,17 @@ public:
 		float TargetAcceptanceRadius, float PathAcceptanceRadius, EAntPathFollowerType PathFollowerType, float PathWidth,
 		float MissingVelocityTimeout = -1.0f, bool PathReplan = false, float ReplanCostThreshold = -1.f, TSubclassOf<UNavigationQueryFilter> FilterClass = nullptr);
 
+	/* Move a squad along one shared corridor.
+	* Only one path is built for the whole group, each agent follows it on its own lateral lane (FlowField follower) and arrives at DestLocation plus its formation offset.
+	* The corridor is widened to the squad extent when PathWidth is narrower.
+	* The path is removed once the last member stops. Members that stay out of the corridor for AAntWorldSettings::SquadStragglerTimeout get their own path with the same width, filter and replan settings.
+	* @param FormationOffsets Goal offset of each agent from DestLocation. empty keeps the current offset of each agent from the squad center.
+	* @return return the shared path handle, invalid if there is no path.
+	*/
+	static FAntHandle MoveSquadToLocation(UWorld *World, const TArray<FAntHandle> &Agents, const FVector &DestLocation, const TArray<FVector> &FormationOffsets,
+		float MaxSpeed, float Acceleration, float Deceleration, float TargetAcceptanceRadius, float PathAcceptanceRadius, float PathWidth,
+		float MissingVelocityTimeout = -1.0f, bool PathReplan = false, float ReplanCostThreshold = -1.f, TSubclassOf<UNavigationQueryFilter> FilterClass = nullptr);
+
 	/* Create a permanent shared path by given locations.
 	* Returned path is permanent until it get removed by calling Ant->RemovePath().
 	* @return return a valid path handle if it found a valid path.
@@ -76,6 +87,20 @@ public:
 
 	static void SortAgentsByCirclePack(UWorld *World, const FVector &DestLocation, TArray<FAntHandle> &Agents, float SplitSpace, TArray<FVector> &ResultLocations);
 
+	/**
+	 * Build a formation at the destination and assign one slot to each agent.
+	 * Slots are matched with an approximate min-cost assignment (greedy over a spatial hash, then local swaps),
+	 * so agents keep their place inside the crowd and their paths don't cross. Meant for large selections (thousands of agents).
+	 * Small Square and Circle groups fall back to SortAgentsBySquare and SortAgentsByCirclePack, which may alter order of the Agents array, turned to Facing as well.
+	 * Timed by the "Ant - FormationAssignment" stat.
+	 * @param World Current active world.
+	 * @param DestLocation Destination location (center of the formation).
+	 * @param Facing Yaw of the formation front in radians.
+	 * @param SplitSpace Space between each agent
+	 * @param ResultLocations Slot of each agent, same order as Agents.
+	*/
+	static void AssignAgentsToFormation(UWorld *World, const FVector &DestLocation, EAntFormationShape Shape, float Facing, TArray<FAntHandle> &Agents, float SplitSpace, TArray<FVector> &ResultLocations);
+
 	/** Get lerp alpha used by the path portals */
 	static void GetCorridorPortalAlpha(const TArray<FVector> &SourceLocations, const FVector &DestLocation, TArray<float> &ResultAlpha);
 
@@ -18,6 +18,9 @@
 #include "Mechanism.h"
 
 #include "Misc/App.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "Serialization/ObjectAndNameAsStringProxyArchive.h"
 
 #include "Machine.h"
 #include "SubjectRecordCollection.h"
@@ -110,3 +113,508 @@ AMechanism::Reset()
 
 	Super::Reset();
 }
+
+namespace
+{
+	/**
+	 * The magic number the mechanism snapshots start with.
+	 */
+	constexpr uint32 SnapshotMagic = 0x4E535041; // "APSN"
+
+	/**
+	 * Check if the trait type can be snapshotted as a raw memory block.
+	 * 
+	 * The type has to be trivially destructible and consist of
+	 * numeric, boolean, enum and such struct properties only.
+	 */
+	bool
+	IsRawSnapshotType(const UScriptStruct* const Type)
+	{
+		if (Type->StructFlags & STRUCT_IsPlainOldData)
+		{
+			return true;
+		}
+		const auto CppStructOps = Type->GetCppStructOps();
+		if (CppStructOps && CppStructOps->HasDestructor())
+		{
+			return false;
+		}
+		for (TFieldIterator<FProperty> It(Type); It; ++It)
+		{
+			if (const auto StructProperty = CastField<FStructProperty>(*It))
+			{
+				if (!IsRawSnapshotType(StructProperty->Struct))
+				{
+					return false;
+				}
+			}
+			else if (!It->IsA<FNumericProperty>() && !It->IsA<FBoolProperty>() && !It->IsA<FEnumProperty>())
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * A trait line read from a snapshot
+	 * before it is moved into its chunk.
+	 */
+	struct FSnapshotLine
+	{
+		UScriptStruct* Type = nullptr;
+		uint8*         Data = nullptr;
+		int32          Num  = 0;
+		bool           bRaw = false;
+
+		FSnapshotLine(UScriptStruct* const InType, const int32 InNum, const bool bInRaw)
+		  : Type(InType)
+		  , Num(InNum)
+		  , bRaw(bInRaw)
+		{
+			const int64 Size = (int64)FMath::Max(1, Type->GetStructureSize()) * Num;
+			if (Size > 0)
+			{
+				Data = (uint8*)FMemory::Malloc(Size, Type->GetMinAlignment());
+				if (!bRaw)
+				{
+					Type->InitializeStruct(Data, Num);
+				}
+			}
+		}
+
+		FSnapshotLine(const FSnapshotLine&) = delete;
+		FSnapshotLine& operator=(const FSnapshotLine&) = delete;
+
+		~FSnapshotLine()
+		{
+			if (Data)
+			{
+				if (!bRaw)
+				{
+					Type->DestroyStruct(Data, Num);
+				}
+				FMemory::Free(Data);
+			}
+		}
+	};
+}
+
+EApparatusStatus
+AMechanism::TakeSnapshot(TArray<uint8>& OutData) const
+{
+	AssessConditionFormat(EParadigm::Polite, !IsInConcurrentEnvironment(), EApparatusStatus::InvalidState,
+						  TEXT("Can not take a snapshot in a concurrent environment."));
+	AssessCondition(EParadigm::Polite, (MechanismId != InvalidId) && UMachine::HasInstance(), EApparatusStatus::InvalidState);
+
+	const auto& Pool = UMachine::Instance->SubjectPools[MechanismId];
+
+	// Gather the live subject slots along with the manifest of their trait types.
+	// The subjects owned by subjectives are not part of the snapshot:
+	TArray<UScriptStruct*> Types;
+	TArray<bool> RawTypes;
+	TMap<UScriptStruct*, int32> TypeIndices;
+	TArray<const UChunk*> SnapshotChunks;
+	TArray<TArray<int32>> SnapshotSlots;
+
+	for (const UChunk* const Chunk : Chunks)
+	{
+		if (!Chunk || (Chunk->Slots.Num() == 0)) continue;
+
+		TArray<int32> SlotIndices;
+		SlotIndices.Reserve(Chunk->Slots.Num());
+		for (int32 SlotIndex = 0; SlotIndex < Chunk->Slots.Num(); ++SlotIndex)
+		{
+			const auto& Slot = Chunk->Slots[SlotIndex];
+			if (Slot.IsStale() || Slot.HasFlag(EFlagmarkBit::DeferredDespawn)) continue;
+			const auto Info = Slot.FindInfo();
+			if (!Info || Info->Subjective) continue;
+			SlotIndices.Add(SlotIndex);
+		}
+		if (SlotIndices.Num() == 0) continue;
+
+		for (const auto& Line : Chunk->Lines)
+		{
+			UScriptStruct* const Type = Line.GetElementType();
+			if (!TypeIndices.Contains(Type))
+			{
+				TypeIndices.Add(Type, Types.Add(Type));
+				RawTypes.Add(IsRawSnapshotType(Type));
+			}
+		}
+		SnapshotChunks.Add(Chunk);
+		SnapshotSlots.Add(MoveTemp(SlotIndices));
+	}
+
+	OutData.Reset();
+	FMemoryWriter Writer(OutData, /*bIsPersistent=*/true);
+	FObjectAndNameAsStringProxyArchive Ar(Writer, /*bInLoadIfFindFails=*/false);
+
+	uint32 Magic = SnapshotMagic;
+	int32 Version = SnapshotVersion;
+	int32 PlacesNum = Pool.Subjects.Num();
+	Ar << Magic << Version << PlacesNum;
+
+	// The type manifest:
+	int32 TypesNum = Types.Num();
+	Ar << TypesNum;
+	for (int32 TypeIndex = 0; TypeIndex < Types.Num(); ++TypeIndex)
+	{
+		FString TypePath = Types[TypeIndex]->GetPathName();
+		int32 TypeSize = Types[TypeIndex]->GetStructureSize();
+		bool bRaw = RawTypes[TypeIndex];
+		Ar << TypePath << TypeSize << bRaw;
+	}
+
+	// The chunk headers with the subject places go first,
+	// so that the restore can validate them before
+	// changing anything:
+	int32 ChunksNum = SnapshotChunks.Num();
+	Ar << ChunksNum;
+	TArray<uint32> Places;
+	TArray<uint32> Generations;
+	TArray<int32> Flagmarks;
+	for (int32 ChunkIndex = 0; ChunkIndex < SnapshotChunks.Num(); ++ChunkIndex)
+	{
+		const UChunk* const Chunk = SnapshotChunks[ChunkIndex];
+		const auto& SlotIndices = SnapshotSlots[ChunkIndex];
+
+		TArray<int32> LineTypes;
+		LineTypes.Reserve(Chunk->Lines.Num());
+		for (const auto& Line : Chunk->Lines)
+		{
+			LineTypes.Add(TypeIndices.FindChecked(Line.GetElementType()));
+		}
+		Ar << LineTypes;
+
+		Places.Reset(SlotIndices.Num());
+		Generations.Reset(SlotIndices.Num());
+		Flagmarks.Reset(SlotIndices.Num());
+		for (const int32 SlotIndex : SlotIndices)
+		{
+			const auto& Slot = Chunk->Slots[SlotIndex];
+			const auto Info = Slot.FindInfo();
+			Places.Add(Info->Id & FSubjectInfo::PlaceMask);
+			Generations.Add(Info->Generation.load(std::memory_order_relaxed));
+			// The networking state is not part of the snapshot:
+			Flagmarks.Add((int32)(Slot.GetFlagmark() & ~FM_Online));
+		}
+		Places.BulkSerialize(Ar);
+		Generations.BulkSerialize(Ar);
+		Flagmarks.BulkSerialize(Ar);
+	}
+
+	// The trait lines data:
+	for (int32 ChunkIndex = 0; ChunkIndex < SnapshotChunks.Num(); ++ChunkIndex)
+	{
+		const UChunk* const Chunk = SnapshotChunks[ChunkIndex];
+		const auto& SlotIndices = SnapshotSlots[ChunkIndex];
+		const bool bDense = SlotIndices.Num() == Chunk->Slots.Num();
+
+		for (const auto& Line : Chunk->Lines)
+		{
+			UScriptStruct* const Type = Line.GetElementType();
+			const int64 Stride = FMath::Max(1, Line.GetElementSize());
+			if (RawTypes[TypeIndices.FindChecked(Type)])
+			{
+				if (bDense)
+				{
+					// The whole line is written as a single block:
+					Ar.Serialize(const_cast<void*>(Line.At(0)), Stride * SlotIndices.Num());
+				}
+				else
+				{
+					for (const int32 SlotIndex : SlotIndices)
+					{
+						Ar.Serialize(const_cast<void*>(Line.At(SlotIndex)), Stride);
+					}
+				}
+			}
+			else
+			{
+				for (const int32 SlotIndex : SlotIndices)
+				{
+					Type->SerializeBin(Ar, const_cast<void*>(Line.At(SlotIndex)));
+				}
+			}
+		}
+	}
+
+	return Ar.IsError() ? EApparatusStatus::Error : EApparatusStatus::Success;
+}
+
+EApparatusStatus
+AMechanism::RestoreSnapshot(const TArray<uint8>& InData)
+{
+	AssessConditionFormat(EParadigm::Polite, !IsInConcurrentEnvironment(), EApparatusStatus::InvalidState,
+						  TEXT("Can not restore a snapshot in a concurrent environment."));
+	AssessConditionFormat(EParadigm::Polite, LocksCount.load(std::memory_order_relaxed) == 0, EApparatusStatus::InvalidState,
+						  TEXT("Can not restore a snapshot while iterating the '%s' mechanism."), *GetName());
+	AssessCondition(EParadigm::Polite, (MechanismId != InvalidId) && UMachine::HasInstance(), EApparatusStatus::InvalidState);
+
+	FMemoryReader Reader(InData, /*bIsPersistent=*/true);
+	FObjectAndNameAsStringProxyArchive Ar(Reader, /*bInLoadIfFindFails=*/true);
+
+	uint32 Magic = 0;
+	int32 Version = 0;
+	int32 PlacesNum = 0;
+	Ar << Magic << Version << PlacesNum;
+	AssessConditionFormat(EParadigm::Polite, (Magic == SnapshotMagic) && (Version == SnapshotVersion), EApparatusStatus::InvalidArgument,
+						  TEXT("Not a mechanism snapshot or an unsupported version: %d"), Version);
+	AssessCondition(EParadigm::Polite, (PlacesNum >= 0) && ((uint32)PlacesNum <= FSubjectInfo::PlacesPerMechanismMax), EApparatusStatus::InvalidArgument);
+
+	// Resolve the type manifest:
+	int32 TypesNum = 0;
+	Ar << TypesNum;
+	AssessCondition(EParadigm::Polite, !Ar.IsError() && (TypesNum >= 0), EApparatusStatus::InvalidArgument);
+	TArray<UScriptStruct*> Types;
+	TArray<bool> RawTypes;
+	Types.Reserve(TypesNum);
+	RawTypes.Reserve(TypesNum);
+	for (int32 TypeIndex = 0; TypeIndex < TypesNum; ++TypeIndex)
+	{
+		FString TypePath;
+		int32 TypeSize = 0;
+		bool bRaw = false;
+		Ar << TypePath << TypeSize << bRaw;
+		UScriptStruct* const Type = FindObject<UScriptStruct>(nullptr, *TypePath);
+		AssessConditionFormat(EParadigm::Polite, Type != nullptr, EApparatusStatus::Missing,
+							  TEXT("The snapshot trait type was not found: %s"), *TypePath);
+		// The raw blocks are only compatible with the very same layout:
+		AssessConditionFormat(EParadigm::Polite, !bRaw || (IsRawSnapshotType(Type) && (Type->GetStructureSize() == TypeSize)),
+							  EApparatusStatus::WrongType,
+							  TEXT("The snapshot trait type has changed its layout: %s"), *TypePath);
+		Types.Add(Type);
+		RawTypes.Add(bRaw);
+	}
+
+	// Read the chunk headers and validate the places before changing anything:
+	auto& Pool = UMachine::Instance->SubjectPools[MechanismId];
+	int32 ChunksNum = 0;
+	Ar << ChunksNum;
+	AssessCondition(EParadigm::Polite, !Ar.IsError() && (ChunksNum >= 0), EApparatusStatus::InvalidArgument);
+	TArray<TArray<int32>> ChunkLineTypes;
+	TArray<TArray<uint32>> ChunkPlaces;
+	TArray<TArray<uint32>> ChunkGenerations;
+	TArray<TArray<int32>> ChunkFlagmarks;
+	ChunkLineTypes.SetNum(ChunksNum);
+	ChunkPlaces.SetNum(ChunksNum);
+	ChunkGenerations.SetNum(ChunksNum);
+	ChunkFlagmarks.SetNum(ChunksNum);
+	TBitArray<> UsedPlaces(false, FMath::Max(PlacesNum, Pool.Subjects.Num()));
+	for (int32 ChunkIndex = 0; ChunkIndex < ChunksNum; ++ChunkIndex)
+	{
+		Ar << ChunkLineTypes[ChunkIndex];
+		ChunkPlaces[ChunkIndex].BulkSerialize(Ar);
+		ChunkGenerations[ChunkIndex].BulkSerialize(Ar);
+		ChunkFlagmarks[ChunkIndex].BulkSerialize(Ar);
+		AssessCondition(EParadigm::Polite, !Ar.IsError(), EApparatusStatus::InvalidArgument);
+		AssessCondition(EParadigm::Polite, (ChunkPlaces[ChunkIndex].Num() == ChunkGenerations[ChunkIndex].Num())
+										&& (ChunkPlaces[ChunkIndex].Num() == ChunkFlagmarks[ChunkIndex].Num()),
+						EApparatusStatus::InvalidArgument);
+		AssessCondition(EParadigm::Polite, ChunkPlaces[ChunkIndex].Num() <= FSubjectInfo::SlotsPerChunkMax, EApparatusStatus::OutOfLimit);
+
+		for (const int32 TypeIndex : ChunkLineTypes[ChunkIndex])
+		{
+			AssessCondition(EParadigm::Polite, Types.IsValidIndex(TypeIndex), EApparatusStatus::InvalidArgument);
+		}
+		for (const uint32 Place : ChunkPlaces[ChunkIndex])
+		{
+			AssessCondition(EParadigm::Polite, (Place >= FSubjectInfo::FirstPlace) && ((int32)Place < PlacesNum) && !UsedPlaces[Place],
+							EApparatusStatus::InvalidArgument);
+			UsedPlaces[Place] = true;
+			if ((int32)Place < Pool.Subjects.Num())
+			{
+				// A subjective may have occupied the place since:
+				const auto& Info = Pool.Subjects[Place];
+				AssessConditionFormat(EParadigm::Polite, !Info.Chunk || !Info.Subjective, EApparatusStatus::Conflict,
+									  TEXT("The snapshot subject place #%u is occupied by a subjective."), Place);
+			}
+		}
+	}
+
+	// Read all of the trait lines data up front, so that
+	// a truncated or corrupted snapshot leaves the current
+	// state untouched:
+	int32 LinesNum = 0;
+	for (const auto& LineTypes : ChunkLineTypes)
+	{
+		LinesNum += LineTypes.Num();
+	}
+	TArray<FSnapshotLine> Lines;
+	Lines.Reserve(LinesNum);
+	for (int32 ChunkIndex = 0; ChunkIndex < ChunksNum; ++ChunkIndex)
+	{
+		const int32 Num = ChunkPlaces[ChunkIndex].Num();
+
+		for (const int32 TypeIndex : ChunkLineTypes[ChunkIndex])
+		{
+			UScriptStruct* const Type = Types[TypeIndex];
+			const int64 Stride = FMath::Max(1, Type->GetStructureSize());
+			if (RawTypes[TypeIndex])
+			{
+				AssessCondition(EParadigm::Polite, Stride * Num <= Ar.TotalSize() - Ar.Tell(), EApparatusStatus::InvalidArgument);
+			}
+			auto& Line = Lines.Emplace_GetRef(Type, Num, RawTypes[TypeIndex]);
+			if (Line.bRaw)
+			{
+				Ar.Serialize(Line.Data, Stride * Num);
+			}
+			else
+			{
+				for (int32 i = 0; i < Num; ++i)
+				{
+					Type->SerializeBin(Ar, Line.Data + Stride * i);
+				}
+			}
+			AssessCondition(EParadigm::Polite, !Ar.IsError(), EApparatusStatus::InvalidArgument);
+		}
+	}
+
+	FExclusiveScope Exclusive(this);
+
+	// Despawn the current subjects. The chunks without any
+	// subjectives are cleared in bulk:
+	for (UChunk* const Chunk : Chunks)
+	{
+		if (!Chunk || (Chunk->Slots.Num() == 0)) continue;
+
+		bool bHasSubjectives = false;
+		for (const auto& Slot : Chunk->Slots)
+		{
+			const auto Info = Slot.IsStale() ? nullptr : Slot.FindInfo();
+			if (Info && Info->Subjective)
+			{
+				bHasSubjectives = true;
+				break;
+			}
+		}
+
+		if (bHasSubjectives)
+		{
+			TArray<uint32> PlacesToRelease;
+			for (const auto& Slot : Chunk->Slots)
+			{
+				const auto Info = Slot.IsStale() ? nullptr : Slot.FindInfo();
+				if (Info && !Info->Subjective && (Info->Chunk == Chunk))
+				{
+					PlacesToRelease.Add(Info->Id & FSubjectInfo::PlaceMask);
+				}
+			}
+			for (const uint32 Place : PlacesToRelease)
+			{
+				Pool.ReleaseSubjectInfo(Place);
+			}
+			continue;
+		}
+
+		for (int32 SlotIndex = 0; SlotIndex < Chunk->Slots.Num(); ++SlotIndex)
+		{
+			const auto Info = Chunk->Slots[SlotIndex].FindInfo();
+			if (!Info || (Info->Chunk != Chunk) || (Info->SlotIndex != SlotIndex)) continue;
+
+			if (Info->NetworkState != nullptr
+			 && Info->NetworkState->IsValid())
+			{
+				SubjectByNetworkId.Remove(Info->NetworkState->Id);
+				Info->NetworkState->Id = FSubjectNetworkState::InvalidId;
+			}
+			Info->Chunk     = nullptr;
+			Info->SlotIndex = FSubjectInfo::InvalidSlotIndex;
+			Info->DoIncrementGeneration();
+			Pool.FreePlaces.Add(Info->Id & FSubjectInfo::PlaceMask);
+		}
+		Chunk->DoPop(Chunk->Slots.Num());
+	}
+
+	// Grow the pool to cover the snapshot places and take
+	// the restored places out of the free list:
+	for (int32 Place = Pool.Subjects.Num(); Place < PlacesNum; ++Place)
+	{
+		auto& Info = Pool.Subjects.AddDefaulted_GetRef();
+		Info.Id = FSubjectInfo::MakeId(MechanismId, Place);
+		Pool.FreePlaces.Add(Place);
+	}
+	Pool.FreePlaces.RemoveAllSwap([&UsedPlaces](const FSubjectInfo::IdType Place)
+	{
+		return ((int32)Place < UsedPlaces.Num()) && UsedPlaces[Place];
+	});
+
+	// Bulk-load the subjects into their chunks:
+	TArray<UChunk*> RestoredChunks;
+	TArray<int32> FirstSlotIndices;
+	RestoredChunks.Reserve(ChunksNum);
+	FirstSlotIndices.Reserve(ChunksNum);
+	for (int32 ChunkIndex = 0; ChunkIndex < ChunksNum; ++ChunkIndex)
+	{
+		TArray<UScriptStruct*> ChunkTypes;
+		for (const int32 TypeIndex : ChunkLineTypes[ChunkIndex])
+		{
+			ChunkTypes.Add(Types[TypeIndex]);
+		}
+		const FTraitmark Traitmark(ChunkTypes);
+		const auto Chunk = ObtainChunk<EParadigm::Polite>(Traitmark);
+		AssessCondition(EParadigm::Polite, OK(Chunk), ToStatus(Chunk));
+
+		const auto& Places = ChunkPlaces[ChunkIndex];
+		const int32 FirstSlotIndex = Chunk->Slots.Num();
+		AssessCondition(EParadigm::Polite, FirstSlotIndex <= FSubjectInfo::SlotsPerChunkMax - Places.Num(), EApparatusStatus::OutOfLimit);
+
+		Chunk->Reserve(FirstSlotIndex + Places.Num());
+		Chunk->Slots.AddDefaulted(Places.Num());
+		Chunk->Count = Chunk->Slots.Num();
+
+		for (int32 i = 0; i < Places.Num(); ++i)
+		{
+			const int32 SlotIndex = FirstSlotIndex + i;
+			auto& Info = Pool.Subjects[Places[i]];
+			check(Info.Chunk == nullptr);
+			Info.Generation.store(ChunkGenerations[ChunkIndex][i], std::memory_order_relaxed);
+			Info.Chunk     = Chunk;
+			Info.SlotIndex = SlotIndex;
+
+			const auto Flagmark = (EFlagmark)(ChunkFlagmarks[ChunkIndex][i] & ~(FM_Stale | FM_DeferredDespawn | FM_Online));
+			auto& Slot = Chunk->Slots[SlotIndex];
+			Slot = &Info;
+			Slot.Fingerprint.SetFlagmark(Flagmark);
+			Slot.Fingerprint.SetTraitmark(Traitmark);
+
+			if (!(Flagmark & FM_Booted))
+			{
+				HaltedSubjects.Add(Info.GetHandle());
+			}
+		}
+
+		RestoredChunks.Add(Chunk);
+		FirstSlotIndices.Add(FirstSlotIndex);
+	}
+
+	// Move the trait lines data into the chunks:
+	int32 LineIndex = 0;
+	for (int32 ChunkIndex = 0; ChunkIndex < ChunksNum; ++ChunkIndex)
+	{
+		UChunk* const Chunk = RestoredChunks[ChunkIndex];
+		const int32 Num = ChunkPlaces[ChunkIndex].Num();
+
+		for (const int32 TypeIndex : ChunkLineTypes[ChunkIndex])
+		{
+			const auto& Staged = Lines[LineIndex++];
+			UScriptStruct* const Type = Types[TypeIndex];
+			auto& Line = Chunk->Lines[Chunk->TraitLineIndexOf(Type)];
+			check(Line.Num() == FirstSlotIndices[ChunkIndex]);
+			if (Num == 0) continue;
+			if (Staged.bRaw)
+			{
+				FMemory::Memcpy(Line.AppendUninitialized(Num), Staged.Data, (int64)FMath::Max(1, Line.GetElementSize()) * Num);
+			}
+			else
+			{
+				Type->CopyScriptStruct(Line.AppendDefaulted(Num), Staged.Data, Num);
+			}
+		}
+		check(Chunk->Lines.Num() == 0 || Chunk->Lines[0].Num() == Chunk->Slots.Num());
+	}
+
+	APPARATUS_REPORT_SUCCESS(TEXT("Restored %d chunks from a snapshot."), ChunksNum);
+	return EApparatusStatus::Success;
+}
@@ -1852,7 +1852,7 @@ struct TSubjectHandle
 		{
 			return EApparatusStatus::InvalidState;
 		}
-		return Info->template SetTraits<Paradigm>(SubjectRecord);
+		return Info->template SetTraits<Paradigm>(SubjectRecord, bLeaveRedundant);
 	}
 
 	/**
@@ -2006,6 +2006,29 @@ class APPARATUSRUNTIME_API AMechanism
 		return SpawnSubject((const FSubjectRecord&)SubjectRecord);
 	}
 
+	/**
+	 * Spawn a batch of subjects cloned from a single prototype record.
+	 *
+	 * The target chunk is resolved only once and its capacity is
+	 * reserved for the whole batch. The prototype traits are then
+	 * block-copied into each of the chunk's trait lines, so no
+	 * per-subject record copying or trait look-up takes place.
+	 *
+	 * The per-instance trait values should be patched through the
+	 * returned handles after the call.
+	 *
+	 * @tparam Paradigm The paradigm to work under.
+	 * @param Prototype The subject record to clone the subjects from.
+	 * @param InCount The number of subjects to spawn.
+	 * @param OutSubjects The array to append the new subject handles to.
+	 * @return The status of the operation.
+	 */
+	template < EParadigm Paradigm = EParadigm::Default >
+	TOutcome<Paradigm>
+	SpawnSubjects(const FSubjectRecord&   Prototype,
+				  const int32             InCount,
+				  TArray<FSubjectHandle>& OutSubjects);
+
 	/**
 	 * Spawn a new subject within the mechanism based on a record.
 	 * Status version.
@@ -2340,6 +2363,59 @@ class APPARATUSRUNTIME_API AMechanism
 	TOutcome<Paradigm>
 	DespawnAllSubjects();
 
+#pragma region Snapshots
+	/// @name Snapshots
+	/// @{
+
+	/**
+	 * The current version of the mechanism snapshot format.
+	 */
+	static constexpr int32 SnapshotVersion = 1;
+
+	/**
+	 * Write the subjects of the mechanism into a binary snapshot.
+	 * 
+	 * The trait lines of each chunk are written as raw memory blocks
+	 * if their type is trivially destructible and has no object, string
+	 * or container properties. The other trait types fall back to the
+	 * reflection-based serialization. The places and generations of the
+	 * subjects are stored also, so the existing subject handles
+	 * (including the ones within the traits) stay valid after a restore.
+	 * 
+	 * Subjects with a subjective are not included, since
+	 * they are owned by their subjectives.
+	 * 
+	 * @note Must not be called during an iterating or operating.
+	 * 
+	 * @param OutData The snapshot data to fill.
+	 * @return The status of the operation.
+	 */
+	EApparatusStatus
+	TakeSnapshot(TArray<uint8>& OutData) const;
+
+	/**
+	 * Restore the subjects of the mechanism from a binary snapshot.
+	 * 
+	 * All of the current subjects without a subjective are despawned
+	 * and the snapshot chunks are bulk-loaded without any per-subject
+	 * spawning. The restored subjects keep their identifiers and
+	 * generations from the time of the snapshot.
+	 * 
+	 * The whole snapshot is read and validated before the current
+	 * subjects are despawned, so a truncated or corrupted snapshot
+	 * leaves the mechanism unchanged.
+	 * 
+	 * @note Must not be called during an iterating or operating.
+	 * 
+	 * @param InData The snapshot data to restore from.
+	 * @return The status of the operation.
+	 */
+	EApparatusStatus
+	RestoreSnapshot(const TArray<uint8>& InData);
+
+	/// @}
+#pragma endregion Snapshots
+
 	/**
 	 * Reset the mechanism completely,
 	 * unregistering all of the entities
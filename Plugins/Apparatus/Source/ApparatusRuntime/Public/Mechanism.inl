@@ -41,6 +41,103 @@ AMechanism::SpawnSubject(const FSubjectRecord& SubjectRecord)
 	return SubjectHandle;
 }
 
+template < EParadigm Paradigm/*=EParadigm::Default*/ >
+inline TOutcome<Paradigm>
+AMechanism::SpawnSubjects(const FSubjectRecord&   Prototype,
+						  const int32             InCount,
+						  TArray<FSubjectHandle>& OutSubjects)
+{
+	AssessCondition(Paradigm, InCount >= 0, EApparatusStatus::InvalidArgument);
+	if (UNLIKELY(InCount == 0))
+	{
+		return EApparatusStatus::Noop;
+	}
+
+	EFlagmark Flagmark = Prototype.GetFlagmark();
+	if (!IsInternal(Paradigm)) // Compile-time branch.
+	{
+		Flagmark &= FM_AllUserLevel;
+	}
+#if WITH_EDITOR
+	const auto World = GetWorld();
+	const bool bEditorSubjects = World && !World->IsGameWorld();
+#endif
+
+	// The chunk is resolved only once for the whole batch:
+	const auto Chunk = ObtainChunk<Paradigm>(Prototype.GetTraitmark());
+	AssessCondition(Paradigm, OK(Chunk), ToStatus(Chunk));
+	AssessConditionFormat(Paradigm, !Chunk->IsSolidLocked(), EApparatusStatus::InvalidState,
+						  TEXT("Can not spawn subjects within a solid-locked chunk. Is there a solid iterating happening?"));
+	AssessConditionFormat(Paradigm, !IsInConcurrentEnvironment(), EApparatusStatus::InvalidState,
+						  TEXT("Can not spawn subjects in a concurrent environment. Is there a concurrent operating currently happening?"));
+
+	const int32 FirstSlotIndex = Chunk->Slots.Num();
+	AssessConditionFormat(Paradigm, FirstSlotIndex <= FSubjectInfo::SlotsPerChunkMax - InCount, EApparatusStatus::OutOfLimit,
+						  TEXT("The maximum number of subjects per chunk would be exceeded: %i + %i"),
+						  (int)FirstSlotIndex, (int)InCount);
+
+	Chunk->Reserve(FirstSlotIndex + InCount);
+	OutSubjects.Reserve(OutSubjects.Num() + InCount);
+	HaltedSubjects.Reserve(HaltedSubjects.Num() + InCount);
+
+	// Clone the prototype traits into each of the lines.
+	// The record's traits are matched by their types, since
+	// the line order is defined by the chunk's traitmark:
+	check(Prototype.GetTraits().Num() == Chunk->TraitLinesNum());
+	for (const auto& TraitRecord : Prototype.GetTraits())
+	{
+		const int32 LineIndex = Chunk->TraitLineIndexOf(TraitRecord.GetType());
+		check(LineIndex > UChunk::InvalidTraitLineIndex);
+		verify(Chunk->Lines[LineIndex].AppendCopies(TraitRecord.GetData(), InCount) == FirstSlotIndex);
+	}
+
+	Chunk->Slots.AddDefaulted(InCount);
+	Chunk->Count = Chunk->Slots.Num();
+
+	for (int32 i = 0; i < InCount; ++i)
+	{
+		const int32 SlotIndex = FirstSlotIndex + i;
+		const auto Info = UMachine::template AllocateSubjectInfo<Paradigm>(this);
+		if (!OK(Info))
+		{
+			// Release the unused tail of the reservation:
+			Chunk->DoPop(InCount - i);
+			return ToStatus(Info);
+		}
+
+		Info->Chunk     = Chunk;
+		Info->SlotIndex = SlotIndex;
+		check(Info->IsValid());
+
+		const auto SubjectHandle = Info->GetHandle();
+		check(SubjectHandle.IsValid());
+		HaltedSubjects.Add(SubjectHandle);
+
+		auto& Slot = Chunk->Slots[SlotIndex];
+		check(Slot.IsStale());
+		Slot = Info;
+		check(!Slot.IsStale());
+		Slot.Fingerprint.AddToFlagmark(Flagmark);
+#if WITH_EDITOR
+		if (bEditorSubjects)
+		{
+			// Safely mark an Editor-based subject:
+			Slot.Fingerprint.AddToFlagmark(FM_Editor);
+		}
+#endif
+		Slot.Fingerprint.SetTraitmark(Prototype.GetTraitmark());
+
+		// The traits are already in place, so
+		// the adjectives see the actual values here:
+		Chunk->ApplyAdjectives(Info);
+
+		OutSubjects.Add(SubjectHandle);
+	}
+
+	APPARATUS_REPORT_SUCCESS(TEXT("Spawned a batch of %d subjects within chunk #%d."), InCount, Chunk->Id);
+	return EApparatusStatus::Success;
+}
+
 template < EParadigm Paradigm/*=EParadigm::Default*/ >
 OPTIONAL_FORCEINLINE TOutcome<Paradigm>
 AMechanism::DoSpawnSubjectDeferred(const FSubjectRecord& SubjectRecord)
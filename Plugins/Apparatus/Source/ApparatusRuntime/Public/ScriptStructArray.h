@@ -403,6 +403,35 @@ struct APPARATUSRUNTIME_API FScriptStructArray
 		return r;
 	}
 
+	/**
+	 * Append several new struct elements without initializing them.
+	 * 
+	 * The caller is responsible for filling the whole appended range
+	 * with valid data, e.g. by a raw memory copy of a trivially
+	 * destructible element type.
+	 * 
+	 * @param InCount The total number of elements to append.
+	 * @return A pointer to the data of the first added element. 
+	 */
+	OPTIONAL_FORCEINLINE void*
+	AppendUninitialized(const int32 InCount)
+	{
+		check(InCount >= 0);
+		if (UNLIKELY(InCount == 0)) return nullptr;
+		check(ElementType);
+		check(Count <= TNumericLimits<int32>::Max() - InCount); // Comparison with overflow protection.
+		const int32 NewCount = Count + InCount;
+		if (NewCount > Capacity)
+		{
+			// We need to increase the capacity...
+			const int32 NewCapacity = CalcSlackGrow(NewCount);
+			Reserve(NewCapacity);
+		}
+		void* r = MemoryAt(Count);
+		Count += InCount;
+		return r;
+	}
+
 	/**
 	 * Clear the array without changing the allocated space, but
 	 * only if the passed capacity is not larger than the present one.
@@ -856,6 +885,64 @@ struct APPARATUSRUNTIME_API FScriptStructArray
 		return Count++;
 	}
 
+	/**
+	 * Append a number of copies of a single struct data.
+	 *
+	 * Plain-old-data element types are block-copied
+	 * without any reflection calls. Other types are
+	 * initialized and copied via their script struct.
+	 *
+	 * @param InData An initialized struct data to clone.
+	 * Must be of the current element type.
+	 * @param InCount The number of copies to append.
+	 * @return The index of the first appended element.
+	 */
+	inline int32
+	AppendCopies(const void* const InData,
+				 const int32       InCount)
+	{
+		check(ElementType);
+		check(InData != nullptr);
+		check(InCount >= 0);
+		check(Count <= TNumericLimits<int32>::Max() - InCount); // Comparison with overflow protection.
+
+		const int32 FirstIndex = Count;
+		if (UNLIKELY(InCount == 0)) return FirstIndex;
+
+		const int32 NewCount = Count + InCount;
+		if (NewCount > Capacity)
+		{
+			const int32 NewCapacity = CalcSlackGrow(NewCount);
+			Reserve(NewCapacity);
+		}
+
+		const SIZE_T Stride = (SIZE_T)GetSafeStructureSize();
+		uint8* const First = (uint8*)MemoryAt(FirstIndex);
+		if (ElementType->StructFlags & STRUCT_IsPlainOldData)
+		{
+			// Fill the first element and then double the
+			// copied range until the whole block is filled:
+			FMemory::Memcpy(First, InData, ElementType->GetStructureSize());
+			int32 Filled = 1;
+			while (Filled < InCount)
+			{
+				const int32 Chunk = FMath::Min(Filled, InCount - Filled);
+				FMemory::Memcpy(First + Stride * Filled, First, Stride * Chunk);
+				Filled += Chunk;
+			}
+		}
+		else
+		{
+			ElementType->InitializeStruct(First, InCount);
+			for (int32 i = 0; i < InCount; ++i)
+			{
+				ElementType->CopyScriptStruct(First + Stride * i, InData);
+			}
+		}
+		Count = NewCount;
+		return FirstIndex;
+	}
+
 	/**
 	 * Move an array.
 	 */
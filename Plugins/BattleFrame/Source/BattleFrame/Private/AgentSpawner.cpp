@@ -16,6 +16,7 @@
 #include "Traits/GridData.h"
 #include "Traits/Team.h"
 #include "Traits/Activated.h"
+#include "Traits/Pooled.h"
 #include "AnimToTextureDataAsset.h"
 #include "NiagaraSubjectRenderer.h"
 #include "BattleFrameBattleControl.h"
@@ -171,18 +172,53 @@ TArray<FSubjectHandle> AAgentSpawner::SpawnAgentsByConfigRectangular
     auto& MoveTrait = AgentRecord.GetTraitRef<FMove>();
     MoveTrait.XY.MoveSpeed *= Multipliers.MoveSpeedMult;
 
-    while (SpawnedAgents.Num() < Quantity)// the following traits varies from agent to agent
+    if (Quantity <= 0)
     {
-        FSubjectRecord Config = AgentRecord;
+        return SpawnedAgents;
+    }
 
-        auto& Located = Config.GetTraitRef<FLocated>();
-        auto& Directed = Config.GetTraitRef<FDirected>();
-        auto& Scaled = Config.GetTraitRef<FScaled>();
-        auto& Collider = Config.GetTraitRef<FCollider>();
-        auto& Move = Config.GetTraitRef<FMove>();
-        auto& Fall = Config.GetTraitRef<FFall>();
-        auto& Moving = Config.GetTraitRef<FMoving>();
-        auto& Patrol = Config.GetTraitRef<FPatrol>();
+    if (AgentConfig->bEnablePooling)
+    {
+        FPooled Pooled;
+        Pooled.PoolKey = AgentConfig;
+        Pooled.Capacity = AgentConfig->PoolCapacity;
+        AgentRecord.SetTrait(Pooled);
+
+        // Wake dormant agents of the same config first, they are reset to the prototype
+        BattleControl->ReuseDormantSubjects(AgentConfig, AgentRecord, Quantity, SpawnedAgents);
+    }
+
+    // Clone the prototype into a single chunk in one go, then patch only the per-instance traits
+    const int32 SpawnCount = Quantity - SpawnedAgents.Num();
+
+    if (SpawnCount > 0 && !OK(Mechanism->SpawnSubjects<EParadigm::SafePolite>(AgentRecord, SpawnCount, SpawnedAgents)))
+    {
+        // 批量生成失败（如区块已满）时，剩余部分逐个生成；已生成的句柄仍然有效
+        UE_LOG(LogTemp, Warning, TEXT("Bulk spawn failed, spawning the remaining agents one by one | 批量生成失败，逐个生成剩余单位"));
+
+        while (SpawnedAgents.Num() < Quantity)
+        {
+            const auto Agent = Mechanism->SpawnSubject(AgentRecord);
+
+            if (!Agent.IsValid()) break;
+
+            SpawnedAgents.Add(Agent);
+        }
+    }
+
+    const auto& Fall = AgentRecord.GetTraitRef<FFall>();
+    const float GroundOffset = AgentRecord.GetTraitRef<FCollider>().Radius * AgentRecord.GetTraitRef<FScaled>().Scale;
+
+    APawn* PlayerPawn = InitialDirection == EInitialDirection::FacePlayer ? UGameplayStatics::GetPlayerPawn(GetWorld(), 0) : nullptr;
+    const FVector ForwardDirection = GetActorForwardVector().GetSafeNormal2D();
+    const FVector CustomDirection3D = FVector(CustomDirection, 0).GetSafeNormal2D();
+
+    for (const FSubjectHandle& Agent : SpawnedAgents)// the following traits varies from agent to agent
+    {
+        auto& Located = Agent.GetTraitRef<FLocated, EParadigm::Unsafe>();
+        auto& Directed = Agent.GetTraitRef<FDirected, EParadigm::Unsafe>();
+        auto& Moving = Agent.GetTraitRef<FMoving, EParadigm::Unsafe>();
+        auto& Patrol = Agent.GetTraitRef<FPatrol, EParadigm::Unsafe>();
 
         float RandomX = FMath::RandRange(-Region.X / 2, Region.X / 2);
         float RandomY = FMath::RandRange(-Region.Y / 2, Region.Y / 2);
@@ -196,7 +232,7 @@ TArray<FSubjectHandle> AAgentSpawner::SpawnAgentsByConfigRectangular
         }
         else
         {
-            SpawnPoint3D = FVector(SpawnPoint3D.X, SpawnPoint3D.Y, SpawnPoint3D.Z + Collider.Radius * Scaled.Scale);
+            SpawnPoint3D = FVector(SpawnPoint3D.X, SpawnPoint3D.Y, SpawnPoint3D.Z + GroundOffset);
         }
 
         Patrol.Origin = SpawnPoint3D;
@@ -210,8 +246,6 @@ TArray<FSubjectHandle> AAgentSpawner::SpawnAgentsByConfigRectangular
         {
             case EInitialDirection::FacePlayer:
             {
-                APawn* PlayerPawn = UGameplayStatics::GetPlayerPawn(GetWorld(), 0);
-
                 if (IsValid(PlayerPawn))
                 {
                     FVector Delta = PlayerPawn->GetActorLocation() - SpawnPoint3D;
@@ -219,20 +253,20 @@ TArray<FSubjectHandle> AAgentSpawner::SpawnAgentsByConfigRectangular
                 }
                 else
                 {
-                    Directed.Direction = GetActorForwardVector().GetSafeNormal2D();
+                    Directed.Direction = ForwardDirection;
                 }
                 break;
             }
 
             case EInitialDirection::FaceForward:
             {
-                Directed.Direction = GetActorForwardVector().GetSafeNormal2D();
+                Directed.Direction = ForwardDirection;
                 break;
             }
 
             case EInitialDirection::CustomDirection:
             {
-                Directed.Direction = FVector(CustomDirection, 0).GetSafeNormal2D();
+                Directed.Direction = CustomDirection3D;
                 break;
             }
         }
@@ -242,13 +276,14 @@ TArray<FSubjectHandle> AAgentSpawner::SpawnAgentsByConfigRectangular
             Moving.LaunchVelSum = Directed.Direction * LaunchVelocity.X + Directed.Direction.UpVector * LaunchVelocity.Y;
             Moving.bLaunching = true;
         }
+    }
 
-        // Spawn using the modified record
-        const auto Agent = Mechanism->SpawnSubject(Config);
-
-        if (bAutoActivation) ActivateAgent(Agent);
-
-        SpawnedAgents.Add(Agent);
+    if (bAutoActivation)
+    {
+        for (const FSubjectHandle& Agent : SpawnedAgents)
+        {
+            ActivateAgent(Agent);
+        }
     }
 
     return SpawnedAgents;
@@ -385,7 +420,7 @@ void AAgentSpawner::KillAllAgents()
         if (Mechanism)
         {
             FFilter Filter = FFilter::Make<FAgent>();
-            Filter.Exclude<FDying>();
+            Filter.Exclude<FDying, FDormant>();
 
             Mechanism->Operate<FUnsafeChain>(Filter,
                 [&](FUnsafeSubjectHandle Subject,
@@ -407,7 +442,7 @@ void AAgentSpawner::KillAgentsBySubtype(int32 Index)
 
         if (Mechanism)
         {
-            FFilter Filter = FFilter::Make<FAgent>().Exclude<FDying>();
+            FFilter Filter = FFilter::Make<FAgent>().Exclude<FDying, FDormant>();
             UBattleFrameFunctionLibraryRT::IncludeSubTypeTraitByIndex(Index, Filter);
 
             Mechanism->Operate<FUnsafeChain>(Filter,
@@ -25,19 +25,120 @@
 
 #include "BattleFrameInterface.h"
 
+#include "Tickable.h"
 
 
-ABattleFrameBattleControl* ABattleFrameBattleControl::Instance = nullptr;
+namespace
+{
+	// 每个世界一个战斗控制器 | One battle controller per world
+	FRWLock InstancesLock;
+	TMap<TObjectKey<UWorld>, ABattleFrameBattleControl*> Instances;
+
+	// 统一模拟所有开启该模式的世界 | Simulates every world that opted in from one ticker
+	class FBattleFrameWorldsTicker : public FTickableGameObject
+	{
+	public:
+
+		virtual void Tick(float DeltaTime) override
+		{
+			TRACE_CPUPROFILER_EVENT_SCOPE_STR("BattleFrameWorldsTick");
+
+			TArray<ABattleFrameBattleControl*> PendingControls;
+
+			{
+				FReadScopeLock ReadLock(InstancesLock);
+
+				for (const auto& Pair : Instances)
+				{
+					if (Pair.Value->bSimulationPending)
+					{
+						PendingControls.Add(Pair.Value);
+					}
+				}
+			}
+
+			// 模拟会通过延迟操作创建Chunk并做场景检测，不能放到工作线程，逐个世界在游戏线程执行 | The simulation creates chunks through deferreds and traces the world, so the worlds are ticked one by one on the game thread
+			for (ABattleFrameBattleControl* BattleControl : PendingControls)
+			{
+				BattleControl->TickSimulation(BattleControl->PendingDeltaTime, BattleControl->PendingSafeDeltaTime);
+				BattleControl->TickPresentation(BattleControl->PendingSafeDeltaTime);
+				BattleControl->bSimulationPending = false;
+			}
+		}
+
+		virtual ETickableTickType GetTickableTickType() const override
+		{
+			return ETickableTickType::Always;
+		}
+
+		virtual TStatId GetStatId() const override
+		{
+			RETURN_QUICK_DECLARE_CYCLE_STAT(FBattleFrameWorldsTicker, STATGROUP_Tickables);
+		}
+	};
+
+	TUniquePtr<FBattleFrameWorldsTicker> WorldsTicker;
+}
 
 void ABattleFrameBattleControl::BeginPlay()
 {
 	Super::BeginPlay();
 
-	Instance = this;
+	{
+		FWriteScopeLock WriteLock(InstancesLock);
+		Instances.Add(TObjectKey<UWorld>(GetWorld()), this);
+	}
+
+	if (bTickWorldsFromSharedTicker && !WorldsTicker.IsValid())
+	{
+		WorldsTicker = MakeUnique<FBattleFrameWorldsTicker>();
+	}
 
 	DefineFilters();
 }
 
+void ABattleFrameBattleControl::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	{
+		FWriteScopeLock WriteLock(InstancesLock);
+
+		const TObjectKey<UWorld> WorldKey(GetWorld());
+
+		if (Instances.FindRef(WorldKey) == this)
+		{
+			Instances.Remove(WorldKey);
+		}
+
+		if (Instances.IsEmpty())
+		{
+			WorldsTicker.Reset();
+		}
+	}
+
+	bSimulationPending = false;
+
+	DormantSubjects.Empty();
+	ParkQueue.Empty();
+	PooledSpawnQueue.Empty();
+	DmgRequestQueue.Empty();
+
+	SlowTimers.Reset();
+	TemporalDamageTimers.Reset();
+	FiredTimers.Empty();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+ABattleFrameBattleControl* ABattleFrameBattleControl::GetInstance(const UObject* WorldContextObject)
+{
+	const UWorld* World = GEngine ? GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::ReturnNull) : nullptr;
+
+	if (!World) return nullptr;
+
+	FReadScopeLock ReadLock(InstancesLock);
+	return Instances.FindRef(TObjectKey<UWorld>(World));
+}
+
 void ABattleFrameBattleControl::Tick(float DeltaTime)
 {
 	TRACE_CPUPROFILER_EVENT_SCOPE_STR("BattleControlTick");
@@ -67,6 +168,22 @@ void ABattleFrameBattleControl::Tick(float DeltaTime)
 
 	float SafeDeltaTime = FMath::Clamp(DeltaTime, 0, 0.0333f);
 
+	// 开启后由世界调度器统一模拟 | When enabled the worlds ticker simulates all opted-in worlds together
+	if (bTickWorldsFromSharedTicker && WorldsTicker.IsValid())
+	{
+		PendingDeltaTime = DeltaTime;
+		PendingSafeDeltaTime = SafeDeltaTime;
+		bSimulationPending = true;
+		return;
+	}
+
+	TickSimulation(DeltaTime, SafeDeltaTime);
+	TickPresentation(SafeDeltaTime);
+}
+
+void ABattleFrameBattleControl::TickSimulation(float DeltaTime, float SafeDeltaTime)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE_STR("BattleControlSimulation");
 
 	//------------------数据统计 | Statistics-------------------
 
@@ -435,6 +552,89 @@ void ABattleFrameBattleControl::Tick(float DeltaTime)
 	}
 	#pragma endregion
 
+	// 地面采样 | Ground Sample
+	#pragma region
+	{
+		TRACE_CPUPROFILER_EVENT_SCOPE_STR("AgentGroundSample");
+
+		// 同一流场和坡度阈值的个体合为一组，每组批量采样 | Agents sharing a flow field and slope threshold are sampled as one batch
+		struct FGroundSampleGroup
+		{
+			AFlowField* FlowField = nullptr;
+			float AngleThreshold = 0;
+			TArray<FVector> Locations;
+			TArray<FSolidSubjectHandle> Subjects;
+			TArray<FFlowFieldSample> Samples;
+		};
+
+		TArray<FGroundSampleGroup> Groups;
+
+		auto Chain = Mechanism->EnchainSolid(AgentMoveFilter);
+		Chain->Retain();
+
+		Chain->Operate([&](FSolidSubjectHandle Subject, FLocated& Located, FFall& Fall, FNavigation& Navigation, FNavigating& Navigating)
+			{
+				Navigating.bIsGroundSampled = false;
+
+				if (Navigation.bReloadFlowField)
+				{
+					Navigating.FlowField = Navigation.FlowFieldToUse.LoadSynchronous();
+					Navigation.bReloadFlowField = false;
+				}
+
+				if (Fall.GroundTraceMode == EGroundTraceMode::SphereTrace || !IsValid(Navigating.FlowField)) return;
+
+				// 相邻个体通常属于同一组
+				FGroundSampleGroup* Group = Groups.FindByPredicate([&](const FGroundSampleGroup& Other)
+					{
+						return Other.FlowField == Navigating.FlowField && Other.AngleThreshold == Fall.SphereTraceAngleThreshold;
+					});
+
+				if (!Group)
+				{
+					Group = &Groups.AddDefaulted_GetRef();
+					Group->FlowField = Navigating.FlowField;
+					Group->AngleThreshold = Fall.SphereTraceAngleThreshold;
+				}
+
+				Group->Locations.Add(Located.Location);
+				Group->Subjects.Add(Subject);
+			});
+
+		// 分片并行采样并写回 | Sample in parallel slices and write the results back
+		constexpr int32 SliceSize = 1024;
+		TArray<FIntVector> Slices;// group, begin, num
+
+		for (int32 GroupIndex = 0; GroupIndex < Groups.Num(); ++GroupIndex)
+		{
+			FGroundSampleGroup& Group = Groups[GroupIndex];
+			Group.Samples.SetNum(Group.Locations.Num());
+
+			for (int32 Begin = 0; Begin < Group.Locations.Num(); Begin += SliceSize)
+			{
+				Slices.Emplace(GroupIndex, Begin, FMath::Min(SliceSize, Group.Locations.Num() - Begin));
+			}
+		}
+
+		ParallelFor(Slices.Num(), [&](int32 Index)
+			{
+				const FIntVector Slice = Slices[Index];
+				FGroundSampleGroup& Group = Groups[Slice.X];
+
+				Group.FlowField->SampleBatch(TConstArrayView<FVector>(Group.Locations).Slice(Slice.Y, Slice.Z), Group.AngleThreshold, TArrayView<FFlowFieldSample>(Group.Samples).Slice(Slice.Y, Slice.Z));
+
+				for (int32 i = Slice.Y; i < Slice.Y + Slice.Z; ++i)
+				{
+					FNavigating& Navigating = Group.Subjects[i].GetTraitRef<FNavigating>();
+					Navigating.SampledGround = Group.Samples[i].GroundLocation;
+					Navigating.bIsGroundSampled = Group.Samples[i].bIsValid;
+				}
+			});
+
+		Chain->Release();
+	}
+	#pragma endregion
+
 	// 移动 | Move
 	#pragma region
 	{
@@ -467,7 +667,7 @@ void ABattleFrameBattleControl::Tick(float DeltaTime)
 				// 死亡区域检测			
 				if (Located.Location.Z < Fall.KillZ)
 				{
-					Subject.DespawnDeferred();
+					DespawnOrPark(Subject);
 
 					// Death Event KillZ
 					if (Subject.HasTrait<FIsSubjective>())
@@ -501,9 +701,9 @@ void ABattleFrameBattleControl::Tick(float DeltaTime)
 				const FVector SelfLocation = Located.Location;
 				const float SelfRadius = Collider.Radius * Scaled.Scale;
 
-				// 必须获取因为之后要用到地面高度
-				bool bInside_BaseFF;
-				FCellStruct& Cell_BaseFF = Navigating.FlowField->GetCellAtLocation(SelfLocation, bInside_BaseFF);
+				// 方向从紧凑镜像读取 | The direction comes from the packed mirror
+				int32 Index_BaseFF = 0;
+				const bool bInside_BaseFF = Navigating.FlowField->HasPackedField() && Navigating.FlowField->WorldToIndex(SelfLocation, Index_BaseFF);
 
 				const bool bIsValidTraceResult = Tracing.TraceResult.IsValid();
 
@@ -610,12 +810,12 @@ void ABattleFrameBattleControl::Tick(float DeltaTime)
 
 								if (IsValid(BindFlowField.FlowField)) // 从目标获取指向目标的流场
 								{
-									bool bInside_TargetFF;
-									FCellStruct& Cell_TargetFF = BindFlowField.FlowField->GetCellAtLocation(SelfLocation, bInside_TargetFF);
+									int32 Index_TargetFF = 0;
+									const bool bInside_TargetFF = BindFlowField.FlowField->HasPackedField() && BindFlowField.FlowField->WorldToIndex(SelfLocation, Index_TargetFF);
 
 									if (bInside_TargetFF)
 									{
-										DesiredMoveDirection = Cell_TargetFF.dir.GetSafeNormal2D();
+										DesiredMoveDirection = BindFlowField.FlowField->GetPackedDirection(Index_TargetFF);
 										Navigating.PreviousNavMode = ENavMode::FlowField;
 									}
 									else
@@ -635,12 +835,23 @@ void ABattleFrameBattleControl::Tick(float DeltaTime)
 						}
 						else
 						{
-							if (bInside_BaseFF)
+							bool bInside_LayerFF = false;
+							FVector2D LayerGoalCoord;
+							const FVector LayerDirection = Navigation.GoalLayer.IsValid() ? Navigating.FlowField->GetLayerDirection(Navigation.GoalLayer, SelfLocation, LayerGoalCoord, bInside_LayerFF) : FVector::ZeroVector;
+
+							if (bInside_LayerFF) // 使用目标层 | follow the goal layer
+							{
+								bool bIsValidGoal = true;
+								Moving.Goal = Navigating.FlowField->GetCellAtCoord(LayerGoalCoord, bIsValidGoal).worldLoc;
+								DesiredMoveDirection = LayerDirection.GetSafeNormal2D();
+								Navigating.PreviousNavMode = ENavMode::FlowField;
+							}
+							else if (bInside_BaseFF)
 							{
 								bool bIsValidGoal = true;
 
 								//FVector WorldLoc;
-								Moving.Goal = Navigating.FlowField->GetCellAtCoord(Cell_BaseFF.goalCoord, bIsValidGoal).worldLoc;
+								Moving.Goal = Navigating.FlowField->GetCellAtCoord(Navigating.FlowField->CurrentCellsArray[Index_BaseFF].goalCoord, bIsValidGoal).worldLoc;
 
 								/*if (Subject.HasTrait(FUniqueID::StaticStruct()))
 								{
@@ -658,7 +869,7 @@ void ABattleFrameBattleControl::Tick(float DeltaTime)
 									}
 								}*/
 								
-								DesiredMoveDirection = Cell_BaseFF.dir.GetSafeNormal2D();
+								DesiredMoveDirection = Navigating.FlowField->GetPackedDirection(Index_BaseFF);
 								Navigating.PreviousNavMode = ENavMode::FlowField;
 							}
 							else
@@ -1024,15 +1235,15 @@ void ABattleFrameBattleControl::Tick(float DeltaTime)
 					if (LIKELY(!Moving.bFalling && !Moving.bLaunching && !Moving.bPushedBack))
 					{
 						const bool bIsAccelerating = AvoidingVelocity.SizeSquared2D() > CurrentVelocity.SizeSquared2D();
-						InterpedVelocity = FMath::VInterpConstantTo(CurrentVelocity, AvoidingVelocity, DeltaTime, bIsAccelerating ? Move.XY.MoveAcceleration : Move.XY.MoveDeceleration);
+						InterpedVelocity = FMath::VInterpConstantTo(CurrentVelocity, AvoidingVelocity, SafeDeltaTime, bIsAccelerating ? Move.XY.MoveAcceleration : Move.XY.MoveDeceleration);
 					}
 					else if (Moving.bFalling)
 					{
-						InterpedVelocity = FMath::VInterpConstantTo(CurrentVelocity, AvoidingVelocity, DeltaTime, 100);
+						InterpedVelocity = FMath::VInterpConstantTo(CurrentVelocity, AvoidingVelocity, SafeDeltaTime, 100);
 					}
 					else if (Moving.bLaunching || Moving.bPushedBack)
 					{
-						InterpedVelocity = FMath::VInterpConstantTo(CurrentVelocity, AvoidingVelocity, DeltaTime, Move.XY.MoveDeceleration);
+						InterpedVelocity = FMath::VInterpConstantTo(CurrentVelocity, AvoidingVelocity, SafeDeltaTime, Move.XY.MoveDeceleration);
 					}
 
 					Moving.CurrentVelocity = FVector(InterpedVelocity.X, InterpedVelocity.Y, Moving.CurrentVelocity.Z);
@@ -1192,13 +1403,15 @@ void ABattleFrameBattleControl::Tick(float DeltaTime)
 				{
 					case EGroundTraceMode::FlowFieldAndSphereTrace:
 						// 模式1：优先使用流场，失败时回退到球体追踪
-						bIsSet = GetInterpedWorldLocation(Navigating.FlowField, SelfLocation, Fall.SphereTraceAngleThreshold, GroundLocation);
+						bIsSet = Navigating.bIsGroundSampled;
+						GroundLocation = Navigating.SampledGround;
 						if (!bIsSet) bIsSet = PerformSphereTrace(GroundLocation);
 						break;
 
 					case EGroundTraceMode::FlowField:
 						// 模式2：仅使用流场采样
-						bIsSet = GetInterpedWorldLocation(Navigating.FlowField, SelfLocation, Fall.SphereTraceAngleThreshold, GroundLocation);
+						bIsSet = Navigating.bIsGroundSampled;
+						GroundLocation = Navigating.SampledGround;
 						break;
 
 					case EGroundTraceMode::SphereTrace:
@@ -1419,12 +1632,12 @@ void ABattleFrameBattleControl::Tick(float DeltaTime)
 						}
 
 						// 计算新角速度
-						float NewAngularVelocity = Moving.CurrentAngularVelocity + Acceleration * DeltaTime;
+						float NewAngularVelocity = Moving.CurrentAngularVelocity + Acceleration * SafeDeltaTime;
 						NewAngularVelocity = FMath::Clamp(NewAngularVelocity, -Move.Yaw.TurnSpeed, Move.Yaw.TurnSpeed);
 
 						// 使用平均速度计算实际转动角度
 						const float AvgAngularVelocity = 0.5f * (Moving.CurrentAngularVelocity + NewAngularVelocity);
-						float AppliedDeltaYaw = AvgAngularVelocity * DeltaTime;
+						float AppliedDeltaYaw = AvgAngularVelocity * SafeDeltaTime;
 
 						// 防止角度过冲
 						if (FMath::Abs(AppliedDeltaYaw) > FMath::Abs(DeltaYaw))
@@ -1879,7 +2092,7 @@ void ABattleFrameBattleControl::Tick(float DeltaTime)
 								CapsuleConfig.Duration = DebugConfig.Duration;
 
 								// 加入调试队列
-								ABattleFrameBattleControl::GetInstance()->DebugCapsuleQueue.Enqueue(CapsuleConfig);
+								DebugCapsuleQueue.Enqueue(CapsuleConfig);
 
 								// 绘制碰撞点
 								FDebugPointConfig PointConfig;
@@ -1888,7 +2101,7 @@ void ABattleFrameBattleControl::Tick(float DeltaTime)
 								PointConfig.Location = VisibilityResult.bBlockingHit ? VisibilityResult.ImpactPoint : VisibilityResult.TraceEnd;
 								PointConfig.Size = DebugConfig.HitPointSize;
 
-								ABattleFrameBattleControl::GetInstance()->DebugPointQueue.Enqueue(PointConfig);
+								DebugPointQueue.Enqueue(PointConfig);
 							}
 						}
 
@@ -2406,7 +2619,7 @@ void ABattleFrameBattleControl::Tick(float DeltaTime)
 					// Suicide
 					if (Attack.TimeOfHitAction == EAttackMode::SuicideATK || Attack.TimeOfHitAction == EAttackMode::Despawn)
 					{
-						Subject.DespawnDeferred();
+						DespawnOrPark(Subject);
 
 						if (Subject.HasTrait<FIsSubjective>())
 						{
@@ -2736,6 +2949,7 @@ void ABattleFrameBattleControl::Tick(float DeltaTime)
 	{
 		TRACE_CPUPROFILER_EVENT_SCOPE_STR("AgentSlowed");
 
+		// 新生成的减速马甲登记到agent和时间轮 | Register newly spawned slows to the agent and the timing wheel
 		auto Chain = Mechanism->EnchainSolid(SlowFilter);
 		UBattleFrameFunctionLibraryRT::CalculateThreadsCountAndBatchSize(Chain->IterableNum(), MaxThreadsAllowed, MinBatchSizeAllowed, ThreadsCount, BatchSize);
 
@@ -2785,78 +2999,91 @@ void ABattleFrameBattleControl::Tick(float DeltaTime)
 					Slow.bJustSpawned = false;
 				}
 
-				// 持续时间结束，解除减速
-				if (Slow.SlowTimeout <= 0)
+				// 持续时间交给时间轮，到期前不再遍历
+				SlowTimers.Schedule(FSubjectHandle(Subject), Slow.SlowTimeout);
+				Subject.SetTraitDeferred(FTimed());
+
+			}, ThreadsCount, BatchSize);
+
+		// 只处理到期的减速马甲 | Only the slows whose timers fired are visited
+		FiredTimers.Reset();
+		SlowTimers.Advance(SafeDeltaTime, FiredTimers);
+
+		ParallelFor(FiredTimers.Num(), [&](int32 Index)
+		{
+			FSolidSubjectHandle Subject = FiredTimers[Index];
+
+			if (!Subject.IsValid() || !Subject.HasTrait<FSlow>()) return;
+
+			const FSlow& Slow = Subject.GetTraitRef<FSlow, EParadigm::Unsafe>();
+
+			// 持续时间结束，解除减速
+			if (Slow.SlowTarget.IsValid())
+			{
+				auto& TargetSlowing = Slow.SlowTarget.GetTraitRef<FSlowing, EParadigm::Unsafe>();
+
+				TargetSlowing.Lock();
+				TargetSlowing.Slows.Remove(FSubjectHandle(Subject));
+				TargetSlowing.Unlock();
+
+				const bool bHasAnimating = Slow.SlowTarget.HasTrait<FAnimating>();
+
+				// 重置材质特效
+				if (bHasAnimating)
 				{
-					auto& TargetSlowing = Slow.SlowTarget.GetTraitRef<FSlowing, EParadigm::Unsafe>();
+					bool bHasSameDmgType = false;
 
+					// 是否还存在同伤害类型的减速马甲
 					TargetSlowing.Lock();
-					TargetSlowing.Slows.Remove(FSubjectHandle(Subject));
+					for (const auto& OtherSlow : TargetSlowing.Slows)
+					{
+						if (OtherSlow.GetTrait<FSlow>().DmgType == Slow.DmgType)
+						{
+							bHasSameDmgType = true;
+							break;
+						}
+					}
 					TargetSlowing.Unlock();
 
-					const bool bHasAnimating = Slow.SlowTarget.HasTrait<FAnimating>();
+					// 是否还存在同伤害类型的延时伤害马甲
+					auto& TargetTemporalDamaging = Slow.SlowTarget.GetTraitRef<FTemporalDamaging, EParadigm::Unsafe>();
 
-					// 重置材质特效
-					if (bHasAnimating)
+					TargetTemporalDamaging.Lock();
+					for (const auto& OtherTemporalDamage : TargetTemporalDamaging.TemporalDamages)
 					{
-						bool bHasSameDmgType = false;
-
-						// 是否还存在同伤害类型的减速马甲
-						TargetSlowing.Lock();
-						for (const auto& OtherSlow : TargetSlowing.Slows)
+						if (OtherTemporalDamage.GetTrait<FTemporalDamage>().DmgType == Slow.DmgType)
 						{
-							if (OtherSlow.GetTrait<FSlow>().DmgType == Slow.DmgType)
-							{
-								bHasSameDmgType = true;
-								break;
-							}
+							bHasSameDmgType = true;
+							break;
 						}
-						TargetSlowing.Unlock();
+					}
+					TargetTemporalDamaging.Unlock();
 
-						// 是否还存在同伤害类型的延时伤害马甲
-						auto& TargetTemporalDamaging = Slow.SlowTarget.GetTraitRef<FTemporalDamaging, EParadigm::Unsafe>();
+					// 如果没有同伤害类型的马甲，可以重置材质特效了
+					if (!bHasSameDmgType)
+					{
+						auto& TargetAnimating = Slow.SlowTarget.GetTraitRef<FAnimating, EParadigm::Unsafe>();
 
-						TargetTemporalDamaging.Lock();
-						for (const auto& OtherTemporalDamage : TargetTemporalDamaging.TemporalDamages)
+						TargetAnimating.Lock();
+						switch (Slow.DmgType)
 						{
-							if (OtherTemporalDamage.GetTrait<FTemporalDamage>().DmgType == Slow.DmgType)
-							{
-								bHasSameDmgType = true;
+							case EDmgType::Fire:
+								TargetAnimating.FireFx = 0;
+								break;
+							case EDmgType::Ice:
+								TargetAnimating.IceFx = 0;
+								break;
+							case EDmgType::Poison:
+								TargetAnimating.PoisonFx = 0;
 								break;
-							}
-						}
-						TargetTemporalDamaging.Unlock();
-
-						// 如果没有同伤害类型的马甲，可以重置材质特效了
-						if (!bHasSameDmgType)
-						{
-							auto& TargetAnimating = Slow.SlowTarget.GetTraitRef<FAnimating, EParadigm::Unsafe>();
-
-							TargetAnimating.Lock();
-							switch (Slow.DmgType)
-							{
-								case EDmgType::Fire:
-									TargetAnimating.FireFx = 0;
-									break;
-								case EDmgType::Ice:
-									TargetAnimating.IceFx = 0;
-									break;
-								case EDmgType::Poison:
-									TargetAnimating.PoisonFx = 0;
-									break;
-							}
-							TargetAnimating.Unlock();
 						}
+						TargetAnimating.Unlock();
 					}
-
-					Subject.DespawnDeferred();
-					return;
 				}
+			}
 
-				// 更新计时器
-				Slow.SlowTimeout -= SafeDeltaTime;
-
-			}, ThreadsCount, BatchSize);
+			Subject.DespawnDeferred();
+		});
 	}
 	#pragma endregion
 
@@ -2865,6 +3092,7 @@ void ABattleFrameBattleControl::Tick(float DeltaTime)
 	{
 		TRACE_CPUPROFILER_EVENT_SCOPE_STR("AgentTemporalDamaging");
 
+		// 新生成的延时伤害马甲登记到agent和时间轮 | Register newly spawned temporal damages to the agent and the timing wheel
 		auto Chain = Mechanism->EnchainSolid(TemporalDamageFilter);
 		UBattleFrameFunctionLibraryRT::CalculateThreadsCountAndBatchSize(Chain->IterableNum(), MaxThreadsAllowed, MinBatchSizeAllowed, ThreadsCount, BatchSize);
 
@@ -2913,158 +3141,176 @@ void ABattleFrameBattleControl::Tick(float DeltaTime)
 					TemporalDamage.bJustSpawned = false;
 				}
 
-				// 持续伤害结束时终止
-				if (TemporalDamage.RemainingTemporalDamage <= 0 || TemporalDamage.CurrentSegment >= TemporalDamage.TemporalDmgSegment)
-				{
-					auto& TargetTemporalDamaging = TemporalDamage.TemporalDamageTarget.GetTraitRef<FTemporalDamaging, EParadigm::Unsafe>();
+				// 下一段伤害的倒计时交给时间轮
+				TemporalDamageTimers.Schedule(FSubjectHandle(Subject), TemporalDamage.TemporalDamageTimeout);
+				Subject.SetTraitDeferred(FTimed());
 
-					// 从马甲列表移除
-					TargetTemporalDamaging.Lock();
-					TargetTemporalDamaging.TemporalDamages.Remove(FSubjectHandle(Subject));
-					TargetTemporalDamaging.Unlock();
+			}, ThreadsCount, BatchSize);
 
-					const bool bHasAnimating = TemporalDamage.TemporalDamageTarget.HasTrait<FAnimating>();
+		// 只处理到期的延时伤害马甲 | Only the temporal damages whose timers fired are visited
+		FiredTimers.Reset();
+		TemporalDamageTimers.Advance(SafeDeltaTime, FiredTimers);
 
-					// 重置材质特效
-					if (bHasAnimating)
-					{
-						bool bHasSameDmgType = false;
+		ParallelFor(FiredTimers.Num(), [&](int32 Index)
+		{
+			FSolidSubjectHandle Subject = FiredTimers[Index];
 
-						// 是否还存在同伤害类型的延时伤害马甲
-						TargetTemporalDamaging.Lock();
-						for (const auto& OtherTemporalDamage : TargetTemporalDamaging.TemporalDamages)
-						{
-							if (OtherTemporalDamage.GetTrait<FTemporalDamage>().DmgType == TemporalDamage.DmgType)
-							{
-								bHasSameDmgType = true;
-								break;
-							}
-						}
-						TargetTemporalDamaging.Unlock();
+			if (!Subject.IsValid() || !Subject.HasTrait<FTemporalDamage>()) return;
+
+			auto& TemporalDamage = Subject.GetTraitRef<FTemporalDamage, EParadigm::Unsafe>();
+
+			// 伤害对象不存在时终止
+			if (!TemporalDamage.TemporalDamageTarget.IsValid())
+			{
+				Subject.DespawnDeferred();
+				return;
+			}
+
+			// 倒计时结束，造成一次伤害
+			if (TemporalDamage.RemainingTemporalDamage > 0 && TemporalDamage.CurrentSegment < TemporalDamage.TemporalDmgSegment)
+			{
+				// 计算本次伤害值
+				float ThisSegmentDamage = 0.0f;
+
+				// 扣除目标生命值
+				if (TemporalDamage.TemporalDamageTarget.HasTrait<FHealth>())
+				{
+					auto& TargetHealth = TemporalDamage.TemporalDamageTarget.GetTraitRef<FHealth, EParadigm::Unsafe>();
 
-						// 是否还存在同伤害类型的减速马甲
-						auto& TargetSlowing = TemporalDamage.TemporalDamageTarget.GetTraitRef<FSlowing, EParadigm::Unsafe>();
+					if (TargetHealth.Current > 0)
+					{
+						// 计算本次伤害值
+						float DamagePerSegment = TemporalDamage.TotalTemporalDamage / TemporalDamage.TemporalDmgSegment;
 
-						TargetSlowing.Lock();
-						for (const auto& OtherSlow : TargetSlowing.Slows)
+						// 确保最后一段使用剩余伤害值
+						if (TemporalDamage.CurrentSegment == TemporalDamage.TemporalDmgSegment - 1)
 						{
-							if (OtherSlow.GetTrait<FSlow>().DmgType == TemporalDamage.DmgType)
-							{
-								bHasSameDmgType = true;
-								break;
-							}
+							ThisSegmentDamage = TemporalDamage.RemainingTemporalDamage;
 						}
-						TargetSlowing.Unlock();
-
-						// 如果没有同伤害类型的马甲，可以重置材质特效了
-						if (!bHasSameDmgType)
+						else
 						{
-							auto& TargetAnimating = TemporalDamage.TemporalDamageTarget.GetTraitRef<FAnimating, EParadigm::Unsafe>();
-
-							TargetAnimating.Lock();
-							switch (TemporalDamage.DmgType)
-							{
-								case EDmgType::Fire:
-									TargetAnimating.FireFx = 0;
-									break;
-								case EDmgType::Ice:
-									TargetAnimating.IceFx = 0;
-									break;
-								case EDmgType::Poison:
-									TargetAnimating.PoisonFx = 0;
-									break;
-							}
-							TargetAnimating.Unlock();
+							ThisSegmentDamage = FMath::Min(DamagePerSegment, TemporalDamage.RemainingTemporalDamage);
 						}
-					}
 
-					Subject.DespawnDeferred();
-					return;
-				}
+						float ClampedDamage = FMath::Min(ThisSegmentDamage, TargetHealth.Current);
 
-				TemporalDamage.TemporalDamageTimeout -= SafeDeltaTime;
+						// 应用伤害
+						TargetHealth.DamageToTake.Enqueue(ClampedDamage);
 
-				// 倒计时结束，造成一次伤害
-				if (TemporalDamage.TemporalDamageTimeout <= 0)
-				{
-					// 计算本次伤害值
-					float ThisSegmentDamage = 0.0f;
+						// 记录伤害施加者
+						TargetHealth.DamageInstigator.Enqueue(TemporalDamage.TemporalDamageInstigator);
 
-					// 扣除目标生命值
-					if (TemporalDamage.TemporalDamageTarget.HasTrait<FHealth>())
-					{
-						auto& TargetHealth = TemporalDamage.TemporalDamageTarget.GetTraitRef<FHealth, EParadigm::Unsafe>();
+						TargetHealth.HitDirection.Enqueue(FVector(0,0,0.0001f));
 
-						if (TargetHealth.Current > 0)
+						// 生成伤害数字
+						if (TemporalDamage.TemporalDamageTarget.HasTrait<FTextPopUp>())
 						{
-							// 计算本次伤害值
-							float DamagePerSegment = TemporalDamage.TotalTemporalDamage / TemporalDamage.TemporalDmgSegment;
+							const auto& TextPopUp = TemporalDamage.TemporalDamageTarget.GetTraitRef<FTextPopUp, EParadigm::Unsafe>();
 
-							// 确保最后一段使用剩余伤害值
-							if (TemporalDamage.CurrentSegment == TemporalDamage.TemporalDmgSegment - 1)
+							if (TextPopUp.Enable)
 							{
-								ThisSegmentDamage = TemporalDamage.RemainingTemporalDamage;
-							}
-							else
-							{
-								ThisSegmentDamage = FMath::Min(DamagePerSegment, TemporalDamage.RemainingTemporalDamage);
-							}
+								float Style;
 
-							float ClampedDamage = FMath::Min(ThisSegmentDamage, TargetHealth.Current);
+								if (ClampedDamage < TextPopUp.WhiteTextBelowPercent)
+								{
+									Style = 0;
+								}
+								else if (ClampedDamage < TextPopUp.OrangeTextAbovePercent)
+								{
+									Style = 1;
+								}
+								else
+								{
+									Style = 2;
+								}
 
-							// 应用伤害
-							TargetHealth.DamageToTake.Enqueue(ClampedDamage);
+								float Radius = TemporalDamage.TemporalDamageTarget.HasTrait<FGridData>() ? TemporalDamage.TemporalDamageTarget.GetTraitRef<FGridData, EParadigm::Unsafe>().Radius : 0;
+								FVector Location = TemporalDamage.TemporalDamageTarget.HasTrait<FLocated>() ? TemporalDamage.TemporalDamageTarget.GetTraitRef<FLocated, EParadigm::Unsafe>().Location : FVector::ZeroVector;
 
-							// 记录伤害施加者
-							TargetHealth.DamageInstigator.Enqueue(TemporalDamage.TemporalDamageInstigator);
+								QueueText(FTextPopConfig(TemporalDamage.TemporalDamageTarget, ClampedDamage, Style, TextPopUp.TextScale, Radius * 1.1, Location));
+							}
+						}
+					}
+				}
 
-							TargetHealth.HitDirection.Enqueue(FVector(0,0,0.0001f));
+				// 更新伤害状态
+				TemporalDamage.RemainingTemporalDamage -= ThisSegmentDamage;
+				TemporalDamage.CurrentSegment++;
 
-							//Temporal.TemporalDamageTarget.SetFlag(NeedSettleDmgFlag, true);
+				// 还有剩余伤害段数时，重新登记倒计时
+				if (TemporalDamage.CurrentSegment < TemporalDamage.TemporalDmgSegment && TemporalDamage.RemainingTemporalDamage > 0)
+				{
+					TemporalDamage.TemporalDamageTimeout = TemporalDamage.TemporalDmgInterval;
+					TemporalDamageTimers.Schedule(FSubjectHandle(Subject), TemporalDamage.TemporalDamageTimeout);
+					return;
+				}
+			}
 
-							// 生成伤害数字
-							if (TemporalDamage.TemporalDamageTarget.HasTrait<FTextPopUp>())
-							{
-								const auto& TextPopUp = TemporalDamage.TemporalDamageTarget.GetTraitRef<FTextPopUp, EParadigm::Unsafe>();
+			// 持续伤害结束时终止
+			auto& TargetTemporalDamaging = TemporalDamage.TemporalDamageTarget.GetTraitRef<FTemporalDamaging, EParadigm::Unsafe>();
 
-								if (TextPopUp.Enable)
-								{
-									float Style;
+			// 从马甲列表移除
+			TargetTemporalDamaging.Lock();
+			TargetTemporalDamaging.TemporalDamages.Remove(FSubjectHandle(Subject));
+			TargetTemporalDamaging.Unlock();
 
-									if (ClampedDamage < TextPopUp.WhiteTextBelowPercent)
-									{
-										Style = 0;
-									}
-									else if (ClampedDamage < TextPopUp.OrangeTextAbovePercent)
-									{
-										Style = 1;
-									}
-									else
-									{
-										Style = 2;
-									}
+			const bool bHasAnimating = TemporalDamage.TemporalDamageTarget.HasTrait<FAnimating>();
 
-									float Radius = TemporalDamage.TemporalDamageTarget.HasTrait<FGridData>() ? TemporalDamage.TemporalDamageTarget.GetTraitRef<FGridData, EParadigm::Unsafe>().Radius : 0;
-									FVector Location = TemporalDamage.TemporalDamageTarget.HasTrait<FLocated>() ? TemporalDamage.TemporalDamageTarget.GetTraitRef<FLocated, EParadigm::Unsafe>().Location : FVector::ZeroVector;
+			// 重置材质特效
+			if (bHasAnimating)
+			{
+				bool bHasSameDmgType = false;
 
-									QueueText(FTextPopConfig(TemporalDamage.TemporalDamageTarget, ClampedDamage, Style, TextPopUp.TextScale, Radius * 1.1, Location));
-								}
-							}
-						}
+				// 是否还存在同伤害类型的延时伤害马甲
+				TargetTemporalDamaging.Lock();
+				for (const auto& OtherTemporalDamage : TargetTemporalDamaging.TemporalDamages)
+				{
+					if (OtherTemporalDamage.GetTrait<FTemporalDamage>().DmgType == TemporalDamage.DmgType)
+					{
+						bHasSameDmgType = true;
+						break;
 					}
+				}
+				TargetTemporalDamaging.Unlock();
 
-					// 更新伤害状态
-					TemporalDamage.RemainingTemporalDamage -= ThisSegmentDamage;
-					TemporalDamage.CurrentSegment++;
+				// 是否还存在同伤害类型的减速马甲
+				auto& TargetSlowing = TemporalDamage.TemporalDamageTarget.GetTraitRef<FSlowing, EParadigm::Unsafe>();
 
-					// 重置倒计时（仅当还有剩余伤害段数时）
-					if (TemporalDamage.CurrentSegment < TemporalDamage.TemporalDmgSegment && TemporalDamage.RemainingTemporalDamage > 0)
+				TargetSlowing.Lock();
+				for (const auto& OtherSlow : TargetSlowing.Slows)
+				{
+					if (OtherSlow.GetTrait<FSlow>().DmgType == TemporalDamage.DmgType)
 					{
-						TemporalDamage.TemporalDamageTimeout = TemporalDamage.TemporalDmgInterval;
+						bHasSameDmgType = true;
+						break;
 					}
 				}
+				TargetSlowing.Unlock();
 
-			}, ThreadsCount, BatchSize);
+				// 如果没有同伤害类型的马甲，可以重置材质特效了
+				if (!bHasSameDmgType)
+				{
+					auto& TargetAnimating = TemporalDamage.TemporalDamageTarget.GetTraitRef<FAnimating, EParadigm::Unsafe>();
+
+					TargetAnimating.Lock();
+					switch (TemporalDamage.DmgType)
+					{
+						case EDmgType::Fire:
+							TargetAnimating.FireFx = 0;
+							break;
+						case EDmgType::Ice:
+							TargetAnimating.IceFx = 0;
+							break;
+						case EDmgType::Poison:
+							TargetAnimating.PoisonFx = 0;
+							break;
+					}
+					TargetAnimating.Unlock();
+				}
+			}
+
+			Subject.DespawnDeferred();
+		});
 	}
 	#pragma endregion
 
@@ -3192,7 +3438,7 @@ void ABattleFrameBattleControl::Tick(float DeltaTime)
 				}
 				else
 				{
-					Subject.DespawnDeferred(); // 移除
+					DespawnOrPark(Subject); // 移除或回收
 				}
 
 			}, ThreadsCount, BatchSize);
@@ -3554,6 +3800,12 @@ void ABattleFrameBattleControl::Tick(float DeltaTime)
 	}
 	#pragma endregion
 
+}
+
+void ABattleFrameBattleControl::TickPresentation(float SafeDeltaTime)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE_STR("BattleControlPresentation");
+
 	// 发送至Niagara | Send Data to Niagara
 	#pragma region
 	{
@@ -4566,73 +4818,48 @@ void ABattleFrameBattleControl::Tick(float DeltaTime)
 						DmgRadius = Subject.GetTraitRef<FDamage_Beam>().DmgRadius;
 					}
 
-					// Do apply dmg and debuff
-					TArray<FDmgResult> DamageResults;
+					// 伤害请求在本轮投射物处理完后统一结算 | Damage requests are resolved in one batch after all projectiles moved
+					FDmgRequest Request;
+					Request.NeighborGrid = NeighborGrid;
+					Request.StartLocation = Located.Location;
+					Request.EndLocation = Located.Location;
+					Request.IgnoreSubjects = ProjectileParamsRT.IgnoreSubjects;
+					Request.DmgInstigator = ProjectileParamsRT.Instigator;
+					Request.DmgCauser = FSubjectHandle(Subject);
+					Request.bAddHitsToCauserIgnore = !bShouldDespawn;
+					Request.HitFromLocation = Located.Location;
 
 					if (bIsPoint)
 					{
-						const auto& Damage_Point = Subject.GetTraitRef<FDamage_Point>();
-						const auto& Debuff_Point = Subject.GetTraitRef<FDebuff_Point>();
+						Request.Shape = EDmgRequestShape::Point;
+						Request.Damage = FDamage_Beam(Subject.GetTraitRef<FDamage_Point>());
+						Request.Debuff = FDebuff_Beam(Subject.GetTraitRef<FDebuff_Point>());
 
-						FSubjectArray SubjectArray;
-						SubjectArray.Subjects.Add(HitSubjectResult[0].Subject);
+						if (!HitSubjectResult.IsEmpty())
+						{
+							Request.Subjects.Subjects.Add(HitSubjectResult[0].Subject);
+						}
 
-						ApplyPointDamageAndDebuffDeferred
-						(
-							SubjectArray,
-							ProjectileParamsRT.IgnoreSubjects,
-							ProjectileParamsRT.Instigator,
-							FSubjectHandle(Subject),
-							Located.Location,
-							Damage_Point,
-							Debuff_Point,
-							DamageResults
-						);
+						DmgRequestQueue.Enqueue(MoveTemp(Request));
 					}
 					else if (bIsRadial)
 					{
-						const auto& Damage_Radial = Subject.GetTraitRef<FDamage_Radial>();
-						const auto& Debuff_Radial = Subject.GetTraitRef<FDebuff_Radial>();
+						Request.Shape = EDmgRequestShape::Radial;
+						Request.Damage = FDamage_Beam(Subject.GetTraitRef<FDamage_Radial>());
+						Request.Debuff = FDebuff_Beam(Subject.GetTraitRef<FDebuff_Radial>());
 
-						ApplyRadialDamageAndDebuffDeferred
-						(
-							NeighborGrid,
-							-1,
-							Located.Location,
-							ProjectileParamsRT.IgnoreSubjects,
-							ProjectileParamsRT.Instigator,
-							FSubjectHandle(Subject),
-							Located.Location,
-							Damage_Radial,
-							Debuff_Radial,
-							DamageResults
-						);
+						DmgRequestQueue.Enqueue(MoveTemp(Request));
 					}
 					else if (bIsBeam)
 					{
 						const auto& Damage_Beam = Subject.GetTraitRef<FDamage_Beam>();
-						const auto& Debuff_Beam = Subject.GetTraitRef<FDebuff_Beam>();
 
-						ApplyBeamDamageAndDebuffDeferred
-						(
-							NeighborGrid,
-							-1,
-							Located.Location,
-							Located.Location + Damage_Beam.DmgDirectionAndDistance,
-							ProjectileParamsRT.IgnoreSubjects,
-							ProjectileParamsRT.Instigator,
-							FSubjectHandle(Subject),
-							Located.Location,
-							Damage_Beam,
-							Debuff_Beam,
-							DamageResults
-						);
-					}
+						Request.Shape = EDmgRequestShape::Beam;
+						Request.EndLocation = Located.Location + Damage_Beam.DmgDirectionAndDistance;
+						Request.Damage = Damage_Beam;
+						Request.Debuff = Subject.GetTraitRef<FDebuff_Beam>();
 
-					// Add to ignore list
-					for (const auto& DamageResult : DamageResults)
-					{
-						ProjectileParamsRT.IgnoreSubjects.Subjects.AddUnique(DamageResult.DamagedSubject);
+						DmgRequestQueue.Enqueue(MoveTemp(Request));
 					}
 
 					// Hit particle burst
@@ -4648,7 +4875,7 @@ void ABattleFrameBattleControl::Tick(float DeltaTime)
 
 				if (bShouldDespawn)
 				{
-					Subject.DespawnDeferred();
+					DespawnOrPark(Subject);
 				}
 
 				// Draw Debug
@@ -4670,6 +4897,29 @@ void ABattleFrameBattleControl::Tick(float DeltaTime)
 				}
 
 			}, ThreadsCount, BatchSize);
+
+		// 批量结算所有投射物的伤害 | Resolve every projectile's damage in one batch
+		FlushDamageRequests();
+	}
+	#pragma endregion
+
+	//------------------- 对象池 | Pooling --------------------
+
+	// 回收休眠 | Park Pooled Subjects
+	#pragma region
+	{
+		TRACE_CPUPROFILER_EVENT_SCOPE_STR("ParkPooledSubjects");
+
+		ParkPooledSubjects();
+	}
+	#pragma endregion
+
+	// 唤醒延迟生成 | Spawn Pooled Deferred
+	#pragma region
+	{
+		TRACE_CPUPROFILER_EVENT_SCOPE_STR("SpawnPooledSubjects");
+
+		SpawnPooledSubjects();
 	}
 	#pragma endregion
 }
@@ -4683,7 +4933,7 @@ void ABattleFrameBattleControl::DefineFilters()
 	// this is a bit inconvenient but good for performance
 	bIsFilterReady = true;
 
-	AgentStatFilter = FFilter::Make<FStatistics>();
+	AgentStatFilter = FFilter::Make<FStatistics>().Exclude<FDormant>();
 	AgentAppeaFilter = FFilter::Make<FAgent, FRendering, FLocated, FDirected, FScaled, FAppear, FAppearing, FAnimation, FActivated>();
 
 	AgentSleepFilter = FFilter::Make<FAgent, FLocated, FDirected, FScaled, FCollider, FSleep, FSleeping, FTrace, FTracing, FMove, FMoving, FRendering, FActivated>().Exclude<FAppearing, FDying>();
@@ -4702,8 +4952,8 @@ void ABattleFrameBattleControl::DefineFilters()
 	AgentStateMachineFilter = FFilter::Make<FAgent, FAnimation, FRendering, FAppear, FAttack, FDeath, FMoving, FSlowing, FActivated>();
 	AgentRenderFilter = FFilter::Make<FAgent, FRendering, FLocated, FDirected, FScaled, FCollider, FAnimation, FHealth, FHealthBar, FPoppingText, FActivated>();
 
-	TemporalDamageFilter = FFilter::Make<FTemporalDamage>();
-	SlowFilter = FFilter::Make<FSlow>();
+	TemporalDamageFilter = FFilter::Make<FTemporalDamage>().Exclude<FTimed>();
+	SlowFilter = FFilter::Make<FSlow>().Exclude<FTimed>();
 
 	SpawnActorsFilter = FFilter::Make<FActorSpawnConfig_Final>();
 	SpawnFxFilter = FFilter::Make<FFxConfig_Final>();
@@ -4758,84 +5008,16 @@ bool ABattleFrameBattleControl::GetInterpedWorldLocation(AFlowField* flowField,
 	// 检查是否已开始游戏
 	if (flowField->bIsBeginPlay) return false;
 
-	// 计算相对位置
-	FVector relativeLocation = (location - flowField->actorLoc).RotateAngleAxis(-flowField->actorRot.Yaw, FVector(0, 0, 1)) + flowField->offsetLoc;
-	float cellRadius = flowField->cellSize / 2.0f;
-
-	// 计算连续网格坐标
-	float continuousGridX = (relativeLocation.X - cellRadius) / flowField->cellSize;
-	float continuousGridY = (relativeLocation.Y - cellRadius) / flowField->cellSize;
-
-	// 获取左下角索引和小数部分
-	int32 baseX = FMath::FloorToInt(continuousGridX);
-	int32 baseY = FMath::FloorToInt(continuousGridY);
-	float fractionX = continuousGridX - baseX;
-	float fractionY = continuousGridY - baseY;
-
-	// 检查四个点是否都在网格内
-	if (baseX >= 0 && (baseX + 1) < flowField->xNum &&
-		baseY >= 0 && (baseY + 1) < flowField->yNum)
-	{
-		// 获取四个角点的单元格
-		bool isValid00, isValid10, isValid01, isValid11;
-		FCellStruct& cell00 = flowField->GetCellAtCoord(FVector2D(baseX, baseY), isValid00);
-		FCellStruct& cell10 = flowField->GetCellAtCoord(FVector2D(baseX + 1, baseY), isValid10);
-		FCellStruct& cell01 = flowField->GetCellAtCoord(FVector2D(baseX, baseY + 1), isValid01);
-		FCellStruct& cell11 = flowField->GetCellAtCoord(FVector2D(baseX + 1, baseY + 1), isValid11);
-
-		// 确保所有单元格都有效
-		if (isValid00 && isValid10 && isValid01 && isValid11)
-		{
-			// 双线性插值位置
-			FVector interpBottom = FMath::Lerp(cell00.worldLoc, cell10.worldLoc, fractionX);
-			FVector interpTop = FMath::Lerp(cell01.worldLoc, cell11.worldLoc, fractionX);
-			outInterpolatedWorldLoc = FMath::Lerp(interpBottom, interpTop, fractionY);
-
-			// 计算与四个角点的最大坡度
-			float maxSlopeAngle = 0.0f;
-			const TArray<FVector> cornerPoints = {
-				cell00.worldLoc,
-				cell10.worldLoc,
-				cell01.worldLoc,
-				cell11.worldLoc
-			};
-
-			for (const FVector& cornerPoint : cornerPoints)
-			{
-				// 计算水平距离（忽略Z轴）
-				FVector horizontalVec = cornerPoint - outInterpolatedWorldLoc;
-				horizontalVec.Z = 0.0f;
-				const float horizontalDistance = horizontalVec.Size();
-
-				// 跳过距离过小的点（避免除以0）
-				if (horizontalDistance < 0) continue;
-
-				// 计算高度差
-				const float heightDiff = FMath::Abs(cornerPoint.Z - outInterpolatedWorldLoc.Z);
-
-				// 计算坡度角度（atan(高度差/水平距离)）
-				const float slopeAngle = FMath::RadiansToDegrees(FMath::Atan(heightDiff / horizontalDistance));
-
-				// 更新最大坡度
-				if (slopeAngle > maxSlopeAngle)
-				{
-					maxSlopeAngle = slopeAngle;
-				}
-			}
-
-			//UE_LOG(LogTemp, Warning, TEXT("maxSlopeAngle = %.2f degrees"), maxSlopeAngle);
+	// 从紧凑镜像双线性采样地面高度，并检查与四个角点的坡度，高度经uint16量化 | bilinear ground sample from the packed mirror with the corner slope test, heights are quantized to uint16
+	// 移动阶段按流场批量采样，此处只用于单点查询 | the move pass samples in batches per flow field, this is for single queries
+	FFlowFieldSample Sample;
+	flowField->SampleBatch(MakeArrayView(&location, 1), angleThreshold, MakeArrayView(&Sample, 1));
 
-			// 检查坡度是否超过阈值
-			if (maxSlopeAngle > angleThreshold)
-			{
-				return false; // 坡度太陡，无效位置
-			}
+	if (!Sample.bIsValid) return false;
 
-			return true; // 有效位置且坡度可接受
-		}
-	}
+	outInterpolatedWorldLoc = Sample.GroundLocation;
 
-	return false; // 基础条件不满足
+	return true;
 }
 
 void ABattleFrameBattleControl::DrawDebugSector(UWorld* World, const FVector& Center, const FVector& Direction, float Radius, float AngleDegrees, float Height, const FColor& Color, bool bPersistentLines, float LifeTime, uint8 DepthPriority, float Thickness)
@@ -5070,1904 +5252,462 @@ void ABattleFrameBattleControl::CopyPasteAnimData(FAnimating& Animating, int32 F
 }
 
 
-//-------------------------------------------------------Damager--------------------------------------------------------
+//-------------------------------------------------------Pooling--------------------------------------------------------
 
-void ABattleFrameBattleControl::ApplyPointDamageAndDebuff(const FSubjectArray& Subjects, const FSubjectArray& IgnoreSubjects, const FSubjectHandle DmgInstigator, const FSubjectHandle DmgCauser, const FVector& HitFromLocation, const FDamage_Point& Damage, const FDebuff_Point& Debuff, TArray<FDmgResult>& DamageResults)
+void ABattleFrameBattleControl::ReleaseGhosts(FSolidSubjectHandle Subject)
 {
-	//TRACE_CPUPROFILER_EVENT_SCOPE_STR("ApplyPointDamageAndDebuff");
-	// 使用TSet存储唯一敌人句柄
-	TSet<FSubjectHandle> UniqueHandles;
+	// 目标被移除或回收后马甲立即失效，不必等到时间轮到期
+	if (Subject.HasTrait<FSlowing>())
+	{
+		auto& Slowing = Subject.GetTraitRef<FSlowing, EParadigm::Unsafe>();
 
-	// 将IgnoreSubjects转换为TSet以提高查找效率
-	const TSet<FSubjectHandle> IgnoreSet(IgnoreSubjects.Subjects);
+		Slowing.Lock();
+		for (const FSubjectHandle& Slow : Slowing.Slows)
+		{
+			if (Slow.IsValid()) Slow.DespawnDeferred();
+		}
+		Slowing.Slows.Reset();
+		Slowing.CombinedSlowMult = 1;
+		Slowing.Unlock();
+	}
 
-	for (const auto& Overlapper : Subjects.Subjects)
+	if (Subject.HasTrait<FTemporalDamaging>())
 	{
-		//TRACE_CPUPROFILER_EVENT_SCOPE_STR("ForEachOverlapper");
-		// 使用TSet的Contains替代数组的Contains
-		if (IgnoreSet.Contains(Overlapper)) continue;
+		auto& TemporalDamaging = Subject.GetTraitRef<FTemporalDamaging, EParadigm::Unsafe>();
 
-		int32 PreviousNum = UniqueHandles.Num();
-		UniqueHandles.Add(Overlapper);
+		TemporalDamaging.Lock();
+		for (const FSubjectHandle& TemporalDamage : TemporalDamaging.TemporalDamages)
+		{
+			if (TemporalDamage.IsValid()) TemporalDamage.DespawnDeferred();
+		}
+		TemporalDamaging.TemporalDamages.Reset();
+		TemporalDamaging.Unlock();
+	}
+}
 
-		if (UniqueHandles.Num() == PreviousNum) continue;
+void ABattleFrameBattleControl::ParkPooledSubjects()
+{
+	FSubjectHandle Subject;
 
-		if (!Overlapper.IsValid()) continue;
+	while (ParkQueue.Dequeue(Subject))
+	{
+		// 同一帧可能被多次入队
+		if (!Subject.IsValid() || Subject.HasTrait<FDormant>()) continue;
 
-		// Pre-calculate all trait checks
-		const bool bHasHealth = Overlapper.HasTrait<FHealth>();
-		const bool bHasLocated = Overlapper.HasTrait<FLocated>();
-		const bool bHasDirected = Overlapper.HasTrait<FDirected>();
-		const bool bHasScaled = Overlapper.HasTrait<FScaled>();
-		const bool bHasCollider = Overlapper.HasTrait<FCollider>();
-		const bool bHasGridData = Overlapper.HasTrait<FGridData>();
-		const bool bHasDefence = Overlapper.HasTrait<FDefence>();
-		const bool bHasTextPopUp = Overlapper.HasTrait<FTextPopUp>();
-		const bool bHasMoving = Overlapper.HasTrait<FMoving>();
-		const bool bHasSlowing = Overlapper.HasTrait<FSlowing>();
-		const bool bHasAnimation = Overlapper.HasTrait<FAnimation>();
-		const bool bHasSleep = Overlapper.HasTrait<FSleep>();
-		const bool bHasSleeping = Overlapper.HasTrait<FSleeping>();
-		const bool bHasHit = Overlapper.HasTrait<FHit>();
-		const bool bHasBeingHit = Overlapper.HasTrait<FBeingHit>();
-		const bool bHasHitGlow = Overlapper.HasFlag(HitGlowFlag);
-		const bool bHasHitJiggle = Overlapper.HasFlag(HitJiggleFlag);
-		const bool bHasHitAnim = Overlapper.HasFlag(HitAnimFlag);
-		const bool bHasPatrolling = Overlapper.HasTrait<FPatrolling>();
-		const bool bHasTrace = Overlapper.HasTrait<FTrace>();
-		const bool bHasIsSubjective = Overlapper.HasTrait<FIsSubjective>();
+		const auto Pooled = Subject.GetTrait<FPooled>();
 
-		FVector Location = bHasLocated ? Overlapper.GetTrait<FLocated>().Location : FVector::ZeroVector;
-		FVector Direction = bHasDirected ? Overlapper.GetTrait<FDirected>().Direction : FVector::ZeroVector;
+		// 先检查池键，避免为无效键创建空池
+		if (!IsValid(Pooled.PoolKey))
+		{
+			Subject.Despawn();
+			continue;
+		}
 
-		FDmgResult DmgResult;
-		DmgResult.DamagedSubject = Overlapper;
+		auto& Pool = DormantSubjects.FindOrAdd(TObjectKey<UObject>(Pooled.PoolKey.Get()));
 
-		FBeingHit NewBeingHit = !bHasBeingHit ? FBeingHit() : Overlapper.GetTrait<FBeingHit>();
+		if (Pool.Num() >= Pooled.Capacity)
+		{
+			Subject.Despawn();
+			continue;
+		}
 
-		// 击退
-		FVector HitDirection = FVector::OneVector;
+		// 去掉激活标记即可让所有逻辑和渲染跳过该个体，FDying 保留以便其它持有该句柄的逻辑仍视其为死亡
+		if (Subject.HasTrait<FAgent>() && !Subject.HasTrait<FDying>())
+		{
+			Subject.SetTrait(FDying());
+		}
 
-		if (bHasLocated) HitDirection = (Location - HitFromLocation).GetSafeNormal2D();
+		Subject.RemoveTrait<FActivated>();
+		Subject.SetTrait(FDormant());
 
-		//-------------伤害和抗性------------
+		Pool.Add(Subject);
+	}
+}
 
-		float NormalDmgMult = 1;
-		float FireDmgMult = 1;
-		float IceDmgMult = 1;
-		float PoisonDmgMult = 1;
-		float PercentDmgMult = 1;
+int32 ABattleFrameBattleControl::ReuseDormantSubjects(const UObject* PoolKey, const FSubjectRecord& Prototype, const int32 MaxCount, TArray<FSubjectHandle>& OutSubjects)
+{
+	TArray<FSubjectHandle>* Pool = DormantSubjects.Find(PoolKey);
 
-		if (bHasHealth)
-		{
-			auto& Health = Overlapper.GetTraitRef<FHealth, EParadigm::Unsafe>();
+	if (!Pool) return 0;
 
-			// 抗性 如果有的话
-			if (bHasDefence)
-			{
-				const auto Defence = Overlapper.GetTrait<FDefence>();
+	int32 ReusedCount = 0;
 
-				NormalDmgMult = 1 - Defence.NormalDmgImmune;
-				FireDmgMult = 1 - Defence.FireDmgImmune;
-				IceDmgMult = 1 - Defence.IceDmgImmune;
-				PoisonDmgMult = 1 - Defence.PoisonDmgImmune;
-				PercentDmgMult = 1.f - Defence.PercentDmgImmune;
-			}
+	while (ReusedCount < MaxCount && Pool->Num() > 0)
+	{
+		const FSubjectHandle Subject = Pool->Pop(EAllowShrinking::No);
 
-			// 基础伤害
-			float BaseDamage = 0;
+		if (!Subject.IsValid() || !Subject.HasTrait<FDormant>()) continue;
 
-			switch (Damage.DmgType)
-			{
-				case EDmgType::Normal:
-					BaseDamage = Damage.Damage * NormalDmgMult;
-					break;
-				case EDmgType::Fire:
-					BaseDamage = Damage.Damage * FireDmgMult;
-					break;
-				case EDmgType::Ice:
-					BaseDamage = Damage.Damage * IceDmgMult;
-					break;
-				case EDmgType::Poison:
-					BaseDamage = Damage.Damage * PoisonDmgMult;
-					break;
-			}
+		// 一次性重置为原型，运行时附加的特征（FDormant, FDying, FRendering, 队伍标签等）一并移除，回到与新生成个体相同的Chunk
+		Subject.SetTraits(Prototype, /*bLeaveRedundant=*/false);
+		Subject.SetFlagmark(Prototype.GetFlagmark());
 
-			// 百分比伤害
-			float PercentageDamage = Health.Maximum * Damage.PercentDmg * PercentDmgMult;
+		OutSubjects.Add(Subject);
+		ReusedCount++;
+	}
 
-			// 总伤害
-			float CombinedDamage = BaseDamage + PercentageDamage;
+	return ReusedCount;
+}
 
-			// 考虑暴击后伤害
-			auto [bIsCrit, PostCritDamage] = ProcessCritDamage(CombinedDamage, Damage.CritDmgMult, Damage.CritProbability);
+void ABattleFrameBattleControl::SpawnPooledSubjects()
+{
+	if (!Mechanism) return;
 
-			// 限制伤害以不大于剩余血量
-			float ClampedDamage = FMath::Min(PostCritDamage, Health.Current);
+	FSubjectRecord Record;
+	TArray<FSubjectHandle> Reused;
 
-			DmgResult.IsCritical = bIsCrit;
-			DmgResult.DmgDealt = ClampedDamage;
+	while (PooledSpawnQueue.Dequeue(Record))
+	{
+		const FPooled* Pooled = Record.GetTraitPtr<FPooled>();
 
-			// 应用伤害
-			Health.DamageToTake.Enqueue(ClampedDamage);
-			Health.HitDirection.Enqueue(HitDirection);
+		// 没有休眠个体时照常生成
+		if (Pooled && ReuseDormantSubjects(Pooled->PoolKey.Get(), Record, 1, Reused) > 0)
+		{
+			Reused.Reset();
+			continue;
+		}
 
-			// 记录伤害施加者
-			Health.DamageInstigator.Enqueue(DmgInstigator);
-			DmgResult.InstigatorSubject = DmgInstigator;
-			DmgResult.CauserSubject = DmgCauser;
+		Mechanism->SpawnSubject(Record);
+	}
+}
 
-			// ------------生成文字--------------
+//-------------------------------------------------------Damager--------------------------------------------------------
 
-			if (bHasTextPopUp && bHasLocated)
-			{
-				const auto TextPopUp = Overlapper.GetTrait<FTextPopUp>();
+void ABattleFrameBattleControl::ApplyPointDamageAndDebuff(const FSubjectArray& Subjects, const FSubjectArray& IgnoreSubjects, const FSubjectHandle DmgInstigator, const FSubjectHandle DmgCauser, const FVector& HitFromLocation, const FDamage_Point& Damage, const FDebuff_Point& Debuff, TArray<FDmgResult>& DamageResults)
+{
+	FDmgRequest Request;
+	Request.Shape = EDmgRequestShape::Point;
+	Request.Subjects = Subjects;
+	Request.IgnoreSubjects = IgnoreSubjects;
+	Request.DmgInstigator = DmgInstigator;
+	Request.DmgCauser = DmgCauser;
+	Request.HitFromLocation = HitFromLocation;
+	Request.Damage = FDamage_Beam(Damage);
+	Request.Debuff = FDebuff_Beam(Debuff);
+
+	ApplyDamageRequest(MoveTemp(Request), DamageResults, false);
+}
 
-				if (TextPopUp.Enable)
-				{
-					float Style = 0;
+void ABattleFrameBattleControl::ApplyPointDamageAndDebuffDeferred(const FSubjectArray& Subjects, const FSubjectArray& IgnoreSubjects, const FSubjectHandle DmgInstigator, const FSubjectHandle DmgCauser, const FVector& HitFromLocation, const FDamage_Point& Damage, const FDebuff_Point& Debuff, TArray<FDmgResult>& DamageResults)
+{
+	FDmgRequest Request;
+	Request.Shape = EDmgRequestShape::Point;
+	Request.Subjects = Subjects;
+	Request.IgnoreSubjects = IgnoreSubjects;
+	Request.DmgInstigator = DmgInstigator;
+	Request.DmgCauser = DmgCauser;
+	Request.HitFromLocation = HitFromLocation;
+	Request.Damage = FDamage_Beam(Damage);
+	Request.Debuff = FDebuff_Beam(Debuff);
+
+	ApplyDamageRequest(MoveTemp(Request), DamageResults, true);
+}
 
-					if (!bIsCrit)
-					{
-						if (PostCritDamage < TextPopUp.WhiteTextBelowPercent)
-						{
-							Style = 0;
-						}
-						else if (PostCritDamage < TextPopUp.OrangeTextAbovePercent)
-						{
-							Style = 1;
-						}
-						else
-						{
-							Style = 2;
-						}
-					}
-					else
-					{
-						Style = 3;
-					}
+void ABattleFrameBattleControl::ApplyRadialDamageAndDebuff(UNeighborGridComponent* NeighborGridComponent, const int32 KeepCount, const FVector& Origin, const FSubjectArray& IgnoreSubjects, const FSubjectHandle DmgInstigator, const FSubjectHandle DmgCauser, const FVector& HitFromLocation, const FDamage_Radial& Damage, const FDebuff_Radial& Debuff, TArray<FDmgResult>& DamageResults)
+{
+	FDmgRequest Request;
+	Request.Shape = EDmgRequestShape::Radial;
+	Request.NeighborGrid = NeighborGridComponent;
+	Request.KeepCount = KeepCount;
+	Request.StartLocation = Origin;
+	Request.EndLocation = Origin;
+	Request.IgnoreSubjects = IgnoreSubjects;
+	Request.DmgInstigator = DmgInstigator;
+	Request.DmgCauser = DmgCauser;
+	Request.HitFromLocation = HitFromLocation;
+	Request.Damage = FDamage_Beam(Damage);
+	Request.Debuff = FDebuff_Beam(Debuff);
+
+	ApplyDamageRequest(MoveTemp(Request), DamageResults, false);
+}
 
-					float Radius = bHasGridData ? Overlapper.GetTrait<FGridData>().Radius : 0;
-					QueueText(FTextPopConfig(Overlapper, PostCritDamage, Style, TextPopUp.TextScale, Radius * 1.1, Location));
-				}
-			}
+void ABattleFrameBattleControl::ApplyRadialDamageAndDebuffDeferred(UNeighborGridComponent* NeighborGridComponent, const int32 KeepCount, const FVector& Origin, const FSubjectArray& IgnoreSubjects, const FSubjectHandle DmgInstigator, const FSubjectHandle DmgCauser, const FVector& HitFromLocation, const FDamage_Radial& Damage, const FDebuff_Radial& Debuff, TArray<FDmgResult>& DamageResults)
+{
+	FDmgRequest Request;
+	Request.Shape = EDmgRequestShape::Radial;
+	Request.NeighborGrid = NeighborGridComponent;
+	Request.KeepCount = KeepCount;
+	Request.StartLocation = Origin;
+	Request.EndLocation = Origin;
+	Request.IgnoreSubjects = IgnoreSubjects;
+	Request.DmgInstigator = DmgInstigator;
+	Request.DmgCauser = DmgCauser;
+	Request.HitFromLocation = HitFromLocation;
+	Request.Damage = FDamage_Beam(Damage);
+	Request.Debuff = FDebuff_Beam(Debuff);
+
+	ApplyDamageRequest(MoveTemp(Request), DamageResults, true);
+}
 
-			//--------------Debuff--------------
+void ABattleFrameBattleControl::ApplyBeamDamageAndDebuff(UNeighborGridComponent* NeighborGridComponent, const int32 KeepCount, const FVector& StartLocation, const FVector& EndLocation, const FSubjectArray& IgnoreSubjects, const FSubjectHandle DmgInstigator, const FSubjectHandle DmgCauser, const FVector& HitFromLocation, const FDamage_Beam& Damage, const FDebuff_Beam& Debuff, TArray<FDmgResult>& DamageResults)
+{
+	FDmgRequest Request;
+	Request.Shape = EDmgRequestShape::Beam;
+	Request.NeighborGrid = NeighborGridComponent;
+	Request.KeepCount = KeepCount;
+	Request.StartLocation = StartLocation;
+	Request.EndLocation = EndLocation;
+	Request.IgnoreSubjects = IgnoreSubjects;
+	Request.DmgInstigator = DmgInstigator;
+	Request.DmgCauser = DmgCauser;
+	Request.HitFromLocation = HitFromLocation;
+	Request.Damage = Damage;
+	Request.Debuff = Debuff;
+
+	ApplyDamageRequest(MoveTemp(Request), DamageResults, false);
+}
 
-			// 持续伤害
-			if (Debuff.TemporalDmgParams.bDealTemporalDmg)
-			{
-				// Record for spawning of TemporalDamage
-				FTemporalDamage TemporalDamage;
+void ABattleFrameBattleControl::ApplyBeamDamageAndDebuffDeferred(UNeighborGridComponent* NeighborGridComponent, const int32 KeepCount, const FVector& StartLocation, const FVector& EndLocation, const FSubjectArray& IgnoreSubjects, const FSubjectHandle DmgInstigator, const FSubjectHandle DmgCauser, const FVector& HitFromLocation, const FDamage_Beam& Damage, const FDebuff_Beam& Debuff, TArray<FDmgResult>& DamageResults)
+{
+	FDmgRequest Request;
+	Request.Shape = EDmgRequestShape::Beam;
+	Request.NeighborGrid = NeighborGridComponent;
+	Request.KeepCount = KeepCount;
+	Request.StartLocation = StartLocation;
+	Request.EndLocation = EndLocation;
+	Request.IgnoreSubjects = IgnoreSubjects;
+	Request.DmgInstigator = DmgInstigator;
+	Request.DmgCauser = DmgCauser;
+	Request.HitFromLocation = HitFromLocation;
+	Request.Damage = Damage;
+	Request.Debuff = Debuff;
+
+	ApplyDamageRequest(MoveTemp(Request), DamageResults, true);
+}
 
-				float TotalTemporalDmg = Debuff.TemporalDmgParams.TemporalDmg;
+void ABattleFrameBattleControl::ApplyDamageRequest(FDmgRequest&& Request, TArray<FDmgResult>& DamageResults, const bool bDeferred)
+{
+	TArray<FDmgRequest> Requests;
+	Requests.Add(MoveTemp(Request));
 
-				switch (Damage.DmgType)
-				{
-					case EDmgType::Normal:
-						TotalTemporalDmg *= NormalDmgMult;
-						break;
-					case EDmgType::Fire:
-						TotalTemporalDmg *= FireDmgMult;
-						break;
-					case EDmgType::Ice:
-						TotalTemporalDmg *= IceDmgMult;
-						break;
-					case EDmgType::Poison:
-						TotalTemporalDmg *= PoisonDmgMult;
-						break;
-				}
+	// 延迟版本由并行的攻击逻辑调用，单个请求在当前线程结算
+	TArray<TArray<FDmgResult>> Results;
+	ApplyDamageBatch(Requests, Results, bDeferred, bDeferred);
 
-				TemporalDamage.TotalTemporalDamage = TotalTemporalDmg;
+	DamageResults.Append(MoveTemp(Results[0]));
+}
 
-				if (TemporalDamage.TotalTemporalDamage > 0)
-				{
-					TemporalDamage.TemporalDamageTarget = Overlapper;
-					TemporalDamage.RemainingTemporalDamage = TemporalDamage.TotalTemporalDamage;
+void ABattleFrameBattleControl::FlushDamageRequests()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE_STR("FlushDamageRequests");
 
-					if (DmgInstigator.IsValid())
-					{
-						TemporalDamage.TemporalDamageInstigator = DmgInstigator;
-					}
-					else
-					{
-						TemporalDamage.TemporalDamageInstigator = FSubjectHandle();
-					}
+	TArray<FDmgRequest> Requests;
+	FDmgRequest Request;
 
-					TemporalDamage.TemporalDmgSegment = Debuff.TemporalDmgParams.TemporalDmgSegment;
-					TemporalDamage.TemporalDmgInterval = Debuff.TemporalDmgParams.TemporalDmgInterval;
-					TemporalDamage.DmgType = Damage.DmgType;
+	while (DmgRequestQueue.Dequeue(Request))
+	{
+		Requests.Add(MoveTemp(Request));
+	}
 
-					Mechanism->SpawnSubject(TemporalDamage);
-				}
-			}
-		}
+	if (Requests.IsEmpty()) return;
 
-		//--------------Debuff--------------
+	TArray<TArray<FDmgResult>> Results;
+	ApplyDamageBatch(Requests, Results, true, false);
 
-		if (Debuff.LaunchParams.bCanLaunch)
-		{
-			if (bHasMoving)
-			{
-				auto Moving = Overlapper.GetTrait<FMoving>();
+	// 投射物命中的目标加入其忽略列表 | Projectiles ignore what they already hit
+	for (int32 RequestIndex = 0; RequestIndex < Requests.Num(); ++RequestIndex)
+	{
+		const FDmgRequest& Request = Requests[RequestIndex];
+		const FSubjectHandle& Causer = Request.DmgCauser;
 
-				FVector KnockbackForce = FVector(Debuff.LaunchParams.LaunchSpeed.X, Debuff.LaunchParams.LaunchSpeed.X, 1) * HitDirection + FVector(0, 0, Debuff.LaunchParams.LaunchSpeed.Y);
-				Moving.LaunchVelSum += KnockbackForce; // 累加击退力
+		// 本帧被移除或回收的投射物不再更新，避免写入已失效或将被复用的个体
+		if (!Request.bAddHitsToCauserIgnore || Results[RequestIndex].IsEmpty() || !Causer.IsValid() || !Causer.HasTrait<FProjectileParamsRT>()) continue;
 
-				Overlapper.SetTrait(Moving);
-			}
+		auto& ProjectileParamsRT = Causer.GetTraitRef<FProjectileParamsRT, EParadigm::Unsafe>();
+
+		for (const auto& DamageResult : Results[RequestIndex])
+		{
+			ProjectileParamsRT.IgnoreSubjects.Subjects.AddUnique(DamageResult.DamagedSubject);
 		}
+	}
+}
+
+void ABattleFrameBattleControl::ResolveDamageTargets(const FDmgRequest& Request, const int32 RequestIndex, TArray<FDmgHit>& OutHits, const bool bDeferred) const
+{
+	if (Request.Shape == EDmgRequestShape::Point)
+	{
+		// 使用TSet存储唯一敌人句柄
+		TSet<FSubjectHandle> UniqueHandles;
 
-		// 减速
-		if (Debuff.SlowParams.bCanSlow && bHasSlowing)
+		// 将IgnoreSubjects转换为TSet以提高查找效率
+		const TSet<FSubjectHandle> IgnoreSet(Request.IgnoreSubjects.Subjects);
+
+		for (const auto& Overlapper : Request.Subjects.Subjects)
 		{
-			// Record for spawning of Slow
-			FSlow Slow;
+			if (IgnoreSet.Contains(Overlapper)) continue;
+
+			bool bAlreadyInSet = false;
+			UniqueHandles.Add(Overlapper, &bAlreadyInSet);
 
-			Slow.SlowTarget = Overlapper;
-			Slow.SlowStrength = Debuff.SlowParams.SlowStrength;
-			Slow.SlowTimeout = Debuff.SlowParams.SlowTime;
-			Slow.DmgType = Damage.DmgType;
+			if (bAlreadyInSet || !Overlapper.IsValid()) continue;
 
-			Mechanism->SpawnSubject(Slow);
+			OutHits.Add(FDmgHit{ Overlapper, RequestIndex });
 		}
 
-		//-----------其它效果------------
+		return;
+	}
 
-		if (bHasSleeping)// wake on hit
+	UNeighborGridComponent* NeighborGridComponent = Request.NeighborGrid;
+
+	// 非延迟调用时，未指定网格则使用场景中的第一个
+	if (!IsValid(NeighborGridComponent) && !bDeferred)
+	{
+		if (UWorld* World = GetWorld())
 		{
-			if (bHasSleep)
+			for (TActorIterator<ANeighborGridActor> It(World); It; ++It)
 			{
-				auto Sleep = Overlapper.GetTrait<FSleep>();
-
-				if (Sleep.bWakeOnHit)
-				{
-					Sleep.bEnable = false;
-					Overlapper.SetTrait(Sleep);
-					Overlapper.RemoveTrait<FSleeping>();
-				}
+				ANeighborGridActor* NeighborGridActor = *It;
+				NeighborGridComponent = NeighborGridActor->GetComponentByClass<UNeighborGridComponent>();
+				break;
 			}
 		}
+	}
 
-		if (bHasHit)
-		{
-			const auto Hit = Overlapper.GetTrait<FHit>();
+	if (!IsValid(NeighborGridComponent)) return;
 
-			// Actor
-			for (const FActorSpawnConfig& Config : Hit.SpawnActor)
-			{
-				FActorSpawnConfig_Final NewConfig(Config);
-				NewConfig.OwnerSubject = FSubjectHandle(Overlapper);
-				NewConfig.AttachToSubject = FSubjectHandle(Overlapper);
-				const FTransform WorldTransform(HitDirection.ToOrientationQuat(), Location);
-				NewConfig.SpawnTransform = ABattleFrameBattleControl::LocalOffsetToWorld(Direction.ToOrientationQuat(),WorldTransform.GetLocation(), NewConfig.Transform);
-				NewConfig.InitialRelativeTransform = NewConfig.SpawnTransform.GetRelativeTransform(WorldTransform);
+	const FDamage_Beam& Damage = Request.Damage;
+	const FDebuff_Beam& Debuff = Request.Debuff;
 
-				Mechanism->SpawnSubject(NewConfig);
-			}
+	bool bHit = false;
+	TArray<FTraceResult> TraceResults;
 
-			// Fx
-			for (const FFxConfig& Config : Hit.SpawnFx)
-			{
-				FFxConfig_Final NewConfig(Config);
-				NewConfig.OwnerSubject = FSubjectHandle(Overlapper);
-				NewConfig.AttachToSubject = FSubjectHandle(Overlapper);
-				const FTransform WorldTransform(HitDirection.ToOrientationQuat(), Location);
-				NewConfig.SpawnTransform = ABattleFrameBattleControl::LocalOffsetToWorld(Direction.ToOrientationQuat(), WorldTransform.GetLocation(), NewConfig.Transform);
-				NewConfig.InitialRelativeTransform = NewConfig.SpawnTransform.GetRelativeTransform(WorldTransform);
+	if (Request.Shape == EDmgRequestShape::Radial)
+	{
+		UBattleFrameFunctionLibraryRT::SphereTraceForSubjects
+		(
+			bHit,
+			TraceResults,
+			NeighborGridComponent,
+			Request.KeepCount,
+			Request.StartLocation,
+			Damage.DmgRadius,
+			!Damage.Filter.ObstacleObjectType.IsEmpty(),
+			Request.StartLocation,
+			0.01,
+			ESortMode::None,
+			Request.StartLocation,
+			Request.IgnoreSubjects,
+			Damage.Filter,
+			FTraceDrawDebugConfig()
+		);
+	}
+	else
+	{
+		UBattleFrameFunctionLibraryRT::SphereSweepForSubjects
+		(
+			bHit,
+			TraceResults,
+			NeighborGridComponent,
+			Request.KeepCount,
+			Request.StartLocation,
+			Request.EndLocation,
+			Damage.DmgRadius,
+			!Damage.Filter.ObstacleObjectType.IsEmpty(),
+			Request.StartLocation,
+			0.01,
+			ESortMode::None,
+			Request.StartLocation,
+			Request.IgnoreSubjects,
+			Damage.Filter,
+			FTraceDrawDebugConfig()
+		);
+	}
 
-				Mechanism->SpawnSubject(NewConfig);
-			}
+	if (!bHit) return;
 
-			// Sound
-			for (const FSoundConfig& Config : Hit.PlaySound)
-			{
-				FSoundConfig_Final NewConfig(Config);
-				NewConfig.OwnerSubject = FSubjectHandle(Overlapper);
-				NewConfig.AttachToSubject = FSubjectHandle(Overlapper);
-				const FTransform WorldTransform(HitDirection.ToOrientationQuat(), Location);
-				NewConfig.SpawnTransform = ABattleFrameBattleControl::LocalOffsetToWorld(Direction.ToOrientationQuat(), WorldTransform.GetLocation(), NewConfig.Transform);
-				NewConfig.InitialRelativeTransform = NewConfig.SpawnTransform.GetRelativeTransform(WorldTransform);
+	const TRange<float> InputRange(0, Damage.DmgRadius);
+	const TRange<float> OutputRange(1, 0);
 
-				Mechanism->SpawnSubject(NewConfig);
-			}
+	for (const auto& TraceResult : TraceResults)
+	{
+		const auto& Overlapper = TraceResult.Subject;
 
-			// Glow
-			if (Hit.bCanGlow && !bHasHitGlow)
-			{
-				Overlapper.SetFlag(HitGlowFlag);
+		if (!Overlapper.IsValid()) continue;
 
-				if (bHasBeingHit)
-				{
-					NewBeingHit.ResetGlow();
-				}
-			}
+		FDmgHit Hit{ Overlapper, RequestIndex };
 
-			// Jiggle
-			if (Hit.JiggleStr != 0 && !bHasHitJiggle)
-			{
-				Overlapper.SetFlag(HitJiggleFlag);
-
-				if (bHasBeingHit)
-				{
-					NewBeingHit.ResetJiggle();
-				}
-			}
-
-			// Anim
-			if (Hit.bPlayAnim && !bHasHitAnim)
-			{
-				Overlapper.SetFlag(HitAnimFlag);
-
-				if (bHasBeingHit)
-				{
-					NewBeingHit.ResetAnim();
-				}
-			}
-		}
-
-		Overlapper.SetTrait(NewBeingHit);
-
-		if (bHasIsSubjective)
-		{
-			FHitData HitData;
-			HitData.SelfSubject = DmgResult.DamagedSubject;
-			HitData.InstigatorSubject = DmgResult.InstigatorSubject;
-			HitData.CauserSubject = DmgResult.CauserSubject;
-			HitData.IsCritical = DmgResult.IsCritical;
-			HitData.IsKill = DmgResult.IsKill;
-			HitData.DmgDealt = DmgResult.DmgDealt;
-			OnHitQueue.Enqueue(HitData);
-		}
-
-		DamageResults.Add(DmgResult);
-	}
-}
-
-void ABattleFrameBattleControl::ApplyPointDamageAndDebuffDeferred(const FSubjectArray& Subjects, const FSubjectArray& IgnoreSubjects, const FSubjectHandle DmgInstigator, const FSubjectHandle DmgCauser, const FVector& HitFromLocation, const FDamage_Point& Damage, const FDebuff_Point& Debuff, TArray<FDmgResult>& DamageResults)
-{
-	//TRACE_CPUPROFILER_EVENT_SCOPE_STR("ApplyPointDamageAndDebuff");
-	// 使用TSet存储唯一敌人句柄
-	TSet<FSubjectHandle> UniqueHandles;
-
-	// 将IgnoreSubjects转换为TSet以提高查找效率
-	const TSet<FSubjectHandle> IgnoreSet(IgnoreSubjects.Subjects);
-
-	for (const auto& Overlapper : Subjects.Subjects)
-	{
-		//TRACE_CPUPROFILER_EVENT_SCOPE_STR("ForEachOverlapper");
-		// 使用TSet的Contains替代数组的Contains
-		if (IgnoreSet.Contains(Overlapper)) continue;
-
-		int32 PreviousNum = UniqueHandles.Num();
-		UniqueHandles.Add(Overlapper);
-
-		if (UniqueHandles.Num() == PreviousNum) continue;
-
-		if (!Overlapper.IsValid()) continue;
-
-		// Pre-calculate all trait checks
-		const bool bHasHealth = Overlapper.HasTrait<FHealth>();
-		const bool bHasLocated = Overlapper.HasTrait<FLocated>();
-		const bool bHasDirected = Overlapper.HasTrait<FDirected>();
-		const bool bHasScaled = Overlapper.HasTrait<FScaled>();
-		const bool bHasCollider = Overlapper.HasTrait<FCollider>();
-		const bool bHasGridData = Overlapper.HasTrait<FGridData>();
-		const bool bHasDefence = Overlapper.HasTrait<FDefence>();
-		const bool bHasTextPopUp = Overlapper.HasTrait<FTextPopUp>();
-		const bool bHasMoving = Overlapper.HasTrait<FMoving>();
-		const bool bHasSlowing = Overlapper.HasTrait<FSlowing>();
-		const bool bHasAnimation = Overlapper.HasTrait<FAnimation>();
-		const bool bHasSleep = Overlapper.HasTrait<FSleep>();
-		const bool bHasSleeping = Overlapper.HasTrait<FSleeping>();
-		const bool bHasHit = Overlapper.HasTrait<FHit>();
-		const bool bHasBeingHit = Overlapper.HasTrait<FBeingHit>();
-		const bool bHasHitGlow = Overlapper.HasFlag(HitGlowFlag);
-		const bool bHasHitJiggle = Overlapper.HasFlag(HitJiggleFlag);
-		const bool bHasHitAnim = Overlapper.HasFlag(HitAnimFlag);
-		const bool bHasPatrolling = Overlapper.HasTrait<FPatrolling>();
-		const bool bHasTrace = Overlapper.HasTrait<FTrace>();
-		const bool bHasIsSubjective = Overlapper.HasTrait<FIsSubjective>();
-
-		FVector Location = bHasLocated ? Overlapper.GetTrait<FLocated>().Location : FVector::ZeroVector;
-		FVector Direction = bHasDirected ? Overlapper.GetTrait<FDirected>().Direction : FVector::ZeroVector;
-
-		FBeingHit NewBeingHit = !bHasBeingHit ? FBeingHit() : Overlapper.GetTrait<FBeingHit>();
-
-		FDmgResult DmgResult;
-		DmgResult.DamagedSubject = Overlapper;
-
-		FVector HitDirection = FVector::ZeroVector;
-
-		if (bHasLocated)
-		{
-			HitDirection = (Location - HitFromLocation).GetSafeNormal2D();
-		}
-
-		//-------------伤害和抗性------------
-
-		float NormalDmgMult = 1;
-		float FireDmgMult = 1;
-		float IceDmgMult = 1;
-		float PoisonDmgMult = 1;
-		float PercentDmgMult = 1;
-
-		if (bHasHealth)
-		{
-			auto& Health = Overlapper.GetTraitRef<FHealth, EParadigm::Unsafe>();
-
-			// 抗性 如果有的话
-			if (bHasDefence)
-			{
-				const auto& Defence = Overlapper.GetTrait<FDefence>();
-
-				NormalDmgMult = 1 - Defence.NormalDmgImmune;
-				FireDmgMult = 1 - Defence.FireDmgImmune;
-				IceDmgMult = 1 - Defence.IceDmgImmune;
-				PoisonDmgMult = 1 - Defence.PoisonDmgImmune;
-				PercentDmgMult = 1.f - Defence.PercentDmgImmune;
-			}
-
-			// 基础伤害
-			float BaseDamage = 0;
-
-			switch (Damage.DmgType)
-			{
-				case EDmgType::Normal:
-					BaseDamage = Damage.Damage * NormalDmgMult;
-					break;
-				case EDmgType::Fire:
-					BaseDamage = Damage.Damage * FireDmgMult;
-					break;
-				case EDmgType::Ice:
-					BaseDamage = Damage.Damage * IceDmgMult;
-					break;
-				case EDmgType::Poison:
-					BaseDamage = Damage.Damage * PoisonDmgMult;
-					break;
-			}
-
-			// 百分比伤害
-			float PercentageDamage = Health.Maximum * Damage.PercentDmg * PercentDmgMult;
-
-			// 总伤害
-			float CombinedDamage = BaseDamage + PercentageDamage;
-
-			// 考虑暴击后伤害
-			auto [bIsCrit, PostCritDamage] = ProcessCritDamage(CombinedDamage, Damage.CritDmgMult, Damage.CritProbability);
-
-			// 限制伤害以不大于剩余血量
-			float ClampedDamage = FMath::Min(PostCritDamage, Health.Current);
-
-			DmgResult.IsCritical = bIsCrit;
-			DmgResult.DmgDealt = ClampedDamage;
-
-			// 应用伤害
-			Health.DamageToTake.Enqueue(ClampedDamage);
-			Health.HitDirection.Enqueue(HitDirection);
-
-			// 记录伤害施加者
-			Health.DamageInstigator.Enqueue(DmgInstigator);
-			DmgResult.InstigatorSubject = DmgInstigator;
-			DmgResult.CauserSubject = DmgCauser;
-
-			// ------------生成文字--------------
-
-			if (bHasTextPopUp && bHasLocated)
-			{
-				const auto& TextPopUp = Overlapper.GetTrait<FTextPopUp>();
-
-				if (TextPopUp.Enable)
-				{
-					float Style = 0;
-
-					if (!bIsCrit)
-					{
-						if (PostCritDamage < TextPopUp.WhiteTextBelowPercent)
-						{
-							Style = 0;
-						}
-						else if (PostCritDamage < TextPopUp.OrangeTextAbovePercent)
-						{
-							Style = 1;
-						}
-						else
-						{
-							Style = 2;
-						}
-					}
-					else
-					{
-						Style = 3;
-					}
-
-					float Radius = bHasGridData ? Overlapper.GetTrait<FGridData>().Radius : 0;
-					QueueText(FTextPopConfig(Overlapper, PostCritDamage, Style, TextPopUp.TextScale, Radius * 1.1, Location));
-				}
-			}
-
-			//--------------Debuff--------------
-
-			// 持续伤害
-			if (Debuff.TemporalDmgParams.bDealTemporalDmg)
-			{
-				// Record for spawning of TemporalDamage
-				FTemporalDamage TemporalDamage;
-
-				float TotalTemporalDmg = Debuff.TemporalDmgParams.TemporalDmg;
-
-				switch (Damage.DmgType)
-				{
-					case EDmgType::Normal:
-						TotalTemporalDmg *= NormalDmgMult;
-						break;
-					case EDmgType::Fire:
-						TotalTemporalDmg *= FireDmgMult;
-						break;
-					case EDmgType::Ice:
-						TotalTemporalDmg *= IceDmgMult;
-						break;
-					case EDmgType::Poison:
-						TotalTemporalDmg *= PoisonDmgMult;
-						break;
-				}
-
-				TemporalDamage.TotalTemporalDamage = TotalTemporalDmg;
-
-				if (TemporalDamage.TotalTemporalDamage > 0)
-				{
-					TemporalDamage.TemporalDamageTarget = Overlapper;
-					TemporalDamage.RemainingTemporalDamage = TemporalDamage.TotalTemporalDamage;
-
-					if (DmgInstigator.IsValid())
-					{
-						TemporalDamage.TemporalDamageInstigator = DmgInstigator;
-					}
-					else
-					{
-						TemporalDamage.TemporalDamageInstigator = FSubjectHandle();
-					}
-
-					TemporalDamage.TemporalDmgSegment = Debuff.TemporalDmgParams.TemporalDmgSegment;
-					TemporalDamage.TemporalDmgInterval = Debuff.TemporalDmgParams.TemporalDmgInterval;
-					TemporalDamage.DmgType = Damage.DmgType;
-
-					Mechanism->SpawnSubjectDeferred(TemporalDamage);
-				}
-			}
-		}
-
-		//--------------Debuff--------------
-
-		// 击退
-		if (Debuff.LaunchParams.bCanLaunch)
-		{
-			if (bHasMoving)
-			{
-				auto& Moving = Overlapper.GetTraitRef<FMoving, EParadigm::Unsafe>();
-
-				FVector KnockbackForce = FVector(Debuff.LaunchParams.LaunchSpeed.X, Debuff.LaunchParams.LaunchSpeed.X, 1) * HitDirection + FVector(0, 0, Debuff.LaunchParams.LaunchSpeed.Y);
-
-				Moving.Lock();
-				Moving.LaunchVelSum += KnockbackForce; // 累加击退力
-				Moving.Unlock();
-			}
-		}
-
-		// 减速
-		if (Debuff.SlowParams.bCanSlow && bHasSlowing)
-		{
-			// Record for deferred spawning of Slow
-			FSlow Slow;
-
-			Slow.SlowTarget = Overlapper;
-			Slow.SlowStrength = Debuff.SlowParams.SlowStrength;
-			Slow.SlowTimeout = Debuff.SlowParams.SlowTime;
-			Slow.DmgType = Damage.DmgType;
-
-			Mechanism->SpawnSubjectDeferred(Slow);
-		}
-
-		//-----------其它效果------------
-
-		if (bHasSleeping)// wake on hit
-		{
-			if (bHasSleep)
-			{
-				auto& Sleep = Overlapper.GetTraitRef<FSleep, EParadigm::Unsafe>();
-
-				if (Sleep.bWakeOnHit)
-				{
-					Sleep.bEnable = false;
-					Overlapper.RemoveTraitDeferred<FSleeping>();
-				}
-			}
-		}
-
-		if (bHasHit)
-		{
-			const auto Hit = Overlapper.GetTrait<FHit>();
-
-			// Actor
-			for (const FActorSpawnConfig& Config : Hit.SpawnActor)
-			{
-				FActorSpawnConfig_Final NewConfig(Config);
-				NewConfig.OwnerSubject = FSubjectHandle(Overlapper);
-				NewConfig.AttachToSubject = FSubjectHandle(Overlapper);
-				const FTransform WorldTransform(HitDirection.ToOrientationQuat(), Location);
-				NewConfig.SpawnTransform = ABattleFrameBattleControl::LocalOffsetToWorld(Direction.ToOrientationQuat(), WorldTransform.GetLocation(), NewConfig.Transform);
-				NewConfig.InitialRelativeTransform = NewConfig.SpawnTransform.GetRelativeTransform(WorldTransform);
-
-				Mechanism->SpawnSubjectDeferred(NewConfig);
-			}
-
-			// Fx
-			for (const FFxConfig& Config : Hit.SpawnFx)
-			{
-				FFxConfig_Final NewConfig(Config);
-				NewConfig.OwnerSubject = FSubjectHandle(Overlapper);
-				NewConfig.AttachToSubject = FSubjectHandle(Overlapper);
-				const FTransform WorldTransform(HitDirection.ToOrientationQuat(), Location);
-				NewConfig.SpawnTransform = ABattleFrameBattleControl::LocalOffsetToWorld(Direction.ToOrientationQuat(), WorldTransform.GetLocation(), NewConfig.Transform);
-				NewConfig.InitialRelativeTransform = NewConfig.SpawnTransform.GetRelativeTransform(WorldTransform);
-
-				Mechanism->SpawnSubjectDeferred(NewConfig);
-			}
-
-			// Sound
-			for (const FSoundConfig& Config : Hit.PlaySound)
-			{
-				FSoundConfig_Final NewConfig(Config);
-				NewConfig.OwnerSubject = FSubjectHandle(Overlapper);
-				NewConfig.AttachToSubject = FSubjectHandle(Overlapper);
-				const FTransform WorldTransform(HitDirection.ToOrientationQuat(), Location);
-				NewConfig.SpawnTransform = ABattleFrameBattleControl::LocalOffsetToWorld(Direction.ToOrientationQuat(), WorldTransform.GetLocation(), NewConfig.Transform);
-				NewConfig.InitialRelativeTransform = NewConfig.SpawnTransform.GetRelativeTransform(WorldTransform);
-
-				Mechanism->SpawnSubjectDeferred(NewConfig);
-			}
-
-			// Glow
-			if (Hit.bCanGlow && !bHasHitGlow)
-			{
-				Overlapper.SetFlag(HitGlowFlag);
-
-				if (bHasBeingHit)
-				{
-					NewBeingHit.ResetGlow();
-				}
-			}
-
-			// Jiggle
-			if (Hit.JiggleStr != 0 && !bHasHitJiggle)
-			{
-				Overlapper.SetFlag(HitJiggleFlag);
-
-				if (bHasBeingHit)
-				{
-					NewBeingHit.ResetJiggle();
-				}
-			}
-
-			// Anim
-			if (Hit.bPlayAnim && !bHasHitAnim)
-			{
-				Overlapper.SetFlag(HitAnimFlag);
-
-				if (bHasBeingHit)
-				{
-					NewBeingHit.ResetAnim();
-				}
-			}
-		}
-
-		Overlapper.SetTraitDeferred(NewBeingHit);
-
-		if (bHasIsSubjective)
-		{
-			FHitData HitData;
-			HitData.SelfSubject = DmgResult.DamagedSubject;
-			HitData.InstigatorSubject = DmgResult.InstigatorSubject;
-			HitData.CauserSubject = DmgResult.CauserSubject;
-			HitData.IsCritical = DmgResult.IsCritical;
-			HitData.IsKill = DmgResult.IsKill;
-			HitData.DmgDealt = DmgResult.DmgDealt;
-			OnHitQueue.Enqueue(HitData);
-		}
-
-		DamageResults.Add(DmgResult);
-	}
-}
-
-void ABattleFrameBattleControl::ApplyRadialDamageAndDebuff(UNeighborGridComponent* NeighborGridComponent, const int32 KeepCount, const FVector& Origin, const FSubjectArray& IgnoreSubjects, const FSubjectHandle DmgInstigator, const FSubjectHandle DmgCauser, const FVector& HitFromLocation, const FDamage_Radial& Damage, const FDebuff_Radial& Debuff, TArray<FDmgResult>& DamageResults)
-{
-	//TRACE_CPUPROFILER_EVENT_SCOPE_STR("ApplyRadialDamageAndDebuff");
-	// sphere trace at Origin
-	if (!IsValid(NeighborGridComponent))
-	{
-		if (UWorld* World = GetWorld())
-		{
-			for (TActorIterator<ANeighborGridActor> It(World); It; ++It)
-			{
-				ANeighborGridActor* NeighborGridActor = *It;
-				NeighborGridComponent = NeighborGridActor->GetComponentByClass<UNeighborGridComponent>();
-				break;
-			}
-		}
-
-		if (!IsValid(NeighborGridComponent)) return;
-	}
-
-	bool bHit;
-	TArray<FTraceResult> TraceResults;
-
-	UBattleFrameFunctionLibraryRT::SphereTraceForSubjects
-	(
-		bHit,
-		TraceResults,
-		NeighborGridComponent,
-		KeepCount,
-		Origin,
-		Damage.DmgRadius,
-		!Damage.Filter.ObstacleObjectType.IsEmpty(),
-		Origin,
-		0.01,
-		ESortMode::None,
-		Origin,
-		IgnoreSubjects,
-		Damage.Filter,
-		FTraceDrawDebugConfig()
-	);
-
-	if (!bHit) return;
-
-	for (const auto& TraceResult : TraceResults)
-	{
-		//TRACE_CPUPROFILER_EVENT_SCOPE_STR("ForEachOverlapper");
-		const auto& Overlapper = TraceResult.Subject;
-
-		if (!Overlapper.IsValid()) continue;
-
-		// Pre-calculate all trait checks
-		const bool bHasHealth = Overlapper.HasTrait<FHealth>();
-		const bool bHasLocated = Overlapper.HasTrait<FLocated>();
-		const bool bHasDirected = Overlapper.HasTrait<FDirected>();
-		const bool bHasScaled = Overlapper.HasTrait<FScaled>();
-		const bool bHasCollider = Overlapper.HasTrait<FCollider>();
-		const bool bHasGridData = Overlapper.HasTrait<FGridData>();
-		const bool bHasDefence = Overlapper.HasTrait<FDefence>();
-		const bool bHasTextPopUp = Overlapper.HasTrait<FTextPopUp>();
-		const bool bHasMoving = Overlapper.HasTrait<FMoving>();
-		const bool bHasSlowing = Overlapper.HasTrait<FSlowing>();
-		const bool bHasAnimation = Overlapper.HasTrait<FAnimation>();
-		const bool bHasSleep = Overlapper.HasTrait<FSleep>();
-		const bool bHasSleeping = Overlapper.HasTrait<FSleeping>();
-		const bool bHasHit = Overlapper.HasTrait<FHit>();
-		const bool bHasBeingHit = Overlapper.HasTrait<FBeingHit>();
-		const bool bHasHitGlow = Overlapper.HasFlag(HitGlowFlag);
-		const bool bHasHitJiggle = Overlapper.HasFlag(HitJiggleFlag);
-		const bool bHasHitAnim = Overlapper.HasFlag(HitAnimFlag);
-		const bool bHasPatrolling = Overlapper.HasTrait<FPatrolling>();
-		const bool bHasTrace = Overlapper.HasTrait<FTrace>();
-		const bool bHasIsSubjective = Overlapper.HasTrait<FIsSubjective>();
-
-		FVector Location = bHasLocated ? Overlapper.GetTrait<FLocated>().Location : FVector::ZeroVector;
-		FVector Direction = bHasDirected ? Overlapper.GetTrait<FDirected>().Direction : FVector::ZeroVector;
-
-		FDmgResult DmgResult;
-		DmgResult.DamagedSubject = Overlapper;
-
-		FBeingHit NewBeingHit = !bHasBeingHit ? FBeingHit() : Overlapper.GetTrait<FBeingHit>();
-
-		// 击退
-		FVector HitDirection = FVector::OneVector;
-		if (bHasLocated) HitDirection = (Location - HitFromLocation).GetSafeNormal2D();
-
-		// 距离衰减
-		float Distance = FVector::Distance(Origin, Location);
-		TRange<float> InputRange(0,Damage.DmgRadius);
-		TRange<float> OutputRange(1, 0);
-		float DmgFalloffMult = Damage.bUseFalloff ? FMath::GetMappedRangeValueClamped(InputRange,OutputRange, Distance) : 1;
-		float DebuffFalloffMult = Debuff.bUseFalloff ? FMath::GetMappedRangeValueClamped(InputRange, OutputRange, Distance) : 1;
-
-		//-------------伤害和抗性------------
-
-		float NormalDmgMult = 1;
-		float FireDmgMult = 1;
-		float IceDmgMult = 1;
-		float PoisonDmgMult = 1;
-		float PercentDmgMult = 1;
-
-		if (bHasHealth)
-		{
-			auto& Health = Overlapper.GetTraitRef<FHealth, EParadigm::Unsafe>();
-
-			// 抗性 如果有的话
-			if (bHasDefence)
-			{
-				const auto Defence = Overlapper.GetTrait<FDefence>();
-
-				NormalDmgMult = 1 - Defence.NormalDmgImmune;
-				FireDmgMult = 1 - Defence.FireDmgImmune;
-				IceDmgMult = 1 - Defence.IceDmgImmune;
-				PoisonDmgMult = 1 - Defence.PoisonDmgImmune;
-				PercentDmgMult = 1.f - Defence.PercentDmgImmune;
-			}
-
-			// 基础伤害
-			float BaseDamage = 0;
-
-			switch (Damage.DmgType)
-			{
-				case EDmgType::Normal:
-					BaseDamage = Damage.Damage * NormalDmgMult;
-					break;
-				case EDmgType::Fire:
-					BaseDamage = Damage.Damage * FireDmgMult;
-					break;
-				case EDmgType::Ice:
-					BaseDamage = Damage.Damage * IceDmgMult;
-					break;
-				case EDmgType::Poison:
-					BaseDamage = Damage.Damage * PoisonDmgMult;
-					break;
-			}
-
-			// 百分比伤害
-			float PercentageDamage = Health.Maximum * Damage.PercentDmg * PercentDmgMult;
-
-			// 总伤害
-			float CombinedDamage = (BaseDamage + PercentageDamage) * DmgFalloffMult;
-
-			// 考虑暴击后伤害
-			auto [bIsCrit, PostCritDamage] = ProcessCritDamage(CombinedDamage, Damage.CritDmgMult, Damage.CritProbability);
-
-			// 限制伤害以不大于剩余血量
-			float ClampedDamage = FMath::Min(PostCritDamage, Health.Current);
-
-			DmgResult.IsCritical = bIsCrit;
-			DmgResult.DmgDealt = ClampedDamage;
-
-			// 应用伤害
-			Health.DamageToTake.Enqueue(ClampedDamage);
-			Health.HitDirection.Enqueue(HitDirection);
-
-			// 记录伤害施加者
-			Health.DamageInstigator.Enqueue(DmgInstigator);
-			DmgResult.InstigatorSubject = DmgInstigator;
-			DmgResult.CauserSubject = DmgCauser;
-
-			// ------------生成文字--------------
-
-			if (bHasTextPopUp && bHasLocated)
-			{
-				const auto TextPopUp = Overlapper.GetTrait<FTextPopUp>();
-
-				if (TextPopUp.Enable)
-				{
-					float Style = 0;
-
-					if (!bIsCrit)
-					{
-						if (PostCritDamage < TextPopUp.WhiteTextBelowPercent)
-						{
-							Style = 0;
-						}
-						else if (PostCritDamage < TextPopUp.OrangeTextAbovePercent)
-						{
-							Style = 1;
-						}
-						else
-						{
-							Style = 2;
-						}
-					}
-					else
-					{
-						Style = 3;
-					}
-
-					float Radius = bHasGridData ? Overlapper.GetTrait<FGridData>().Radius : 0;
-					QueueText(FTextPopConfig(Overlapper, PostCritDamage, Style, TextPopUp.TextScale, Radius * 1.1, Location));
-				}
-			}
-
-			//--------------Debuff--------------
-			// 持续伤害
-			if (Debuff.TemporalDmgParams.bDealTemporalDmg)
-			{
-				// Record for spawning of TemporalDamage
-				FTemporalDamage TemporalDamage;
-
-				float TotalTemporalDmg = Debuff.TemporalDmgParams.TemporalDmg;
-
-				switch (Damage.DmgType)
-				{
-				case EDmgType::Normal:
-					TotalTemporalDmg *= NormalDmgMult;
-					break;
-				case EDmgType::Fire:
-					TotalTemporalDmg *= FireDmgMult;
-					break;
-				case EDmgType::Ice:
-					TotalTemporalDmg *= IceDmgMult;
-					break;
-				case EDmgType::Poison:
-					TotalTemporalDmg *= PoisonDmgMult;
-					break;
-				}
-
-				TemporalDamage.TotalTemporalDamage = TotalTemporalDmg * DebuffFalloffMult;
-
-				if (TemporalDamage.TotalTemporalDamage > 0)
-				{
-					TemporalDamage.TemporalDamageTarget = Overlapper;
-					TemporalDamage.RemainingTemporalDamage = TemporalDamage.TotalTemporalDamage;
-
-					if (DmgInstigator.IsValid())
-					{
-						TemporalDamage.TemporalDamageInstigator = DmgInstigator;
-					}
-					else
-					{
-						TemporalDamage.TemporalDamageInstigator = FSubjectHandle();
-					}
-
-					TemporalDamage.TemporalDmgSegment = Debuff.TemporalDmgParams.TemporalDmgSegment;
-					TemporalDamage.TemporalDmgInterval = Debuff.TemporalDmgParams.TemporalDmgInterval;
-					TemporalDamage.DmgType = Damage.DmgType;
-
-					Mechanism->SpawnSubject(TemporalDamage);
-				}
-			}
-		}
-
-		//--------------Debuff--------------
-
-		if (Debuff.LaunchParams.bCanLaunch)
-		{
-			if (bHasMoving)
-			{
-				auto Moving = Overlapper.GetTrait<FMoving>();
-
-				FVector KnockbackForce = FVector(Debuff.LaunchParams.LaunchSpeed.X, Debuff.LaunchParams.LaunchSpeed.X, 1) * HitDirection + FVector(0, 0, Debuff.LaunchParams.LaunchSpeed.Y);
-				Moving.LaunchVelSum += KnockbackForce * DebuffFalloffMult; // 累加击退力
-
-				Overlapper.SetTrait(Moving);
-			}
-		}
-
-		// 减速
-		if (Debuff.SlowParams.bCanSlow && bHasSlowing)
-		{
-			// Record for spawning of Slow
-			FSlow Slow;
-
-			Slow.SlowTarget = Overlapper;
-			Slow.SlowStrength = Debuff.SlowParams.SlowStrength * DebuffFalloffMult;
-			Slow.SlowTimeout = Debuff.SlowParams.SlowTime;
-			Slow.DmgType = Damage.DmgType;
-			Mechanism->SpawnSubject(Slow);
-		}
-
-		//-----------其它效果------------
-
-		if (bHasSleeping)// wake on hit
-		{
-			if (bHasSleep)
-			{
-				auto Sleep = Overlapper.GetTrait<FSleep>();
-
-				if (Sleep.bWakeOnHit)
-				{
-					Sleep.bEnable = false;
-					Overlapper.SetTrait(Sleep);
-					Overlapper.RemoveTrait<FSleeping>();
-				}
-			}
-		}
-
-		if (bHasHit)
-		{
-			const auto Hit = Overlapper.GetTrait<FHit>();
-
-			// Actor
-			for (const FActorSpawnConfig& Config : Hit.SpawnActor)
-			{
-				FActorSpawnConfig_Final NewConfig(Config);
-				NewConfig.OwnerSubject = FSubjectHandle(Overlapper);
-				NewConfig.AttachToSubject = FSubjectHandle(Overlapper);
-				const FTransform WorldTransform(HitDirection.ToOrientationQuat(), Location);
-				NewConfig.SpawnTransform = ABattleFrameBattleControl::LocalOffsetToWorld(Direction.ToOrientationQuat(), WorldTransform.GetLocation(), NewConfig.Transform);
-				NewConfig.InitialRelativeTransform = NewConfig.SpawnTransform.GetRelativeTransform(WorldTransform);
-
-				Mechanism->SpawnSubject(NewConfig);
-			}
-
-			// Fx
-			for (const FFxConfig& Config : Hit.SpawnFx)
-			{
-				FFxConfig_Final NewConfig(Config);
-				NewConfig.OwnerSubject = FSubjectHandle(Overlapper);
-				NewConfig.AttachToSubject = FSubjectHandle(Overlapper);
-				const FTransform WorldTransform(HitDirection.ToOrientationQuat(), Location);
-				NewConfig.SpawnTransform = ABattleFrameBattleControl::LocalOffsetToWorld(Direction.ToOrientationQuat(), WorldTransform.GetLocation(), NewConfig.Transform);
-				NewConfig.InitialRelativeTransform = NewConfig.SpawnTransform.GetRelativeTransform(WorldTransform);
-
-				Mechanism->SpawnSubject(NewConfig);
-			}
-
-			// Sound
-			for (const FSoundConfig& Config : Hit.PlaySound)
-			{
-				FSoundConfig_Final NewConfig(Config);
-				NewConfig.OwnerSubject = FSubjectHandle(Overlapper);
-				NewConfig.AttachToSubject = FSubjectHandle(Overlapper);
-				const FTransform WorldTransform(HitDirection.ToOrientationQuat(), Location);
-				NewConfig.SpawnTransform = ABattleFrameBattleControl::LocalOffsetToWorld(Direction.ToOrientationQuat(), WorldTransform.GetLocation(), NewConfig.Transform);
-				NewConfig.InitialRelativeTransform = NewConfig.SpawnTransform.GetRelativeTransform(WorldTransform);
-
-				Mechanism->SpawnSubject(NewConfig);
-			}
-
-			// Glow
-			if (Hit.bCanGlow && !bHasHitGlow)
-			{
-				Overlapper.SetFlag(HitGlowFlag);
-
-				if (bHasBeingHit)
-				{
-					NewBeingHit.ResetGlow();
-				}
-			}
-
-			// Jiggle
-			if (Hit.JiggleStr != 0 && !bHasHitJiggle)
-			{
-				Overlapper.SetFlag(HitJiggleFlag);
-
-				if (bHasBeingHit)
-				{
-					NewBeingHit.ResetJiggle();
-				}
-			}
-
-			// Anim
-			if (Hit.bPlayAnim && !bHasHitAnim)
-			{
-				Overlapper.SetFlag(HitAnimFlag);
-
-				if (bHasBeingHit)
-				{
-					NewBeingHit.ResetAnim();
-				}
-			}
-		}
-
-		Overlapper.SetTrait(NewBeingHit);
-
-		if (bHasIsSubjective)
-		{
-			FHitData HitData;
-			HitData.SelfSubject = DmgResult.DamagedSubject;
-			HitData.InstigatorSubject = DmgResult.InstigatorSubject;
-			HitData.CauserSubject = DmgResult.CauserSubject;
-			HitData.IsCritical = DmgResult.IsCritical;
-			HitData.IsKill = DmgResult.IsKill;
-			HitData.DmgDealt = DmgResult.DmgDealt;
-			OnHitQueue.Enqueue(HitData);
-		}
-
-		DamageResults.Add(DmgResult);
-	}
-}
-
-void ABattleFrameBattleControl::ApplyRadialDamageAndDebuffDeferred(UNeighborGridComponent* NeighborGridComponent, const int32 KeepCount, const FVector& Origin, const FSubjectArray& IgnoreSubjects, const FSubjectHandle DmgInstigator, const FSubjectHandle DmgCauser, const FVector& HitFromLocation, const FDamage_Radial& Damage, const FDebuff_Radial& Debuff, TArray<FDmgResult>& DamageResults)
-{
-	//TRACE_CPUPROFILER_EVENT_SCOPE_STR("ApplyRadialDamageAndDebuff");
-	// sphere trace at Origin
-
-	if (!IsValid(NeighborGridComponent)) return;
-
-	bool bHit;
-	TArray<FTraceResult> TraceResults;
-
-	UBattleFrameFunctionLibraryRT::SphereTraceForSubjects
-	(
-		bHit,
-		TraceResults,
-		NeighborGridComponent,
-		KeepCount,
-		Origin,
-		Damage.DmgRadius,
-		!Damage.Filter.ObstacleObjectType.IsEmpty(),
-		Origin,
-		0.01,
-		ESortMode::None,
-		Origin,
-		IgnoreSubjects,
-		Damage.Filter,
-		FTraceDrawDebugConfig()
-	);
-
-	if (!bHit) return;
-
-	for (const auto& TraceResult : TraceResults)
-	{
-		//TRACE_CPUPROFILER_EVENT_SCOPE_STR("ForEachOverlapper");
-		const auto& Overlapper = TraceResult.Subject;
-
-		if (!Overlapper.IsValid()) continue;
-
-		// Pre-calculate all trait checks
-		const bool bHasHealth = Overlapper.HasTrait<FHealth>();
-		const bool bHasLocated = Overlapper.HasTrait<FLocated>();
-		const bool bHasDirected = Overlapper.HasTrait<FDirected>();
-		const bool bHasScaled = Overlapper.HasTrait<FScaled>();
-		const bool bHasCollider = Overlapper.HasTrait<FCollider>();
-		const bool bHasGridData = Overlapper.HasTrait<FGridData>();
-		const bool bHasDefence = Overlapper.HasTrait<FDefence>();
-		const bool bHasTextPopUp = Overlapper.HasTrait<FTextPopUp>();
-		const bool bHasMoving = Overlapper.HasTrait<FMoving>();
-		const bool bHasSlowing = Overlapper.HasTrait<FSlowing>();
-		const bool bHasAnimation = Overlapper.HasTrait<FAnimation>();
-		const bool bHasSleep = Overlapper.HasTrait<FSleep>();
-		const bool bHasSleeping = Overlapper.HasTrait<FSleeping>();
-		const bool bHasHit = Overlapper.HasTrait<FHit>();
-		const bool bHasBeingHit = Overlapper.HasTrait<FBeingHit>();
-		const bool bHasHitGlow = Overlapper.HasFlag(HitGlowFlag);
-		const bool bHasHitJiggle = Overlapper.HasFlag(HitJiggleFlag);
-		const bool bHasHitAnim = Overlapper.HasFlag(HitAnimFlag);
-		const bool bHasPatrolling = Overlapper.HasTrait<FPatrolling>();
-		const bool bHasTrace = Overlapper.HasTrait<FTrace>();
-		const bool bHasIsSubjective = Overlapper.HasTrait<FIsSubjective>();
-
-		FVector Location = bHasLocated ? Overlapper.GetTrait<FLocated>().Location : FVector::ZeroVector;
-		FVector Direction = bHasDirected ? Overlapper.GetTrait<FDirected>().Direction : FVector::ZeroVector;
-
-		FDmgResult DmgResult;
-		DmgResult.DamagedSubject = Overlapper;
-
-		FBeingHit NewBeingHit = !bHasBeingHit ? FBeingHit() : Overlapper.GetTrait<FBeingHit>();
-
-		// 击退
-		FVector HitDirection = FVector::OneVector;
-		if (bHasLocated) HitDirection = (Location - HitFromLocation).GetSafeNormal2D();
-
-		// 距离衰减
-		float Distance = FVector::Distance(Origin, Location);
-		TRange<float> InputRange(0, Damage.DmgRadius);
-		TRange<float> OutputRange(1, 0);
-		float DmgFalloffMult = Damage.bUseFalloff ? FMath::GetMappedRangeValueClamped(InputRange, OutputRange, Distance) : 1;
-		float DebuffFalloffMult = Debuff.bUseFalloff ? FMath::GetMappedRangeValueClamped(InputRange, OutputRange, Distance) : 1;
-
-		//-------------伤害和抗性------------
-
-		float NormalDmgMult = 1;
-		float FireDmgMult = 1;
-		float IceDmgMult = 1;
-		float PoisonDmgMult = 1;
-		float PercentDmgMult = 1;
-
-		if (bHasHealth)
-		{
-			auto& Health = Overlapper.GetTraitRef<FHealth, EParadigm::Unsafe>();
-
-			// 抗性 如果有的话
-			if (bHasDefence)
-			{
-				const auto Defence = Overlapper.GetTrait<FDefence>();
-
-				NormalDmgMult = 1 - Defence.NormalDmgImmune;
-				FireDmgMult = 1 - Defence.FireDmgImmune;
-				IceDmgMult = 1 - Defence.IceDmgImmune;
-				PoisonDmgMult = 1 - Defence.PoisonDmgImmune;
-				PercentDmgMult = 1.f - Defence.PercentDmgImmune;
-			}
-
-			// 基础伤害
-			float BaseDamage = 0;
-
-			switch (Damage.DmgType)
-			{
-				case EDmgType::Normal:
-					BaseDamage = Damage.Damage * NormalDmgMult;
-					break;
-				case EDmgType::Fire:
-					BaseDamage = Damage.Damage * FireDmgMult;
-					break;
-				case EDmgType::Ice:
-					BaseDamage = Damage.Damage * IceDmgMult;
-					break;
-				case EDmgType::Poison:
-					BaseDamage = Damage.Damage * PoisonDmgMult;
-					break;
-			}
-
-			// 百分比伤害
-			float PercentageDamage = Health.Maximum * Damage.PercentDmg * PercentDmgMult;
-
-			// 总伤害
-			float CombinedDamage = (BaseDamage + PercentageDamage) * DmgFalloffMult;
-
-			// 考虑暴击后伤害
-			auto [bIsCrit, PostCritDamage] = ProcessCritDamage(CombinedDamage, Damage.CritDmgMult, Damage.CritProbability);
-
-			// 限制伤害以不大于剩余血量
-			float ClampedDamage = FMath::Min(PostCritDamage, Health.Current);
-
-			DmgResult.IsCritical = bIsCrit;
-			DmgResult.DmgDealt = ClampedDamage;
-
-			// 应用伤害
-			Health.DamageToTake.Enqueue(ClampedDamage);
-			Health.HitDirection.Enqueue(HitDirection);
-
-			// 记录伤害施加者
-			Health.DamageInstigator.Enqueue(DmgInstigator);
-			DmgResult.InstigatorSubject = DmgInstigator;
-			DmgResult.CauserSubject = DmgCauser;
-
-			// ------------生成文字--------------
-
-			if (bHasTextPopUp && bHasLocated)
-			{
-				const auto TextPopUp = Overlapper.GetTrait<FTextPopUp>();
-
-				if (TextPopUp.Enable)
-				{
-					float Style = 0;
-
-					if (!bIsCrit)
-					{
-						if (PostCritDamage < TextPopUp.WhiteTextBelowPercent)
-						{
-							Style = 0;
-						}
-						else if (PostCritDamage < TextPopUp.OrangeTextAbovePercent)
-						{
-							Style = 1;
-						}
-						else
-						{
-							Style = 2;
-						}
-					}
-					else
-					{
-						Style = 3;
-					}
-
-					float Radius = bHasGridData ? Overlapper.GetTrait<FGridData>().Radius : 0;
-					QueueText(FTextPopConfig(Overlapper, PostCritDamage, Style, TextPopUp.TextScale, Radius * 1.1, Location));
-				}
-			}
-
-			//--------------Debuff--------------
-			// 持续伤害
-			if (Debuff.TemporalDmgParams.bDealTemporalDmg)
-			{
-				// Record for spawning of TemporalDamage
-				FTemporalDamage TemporalDamage;
-
-				float TotalTemporalDmg = Debuff.TemporalDmgParams.TemporalDmg;
-
-				switch (Damage.DmgType)
-				{
-				case EDmgType::Normal:
-					TotalTemporalDmg *= NormalDmgMult;
-					break;
-				case EDmgType::Fire:
-					TotalTemporalDmg *= FireDmgMult;
-					break;
-				case EDmgType::Ice:
-					TotalTemporalDmg *= IceDmgMult;
-					break;
-				case EDmgType::Poison:
-					TotalTemporalDmg *= PoisonDmgMult;
-					break;
-				}
-
-				TemporalDamage.TotalTemporalDamage = TotalTemporalDmg * DebuffFalloffMult;
-
-				if (TemporalDamage.TotalTemporalDamage > 0)
-				{
-					TemporalDamage.TemporalDamageTarget = Overlapper;
-					TemporalDamage.RemainingTemporalDamage = TemporalDamage.TotalTemporalDamage;
-
-					if (DmgInstigator.IsValid())
-					{
-						TemporalDamage.TemporalDamageInstigator = DmgInstigator;
-					}
-					else
-					{
-						TemporalDamage.TemporalDamageInstigator = FSubjectHandle();
-					}
-
-					TemporalDamage.TemporalDmgSegment = Debuff.TemporalDmgParams.TemporalDmgSegment;
-					TemporalDamage.TemporalDmgInterval = Debuff.TemporalDmgParams.TemporalDmgInterval;
-					TemporalDamage.DmgType = Damage.DmgType;
-
-					Mechanism->SpawnSubjectDeferred(TemporalDamage);
-				}
-			}
-		}
-
-		//--------------Debuff--------------
-
-		if (Debuff.LaunchParams.bCanLaunch)
-		{
-			if (bHasMoving)
-			{
-				auto Moving = Overlapper.GetTrait<FMoving>();
-
-				FVector KnockbackForce = FVector(Debuff.LaunchParams.LaunchSpeed.X, Debuff.LaunchParams.LaunchSpeed.X, 1) * HitDirection + FVector(0, 0, Debuff.LaunchParams.LaunchSpeed.Y);
-				Moving.LaunchVelSum += KnockbackForce * DebuffFalloffMult; // 累加击退力
-
-				Overlapper.SetTraitDeferred(Moving);
-			}
-		}
-
-		// 减速
-		if (Debuff.SlowParams.bCanSlow && bHasSlowing)
-		{
-			// Record for spawning of Slow
-			FSlow Slow;
-
-			Slow.SlowTarget = Overlapper;
-			Slow.SlowStrength = Debuff.SlowParams.SlowStrength * DebuffFalloffMult;
-			Slow.SlowTimeout = Debuff.SlowParams.SlowTime;
-			Slow.DmgType = Damage.DmgType;
-
-			Mechanism->SpawnSubjectDeferred(Slow);
-		}
-
-		//-----------其它效果------------
-
-		if (bHasSleeping)// wake on hit
-		{
-			if (bHasSleep)
-			{
-				auto Sleep = Overlapper.GetTrait<FSleep>();
-
-				if (Sleep.bWakeOnHit)
-				{
-					Sleep.bEnable = false;
-					Overlapper.SetTraitDeferred(Sleep);
-					Overlapper.RemoveTraitDeferred<FSleeping>();
-				}
-			}
-		}
-
-		if (bHasHit)
-		{
-			const auto Hit = Overlapper.GetTrait<FHit>();
-
-			// Actor
-			for (const FActorSpawnConfig& Config : Hit.SpawnActor)
-			{
-				FActorSpawnConfig_Final NewConfig(Config);
-				NewConfig.OwnerSubject = FSubjectHandle(Overlapper);
-				NewConfig.AttachToSubject = FSubjectHandle(Overlapper);
-				const FTransform WorldTransform(HitDirection.ToOrientationQuat(), Location);
-				NewConfig.SpawnTransform = ABattleFrameBattleControl::LocalOffsetToWorld(Direction.ToOrientationQuat(), WorldTransform.GetLocation(), NewConfig.Transform);
-				NewConfig.InitialRelativeTransform = NewConfig.SpawnTransform.GetRelativeTransform(WorldTransform);
-
-				Mechanism->SpawnSubjectDeferred(NewConfig);
-			}
-
-			// Fx
-			for (const FFxConfig& Config : Hit.SpawnFx)
-			{
-				FFxConfig_Final NewConfig(Config);
-				NewConfig.OwnerSubject = FSubjectHandle(Overlapper);
-				NewConfig.AttachToSubject = FSubjectHandle(Overlapper);
-				const FTransform WorldTransform(HitDirection.ToOrientationQuat(), Location);
-				NewConfig.SpawnTransform = ABattleFrameBattleControl::LocalOffsetToWorld(Direction.ToOrientationQuat(), WorldTransform.GetLocation(), NewConfig.Transform);
-				NewConfig.InitialRelativeTransform = NewConfig.SpawnTransform.GetRelativeTransform(WorldTransform);
-
-				Mechanism->SpawnSubjectDeferred(NewConfig);
-			}
-
-			// Sound
-			for (const FSoundConfig& Config : Hit.PlaySound)
-			{
-				FSoundConfig_Final NewConfig(Config);
-				NewConfig.OwnerSubject = FSubjectHandle(Overlapper);
-				NewConfig.AttachToSubject = FSubjectHandle(Overlapper);
-				const FTransform WorldTransform(HitDirection.ToOrientationQuat(), Location);
-				NewConfig.SpawnTransform = ABattleFrameBattleControl::LocalOffsetToWorld(Direction.ToOrientationQuat(), WorldTransform.GetLocation(), NewConfig.Transform);
-				NewConfig.InitialRelativeTransform = NewConfig.SpawnTransform.GetRelativeTransform(WorldTransform);
-
-				Mechanism->SpawnSubjectDeferred(NewConfig);
-			}
-
-			// Glow
-			if (Hit.bCanGlow && !bHasHitGlow)
-			{
-				Overlapper.SetFlag(HitGlowFlag);
-
-				if (bHasBeingHit)
-				{
-					NewBeingHit.ResetGlow();
-				}
-			}
-
-			// Jiggle
-			if (Hit.JiggleStr != 0 && !bHasHitJiggle)
-			{
-				Overlapper.SetFlag(HitJiggleFlag);
-
-				if (bHasBeingHit)
-				{
-					NewBeingHit.ResetJiggle();
-				}
-			}
-
-			// Anim
-			if (Hit.bPlayAnim && !bHasHitAnim)
-			{
-				Overlapper.SetFlag(HitAnimFlag);
-
-				if (bHasBeingHit)
-				{
-					NewBeingHit.ResetAnim();
-				}
-			}
-		}
-
-		Overlapper.SetTraitDeferred(NewBeingHit);
-
-		if (bHasIsSubjective)
-		{
-			FHitData HitData;
-			HitData.SelfSubject = DmgResult.DamagedSubject;
-			HitData.InstigatorSubject = DmgResult.InstigatorSubject;
-			HitData.CauserSubject = DmgResult.CauserSubject;
-			HitData.IsCritical = DmgResult.IsCritical;
-			HitData.IsKill = DmgResult.IsKill;
-			HitData.DmgDealt = DmgResult.DmgDealt;
-			OnHitQueue.Enqueue(HitData);
-		}
-
-		DamageResults.Add(DmgResult);
-	}
-}
-
-void ABattleFrameBattleControl::ApplyBeamDamageAndDebuff(UNeighborGridComponent* NeighborGridComponent, const int32 KeepCount, const FVector& StartLocation, const FVector& EndLocation, const FSubjectArray& IgnoreSubjects, const FSubjectHandle DmgInstigator, const FSubjectHandle DmgCauser, const FVector& HitFromLocation, const FDamage_Beam& Damage, const FDebuff_Beam& Debuff, TArray<FDmgResult>& DamageResults)
-{
-	//TRACE_CPUPROFILER_EVENT_SCOPE_STR("ApplyRadialDamageAndDebuff");
-	// sphere trace at Origin
-	if (!IsValid(NeighborGridComponent))
-	{
-		if (UWorld* World = GetWorld())
-		{
-			for (TActorIterator<ANeighborGridActor> It(World); It; ++It)
-			{
-				ANeighborGridActor* NeighborGridActor = *It;
-				NeighborGridComponent = NeighborGridActor->GetComponentByClass<UNeighborGridComponent>();
-				break;
-			}
-		}
-
-		if (!IsValid(NeighborGridComponent)) return;
-	}
-
-	bool bHit;
-	TArray<FTraceResult> TraceResults;
-
-	UBattleFrameFunctionLibraryRT::SphereSweepForSubjects
-	(
-		bHit,
-		TraceResults,
-		NeighborGridComponent,
-		KeepCount,
-		StartLocation,
-		EndLocation,
-		Damage.DmgRadius,
-		!Damage.Filter.ObstacleObjectType.IsEmpty(),
-		StartLocation,
-		0.01,
-		ESortMode::None,
-		StartLocation,
-		IgnoreSubjects,
-		Damage.Filter,
-		FTraceDrawDebugConfig()
-	);
-
-	if (!bHit) return;
-
-	for (const auto& TraceResult : TraceResults)
-	{
-		//TRACE_CPUPROFILER_EVENT_SCOPE_STR("ForEachOverlapper");
-		const auto& Overlapper = TraceResult.Subject;
-
-		if (!Overlapper.IsValid()) continue;
-
-		// Pre-calculate all trait checks
-		const bool bHasHealth = Overlapper.HasTrait<FHealth>();
-		const bool bHasLocated = Overlapper.HasTrait<FLocated>();
-		const bool bHasDirected = Overlapper.HasTrait<FDirected>();
-		const bool bHasScaled = Overlapper.HasTrait<FScaled>();
-		const bool bHasCollider = Overlapper.HasTrait<FCollider>();
-		const bool bHasGridData = Overlapper.HasTrait<FGridData>();
-		const bool bHasDefence = Overlapper.HasTrait<FDefence>();
-		const bool bHasTextPopUp = Overlapper.HasTrait<FTextPopUp>();
-		const bool bHasMoving = Overlapper.HasTrait<FMoving>();
-		const bool bHasSlowing = Overlapper.HasTrait<FSlowing>();
-		const bool bHasAnimation = Overlapper.HasTrait<FAnimation>();
-		const bool bHasSleep = Overlapper.HasTrait<FSleep>();
-		const bool bHasSleeping = Overlapper.HasTrait<FSleeping>();
-		const bool bHasHit = Overlapper.HasTrait<FHit>();
-		const bool bHasBeingHit = Overlapper.HasTrait<FBeingHit>();
-		const bool bHasHitGlow = Overlapper.HasFlag(HitGlowFlag);
-		const bool bHasHitJiggle = Overlapper.HasFlag(HitJiggleFlag);
-		const bool bHasHitAnim = Overlapper.HasFlag(HitAnimFlag);
-		const bool bHasPatrolling = Overlapper.HasTrait<FPatrolling>();
-		const bool bHasTrace = Overlapper.HasTrait<FTrace>();
-		const bool bHasIsSubjective = Overlapper.HasTrait<FIsSubjective>();
-
-		FVector Location = bHasLocated ? Overlapper.GetTrait<FLocated>().Location : FVector::ZeroVector;
-		FVector Direction = bHasDirected ? Overlapper.GetTrait<FDirected>().Direction : FVector::ZeroVector;
-
-		FDmgResult DmgResult;
-		DmgResult.DamagedSubject = Overlapper;
-
-		FBeingHit NewBeingHit = !bHasBeingHit ? FBeingHit() : Overlapper.GetTrait<FBeingHit>();
-
-		// 击退
-		FVector HitDirection = FVector::OneVector;
-		if (bHasLocated) HitDirection = (Location - HitFromLocation).GetSafeNormal2D();
-
-		// 距离衰减
-		float Distance = FMath::PointDistToLine(StartLocation, EndLocation, Location);
-		TRange<float> InputRange(0, Damage.DmgRadius);
-		TRange<float> OutputRange(1, 0);
-		float DmgFalloffMult = Damage.bUseFalloff ? FMath::GetMappedRangeValueClamped(InputRange, OutputRange, Distance) : 1;
-		float DebuffFalloffMult = Debuff.bUseFalloff ? FMath::GetMappedRangeValueClamped(InputRange, OutputRange, Distance) : 1;
-
-		//-------------伤害和抗性------------
-
-		float NormalDmgMult = 1;
-		float FireDmgMult = 1;
-		float IceDmgMult = 1;
-		float PoisonDmgMult = 1;
-		float PercentDmgMult = 1;
-
-		if (bHasHealth)
-		{
-			auto& Health = Overlapper.GetTraitRef<FHealth,EParadigm::Unsafe>();
-
-			// 抗性 如果有的话
-			if (bHasDefence)
-			{
-				const auto Defence = Overlapper.GetTrait<FDefence>();
-
-				NormalDmgMult = 1 - Defence.NormalDmgImmune;
-				FireDmgMult = 1 - Defence.FireDmgImmune;
-				IceDmgMult = 1 - Defence.IceDmgImmune;
-				PoisonDmgMult = 1 - Defence.PoisonDmgImmune;
-				PercentDmgMult = 1.f - Defence.PercentDmgImmune;
-			}
-
-			// 基础伤害
-			float BaseDamage = 0;
-
-			switch (Damage.DmgType)
-			{
-				case EDmgType::Normal:
-					BaseDamage = Damage.Damage * NormalDmgMult;
-					break;
-				case EDmgType::Fire:
-					BaseDamage = Damage.Damage * FireDmgMult;
-					break;
-				case EDmgType::Ice:
-					BaseDamage = Damage.Damage * IceDmgMult;
-					break;
-				case EDmgType::Poison:
-					BaseDamage = Damage.Damage * PoisonDmgMult;
-					break;
-			}
-
-			// 百分比伤害
-			float PercentageDamage = Health.Maximum * Damage.PercentDmg * PercentDmgMult;
-
-			// 总伤害
-			float CombinedDamage = (BaseDamage + PercentageDamage) * DmgFalloffMult;
-
-			// 考虑暴击后伤害
-			auto [bIsCrit, PostCritDamage] = ProcessCritDamage(CombinedDamage, Damage.CritDmgMult, Damage.CritProbability);
-
-			// 限制伤害以不大于剩余血量
-			float ClampedDamage = FMath::Min(PostCritDamage, Health.Current);
-
-			DmgResult.IsCritical = bIsCrit;
-			DmgResult.DmgDealt = ClampedDamage;
-
-			// 应用伤害
-			Health.DamageToTake.Enqueue(ClampedDamage);
-			Health.HitDirection.Enqueue(HitDirection);
-
-			// 记录伤害施加者
-			Health.DamageInstigator.Enqueue(DmgInstigator);
-			DmgResult.InstigatorSubject = DmgInstigator;
-			DmgResult.CauserSubject = DmgCauser;
-
-			// ------------生成文字--------------
-
-			if (bHasTextPopUp && bHasLocated)
-			{
-				const auto TextPopUp = Overlapper.GetTrait<FTextPopUp>();
-
-				if (TextPopUp.Enable)
-				{
-					float Style = 0;
-
-					if (!bIsCrit)
-					{
-						if (PostCritDamage < TextPopUp.WhiteTextBelowPercent)
-						{
-							Style = 0;
-						}
-						else if (PostCritDamage < TextPopUp.OrangeTextAbovePercent)
-						{
-							Style = 1;
-						}
-						else
-						{
-							Style = 2;
-						}
-					}
-					else
-					{
-						Style = 3;
-					}
-
-					float Radius = bHasGridData ? Overlapper.GetTrait<FGridData>().Radius : 0;
-					QueueText(FTextPopConfig(Overlapper, PostCritDamage, Style, TextPopUp.TextScale, Radius * 1.1, Location));
-				}
-			}
-
-			//--------------Debuff--------------
-			// 持续伤害
-			if (Debuff.TemporalDmgParams.bDealTemporalDmg)
-			{
-				// Record for spawning of TemporalDamage
-				FTemporalDamage TemporalDamage;
-
-				float TotalTemporalDmg = Debuff.TemporalDmgParams.TemporalDmg;
-
-				switch (Damage.DmgType)
-				{
-				case EDmgType::Normal:
-					TotalTemporalDmg *= NormalDmgMult;
-					break;
-				case EDmgType::Fire:
-					TotalTemporalDmg *= FireDmgMult;
-					break;
-				case EDmgType::Ice:
-					TotalTemporalDmg *= IceDmgMult;
-					break;
-				case EDmgType::Poison:
-					TotalTemporalDmg *= PoisonDmgMult;
-					break;
-				}
-
-				TemporalDamage.TotalTemporalDamage = TotalTemporalDmg * DebuffFalloffMult;
-
-				if (TemporalDamage.TotalTemporalDamage > 0)
-				{
-					TemporalDamage.TemporalDamageTarget = Overlapper;
-					TemporalDamage.RemainingTemporalDamage = TemporalDamage.TotalTemporalDamage;
-
-					if (DmgInstigator.IsValid())
-					{
-						TemporalDamage.TemporalDamageInstigator = DmgInstigator;
-					}
-					else
-					{
-						TemporalDamage.TemporalDamageInstigator = FSubjectHandle();
-					}
-
-					TemporalDamage.TemporalDmgSegment = Debuff.TemporalDmgParams.TemporalDmgSegment;
-					TemporalDamage.TemporalDmgInterval = Debuff.TemporalDmgParams.TemporalDmgInterval;
-					TemporalDamage.DmgType = Damage.DmgType;
-
-					Mechanism->SpawnSubject(TemporalDamage);
-				}
-			}
-		}
-
-		//--------------Debuff--------------
-
-		if (Debuff.LaunchParams.bCanLaunch)
+		// 距离衰减，球形伤害的起点与终点相同
+		if (Damage.bUseFalloff || Debuff.bUseFalloff)
 		{
-			if (bHasMoving)
-			{
-				auto Moving = Overlapper.GetTrait<FMoving>();
-
-				FVector KnockbackForce = FVector(Debuff.LaunchParams.LaunchSpeed.X, Debuff.LaunchParams.LaunchSpeed.X, 1) * HitDirection + FVector(0, 0, Debuff.LaunchParams.LaunchSpeed.Y);
-				Moving.LaunchVelSum += KnockbackForce * DebuffFalloffMult; // 累加击退力
-
-				Overlapper.SetTrait(Moving);
-			}
-		}
+			const FVector Location = Overlapper.HasTrait<FLocated>() ? Overlapper.GetTrait<FLocated>().Location : FVector::ZeroVector;
+			const float Distance = FMath::PointDistToSegment(Location, Request.StartLocation, Request.EndLocation);
 
-		// 减速
-		if (Debuff.SlowParams.bCanSlow && bHasSlowing)
-		{
-			// Record for spawning of Slow
-			FSlow Slow;
-
-			Slow.SlowTarget = Overlapper;
-			Slow.SlowStrength = Debuff.SlowParams.SlowStrength * DebuffFalloffMult;
-			Slow.SlowTimeout = Debuff.SlowParams.SlowTime;
-			Slow.DmgType = Damage.DmgType;
-			Mechanism->SpawnSubject(Slow);
+			Hit.DmgFalloffMult = Damage.bUseFalloff ? FMath::GetMappedRangeValueClamped(InputRange, OutputRange, Distance) : 1;
+			Hit.DebuffFalloffMult = Debuff.bUseFalloff ? FMath::GetMappedRangeValueClamped(InputRange, OutputRange, Distance) : 1;
 		}
 
-		//-----------其它效果------------
+		OutHits.Add(Hit);
+	}
+}
 
-		if (bHasSleeping)// wake on hit
-		{
-			if (bHasSleep)
-			{
-				auto Sleep = Overlapper.GetTrait<FSleep>();
+void ABattleFrameBattleControl::ApplyDamageBatch(const TArray<FDmgRequest>& Requests, TArray<TArray<FDmgResult>>& OutResults, const bool bDeferred, const bool bSingleThread)
+{
+	//TRACE_CPUPROFILER_EVENT_SCOPE_STR("ApplyDamageBatch");
+	OutResults.SetNum(Requests.Num());
 
-				if (Sleep.bWakeOnHit)
-				{
-					Sleep.bEnable = false;
-					Overlapper.SetTrait(Sleep);
-					Overlapper.RemoveTrait<FSleeping>();
-				}
-			}
-		}
+	if (Requests.IsEmpty()) return;
 
-		if (bHasHit)
-		{
-			const auto Hit = Overlapper.GetTrait<FHit>();
+	//-------------解析目标------------
 
-			// Actor
-			for (const FActorSpawnConfig& Config : Hit.SpawnActor)
-			{
-				FActorSpawnConfig_Final NewConfig(Config);
-				NewConfig.OwnerSubject = FSubjectHandle(Overlapper);
-				NewConfig.AttachToSubject = FSubjectHandle(Overlapper);
-				const FTransform WorldTransform(HitDirection.ToOrientationQuat(), Location);
-				NewConfig.SpawnTransform = ABattleFrameBattleControl::LocalOffsetToWorld(Direction.ToOrientationQuat(), WorldTransform.GetLocation(), NewConfig.Transform);
-				NewConfig.InitialRelativeTransform = NewConfig.SpawnTransform.GetRelativeTransform(WorldTransform);
+	// 所有请求的空间查询在一次并行中完成 | Resolve every request's target set in one parallel pass
+	TArray<TArray<FDmgHit>> RequestHits;
+	RequestHits.SetNum(Requests.Num());
 
-				Mechanism->SpawnSubject(NewConfig);
-			}
+	ParallelFor(Requests.Num(), [&](int32 RequestIndex)
+	{
+		ResolveDamageTargets(Requests[RequestIndex], RequestIndex, RequestHits[RequestIndex], bDeferred);
 
-			// Fx
-			for (const FFxConfig& Config : Hit.SpawnFx)
-			{
-				FFxConfig_Final NewConfig(Config);
-				NewConfig.OwnerSubject = FSubjectHandle(Overlapper);
-				NewConfig.AttachToSubject = FSubjectHandle(Overlapper);
-				const FTransform WorldTransform(HitDirection.ToOrientationQuat(), Location);
-				NewConfig.SpawnTransform = ABattleFrameBattleControl::LocalOffsetToWorld(Direction.ToOrientationQuat(), WorldTransform.GetLocation(), NewConfig.Transform);
-				NewConfig.InitialRelativeTransform = NewConfig.SpawnTransform.GetRelativeTransform(WorldTransform);
+	}, bSingleThread || !bDeferred || Requests.Num() == 1);
 
-				Mechanism->SpawnSubject(NewConfig);
-			}
+	//-------------按目标聚合------------
 
-			// Sound
-			for (const FSoundConfig& Config : Hit.PlaySound)
-			{
-				FSoundConfig_Final NewConfig(Config);
-				NewConfig.OwnerSubject = FSubjectHandle(Overlapper);
-				NewConfig.AttachToSubject = FSubjectHandle(Overlapper);
-				const FTransform WorldTransform(HitDirection.ToOrientationQuat(), Location);
-				NewConfig.SpawnTransform = ABattleFrameBattleControl::LocalOffsetToWorld(Direction.ToOrientationQuat(), WorldTransform.GetLocation(), NewConfig.Transform);
-				NewConfig.InitialRelativeTransform = NewConfig.SpawnTransform.GetRelativeTransform(WorldTransform);
+	// 同一目标的所有命中归为一组，每组只由一个线程处理 | Group hits per target so each target is handled by exactly one worker
+	TArray<FDmgTargetGroup> Groups;
+	TMap<FSubjectHandle, int32> GroupIndices;
 
-				Mechanism->SpawnSubject(NewConfig);
-			}
+	for (int32 RequestIndex = 0; RequestIndex < Requests.Num(); ++RequestIndex)
+	{
+		TArray<FDmgHit>& Hits = RequestHits[RequestIndex];
+		OutResults[RequestIndex].SetNum(Hits.Num());
 
-			// Glow
-			if (Hit.bCanGlow && !bHasHitGlow)
-			{
-				Overlapper.SetFlag(HitGlowFlag);
+		for (int32 HitIndex = 0; HitIndex < Hits.Num(); ++HitIndex)
+		{
+			FDmgHit& Hit = Hits[HitIndex];
+			Hit.ResultIndex = HitIndex;
 
-				if (bHasBeingHit)
-				{
-					NewBeingHit.ResetGlow();
-				}
-			}
+			const int32* GroupIndex = GroupIndices.Find(Hit.Target);
 
-			// Jiggle
-			if (Hit.JiggleStr != 0 && !bHasHitJiggle)
+			if (GroupIndex)
 			{
-				Overlapper.SetFlag(HitJiggleFlag);
-
-				if (bHasBeingHit)
-				{
-					NewBeingHit.ResetJiggle();
-				}
+				Groups[*GroupIndex].Hits.Add(Hit);
 			}
-
-			// Anim
-			if (Hit.bPlayAnim && !bHasHitAnim)
+			else
 			{
-				Overlapper.SetFlag(HitAnimFlag);
-
-				if (bHasBeingHit)
-				{
-					NewBeingHit.ResetAnim();
-				}
+				GroupIndices.Add(Hit.Target, Groups.Num());
+				Groups.AddDefaulted_GetRef().Hits.Add(Hit);
 			}
 		}
-
-		Overlapper.SetTrait(NewBeingHit);
-
-		if (bHasIsSubjective)
-		{
-			FHitData HitData;
-			HitData.SelfSubject = DmgResult.DamagedSubject;
-			HitData.InstigatorSubject = DmgResult.InstigatorSubject;
-			HitData.CauserSubject = DmgResult.CauserSubject;
-			HitData.IsCritical = DmgResult.IsCritical;
-			HitData.IsKill = DmgResult.IsKill;
-			HitData.DmgDealt = DmgResult.DmgDealt;
-			OnHitQueue.Enqueue(HitData);
-		}
-
-		DamageResults.Add(DmgResult);
 	}
-}
-
-void ABattleFrameBattleControl::ApplyBeamDamageAndDebuffDeferred(UNeighborGridComponent* NeighborGridComponent, const int32 KeepCount, const FVector& StartLocation, const FVector& EndLocation, const FSubjectArray& IgnoreSubjects, const FSubjectHandle DmgInstigator, const FSubjectHandle DmgCauser, const FVector& HitFromLocation, const FDamage_Beam& Damage, const FDebuff_Beam& Debuff, TArray<FDmgResult>& DamageResults)
-{
-	//TRACE_CPUPROFILER_EVENT_SCOPE_STR("ApplyRadialDamageAndDebuff");
-	// sphere trace at Origin
-
-	if (!IsValid(NeighborGridComponent)) return;
-
-	bool bHit;
-	TArray<FTraceResult> TraceResults;
-
-	UBattleFrameFunctionLibraryRT::SphereSweepForSubjects
-	(
-		bHit,
-		TraceResults,
-		NeighborGridComponent,
-		KeepCount,
-		StartLocation,
-		EndLocation,
-		Damage.DmgRadius,
-		!Damage.Filter.ObstacleObjectType.IsEmpty(),
-		StartLocation,
-		0.01,
-		ESortMode::None,
-		StartLocation,
-		IgnoreSubjects,
-		Damage.Filter,
-		FTraceDrawDebugConfig()
-	);
 
-	if (!bHit) return;
+	//-------------应用伤害和减益------------
 
-	for (const auto& TraceResult : TraceResults)
+	ParallelFor(Groups.Num(), [&](int32 GroupIndex)
 	{
 		//TRACE_CPUPROFILER_EVENT_SCOPE_STR("ForEachOverlapper");
-		const auto& Overlapper = TraceResult.Subject;
+		const auto& Hits = Groups[GroupIndex].Hits;
+		const FSubjectHandle Overlapper = Hits[0].Target;
 
-		if (!Overlapper.IsValid()) continue;
+		if (!Overlapper.IsValid()) return;
 
 		// Pre-calculate all trait checks
 		const bool bHasHealth = Overlapper.HasTrait<FHealth>();
 		const bool bHasLocated = Overlapper.HasTrait<FLocated>();
 		const bool bHasDirected = Overlapper.HasTrait<FDirected>();
-		const bool bHasScaled = Overlapper.HasTrait<FScaled>();
-		const bool bHasCollider = Overlapper.HasTrait<FCollider>();
 		const bool bHasGridData = Overlapper.HasTrait<FGridData>();
 		const bool bHasDefence = Overlapper.HasTrait<FDefence>();
 		const bool bHasTextPopUp = Overlapper.HasTrait<FTextPopUp>();
 		const bool bHasMoving = Overlapper.HasTrait<FMoving>();
 		const bool bHasSlowing = Overlapper.HasTrait<FSlowing>();
-		const bool bHasAnimation = Overlapper.HasTrait<FAnimation>();
 		const bool bHasSleep = Overlapper.HasTrait<FSleep>();
 		const bool bHasSleeping = Overlapper.HasTrait<FSleeping>();
 		const bool bHasHit = Overlapper.HasTrait<FHit>();
@@ -6975,31 +5715,14 @@ void ABattleFrameBattleControl::ApplyBeamDamageAndDebuffDeferred(UNeighborGridCo
 		const bool bHasHitGlow = Overlapper.HasFlag(HitGlowFlag);
 		const bool bHasHitJiggle = Overlapper.HasFlag(HitJiggleFlag);
 		const bool bHasHitAnim = Overlapper.HasFlag(HitAnimFlag);
-		const bool bHasPatrolling = Overlapper.HasTrait<FPatrolling>();
-		const bool bHasTrace = Overlapper.HasTrait<FTrace>();
 		const bool bHasIsSubjective = Overlapper.HasTrait<FIsSubjective>();
 
-		FVector Location = bHasLocated ? Overlapper.GetTrait<FLocated>().Location : FVector::ZeroVector;
-		FVector Direction = bHasDirected ? Overlapper.GetTrait<FDirected>().Direction : FVector::ZeroVector;
-
-		FDmgResult DmgResult;
-		DmgResult.DamagedSubject = Overlapper;
+		const FVector Location = bHasLocated ? Overlapper.GetTrait<FLocated>().Location : FVector::ZeroVector;
+		const FVector Direction = bHasDirected ? Overlapper.GetTrait<FDirected>().Direction : FVector::ZeroVector;
 
 		FBeingHit NewBeingHit = !bHasBeingHit ? FBeingHit() : Overlapper.GetTrait<FBeingHit>();
 
-		// 击退
-		FVector HitDirection = FVector::OneVector;
-		if (bHasLocated) HitDirection = (Location - HitFromLocation).GetSafeNormal2D();
-
-		// 距离衰减
-		float Distance = FMath::PointDistToLine(StartLocation, EndLocation, Location);
-		TRange<float> InputRange(0, Damage.DmgRadius);
-		TRange<float> OutputRange(1, 0);
-		float DmgFalloffMult = Damage.bUseFalloff ? FMath::GetMappedRangeValueClamped(InputRange, OutputRange, Distance) : 1;
-		float DebuffFalloffMult = Debuff.bUseFalloff ? FMath::GetMappedRangeValueClamped(InputRange, OutputRange, Distance) : 1;
-
-
-		//-------------伤害和抗性------------
+		//-------------抗性------------
 
 		float NormalDmgMult = 1;
 		float FireDmgMult = 1;
@@ -7007,236 +5730,291 @@ void ABattleFrameBattleControl::ApplyBeamDamageAndDebuffDeferred(UNeighborGridCo
 		float PoisonDmgMult = 1;
 		float PercentDmgMult = 1;
 
-		if (bHasHealth)
+		if (bHasDefence)
 		{
-			auto& Health = Overlapper.GetTraitRef<FHealth, EParadigm::Unsafe>();
+			const auto& Defence = Overlapper.GetTrait<FDefence>();
 
-			// 抗性 如果有的话
-			if (bHasDefence)
-			{
-				const auto Defence = Overlapper.GetTrait<FDefence>();
+			NormalDmgMult = 1 - Defence.NormalDmgImmune;
+			FireDmgMult = 1 - Defence.FireDmgImmune;
+			IceDmgMult = 1 - Defence.IceDmgImmune;
+			PoisonDmgMult = 1 - Defence.PoisonDmgImmune;
+			PercentDmgMult = 1.f - Defence.PercentDmgImmune;
+		}
 
-				NormalDmgMult = 1 - Defence.NormalDmgImmune;
-				FireDmgMult = 1 - Defence.FireDmgImmune;
-				IceDmgMult = 1 - Defence.IceDmgImmune;
-				PoisonDmgMult = 1 - Defence.PoisonDmgImmune;
-				PercentDmgMult = 1.f - Defence.PercentDmgImmune;
+		auto GetDmgTypeMult = [&](const EDmgType DmgType)
+		{
+			switch (DmgType)
+			{
+				case EDmgType::Fire:
+					return FireDmgMult;
+				case EDmgType::Ice:
+					return IceDmgMult;
+				case EDmgType::Poison:
+					return PoisonDmgMult;
+				default:
+					return NormalDmgMult;
 			}
+		};
+
+		// 同一帧内的多次命中按剩余血量依次限制
+		float HealthLeft = bHasHealth ? Overlapper.GetTraitRef<FHealth, EParadigm::Unsafe>().Current : 0;
+
+		FVector LaunchVelSum = FVector::ZeroVector;
+		FVector FirstHitDirection = FVector::ZeroVector;
+
+		for (int32 HitIndex = 0; HitIndex < Hits.Num(); ++HitIndex)
+		{
+			const FDmgHit& Hit = Hits[HitIndex];
+			const FDmgRequest& Request = Requests[Hit.RequestIndex];
+			const FDamage_Beam& Damage = Request.Damage;
+			const FDebuff_Beam& Debuff = Request.Debuff;
 
-			// 基础伤害
-			float BaseDamage = 0;
+			FDmgResult& DmgResult = OutResults[Hit.RequestIndex][Hit.ResultIndex];
+			DmgResult.DamagedSubject = Overlapper;
+			DmgResult.InstigatorSubject = Request.DmgInstigator;
+			DmgResult.CauserSubject = Request.DmgCauser;
 
-			switch (Damage.DmgType)
+			// 击退方向
+			const FVector HitDirection = bHasLocated ? (Location - Request.HitFromLocation).GetSafeNormal2D() : FVector::ZeroVector;
+
+			if (HitIndex == 0) FirstHitDirection = HitDirection;
+
+			const float DmgTypeMult = GetDmgTypeMult(Damage.DmgType);
+
+			//-------------伤害------------
+
+			if (bHasHealth)
 			{
-			case EDmgType::Normal:
-				BaseDamage = Damage.Damage * NormalDmgMult;
-				break;
-			case EDmgType::Fire:
-				BaseDamage = Damage.Damage * FireDmgMult;
-				break;
-			case EDmgType::Ice:
-				BaseDamage = Damage.Damage * IceDmgMult;
-				break;
-			case EDmgType::Poison:
-				BaseDamage = Damage.Damage * PoisonDmgMult;
-				break;
-			}
+				auto& Health = Overlapper.GetTraitRef<FHealth, EParadigm::Unsafe>();
 
-			// 百分比伤害
-			float PercentageDamage = Health.Maximum * Damage.PercentDmg * PercentDmgMult;
+				// 基础伤害
+				float BaseDamage = Damage.Damage * DmgTypeMult;
 
-			// 总伤害
-			float CombinedDamage = (BaseDamage + PercentageDamage) * DmgFalloffMult;
+				// 百分比伤害
+				float PercentageDamage = Health.Maximum * Damage.PercentDmg * PercentDmgMult;
 
-			// 考虑暴击后伤害
-			auto [bIsCrit, PostCritDamage] = ProcessCritDamage(CombinedDamage, Damage.CritDmgMult, Damage.CritProbability);
+				// 总伤害
+				float CombinedDamage = (BaseDamage + PercentageDamage) * Hit.DmgFalloffMult;
 
-			// 限制伤害以不大于剩余血量
-			float ClampedDamage = FMath::Min(PostCritDamage, Health.Current);
+				// 考虑暴击后伤害
+				auto [bIsCrit, PostCritDamage] = ProcessCritDamage(CombinedDamage, Damage.CritDmgMult, Damage.CritProbability);
 
-			DmgResult.IsCritical = bIsCrit;
-			DmgResult.DmgDealt = ClampedDamage;
+				// 限制伤害以不大于剩余血量
+				float ClampedDamage = FMath::Min(PostCritDamage, HealthLeft);
+				HealthLeft -= FMath::Max(ClampedDamage, 0.f);
 
-			// 应用伤害
-			Health.DamageToTake.Enqueue(ClampedDamage);
-			Health.HitDirection.Enqueue(HitDirection);
+				DmgResult.IsCritical = bIsCrit;
+				DmgResult.DmgDealt = ClampedDamage;
 
-			// 记录伤害施加者
-			Health.DamageInstigator.Enqueue(DmgInstigator);
-			DmgResult.InstigatorSubject = DmgInstigator;
-			DmgResult.CauserSubject = DmgCauser;
+				// 应用伤害
+				Health.DamageToTake.Enqueue(ClampedDamage);
+				Health.HitDirection.Enqueue(HitDirection);
 
-			// ------------生成文字--------------
+				// 记录伤害施加者
+				Health.DamageInstigator.Enqueue(Request.DmgInstigator);
 
-			if (bHasTextPopUp && bHasLocated)
-			{
-				const auto TextPopUp = Overlapper.GetTrait<FTextPopUp>();
+				// ------------生成文字--------------
 
-				if (TextPopUp.Enable)
+				if (bHasTextPopUp && bHasLocated)
 				{
-					float Style = 0;
+					const auto& TextPopUp = Overlapper.GetTrait<FTextPopUp>();
 
-					if (!bIsCrit)
+					if (TextPopUp.Enable)
 					{
-						if (PostCritDamage < TextPopUp.WhiteTextBelowPercent)
-						{
-							Style = 0;
-						}
-						else if (PostCritDamage < TextPopUp.OrangeTextAbovePercent)
+						float Style = 0;
+
+						if (!bIsCrit)
 						{
-							Style = 1;
+							if (PostCritDamage < TextPopUp.WhiteTextBelowPercent)
+							{
+								Style = 0;
+							}
+							else if (PostCritDamage < TextPopUp.OrangeTextAbovePercent)
+							{
+								Style = 1;
+							}
+							else
+							{
+								Style = 2;
+							}
 						}
 						else
 						{
-							Style = 2;
+							Style = 3;
 						}
+
+						float Radius = bHasGridData ? Overlapper.GetTrait<FGridData>().Radius : 0;
+						QueueText(FTextPopConfig(Overlapper, PostCritDamage, Style, TextPopUp.TextScale, Radius * 1.1, Location));
 					}
-					else
+				}
+
+				//--------------Debuff--------------
+
+				// 持续伤害
+				if (Debuff.TemporalDmgParams.bDealTemporalDmg)
+				{
+					// Record for spawning of TemporalDamage
+					FTemporalDamage TemporalDamage;
+
+					TemporalDamage.TotalTemporalDamage = Debuff.TemporalDmgParams.TemporalDmg * DmgTypeMult * Hit.DebuffFalloffMult;
+
+					if (TemporalDamage.TotalTemporalDamage > 0)
 					{
-						Style = 3;
-					}
+						TemporalDamage.TemporalDamageTarget = Overlapper;
+						TemporalDamage.RemainingTemporalDamage = TemporalDamage.TotalTemporalDamage;
+						TemporalDamage.TemporalDamageInstigator = Request.DmgInstigator.IsValid() ? Request.DmgInstigator : FSubjectHandle();
+						TemporalDamage.TemporalDmgSegment = Debuff.TemporalDmgParams.TemporalDmgSegment;
+						TemporalDamage.TemporalDmgInterval = Debuff.TemporalDmgParams.TemporalDmgInterval;
+						TemporalDamage.DmgType = Damage.DmgType;
 
-					float Radius = bHasGridData ? Overlapper.GetTrait<FGridData>().Radius : 0;
-					QueueText(FTextPopConfig(Overlapper, PostCritDamage, Style, TextPopUp.TextScale, Radius * 1.1, Location));
+						if (bDeferred)
+						{
+							Mechanism->SpawnSubjectDeferred(TemporalDamage);
+						}
+						else
+						{
+							Mechanism->SpawnSubject(TemporalDamage);
+						}
+					}
 				}
 			}
 
 			//--------------Debuff--------------
-			// 持续伤害
-			if (Debuff.TemporalDmgParams.bDealTemporalDmg)
+
+			// 击退，同一帧的多次击退先累加
+			if (Debuff.LaunchParams.bCanLaunch && bHasMoving)
+			{
+				FVector KnockbackForce = FVector(Debuff.LaunchParams.LaunchSpeed.X, Debuff.LaunchParams.LaunchSpeed.X, 1) * HitDirection + FVector(0, 0, Debuff.LaunchParams.LaunchSpeed.Y);
+				LaunchVelSum += KnockbackForce * Hit.DebuffFalloffMult;
+			}
+
+			// 减速
+			if (Debuff.SlowParams.bCanSlow && bHasSlowing)
 			{
-				// Record for spawning of TemporalDamage
-				FTemporalDamage TemporalDamage;
+				// Record for spawning of Slow
+				FSlow Slow;
 
-				float TotalTemporalDmg = Debuff.TemporalDmgParams.TemporalDmg;
+				Slow.SlowTarget = Overlapper;
+				Slow.SlowStrength = Debuff.SlowParams.SlowStrength * Hit.DebuffFalloffMult;
+				Slow.SlowTimeout = Debuff.SlowParams.SlowTime;
+				Slow.DmgType = Damage.DmgType;
 
-				switch (Damage.DmgType)
+				if (bDeferred)
 				{
-				case EDmgType::Normal:
-					TotalTemporalDmg *= NormalDmgMult;
-					break;
-				case EDmgType::Fire:
-					TotalTemporalDmg *= FireDmgMult;
-					break;
-				case EDmgType::Ice:
-					TotalTemporalDmg *= IceDmgMult;
-					break;
-				case EDmgType::Poison:
-					TotalTemporalDmg *= PoisonDmgMult;
-					break;
+					Mechanism->SpawnSubjectDeferred(Slow);
 				}
-
-				TemporalDamage.TotalTemporalDamage = TotalTemporalDmg * DebuffFalloffMult;
-
-				if (TemporalDamage.TotalTemporalDamage > 0)
+				else
 				{
-					TemporalDamage.TemporalDamageTarget = Overlapper;
-					TemporalDamage.RemainingTemporalDamage = TemporalDamage.TotalTemporalDamage;
-
-					if (DmgInstigator.IsValid())
-					{
-						TemporalDamage.TemporalDamageInstigator = DmgInstigator;
-					}
-					else
-					{
-						TemporalDamage.TemporalDamageInstigator = FSubjectHandle();
-					}
-
-					TemporalDamage.TemporalDmgSegment = Debuff.TemporalDmgParams.TemporalDmgSegment;
-					TemporalDamage.TemporalDmgInterval = Debuff.TemporalDmgParams.TemporalDmgInterval;
-					TemporalDamage.DmgType = Damage.DmgType;
-
-					Mechanism->SpawnSubjectDeferred(TemporalDamage);
+					Mechanism->SpawnSubject(Slow);
 				}
 			}
-		}
-
-		//--------------Debuff--------------
 
-		if (Debuff.LaunchParams.bCanLaunch)
-		{
-			if (bHasMoving)
+			if (bHasIsSubjective)
 			{
-				auto Moving = Overlapper.GetTrait<FMoving>();
-
-				FVector KnockbackForce = FVector(Debuff.LaunchParams.LaunchSpeed.X, Debuff.LaunchParams.LaunchSpeed.X, 1) * HitDirection + FVector(0, 0, Debuff.LaunchParams.LaunchSpeed.Y);
-				Moving.LaunchVelSum += KnockbackForce * DebuffFalloffMult; // 累加击退力
-
-				Overlapper.SetTraitDeferred(Moving);
+				FHitData HitData;
+				HitData.SelfSubject = DmgResult.DamagedSubject;
+				HitData.InstigatorSubject = DmgResult.InstigatorSubject;
+				HitData.CauserSubject = DmgResult.CauserSubject;
+				HitData.IsCritical = DmgResult.IsCritical;
+				HitData.IsKill = DmgResult.IsKill;
+				HitData.DmgDealt = DmgResult.DmgDealt;
+				OnHitQueue.Enqueue(HitData);
 			}
 		}
 
-		// 减速
-		if (Debuff.SlowParams.bCanSlow && bHasSlowing)
+		//-----------每个目标只处理一次的效果------------
+
+		if (!LaunchVelSum.IsZero())
 		{
-			// Record for spawning of Slow
-			FSlow Slow;
-
-			Slow.SlowTarget = Overlapper;
-			Slow.SlowStrength = Debuff.SlowParams.SlowStrength * DebuffFalloffMult;
-			Slow.SlowTimeout = Debuff.SlowParams.SlowTime;
-			Slow.DmgType = Damage.DmgType;
-			Mechanism->SpawnSubjectDeferred(Slow);
-		}
+			auto& Moving = Overlapper.GetTraitRef<FMoving, EParadigm::Unsafe>();
 
-		//-----------其它效果------------
+			Moving.Lock();
+			Moving.LaunchVelSum += LaunchVelSum; // 累加击退力
+			Moving.Unlock();
+		}
 
 		if (bHasSleeping)// wake on hit
 		{
 			if (bHasSleep)
 			{
-				auto Sleep = Overlapper.GetTrait<FSleep>();
+				auto& Sleep = Overlapper.GetTraitRef<FSleep, EParadigm::Unsafe>();
 
 				if (Sleep.bWakeOnHit)
 				{
 					Sleep.bEnable = false;
-					Overlapper.SetTraitDeferred(Sleep);
-					Overlapper.RemoveTraitDeferred<FSleeping>();
+
+					if (bDeferred)
+					{
+						Overlapper.RemoveTraitDeferred<FSleeping>();
+					}
+					else
+					{
+						Overlapper.RemoveTrait<FSleeping>();
+					}
 				}
 			}
 		}
 
 		if (bHasHit)
 		{
-			const auto Hit = Overlapper.GetTrait<FHit>();
+			const auto& Hit = Overlapper.GetTrait<FHit>();
+			const FTransform WorldTransform(FirstHitDirection.ToOrientationQuat(), Location);
 
 			// Actor
 			for (const FActorSpawnConfig& Config : Hit.SpawnActor)
 			{
 				FActorSpawnConfig_Final NewConfig(Config);
-				NewConfig.OwnerSubject = FSubjectHandle(Overlapper);
-				NewConfig.AttachToSubject = FSubjectHandle(Overlapper);
-				const FTransform WorldTransform(HitDirection.ToOrientationQuat(), Location);
+				NewConfig.OwnerSubject = Overlapper;
+				NewConfig.AttachToSubject = Overlapper;
 				NewConfig.SpawnTransform = ABattleFrameBattleControl::LocalOffsetToWorld(Direction.ToOrientationQuat(), WorldTransform.GetLocation(), NewConfig.Transform);
 				NewConfig.InitialRelativeTransform = NewConfig.SpawnTransform.GetRelativeTransform(WorldTransform);
 
-				Mechanism->SpawnSubjectDeferred(NewConfig);
+				if (bDeferred)
+				{
+					Mechanism->SpawnSubjectDeferred(NewConfig);
+				}
+				else
+				{
+					Mechanism->SpawnSubject(NewConfig);
+				}
 			}
 
 			// Fx
 			for (const FFxConfig& Config : Hit.SpawnFx)
 			{
 				FFxConfig_Final NewConfig(Config);
-				NewConfig.OwnerSubject = FSubjectHandle(Overlapper);
-				NewConfig.AttachToSubject = FSubjectHandle(Overlapper);
-				const FTransform WorldTransform(HitDirection.ToOrientationQuat(), Location);
+				NewConfig.OwnerSubject = Overlapper;
+				NewConfig.AttachToSubject = Overlapper;
 				NewConfig.SpawnTransform = ABattleFrameBattleControl::LocalOffsetToWorld(Direction.ToOrientationQuat(), WorldTransform.GetLocation(), NewConfig.Transform);
 				NewConfig.InitialRelativeTransform = NewConfig.SpawnTransform.GetRelativeTransform(WorldTransform);
 
-				Mechanism->SpawnSubjectDeferred(NewConfig);
+				if (bDeferred)
+				{
+					Mechanism->SpawnSubjectDeferred(NewConfig);
+				}
+				else
+				{
+					Mechanism->SpawnSubject(NewConfig);
+				}
 			}
 
 			// Sound
 			for (const FSoundConfig& Config : Hit.PlaySound)
 			{
 				FSoundConfig_Final NewConfig(Config);
-				NewConfig.OwnerSubject = FSubjectHandle(Overlapper);
-				NewConfig.AttachToSubject = FSubjectHandle(Overlapper);
-				const FTransform WorldTransform(HitDirection.ToOrientationQuat(), Location);
+				NewConfig.OwnerSubject = Overlapper;
+				NewConfig.AttachToSubject = Overlapper;
 				NewConfig.SpawnTransform = ABattleFrameBattleControl::LocalOffsetToWorld(Direction.ToOrientationQuat(), WorldTransform.GetLocation(), NewConfig.Transform);
 				NewConfig.InitialRelativeTransform = NewConfig.SpawnTransform.GetRelativeTransform(WorldTransform);
 
-				Mechanism->SpawnSubjectDeferred(NewConfig);
+				if (bDeferred)
+				{
+					Mechanism->SpawnSubjectDeferred(NewConfig);
+				}
+				else
+				{
+					Mechanism->SpawnSubject(NewConfig);
+				}
 			}
 
 			// Glow
@@ -7273,25 +6051,24 @@ void ABattleFrameBattleControl::ApplyBeamDamageAndDebuffDeferred(UNeighborGridCo
 			}
 		}
 
-		Overlapper.SetTraitDeferred(NewBeingHit);
-
-		if (bHasIsSubjective)
+		if (bDeferred)
+		{
+			Overlapper.SetTraitDeferred(NewBeingHit);
+		}
+		else
 		{
-			FHitData HitData;
-			HitData.SelfSubject = DmgResult.DamagedSubject;
-			HitData.InstigatorSubject = DmgResult.InstigatorSubject;
-			HitData.CauserSubject = DmgResult.CauserSubject;
-			HitData.IsCritical = DmgResult.IsCritical;
-			HitData.IsKill = DmgResult.IsKill;
-			HitData.DmgDealt = DmgResult.DmgDealt;
-			OnHitQueue.Enqueue(HitData);
+			Overlapper.SetTrait(NewBeingHit);
 		}
 
-		DamageResults.Add(DmgResult);
+	}, bSingleThread || !bDeferred || Groups.Num() < MinBatchSizeAllowed);
+
+	// 丢弃失效目标留下的空位
+	for (auto& Results : OutResults)
+	{
+		Results.RemoveAll([](const FDmgResult& Result) { return !Result.DamagedSubject.IsValid(); });
 	}
 }
 
-
 //---------------------------------------------------A* Pathfinding-----------------------------------------------------
 
 bool ABattleFrameBattleControl::FindPathAStar(AFlowField* FlowField, const FVector& StartLocation, const FVector& GoalLocation, TArray<FVector>& OutPath)
@@ -15,6 +15,28 @@
 #include "Async/Async.h"
 #include "Engine/Engine.h"
 
+namespace
+{
+	// 池化配置的延迟生成交给BattleControl，在游戏线程上优先唤醒休眠个体 | Deferred spawns of a pooled config go through the battle control, which wakes dormant subjects on the game thread
+	void SpawnProjectileRecordDeferred(UWorld* World, AMechanism* Mechanism, UProjectileConfigDataAsset* Config, FSubjectRecord& Record)
+	{
+		ABattleFrameBattleControl* BattleControl = Config->bEnablePooling ? ABattleFrameBattleControl::GetInstance(World) : nullptr;
+
+		if (BattleControl)
+		{
+			FPooled Pooled;
+			Pooled.PoolKey = Config;
+			Pooled.Capacity = Config->PoolCapacity;
+			Record.SetTrait(Pooled);
+
+			BattleControl->SpawnPooledDeferred(MoveTemp(Record));
+			return;
+		}
+
+		Mechanism->SpawnSubjectDeferred(Record);
+	}
+}
+
 //---------------------------------Spawning-------------------------------
 
 TArray<FSubjectHandle> UBattleFrameFunctionLibraryRT::SpawnAgentsByConfigRectangular
@@ -760,6 +782,26 @@ void UBattleFrameFunctionLibraryRT::SpawnProjectileByConfig(bool& Successful, FS
 		return;
 	}
 
+	// 对象池：优先唤醒同一配置的休眠投射物
+	ABattleFrameBattleControl* BattleControl = ABattleFrameBattleControl::GetInstance(World);
+
+	if (Config->bEnablePooling && BattleControl)
+	{
+		FPooled Pooled;
+		Pooled.PoolKey = Config;
+		Pooled.Capacity = Config->PoolCapacity;
+		Record.SetTrait(Pooled);
+
+		TArray<FSubjectHandle> Reused;
+
+		if (BattleControl->ReuseDormantSubjects(Config, Record, 1, Reused) > 0)
+		{
+			SpawnedProjectile = Reused[0];
+			Successful = true;
+			return;
+		}
+	}
+
 	SpawnedProjectile = Mechanism->SpawnSubject(Record);
 
 	if (SpawnedProjectile.IsValid())
@@ -848,7 +890,7 @@ void UBattleFrameFunctionLibraryRT::SpawnProjectileByConfigDeferred(bool& Succes
 		return;
 	}
 
-	Mechanism->SpawnSubjectDeferred(Record);
+	SpawnProjectileRecordDeferred(World, Mechanism, Config, Record);
 	Successful = true;
 }
 
@@ -970,7 +1012,7 @@ void UBattleFrameFunctionLibraryRT::SpawnProjectile_StaticDeferred(bool& Success
 	Record.SetTrait(ProjectileParamsRT);
 	Record.SetTrait(FActivated());
 
-	Mechanism->SpawnSubjectDeferred(Record);
+	SpawnProjectileRecordDeferred(World, Mechanism, Config, Record);
 	Successful = true;
 }
 
@@ -1141,7 +1183,7 @@ void UBattleFrameFunctionLibraryRT::SpawnProjectile_InterpedDeferred(bool& Succe
 	Record.SetTrait(ProjectileMoving);
 	Record.SetTrait(FActivated());
 
-	Mechanism->SpawnSubjectDeferred(Record);
+	SpawnProjectileRecordDeferred(World, Mechanism, Config, Record);
 	Successful = true;
 }
 
@@ -1287,7 +1329,7 @@ void UBattleFrameFunctionLibraryRT::SpawnProjectile_BallisticDeferred(bool& Succ
 	Record.SetTrait(ProjectileMoving);
 	Record.SetTrait(FActivated());
 
-	Mechanism->SpawnSubjectDeferred(Record);
+	SpawnProjectileRecordDeferred(World, Mechanism, Config, Record);
 	Successful = true;
 }
 
@@ -1445,7 +1487,7 @@ void UBattleFrameFunctionLibraryRT::SpawnProjectile_TrackingDeferred(bool& Succe
 	Record.SetTrait(ProjectileMoving);
 	Record.SetTrait(FActivated());
 
-	Mechanism->SpawnSubjectDeferred(Record);
+	SpawnProjectileRecordDeferred(World, Mechanism, Config, Record);
 	Successful = true;
 }
 
@@ -1840,7 +1882,7 @@ void USphereSweepForSubjectsAsyncAction::Activate()
 								CapsuleConfig.Duration = DrawDebugConfig.Duration;
 
 								// 加入调试队列
-								ABattleFrameBattleControl::GetInstance()->DebugCapsuleQueue.Enqueue(CapsuleConfig);
+								ABattleFrameBattleControl::GetInstance(NeighborGridComponent)->DebugCapsuleQueue.Enqueue(CapsuleConfig);
 							}
 
 							// trace results
@@ -1852,7 +1894,7 @@ void USphereSweepForSubjectsAsyncAction::Activate()
 								SphereConfig.Radius = Result.Subject.GetTrait<FGridData>().Radius;
 								SphereConfig.Duration = DrawDebugConfig.Duration;
 								SphereConfig.LineThickness = DrawDebugConfig.LineThickness;
-								ABattleFrameBattleControl::GetInstance()->DebugSphereQueue.Enqueue(SphereConfig);
+								ABattleFrameBattleControl::GetInstance(NeighborGridComponent)->DebugSphereQueue.Enqueue(SphereConfig);
 							}
 
 							// visibility check results
@@ -1888,7 +1930,7 @@ void USphereSweepForSubjectsAsyncAction::Activate()
 								CapsuleConfig.Duration = DrawDebugConfig.Duration;
 
 								// 加入调试队列
-								ABattleFrameBattleControl::GetInstance()->DebugCapsuleQueue.Enqueue(CapsuleConfig);
+								ABattleFrameBattleControl::GetInstance(NeighborGridComponent)->DebugCapsuleQueue.Enqueue(CapsuleConfig);
 
 								// 绘制碰撞点
 								FDebugPointConfig PointConfig;
@@ -1897,7 +1939,7 @@ void USphereSweepForSubjectsAsyncAction::Activate()
 								PointConfig.Location = VisibilityResult.bBlockingHit ? VisibilityResult.ImpactPoint : VisibilityResult.TraceEnd;
 								PointConfig.Size = DrawDebugConfig.HitPointSize;
 
-								ABattleFrameBattleControl::GetInstance()->DebugPointQueue.Enqueue(PointConfig);
+								ABattleFrameBattleControl::GetInstance(NeighborGridComponent)->DebugPointQueue.Enqueue(PointConfig);
 							}
 						}
 
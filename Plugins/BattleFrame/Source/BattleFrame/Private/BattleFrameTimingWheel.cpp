@@ -0,0 +1,97 @@
+/*
+* BattleFrame
+* Created: 2025
+* Author: Leroy Works, All Rights Reserved.
+*/
+
+#include "BattleFrameTimingWheel.h"
+
+void FBattleFrameTimingWheel::Advance(const float DeltaTime, TArray<FSubjectHandle>& OutFired)
+{
+	// 新登记的计时器以当前tick为起点入轮，至少延迟一个tick
+	FPendingTimer Pending;
+
+	while (PendingQueue.Dequeue(Pending))
+	{
+		const int64 DelayTicks = FMath::Max<int64>(1, FMath::CeilToInt64(Pending.Delay / Resolution));
+		Insert(FTimerEntry{ Pending.Subject, CurrentTick + uint64(DelayTicks) });
+		NumTimers++;
+	}
+
+	Accumulator += FMath::Max(DeltaTime, 0.f);
+
+	while (Accumulator >= Resolution)
+	{
+		Accumulator -= Resolution;
+		CurrentTick++;
+
+		// 低位归零时把上层对应槽位的计时器下沉
+		for (int32 Level = 1; Level < NumLevels; ++Level)
+		{
+			if ((CurrentTick & ((uint64(1) << (SlotBits * Level)) - 1)) != 0) break;
+
+			Cascade(Level);
+		}
+
+		TArray<FTimerEntry>& Slot = Slots[0][CurrentTick & SlotMask];
+
+		if (Slot.IsEmpty()) continue;
+
+		for (const FTimerEntry& Entry : Slot)
+		{
+			OutFired.Add(Entry.Subject);
+		}
+
+		NumTimers -= Slot.Num();
+		Slot.Reset();
+	}
+}
+
+void FBattleFrameTimingWheel::Reset()
+{
+	for (int32 Level = 0; Level < NumLevels; ++Level)
+	{
+		for (int32 Index = 0; Index < NumSlots; ++Index)
+		{
+			Slots[Level][Index].Empty();
+		}
+	}
+
+	PendingQueue.Empty();
+	Accumulator = 0.f;
+	CurrentTick = 0;
+	NumTimers = 0;
+}
+
+void FBattleFrameTimingWheel::Insert(const FTimerEntry& Entry)
+{
+	const uint64 Delta = Entry.ExpireTick > CurrentTick ? Entry.ExpireTick - CurrentTick : 0;
+
+	// 超出总跨度的计时器先放在顶层最远的槽位，下沉时按真实到期时间重新分配
+	const uint64 SlotTick = Delta < MaxSpan ? Entry.ExpireTick : CurrentTick + MaxSpan - 1;
+	const uint64 SlotDelta = SlotTick - FMath::Min(SlotTick, CurrentTick);
+
+	int32 Level = 0;
+
+	while (Level < NumLevels - 1 && SlotDelta >= (uint64(1) << (SlotBits * (Level + 1))))
+	{
+		Level++;
+	}
+
+	Slots[Level][(SlotTick >> (SlotBits * Level)) & SlotMask].Add(Entry);
+}
+
+void FBattleFrameTimingWheel::Cascade(const int32 Level)
+{
+	TArray<FTimerEntry>& Slot = Slots[Level][(CurrentTick >> (SlotBits * Level)) & SlotMask];
+
+	if (Slot.IsEmpty()) return;
+
+	TArray<FTimerEntry> Entries = MoveTemp(Slot);
+	Slot.Reset();
+
+	for (const FTimerEntry& Entry : Entries)
+	{
+		Insert(Entry);
+	}
+}
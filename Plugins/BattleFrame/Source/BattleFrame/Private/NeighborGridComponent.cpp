@@ -338,7 +338,7 @@ void UNeighborGridComponent::SphereTraceForSubjects
 		Config.Location = Origin;
 		Config.Radius = Radius;
 		Config.Duration = DrawDebugConfig.Duration;
-		ABattleFrameBattleControl::GetInstance()->DebugSphereQueue.Enqueue(Config);
+		ABattleFrameBattleControl::GetInstance(this)->DebugSphereQueue.Enqueue(Config);
 
 		// trace results
 		for (const auto& Result : Results)
@@ -349,7 +349,7 @@ void UNeighborGridComponent::SphereTraceForSubjects
 			SphereConfig.Location = Result.Subject.GetTrait<FLocated>().Location;
 			SphereConfig.Radius = Result.Subject.GetTrait<FGridData>().Radius;
 			SphereConfig.Duration = DrawDebugConfig.Duration;
-			ABattleFrameBattleControl::GetInstance()->DebugSphereQueue.Enqueue(SphereConfig);
+			ABattleFrameBattleControl::GetInstance(this)->DebugSphereQueue.Enqueue(SphereConfig);
 		}
 
 		// visibility check results
@@ -385,7 +385,7 @@ void UNeighborGridComponent::SphereTraceForSubjects
 			CapsuleConfig.Duration = DrawDebugConfig.Duration;
 
 			// 加入调试队列
-			ABattleFrameBattleControl::GetInstance()->DebugCapsuleQueue.Enqueue(CapsuleConfig);
+			ABattleFrameBattleControl::GetInstance(this)->DebugCapsuleQueue.Enqueue(CapsuleConfig);
 
 			// 绘制碰撞点
 			FDebugPointConfig PointConfig;
@@ -394,7 +394,7 @@ void UNeighborGridComponent::SphereTraceForSubjects
 			PointConfig.Location = VisibilityResult.bBlockingHit ? VisibilityResult.ImpactPoint : VisibilityResult.TraceEnd;
 			PointConfig.Size = DrawDebugConfig.HitPointSize;
 
-			ABattleFrameBattleControl::GetInstance()->DebugPointQueue.Enqueue(PointConfig);
+			ABattleFrameBattleControl::GetInstance(this)->DebugPointQueue.Enqueue(PointConfig);
 		}
 	}
 }
@@ -701,7 +701,7 @@ void UNeighborGridComponent::SphereSweepForSubjects(
 			CapsuleConfig.Duration = DrawDebugConfig.Duration;
 
 			// 加入调试队列
-			ABattleFrameBattleControl::GetInstance()->DebugCapsuleQueue.Enqueue(CapsuleConfig);
+			ABattleFrameBattleControl::GetInstance(this)->DebugCapsuleQueue.Enqueue(CapsuleConfig);
 		}
 
 		// trace results
@@ -713,7 +713,7 @@ void UNeighborGridComponent::SphereSweepForSubjects(
 			SphereConfig.Radius = Result.Subject.GetTrait<FGridData>().Radius;
 			SphereConfig.Duration = DrawDebugConfig.Duration;
 			SphereConfig.LineThickness = DrawDebugConfig.LineThickness;
-			ABattleFrameBattleControl::GetInstance()->DebugSphereQueue.Enqueue(SphereConfig);
+			ABattleFrameBattleControl::GetInstance(this)->DebugSphereQueue.Enqueue(SphereConfig);
 		}
 
 		// visibility check results
@@ -749,7 +749,7 @@ void UNeighborGridComponent::SphereSweepForSubjects(
 			CapsuleConfig.Duration = DrawDebugConfig.Duration;
 
 			// 加入调试队列
-			ABattleFrameBattleControl::GetInstance()->DebugCapsuleQueue.Enqueue(CapsuleConfig);
+			ABattleFrameBattleControl::GetInstance(this)->DebugCapsuleQueue.Enqueue(CapsuleConfig);
 
 			// 绘制碰撞点
 			FDebugPointConfig PointConfig;
@@ -758,7 +758,7 @@ void UNeighborGridComponent::SphereSweepForSubjects(
 			PointConfig.Location = VisibilityResult.bBlockingHit ? VisibilityResult.ImpactPoint : VisibilityResult.TraceEnd;
 			PointConfig.Size = DrawDebugConfig.HitPointSize;
 
-			ABattleFrameBattleControl::GetInstance()->DebugPointQueue.Enqueue(PointConfig);
+			ABattleFrameBattleControl::GetInstance(this)->DebugPointQueue.Enqueue(PointConfig);
 		}
 	}
 }
@@ -1106,7 +1106,7 @@ void UNeighborGridComponent::SectorTraceForSubjects
 		SectorConfig.Color = DrawDebugConfig.Color;
 		SectorConfig.LineThickness = DrawDebugConfig.LineThickness;
 
-		ABattleFrameBattleControl::GetInstance()->DebugSectorQueue.Enqueue(SectorConfig);
+		ABattleFrameBattleControl::GetInstance(this)->DebugSectorQueue.Enqueue(SectorConfig);
 
 		// trace results
 		for (const auto& Result : Results)
@@ -1116,7 +1116,7 @@ void UNeighborGridComponent::SectorTraceForSubjects
 			SphereConfig.Location = Result.Subject.GetTrait<FLocated>().Location;
 			SphereConfig.Radius = Result.Subject.GetTrait<FGridData>().Radius;
 			SphereConfig.Duration = DrawDebugConfig.Duration;
-			ABattleFrameBattleControl::GetInstance()->DebugSphereQueue.Enqueue(SphereConfig);
+			ABattleFrameBattleControl::GetInstance(this)->DebugSphereQueue.Enqueue(SphereConfig);
 		}
 
 		// visibility check results
@@ -1152,7 +1152,7 @@ void UNeighborGridComponent::SectorTraceForSubjects
 			CapsuleConfig.Duration = DrawDebugConfig.Duration;
 
 			// 加入调试队列
-			ABattleFrameBattleControl::GetInstance()->DebugCapsuleQueue.Enqueue(CapsuleConfig);
+			ABattleFrameBattleControl::GetInstance(this)->DebugCapsuleQueue.Enqueue(CapsuleConfig);
 
 			// 绘制碰撞点
 			FDebugPointConfig PointConfig;
@@ -1161,7 +1161,7 @@ void UNeighborGridComponent::SectorTraceForSubjects
 			PointConfig.Location = VisibilityResult.bBlockingHit ? VisibilityResult.ImpactPoint : VisibilityResult.TraceEnd;
 			PointConfig.Size = DrawDebugConfig.HitPointSize;
 
-			ABattleFrameBattleControl::GetInstance()->DebugPointQueue.Enqueue(PointConfig);
+			ABattleFrameBattleControl::GetInstance(this)->DebugPointQueue.Enqueue(PointConfig);
 		}
 	}
 }
@@ -1421,7 +1421,7 @@ void UNeighborGridComponent::SectorTraceForSubjects
 //		CapsuleConfig.Duration = DrawDebugConfig.Duration;
 //
 //		// 加入调试队列
-//		ABattleFrameBattleControl::GetInstance()->DebugCapsuleQueue.Enqueue(CapsuleConfig);
+//		ABattleFrameBattleControl::GetInstance(this)->DebugCapsuleQueue.Enqueue(CapsuleConfig);
 //	}
 //}
 
@@ -1556,7 +1556,7 @@ void UNeighborGridComponent::Update()
 				Config.Location = Located.Location;
 				Config.Color = FColor::Red;
 				Config.LineThickness = 0.f;
-				ABattleFrameBattleControl::GetInstance()->DebugSphereQueue.Enqueue(Config);
+				ABattleFrameBattleControl::GetInstance(this)->DebugSphereQueue.Enqueue(Config);
 			}
 
 		}, ThreadsCount, BatchSize);
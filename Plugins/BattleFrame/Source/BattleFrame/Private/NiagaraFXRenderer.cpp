@@ -69,7 +69,7 @@ void ANiagaraFXRenderer::Tick(float DeltaTime)
             });
 
         // Register New Attached Fx
-        FFilter NewAttachedFxFilter = FFilter::Make<FLocated, FDirected, FScaled, FIsAttachedFx>().Exclude<FRendering>();
+        FFilter NewAttachedFxFilter = FFilter::Make<FLocated, FDirected, FScaled, FIsAttachedFx>().Exclude<FRendering, FDormant>();
         NewAttachedFxFilter += TraitType;
         NewAttachedFxFilter += SubType;
 
@@ -145,8 +145,8 @@ void ANiagaraFXRenderer::Tick(float DeltaTime)
             CurrentData->ValidTransforms_Attached.Reset();
         }
 
-        // Update Existing Attached Fx
-        FFilter ExistingAttachedFxFilter = FFilter::Make<FLocated, FDirected, FScaled, FIsAttachedFx, FRendering>();
+        // Update Existing Attached Fx, parked subjects drop out so their slot is hidden and freed
+        FFilter ExistingAttachedFxFilter = FFilter::Make<FLocated, FDirected, FScaled, FIsAttachedFx, FRendering>().Exclude<FDormant>();
         ExistingAttachedFxFilter += TraitType;
         ExistingAttachedFxFilter += SubType;
 
@@ -124,6 +124,12 @@ public:
     UPROPERTY(BlueprintReadWrite, EditAnywhere, meta = (ToolTip = "自定义特征"))
     FSubjectRecord ExtraTraits;
 
+    UPROPERTY(BlueprintReadWrite, EditAnywhere, meta = (ToolTip = "对象池：死亡后不销毁而是休眠，供后续生成复用"))
+    bool bEnablePooling = false;
+
+    UPROPERTY(BlueprintReadWrite, EditAnywhere, meta = (ToolTip = "对象池最多保留的休眠个体数", EditCondition = "bEnablePooling", ClampMin = "0"))
+    int32 PoolCapacity = 10000;
+
     UAgentConfigDataAsset() {};
 
 };
@@ -26,6 +26,7 @@
 #include "BattleFrameFunctionLibraryRT.h"
 #include "BattleFrameStructs.h"
 #include "BattleFrameEnums.h"
+#include "BattleFrameTimingWheel.h"
 
 #include "Traits/Debuff.h"
 #include "Traits/Animation.h"
@@ -67,6 +68,8 @@
 #include "Traits/MayDie.h"
 #include "Traits/PrimaryType.h"
 #include "Traits/Transform.h"
+#include "Traits/Pooled.h"
+#include "Traits/Timed.h"
 
 #include "BattleFrameBattleControl.generated.h"
 
@@ -75,6 +78,48 @@ class UNeighborGridComponent;
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE(FOnUnTraceTarget);
 
+// 伤害请求的形状 | Shape of a damage request
+enum class EDmgRequestShape : uint8
+{
+	Point,
+	Radial,
+	Beam
+};
+
+// 伤害请求，点/球形/球扫伤害统一以FDamage_Beam与FDebuff_Beam描述 | A single damage request, every shape is described by the beam damage and debuff
+struct FDmgRequest
+{
+	EDmgRequestShape Shape = EDmgRequestShape::Point;
+	UNeighborGridComponent* NeighborGrid = nullptr;
+	int32 KeepCount = -1;
+	FVector StartLocation = FVector::ZeroVector;
+	FVector EndLocation = FVector::ZeroVector;
+	FSubjectArray Subjects;
+	FSubjectArray IgnoreSubjects;
+	FSubjectHandle DmgInstigator = FSubjectHandle();
+	FSubjectHandle DmgCauser = FSubjectHandle();
+	FVector HitFromLocation = FVector::ZeroVector;
+	FDamage_Beam Damage = FDamage_Beam();
+	FDebuff_Beam Debuff = FDebuff_Beam();
+	bool bAddHitsToCauserIgnore = false; // 入队时确定，结算时施加者可能已被移除或回收 | Decided when queued, the causer may be despawned or parked by the time the batch is flushed
+};
+
+// 一次命中，记录所属请求及其在结果中的位置 | One resolved hit, pointing back to its request and result slot
+struct FDmgHit
+{
+	FSubjectHandle Target = FSubjectHandle();
+	int32 RequestIndex = 0;
+	int32 ResultIndex = 0;
+	float DmgFalloffMult = 1;
+	float DebuffFalloffMult = 1;
+};
+
+// 同一目标在一批请求中的全部命中 | All hits one target received within a batch
+struct FDmgTargetGroup
+{
+	TArray<FDmgHit, TInlineAllocator<4>> Hits;
+};
+
 UCLASS()
 class BATTLEFRAME_API ABattleFrameBattleControl : public AActor
 {
@@ -97,7 +142,14 @@ public:
 	UPROPERTY(BlueprintReadOnly, VisibleAnywhere, Category = BattleFrame)
 	int32 AgentCount = 0;
 
-	static ABattleFrameBattleControl* Instance;
+	// 开启的世界不在自身Tick中模拟，而是由同一个调度器在游戏线程上依次模拟，世界之间不并行，每个世界内部的遍历仍是并行的 | Opted-in worlds are not simulated in their own tick but one after another by a shared ticker on the game thread. Worlds do not run in parallel with each other, the passes inside each world still run concurrently
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = BattleFrame)
+	bool bTickWorldsFromSharedTicker = false;
+
+	bool bSimulationPending = false;
+	float PendingDeltaTime = 0.f;
+	float PendingSafeDeltaTime = 0.f;
+
 	UWorld* CurrentWorld = nullptr;
 	AMechanism* Mechanism = nullptr;
 	TArray<UNeighborGridComponent*> NeighborGrids;
@@ -130,6 +182,19 @@ public:
 	TQueue<FHitData, EQueueMode::Mpsc> OnHitQueue;
 	TQueue<FDeathData, EQueueMode::Mpsc> OnDeathQueue;
 
+	// Batched Damage
+	TQueue<FDmgRequest, EQueueMode::Mpsc> DmgRequestQueue;
+
+	// Subject Pooling
+	TMap<TObjectKey<UObject>, TArray<FSubjectHandle>> DormantSubjects;
+	TQueue<FSubjectHandle, EQueueMode::Mpsc> ParkQueue;
+	TQueue<FSubjectRecord, EQueueMode::Mpsc> PooledSpawnQueue;
+
+	// Timing Wheels
+	FBattleFrameTimingWheel SlowTimers;
+	FBattleFrameTimingWheel TemporalDamageTimers;
+	TArray<FSubjectHandle> FiredTimers;
+
 	// Draw Debug Queue
 	TQueue<FDebugPointConfig, EQueueMode::Mpsc> DebugPointQueue;
 	TQueue<FDebugLineConfig, EQueueMode::Mpsc> DebugLineQueue;
@@ -188,23 +253,19 @@ public:
 
 	void Tick(float DeltaTime) override;
 
-	void EndPlay(const EEndPlayReason::Type EndPlayReason) override
-	{
-		if (Instance == this)
-		{
-			Instance = nullptr;
-		}
+	void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
-		Super::EndPlay(EndPlayReason);
-	}
+	// 模拟部分，会创建Chunk、做场景检测，只能在游戏线程执行 | Simulation passes, they create chunks and run world traces so game thread only
+	void TickSimulation(float DeltaTime, float SafeDeltaTime);
+
+	// 渲染、生成和事件，只能在游戏线程执行 | Rendering, spawning and events, game thread only
+	void TickPresentation(float SafeDeltaTime);
 
 	//---------------------------------------------Helpers------------------------------------------------------------------
 
-	UFUNCTION(BlueprintCallable, BlueprintPure)
-	static ABattleFrameBattleControl* GetInstance()
-	{
-		return Instance;
-	}
+	// 获取世界对应的战斗控制器 | Get the battle controller of the world
+	UFUNCTION(BlueprintCallable, BlueprintPure, meta = (WorldContext = "WorldContextObject"))
+	static ABattleFrameBattleControl* GetInstance(const UObject* WorldContextObject);
 
 	void DefineFilters();
 
@@ -348,6 +409,39 @@ public:
 	};
 
 
+	//---------------------------------------------Pooling------------------------------------------------------------------
+
+	// 池化的个体进入休眠队列，其余照常销毁 | Pooled subjects are queued for parking, the rest are despawned as usual
+	FORCEINLINE void DespawnOrPark(FSolidSubjectHandle Subject)
+	{
+		ReleaseGhosts(Subject);
+
+		if (Subject.HasTrait<FPooled>())
+		{
+			ParkQueue.Enqueue(FSubjectHandle(Subject));
+		}
+		else
+		{
+			Subject.DespawnDeferred();
+		}
+	}
+
+	// 移除挂在个体上的减速和延时伤害马甲，它们已登记到时间轮，不会再被遍历 | Despawn the slow and temporal damage ghosts of a subject, timed ghosts are no longer visited by the chains
+	void ReleaseGhosts(FSolidSubjectHandle Subject);
+
+	void ParkPooledSubjects();
+
+	int32 ReuseDormantSubjects(const UObject* PoolKey, const FSubjectRecord& Prototype, const int32 MaxCount, TArray<FSubjectHandle>& OutSubjects);
+
+	// 并行阶段的池化延迟生成先入队，回收休眠后在游戏线程上唤醒或生成 | Pooled deferred spawns are queued from any thread, then woken or spawned on the game thread after parking
+	FORCEINLINE void SpawnPooledDeferred(FSubjectRecord&& Record)
+	{
+		PooledSpawnQueue.Enqueue(MoveTemp(Record));
+	}
+
+	void SpawnPooledSubjects();
+
+
 	//---------------------------------------------Damager------------------------------------------------------------------
 
 	void ApplyPointDamageAndDebuff(const FSubjectArray& Subjects, const FSubjectArray& IgnoreSubjects, const FSubjectHandle DmgInstigator, const FSubjectHandle DmgCauser, const FVector& HitFromLocation, const FDamage_Point& Damage, const FDebuff_Point& Debuff, TArray<FDmgResult>& DamageResults);
@@ -362,6 +456,17 @@ public:
 
 	void ApplyBeamDamageAndDebuffDeferred(UNeighborGridComponent* NeighborGridComponent, const int32 KeepCount, const FVector& StartLocation, const FVector& EndLocation, const FSubjectArray& IgnoreSubjects, const FSubjectHandle DmgInstigator, const FSubjectHandle DmgCauser, const FVector& HitFromLocation, const FDamage_Beam& Damage, const FDebuff_Beam& Debuff, TArray<FDmgResult>& DamageResults);
 
+	void ApplyDamageRequest(FDmgRequest&& Request, TArray<FDmgResult>& DamageResults, const bool bDeferred);
+
+	// 一批伤害请求：并行解析目标，按目标聚合，再并行结算伤害和减益 | Resolve targets in parallel, group hits per target, then apply damage and debuffs in one parallel sweep
+	// 在并行操作内调用时bSingleThread为true，避免嵌套ParallelFor | bSingleThread is set when called from inside a concurrent operation so no ParallelFor is nested
+	void ApplyDamageBatch(const TArray<FDmgRequest>& Requests, TArray<TArray<FDmgResult>>& OutResults, const bool bDeferred, const bool bSingleThread);
+
+	void ResolveDamageTargets(const FDmgRequest& Request, const int32 RequestIndex, TArray<FDmgHit>& OutHits, const bool bDeferred) const;
+
+	// 结算本帧排队的伤害请求 | Resolve the damage requests queued this frame
+	void FlushDamageRequests();
+
 	
 	//-------------------------------------------Pack Data------------------------------------------------------------------
 	
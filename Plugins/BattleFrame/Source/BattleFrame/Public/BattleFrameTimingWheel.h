@@ -0,0 +1,85 @@
+/*
+* BattleFrame
+* Created: 2025
+* Author: Leroy Works, All Rights Reserved.
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Queue.h"
+#include "SubjectHandle.h"
+
+/**
+ * 分层时间轮：个体登记到期时间，每帧只返回到期的个体
+ * Hierarchical timing wheel. Subjects register an expiration and each frame
+ * only the subjects whose timers fired are returned, so timer bookkeeping
+ * scales with the number of events instead of the population.
+ */
+class BATTLEFRAME_API FBattleFrameTimingWheel
+{
+public:
+
+	static constexpr int32 SlotBits = 6;
+	static constexpr int32 NumSlots = 1 << SlotBits;
+	static constexpr int32 SlotMask = NumSlots - 1;
+	static constexpr int32 NumLevels = 4;
+
+	// 最大可直接容纳的延迟（tick），更远的到期会在顶层轮转中逐步下沉
+	static constexpr uint64 MaxSpan = uint64(1) << (SlotBits * NumLevels);
+
+	explicit FBattleFrameTimingWheel(const float InResolution = 1.f / 60.f)
+		: Resolution(FMath::Max(InResolution, UE_KINDA_SMALL_NUMBER))
+	{
+	}
+
+	/**
+	 * 登记一个到期时间，可在并行线程中调用
+	 * Register an expiration in seconds from now. Thread-safe; the entry
+	 * enters the wheel on the next Advance.
+	 */
+	FORCEINLINE void Schedule(const FSubjectHandle& Subject, const float Delay)
+	{
+		PendingQueue.Enqueue(FPendingTimer{ Subject, Delay });
+	}
+
+	/**
+	 * 推进时间并输出所有到期的个体，仅在游戏线程调用
+	 * Advance the wheel by DeltaTime and append every subject whose timer
+	 * fired. Game thread only. Handles may have been despawned meanwhile.
+	 */
+	void Advance(const float DeltaTime, TArray<FSubjectHandle>& OutFired);
+
+	void Reset();
+
+	FORCEINLINE int32 Num() const
+	{
+		return NumTimers;
+	}
+
+private:
+
+	struct FPendingTimer
+	{
+		FSubjectHandle Subject;
+		float Delay = 0.f;
+	};
+
+	struct FTimerEntry
+	{
+		FSubjectHandle Subject;
+		uint64 ExpireTick = 0;
+	};
+
+	void Insert(const FTimerEntry& Entry);
+
+	void Cascade(const int32 Level);
+
+	float Resolution = 1.f / 60.f;
+	float Accumulator = 0.f;
+	uint64 CurrentTick = 0;
+	int32 NumTimers = 0;
+
+	TArray<FTimerEntry> Slots[NumLevels][NumSlots];
+	TQueue<FPendingTimer, EQueueMode::Mpsc> PendingQueue;
+};
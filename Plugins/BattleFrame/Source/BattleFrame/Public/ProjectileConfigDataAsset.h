@@ -93,6 +93,14 @@ public:
     FDebuff_Beam Debuff_Beam;
 
 
+    // 对象池
+    UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Pooling", meta = (ToolTip = "对象池：结束后不销毁而是休眠，供后续生成复用"))
+    bool bEnablePooling = false;
+
+    UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Pooling", meta = (ToolTip = "对象池最多保留的休眠个体数", EditCondition = "bEnablePooling", ClampMin = "0"))
+    int32 PoolCapacity = 10000;
+
+
 
     UProjectileConfigDataAsset() {};
 };
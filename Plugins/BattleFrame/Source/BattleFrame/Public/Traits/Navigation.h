@@ -18,6 +18,9 @@ public:
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, meta = (Tooltip = "更换流场后要设该值为true来通知更新数据"))
 	bool bReloadFlowField = true;
 
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, meta = (Tooltip = "流场目标层，通过流场的AcquireGoalLayer获取。有效时朝该层的目标移动，而不是流场自身的目标"))
+	FFlowFieldGoalLayerHandle GoalLayer;
+
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, meta = (Tooltip = "使用A星寻路。禁用后会直线移动到目标点。"))
 	bool bUseAStar = true;
 
@@ -48,4 +51,9 @@ public:
 
 	ENavMode PreviousNavMode = ENavMode::None;
 
+	// 移动前按流场批量采样的地面 | Flow field ground sampled in batches before the move pass
+	FVector SampledGround = FVector::ZeroVector;
+
+	bool bIsGroundSampled = false;
+
 };
\ No newline at end of file
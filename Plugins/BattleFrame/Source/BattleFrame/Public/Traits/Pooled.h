@@ -0,0 +1,31 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Pooled.generated.h" 
+
+USTRUCT(BlueprintType)
+struct BATTLEFRAME_API FPooled
+{
+	GENERATED_BODY()
+
+public:
+
+	// 回收到哪个对象池，以生成时使用的配置资产为键 | The config asset keying the pool this subject returns to
+	UPROPERTY(BlueprintReadOnly, VisibleAnywhere)
+	TObjectPtr<UObject> PoolKey = nullptr;
+
+	// 对象池容量，超出时直接销毁 | Subjects beyond this count are despawned instead of parked
+	UPROPERTY(BlueprintReadOnly, VisibleAnywhere)
+	int32 Capacity = 0;
+
+};
+
+USTRUCT(BlueprintType)
+struct BATTLEFRAME_API FDormant
+{
+	GENERATED_BODY()
+
+public:
+
+
+};
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Timed.generated.h" 
+
+// 已登记到时间轮，不再需要每帧倒计时 | Registered with the timing wheel, no per-frame countdown needed
+USTRUCT(BlueprintType)
+struct BATTLEFRAME_API FTimed
+{
+	GENERATED_BODY()
+
+public:
+
+};
@@ -28,6 +28,7 @@
 #include "Traits/Navigation.h"
 #include "Traits/OwnerSubject.h"
 #include "Traits/Patrol.h"
+#include "Traits/Pooled.h"
 #include "Traits/PrimaryType.h"
 #include "Traits/ProjectileConfig.h"
 #include "Traits/RenderBatchData.h"
@@ -44,5 +45,6 @@
 #include "Traits/TemporalDamage.h"
 #include "Traits/TextPopConfig.h"
 #include "Traits/TextPopUp.h"
+#include "Traits/Timed.h"
 #include "Traits/Trace.h"
 #include "Traits/Transform.h"
\ No newline at end of file
@@ -41,6 +41,20 @@ void AFlowField::OnConstruction(const FTransform& Transform)
 	DrawDebug();
 }
 
+void AFlowField::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	// the background task writes into this actor
+	if (PendingUpdate.IsValid())
+	{
+		PendingUpdate.Wait();
+		PendingUpdate = TFuture<void>();
+	}
+
+	bAsyncUpdateQueued = false;
+
+	Super::EndPlay(EndPlayReason);
+}
+
 void AFlowField::DrawDebug()
 {
 	InitFlowField(EInitMode::Construction);
@@ -65,17 +79,45 @@ void AFlowField::UpdateFlowField()
 {
 	TRACE_CPUPROFILER_EVENT_SCOPE_STR("UpdateFlowField");
 
+	// never let a background refresh run concurrently with this one
+	if (PendingUpdate.IsValid())
+	{
+		PendingUpdate.Wait();
+		FinishAsyncUpdate();
+	}
+
 	EInitMode InitMode = bIsBeginPlay ? EInitMode::BeginPlay : EInitMode::Runtime;
 
 	InitFlowField(InitMode);
 
 	GetGoalLocation();
 
-	CreateGrid();
+	const bool bWasGridDirty = bIsGridDirty;
+
+	if (!RepairFlowField())
+	{
+		CreateGrid();
+
+		if (!bWasGridDirty)
+		{
+			RequeryDirtyCells(nullptr);
+		}
+
+		CurrentCellsArray = InitialCellsArray;
+
+		CalculateFlowField(CurrentCellsArray);
+	}
+
+	DirtyCellRects.Reset();
+	LastGoalGridCoords = GoalGridCoords;
+	++FieldVersion;
 
-	CurrentCellsArray = InitialCellsArray;
+	// this refresh already covers any queued background one
+	bAsyncUpdateQueued = false;
 
-	CalculateFlowField(CurrentCellsArray);
+	BuildPackedField();
+
+	RefreshGoalLayers();
 
 	DrawCells(InitMode);
 
@@ -88,14 +130,103 @@ void AFlowField::TickFlowField()
 {
 	TRACE_CPUPROFILER_EVENT_SCOPE_STR("TickFlowField");
 
+	if (PendingUpdate.IsValid() && PendingUpdate.IsReady())
+	{
+		FinishAsyncUpdate();
+	}
+
+	// the first refresh and grid rebuilds stay synchronous, so readers never see an empty field
+	const bool bCanUpdateAsync = bAsyncUpdate && !bIsBeginPlay && !bIsGridDirty;
+
 	if (nextTickTimeLeft <= 0.f)
 	{
-		UpdateFlowField();
+		if (bCanUpdateAsync)
+		{
+			bAsyncUpdateQueued = true;
+		}
+		else
+		{
+			UpdateFlowField();
+		}
+	}
+
+	// a refresh requested while the previous one is still running waits for it, at most one is kept
+	if (bAsyncUpdateQueued && bCanUpdateAsync && !PendingUpdate.IsValid())
+	{
+		bAsyncUpdateQueued = false;
+
+		StartAsyncUpdate();
 	}
 
 	UpdateTimer();
 }
 
+void AFlowField::StartAsyncUpdate()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE_STR("StartAsyncUpdate");
+
+	InitFlowField(EInitMode::Runtime);
+
+	GetGoalLocation();
+
+	const bool bRepair = CanRepairFlowField();
+
+	// nothing changed since the last refresh
+	if (bRepair && DirtyCellRects.IsEmpty()) return;
+
+	// traces stay on the game thread, only the integration and direction passes run in the background
+	TBitArray<> Changed;
+
+	if (bRepair)
+	{
+		Changed.Init(false, xNum * yNum);
+	}
+
+	RequeryDirtyCells(bRepair ? &Changed : nullptr);
+
+	DirtyCellRects.Reset();
+
+	PendingUpdate = Async(EAsyncExecution::TaskGraph, [this, bRepair, Changed = MoveTemp(Changed)]() mutable
+		{
+			TRACE_CPUPROFILER_EVENT_SCOPE_STR("AsyncUpdateFlowField");
+
+			if (bRepair)
+			{
+				// repair a copy of the published field, the game thread keeps reading CurrentCellsArray
+				BackCellsArray = CurrentCellsArray;
+
+				RepairCells(BackCellsArray, Changed);
+			}
+			else
+			{
+				BackCellsArray = InitialCellsArray;
+
+				CalculateFlowField(BackCellsArray);
+			}
+		});
+}
+
+void AFlowField::FinishAsyncUpdate()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE_STR("FinishAsyncUpdate");
+
+	PendingUpdate = TFuture<void>();
+
+	// publish the new field
+	Swap(CurrentCellsArray, BackCellsArray);
+
+	LastGoalGridCoords = GoalGridCoords;
+	++FieldVersion;
+
+	BuildPackedField();
+
+	RefreshGoalLayers();
+
+	DrawCells(EInitMode::Runtime);
+
+	DrawArrows(EInitMode::Runtime);
+}
+
 bool AFlowField::WorldToGridBP(UPARAM(ref) const FVector& Location, FVector2D& gridCoord)
 {
 	return WorldToGrid(Location, gridCoord);
@@ -116,6 +247,22 @@ FVector AFlowField::GetAverageDirectionBP(UPARAM(ref) const FVector& Location, c
 	return GetAverageDirection(Location, Radius, bOutIsValid);
 }
 
+FVector AFlowField::GetLayerDirectionBP(const FFlowFieldGoalLayerHandle& Handle, UPARAM(ref) const FVector& Location, FVector& GoalLocation, bool& bOutIsValid)
+{
+	FVector2D GoalCoord;
+	const FVector Direction = GetLayerDirection(Handle, Location, GoalCoord, bOutIsValid);
+
+	bool bIsValidGoal;
+	GoalLocation = bOutIsValid ? GetCellAtCoord(GoalCoord, bIsValidGoal).worldLoc : FVector::ZeroVector;
+
+	return Direction;
+}
+
+FVector AFlowField::GetLayerAverageDirectionBP(const FFlowFieldGoalLayerHandle& Handle, UPARAM(ref) const FVector& Location, const float Radius, bool& bOutIsValid)
+{
+	return GetAverageDirection(Handle, Location, Radius, bOutIsValid);
+}
+
 void AFlowField::InitFlowField(EInitMode InitMode)
 {
 	TRACE_CPUPROFILER_EVENT_SCOPE_STR("InitFlowField");
@@ -273,19 +420,153 @@ void AFlowField::CreateGrid()
 	InitialCellsArray.Empty();
 	CurrentCellsArray.Empty();
 
-	for (int x = 0; x < xNum; ++x)
+	if (!LoadBakedEnvironment())
 	{
-		for (int y = 0; y < yNum; ++y)
+		TArray<int32> CellIndices;
+		CellIndices.SetNumUninitialized(xNum * yNum);
+
+		for (int32 Index = 0; Index < CellIndices.Num(); ++Index)
 		{
-			FVector2D gridCoord = FVector2D(x, y);
-			FCellStruct newCell = EnvQuery(gridCoord);
-			InitialCellsArray.Add(newCell);
+			CellIndices[Index] = Index;
 		}
+
+		InitialCellsArray.SetNum(CellIndices.Num());
+
+		QueryCells(InitialCellsArray, CellIndices);
 	}
 
 	bIsGridDirty = false;
 }
 
+void AFlowField::QueryCells(TArray<FCellStruct>& OutCells, const TArray<int32>& CellIndices)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE_STR("QueryCells");
+
+	const int32 ChunkSize = FMath::Max(EnvQueryChunkSize, 1);
+	const int32 NumChunks = FMath::DivideAndRoundUp(CellIndices.Num(), ChunkSize);
+
+	// scene queries only read the physics scene, so every chunk can trace on its own worker
+	ParallelFor(NumChunks, [&](int32 ChunkIndex)
+		{
+			const int32 Begin = ChunkIndex * ChunkSize;
+			const int32 End = FMath::Min(Begin + ChunkSize, CellIndices.Num());
+
+			for (int32 i = Begin; i < End; ++i)
+			{
+				const int32 Index = CellIndices[i];
+				OutCells[Index] = EnvQuery(FVector2D(Index / yNum, Index % yNum));
+			}
+		}, bParallelEnvQuery ? EParallelForFlags::None : EParallelForFlags::ForceSingleThread);
+}
+
+bool AFlowField::LoadBakedEnvironment()
+{
+	if (!IsValid(BakedEnvironment)) return false;
+
+	TRACE_CPUPROFILER_EVENT_SCOPE_STR("LoadBakedEnvironment");
+
+	const UFlowFieldBakeData& Bake = *BakedEnvironment;
+	const int32 numCells = xNum * yNum;
+
+	const bool bIsSameGrid = Bake.xNum == xNum && Bake.yNum == yNum
+		&& FMath::IsNearlyEqual(Bake.cellSize, cellSize)
+		&& FMath::IsNearlyEqual(Bake.flowFieldSize.Z, flowFieldSize.Z)
+		&& Bake.actorLoc.Equals(actorLoc, 1.f)
+		&& FMath::IsNearlyEqual(Bake.actorYaw, float(actorRot.Yaw), 0.01f);
+
+	// the costs depend on how the cells were queried too
+	const bool bIsSameQuery = Bake.initialCost == initialCost
+		&& FMath::IsNearlyEqual(Bake.maxWalkableAngle, maxWalkableAngle)
+		&& Bake.traceGround == traceGround
+		&& Bake.traceObstacles == traceObstacles
+		&& Bake.groundObjectType == groundObjectType
+		&& Bake.obstacleObjectType == obstacleObjectType;
+
+	const bool bIsComplete = Bake.Costs.Num() == numCells && Bake.Types.Num() == numCells && Bake.Heights.Num() == numCells && Bake.Normals.Num() == numCells;
+
+	if (!bIsSameGrid || !bIsSameQuery || !bIsComplete)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("%s: BakedEnvironment %s does not match the grid or the query settings anymore, tracing instead. Bake it again"), *GetName(), *Bake.GetName());
+		return false;
+	}
+
+	InitialCellsArray.SetNum(numCells);
+
+	ParallelFor(numCells, [&](int32 Index)
+		{
+			FCellStruct& Cell = InitialCellsArray[Index];
+			Cell.gridCoord = FVector2D(Index / yNum, Index % yNum);
+			Cell.worldLoc = GridToWorld(Cell.gridCoord);
+			Cell.worldLoc.Z = Bake.Heights[Index];
+			Cell.normal = FVector(Bake.Normals[Index]);
+			Cell.cost = Bake.Costs[Index];
+			Cell.type = ECellType(Bake.Types[Index]);
+		});
+
+	return true;
+}
+
+void AFlowField::BakeEnvironment()
+{
+	if (!IsValid(BakedEnvironment))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("%s: assign a FlowFieldBakeData asset to BakedEnvironment before baking"), *GetName());
+		return;
+	}
+
+	TRACE_CPUPROFILER_EVENT_SCOPE_STR("BakeEnvironment");
+
+	const UWorld* World = GetWorld();
+	InitFlowField(IsValid(World) && World->IsGameWorld() ? EInitMode::Runtime : EInitMode::Construction);
+
+	const int32 numCells = xNum * yNum;
+
+	TArray<int32> CellIndices;
+	CellIndices.SetNumUninitialized(numCells);
+
+	for (int32 Index = 0; Index < numCells; ++Index)
+	{
+		CellIndices[Index] = Index;
+	}
+
+	TArray<FCellStruct> Cells;
+	Cells.SetNum(numCells);
+
+	QueryCells(Cells, CellIndices);
+
+	UFlowFieldBakeData& Bake = *BakedEnvironment;
+	Bake.Modify();
+
+	Bake.xNum = xNum;
+	Bake.yNum = yNum;
+	Bake.cellSize = cellSize;
+	Bake.flowFieldSize = flowFieldSize;
+	Bake.actorLoc = actorLoc;
+	Bake.actorYaw = float(actorRot.Yaw);
+	Bake.initialCost = initialCost;
+	Bake.maxWalkableAngle = maxWalkableAngle;
+	Bake.traceGround = traceGround;
+	Bake.traceObstacles = traceObstacles;
+	Bake.groundObjectType = groundObjectType;
+	Bake.obstacleObjectType = obstacleObjectType;
+
+	Bake.Costs.SetNumUninitialized(numCells);
+	Bake.Types.SetNumUninitialized(numCells);
+	Bake.Heights.SetNumUninitialized(numCells);
+	Bake.Normals.SetNumUninitialized(numCells);
+
+	for (int32 Index = 0; Index < numCells; ++Index)
+	{
+		const FCellStruct& Cell = Cells[Index];
+		Bake.Costs[Index] = uint8(FMath::Clamp(Cell.cost, 0, 255));
+		Bake.Types[Index] = uint8(Cell.type);
+		Bake.Heights[Index] = float(Cell.worldLoc.Z);
+		Bake.Normals[Index] = FVector3f(Cell.normal);
+	}
+
+	Bake.MarkPackageDirty();
+}
+
 void AFlowField::CalculateFlowField(TArray<FCellStruct>& InCurrentCellsArray)
 {
 	TRACE_CPUPROFILER_EVENT_SCOPE_STR("CalculateFlowField");
@@ -323,6 +604,11 @@ void AFlowField::CalculateFlowField(TArray<FCellStruct>& InCurrentCellsArray)
 		}
 	};
 
+	if (IntegrationMode == EIntegrationMode::BucketQueue)
+	{
+		CalculateIntegrationFieldDial(InCurrentCellsArray);
+	}
+	else
 	{
 		TRACE_CPUPROFILER_EVENT_SCOPE_STR("CreateIntegrationField");
 
@@ -412,6 +698,9 @@ void AFlowField::CalculateFlowField(TArray<FCellStruct>& InCurrentCellsArray)
 				}
 			}
 		}
+
+		// keep the compact fields in sync so the field can be repaired later
+		SyncIntegrationFields(InCurrentCellsArray);
 	}
 
 	{
@@ -419,74 +708,1028 @@ void AFlowField::CalculateFlowField(TArray<FCellStruct>& InCurrentCellsArray)
 
 		ParallelFor(numCells, [&](int32 j)
 			{
-				int32 currentIndex = j;
-				FVector2D currentCoord = FVector2D(currentIndex / yNum, currentIndex % yNum);
-				FCellStruct& currentCell = InCurrentCellsArray[CoordToIndex(currentCoord)];
+				CalculateCellDirection(InCurrentCellsArray, j);
+			});
+	}
+}
+
+void AFlowField::CalculateCellDirection(TArray<FCellStruct>& InCurrentCellsArray, const int32 CellIndex)
+{
+	auto IsValidCoord = [&](const FVector2D& gridCoord) -> bool {
+		return gridCoord.X >= 0 && gridCoord.X < xNum && gridCoord.Y >= 0 && gridCoord.Y < yNum;
+		};
+
+	FVector2D currentCoord = FVector2D(CellIndex / yNum, CellIndex % yNum);
+	FCellStruct& currentCell = InCurrentCellsArray[CoordToIndex(currentCoord)];
+
+	const FVector2D neighborCoords[8] =
+	{
+		currentCoord + FVector2D(0,-1),
+		currentCoord + FVector2D(1,0),
+		currentCoord + FVector2D(0,1),
+		currentCoord + FVector2D(-1,0),
+		currentCoord + FVector2D(1,-1),
+		currentCoord + FVector2D(1,1),
+		currentCoord + FVector2D(-1,1),
+		currentCoord + FVector2D(-1,-1),
+	};
+
+	auto IsValidDiagonal = [&](int32 indexA, int32 indexB) -> bool
+		{
+			bool result = true;
+
+			if (IsValidCoord(neighborCoords[indexA]))
+			{
+				if (InCurrentCellsArray[CoordToIndex(neighborCoords[indexA])].cost == 255)
+				{
+					result = false;
+				}
+			}
+			if (IsValidCoord(neighborCoords[indexB]))
+			{
+				if (InCurrentCellsArray[CoordToIndex(neighborCoords[indexB])].cost == 255)
+				{
+					result = false;
+				}
+			}
+			return result;
+		};
+
+	bool hasBestCell = false;
+	const FCellStruct* bestCell = nullptr;
+	int32 bestDist = currentCell.dist;
+
+	for (int32 i = 0; i < 8; i++)
+	{
+		const FVector2D& neighborCoord = neighborCoords[i];
+
+		if (!IsValidCoord(neighborCoord)) continue;
+
+		const FCellStruct& neighborCell = InCurrentCellsArray[CoordToIndex(neighborCoord)];
+
+		if (bIgnoreInternalObstacleCells && neighborCell.cost == 255) continue;
+
+		if (currentCell.cost != 255)
+		{
+			if (i == 4 && !IsValidDiagonal(0, 1)) continue;
+			if (i == 5 && !IsValidDiagonal(1, 2)) continue;
+			if (i == 6 && !IsValidDiagonal(2, 3)) continue;
+			if (i == 7 && !IsValidDiagonal(3, 0)) continue;
+		}
+
+		float heightDifference = FMath::Abs(currentCell.worldLoc.Z - neighborCell.worldLoc.Z);
+		float horizontalDistance = FVector2D::Distance(
+			FVector2D(currentCell.worldLoc.X, currentCell.worldLoc.Y),
+			FVector2D(neighborCell.worldLoc.X, neighborCell.worldLoc.Y)
+		);
+		float slopeAngle = FMath::RadiansToDegrees(FMath::Atan(heightDifference / horizontalDistance));
+
+		if (slopeAngle > maxWalkableAngle && currentCell.cost != 255) continue;
+
+		if (neighborCell.dist < bestDist)
+		{
+			hasBestCell = true;
+			bestCell = &neighborCell;
+			bestDist = neighborCell.dist;
+		}
+	}
+
+	if (hasBestCell)
+	{
+		currentCell.dir = UKismetMathLibrary::GetDirectionUnitVector(
+			currentCell.worldLoc,
+			bestCell->worldLoc
+		);
+	}
+	else
+	{
+		currentCell.dir = FVector::ZeroVector;
+	}
+}
+
+namespace FlowFieldIntegration
+{
+	// costs are integers in 0-255, so a ring of 256 buckets covers every pending distance (Dial's algorithm)
+	constexpr int32 NumBuckets = 256;
+	constexpr uint32 Unreached = 65535;
+
+	struct FNeighborOffset
+	{
+		int32 X;
+		int32 Y;
+		int32 GuardA;
+		int32 GuardB;
+	};
+
+	// same order as the priority queue mode. the first four of AdjacentFirst are diagonals guarded by two adjacent cells
+	static const FNeighborOffset AdjacentFirstOffsets[8] = {
+		{ 1,-1, 4, 5 }, { 1, 1, 5, 6 }, {-1, 1, 6, 7 }, {-1,-1, 7, 4 },
+		{ 0,-1,-1,-1 }, { 1, 0,-1,-1 }, { 0, 1,-1,-1 }, {-1, 0,-1,-1 }
+	};
+
+	static const FNeighborOffset DiagonalFirstOffsets[4] = {
+		{ 0,-1,-1,-1 }, { 1, 0,-1,-1 }, { 0, 1,-1,-1 }, {-1, 0,-1,-1 }
+	};
+}
+
+void AFlowField::SyncIntegrationFields(const TArray<FCellStruct>& InCurrentCellsArray)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE_STR("SyncIntegrationFields");
+
+	const int32 numCells = InCurrentCellsArray.Num();
+
+	CostField.SetNumUninitialized(numCells);
+	HeightField.SetNumUninitialized(numCells);
+	DistField.SetNumUninitialized(numCells);
+	GoalField.SetNumUninitialized(numCells);
+
+	TMap<FVector2D, int32> GoalIndices;
 
-				bool hasBestCell = false;
-				FCellStruct bestCell;
-				int32 bestDist = currentCell.dist;
+	for (int32 GoalIndex = 0; GoalIndex < GoalGridCoords.Num(); ++GoalIndex)
+	{
+		GoalIndices.FindOrAdd(GoalGridCoords[GoalIndex], GoalIndex);
+	}
+
+	for (int32 Index = 0; Index < numCells; ++Index)
+	{
+		const FCellStruct& Cell = InCurrentCellsArray[Index];
+		CostField[Index] = uint8(FMath::Clamp(Cell.cost, 0, 255));
+		HeightField[Index] = float(Cell.worldLoc.Z);
+
+		const bool bIsReached = Cell.dist < int32(FlowFieldIntegration::Unreached);
+		const int32* GoalIndex = bIsReached ? GoalIndices.Find(Cell.goalCoord) : nullptr;
+
+		DistField[Index] = GoalIndex ? uint32(Cell.dist) : FlowFieldIntegration::Unreached;
+		GoalField[Index] = GoalIndex ? *GoalIndex : INDEX_NONE;
+	}
+}
+
+void AFlowField::CalculateIntegrationFieldDial(TArray<FCellStruct>& InCurrentCellsArray)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE_STR("CreateIntegrationFieldDial");
+
+	using namespace FlowFieldIntegration;
+
+	const int32 numCells = InCurrentCellsArray.Num();
+
+	if (numCells == 0) return;
+
+	// compact SoA copy of what the integration needs
+	CostField.SetNumUninitialized(numCells);
+	HeightField.SetNumUninitialized(numCells);
+	DistField.Init(Unreached, numCells);
+	GoalField.Init(INDEX_NONE, numCells);
+
+	for (int32 Index = 0; Index < numCells; ++Index)
+	{
+		const FCellStruct& Cell = InCurrentCellsArray[Index];
+		CostField[Index] = uint8(FMath::Clamp(Cell.cost, 0, 255));
+		HeightField[Index] = float(Cell.worldLoc.Z);
+	}
+
+	// 初始化目标点
+	TArray<int32> Sources;
+
+	for (int32 GoalIndex = 0; GoalIndex < GoalGridCoords.Num(); ++GoalIndex)
+	{
+		const int32 Index = CoordToIndex(GoalGridCoords[GoalIndex]);
+		DistField[Index] = 0;
+		GoalField[Index] = GoalIndex;
+		Sources.Add(Index);
+	}
+
+	PropagateIntegrationField(DistField, GoalField, Sources, nullptr);
+
+	// write back into the cells
+	ParallelFor(numCells, [&](int32 Index)
+		{
+			if (GoalField[Index] == INDEX_NONE) return;
+
+			FCellStruct& Cell = InCurrentCellsArray[Index];
+			Cell.dist = int32(DistField[Index]);
+			Cell.goalCoord = GoalGridCoords[GoalField[Index]];
+		});
+}
+
+void AFlowField::PropagateIntegrationField(TArray<uint32>& InDistField, TArray<int32>& InGoalField, TArray<int32>& Sources, TBitArray<>* OutChanged)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE_STR("PropagateIntegrationField");
+
+	using namespace FlowFieldIntegration;
+
+	if (Sources.IsEmpty()) return;
+
+	// sources may start at any distance, they are fed into the ring once it reaches them
+	Sources.Sort([&InDistField](const int32 A, const int32 B) { return InDistField[A] < InDistField[B]; });
+
+	DistBuckets.SetNum(NumBuckets);
 
-				std::vector<FVector2D> neighborCoords =
+	for (TArray<int32>& Bucket : DistBuckets)
+	{
+		Bucket.Reset();
+	}
+
+	const FNeighborOffset* Offsets = Style == EStyle::AdjacentFirst ? AdjacentFirstOffsets : DiagonalFirstOffsets;
+	const int32 NumOffsets = Style == EStyle::AdjacentFirst ? 8 : 4;
+
+	// the slope test compares height difference against horizontal distance * tan(maxWalkableAngle)
+	const float MaxSlope = maxWalkableAngle >= 90.f ? FLT_MAX : FMath::Tan(FMath::DegreesToRadians(maxWalkableAngle));
+	const float MaxRiseAdjacent = cellSize * MaxSlope;
+	const float MaxRiseDiagonal = cellSize * UE_SQRT_2 * MaxSlope;
+
+	int32 Pending = Sources.Num();
+	int32 NextSource = 0;
+
+	// 计算积分场
+	for (uint32 CurrentDist = InDistField[Sources[0]]; Pending > 0; ++CurrentDist)
+	{
+		TArray<int32>& Bucket = DistBuckets[CurrentDist % NumBuckets];
+
+		while (NextSource < Sources.Num() && InDistField[Sources[NextSource]] <= CurrentDist)
+		{
+			Bucket.Add(Sources[NextSource++]);
+		}
+
+		// zero cost neighbors land in the same bucket, so iterate by index while it grows
+		for (int32 BucketIndex = 0; BucketIndex < Bucket.Num(); ++BucketIndex)
+		{
+			const int32 CurrentIndex = Bucket[BucketIndex];
+			--Pending;
+
+			// 跳过已更新的过时节点
+			if (InDistField[CurrentIndex] != CurrentDist) continue;
+
+			const int32 CurrentX = CurrentIndex / yNum;
+			const int32 CurrentY = CurrentIndex % yNum;
+			const bool bCurrentIsObstacle = CostField[CurrentIndex] == 255;
+			const float CurrentHeight = HeightField[CurrentIndex];
+
+			auto IsBlockedAt = [&](const FNeighborOffset& Offset) -> bool
 				{
-					currentCoord + FVector2D(0,-1),
-					currentCoord + FVector2D(1,0),
-					currentCoord + FVector2D(0,1),
-					currentCoord + FVector2D(-1,0),
-					currentCoord + FVector2D(1,-1),
-					currentCoord + FVector2D(1,1),
-					currentCoord + FVector2D(-1,1),
-					currentCoord + FVector2D(-1,-1),
+					const int32 X = CurrentX + Offset.X;
+					const int32 Y = CurrentY + Offset.Y;
+					return X >= 0 && X < xNum && Y >= 0 && Y < yNum && CostField[X * yNum + Y] == 255;
 				};
 
-				for (int32 i = 0; i < 8; i++)
-				{
-					FVector2D neighborCoord = neighborCoords[i];
+			for (int32 i = 0; i < NumOffsets; ++i)
+			{
+				const FNeighborOffset& Offset = Offsets[i];
+				const int32 NeighborX = CurrentX + Offset.X;
+				const int32 NeighborY = CurrentY + Offset.Y;
 
-					if (!IsValidCoord(neighborCoord)) continue;
+				if (NeighborX < 0 || NeighborX >= xNum || NeighborY < 0 || NeighborY >= yNum) continue;
 
-					FCellStruct& neighborCell = InCurrentCellsArray[CoordToIndex(neighborCoord)];
+				const int32 NeighborIndex = NeighborX * yNum + NeighborY;
+				const uint8 NeighborCost = CostField[NeighborIndex];
 
-					if (bIgnoreInternalObstacleCells && neighborCell.cost == 255) continue;
+				if (bIgnoreInternalObstacleCells && NeighborCost == 255) continue;
 
-					if (currentCell.cost != 255)
-					{
-						if (i == 4 && !IsValidDiagonal(neighborCoords, 0, 1)) continue;
-						if (i == 5 && !IsValidDiagonal(neighborCoords, 1, 2)) continue;
-						if (i == 6 && !IsValidDiagonal(neighborCoords, 2, 3)) continue;
-						if (i == 7 && !IsValidDiagonal(neighborCoords, 3, 0)) continue;
-					}
+				if (Offset.GuardA != INDEX_NONE && (IsBlockedAt(Offsets[Offset.GuardA]) || IsBlockedAt(Offsets[Offset.GuardB]))) continue;
+
+				const float MaxRise = (Offset.X != 0 && Offset.Y != 0) ? MaxRiseDiagonal : MaxRiseAdjacent;
 
-					float heightDifference = FMath::Abs(currentCell.worldLoc.Z - neighborCell.worldLoc.Z);
-					float horizontalDistance = FVector2D::Distance(
-						FVector2D(currentCell.worldLoc.X, currentCell.worldLoc.Y),
-						FVector2D(neighborCell.worldLoc.X, neighborCell.worldLoc.Y)
-					);
-					float slopeAngle = FMath::RadiansToDegrees(FMath::Atan(heightDifference / horizontalDistance));
+				if (FMath::Abs(CurrentHeight - HeightField[NeighborIndex]) > MaxRise && !bCurrentIsObstacle) continue;
 
-					if (slopeAngle > maxWalkableAngle && currentCell.cost != 255) continue;
+				const uint32 NewDist = CurrentDist + NeighborCost;
 
-					if (neighborCell.dist < bestDist)
+				if (NewDist < InDistField[NeighborIndex])
+				{
+					InDistField[NeighborIndex] = NewDist;
+					InGoalField[NeighborIndex] = InGoalField[CurrentIndex]; // 继承当前节点的目标坐标
+					DistBuckets[NewDist % NumBuckets].Add(NeighborIndex);
+					++Pending;
+
+					if (OutChanged)
 					{
-						hasBestCell = true;
-						bestCell = neighborCell;
-						bestDist = neighborCell.dist;
+						(*OutChanged)[NeighborIndex] = true;
 					}
 				}
+			}
+		}
 
-				if (hasBestCell)
+		Bucket.Reset();
+	}
+}
+
+void AFlowField::MarkRegionDirty(const FBox& WorldBox)
+{
+	if (xNum <= 0 || yNum <= 0 || !WorldBox.IsValid) return;
+
+	int32 MinX = MAX_int32;
+	int32 MinY = MAX_int32;
+	int32 MaxX = MIN_int32;
+	int32 MaxY = MIN_int32;
+
+	// the grid can be rotated, so bound all four corners in grid space
+	const FVector Corners[4] = {
+		FVector(WorldBox.Min.X, WorldBox.Min.Y, 0),
+		FVector(WorldBox.Max.X, WorldBox.Min.Y, 0),
+		FVector(WorldBox.Min.X, WorldBox.Max.Y, 0),
+		FVector(WorldBox.Max.X, WorldBox.Max.Y, 0)
+	};
+
+	for (const FVector& Corner : Corners)
+	{
+		const FVector relativeLocation = (Corner - FVector(actorLoc.X, actorLoc.Y, 0)).RotateAngleAxis(-actorRot.Yaw, FVector(0, 0, 1)) + offsetLoc;
+		const int32 X = FMath::FloorToInt(relativeLocation.X / cellSize);
+		const int32 Y = FMath::FloorToInt(relativeLocation.Y / cellSize);
+
+		MinX = FMath::Min(MinX, X);
+		MinY = FMath::Min(MinY, Y);
+		MaxX = FMath::Max(MaxX, X);
+		MaxY = FMath::Max(MaxY, Y);
+	}
+
+	// outside grid?
+	if (MaxX < 0 || MaxY < 0 || MinX >= xNum || MinY >= yNum) return;
+
+	DirtyCellRects.Add(FIntRect(FMath::Max(MinX, 0), FMath::Max(MinY, 0), FMath::Min(MaxX, xNum - 1), FMath::Min(MaxY, yNum - 1)));
+}
+
+void AFlowField::RequeryDirtyCells(TBitArray<>* OutDirty)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE_STR("RequeryDirtyCells");
+
+	const int32 numCells = InitialCellsArray.Num();
+
+	if (DirtyCellRects.IsEmpty() || numCells != xNum * yNum) return;
+
+	// rects may overlap, query every cell once
+	TBitArray<> Dirty(false, numCells);
+
+	for (const FIntRect& Rect : DirtyCellRects)
+	{
+		for (int32 x = FMath::Max(Rect.Min.X, 0); x <= FMath::Min(Rect.Max.X, xNum - 1); ++x)
+		{
+			for (int32 y = FMath::Max(Rect.Min.Y, 0); y <= FMath::Min(Rect.Max.Y, yNum - 1); ++y)
+			{
+				Dirty[x * yNum + y] = true;
+			}
+		}
+	}
+
+	const bool bHasCurrent = CurrentCellsArray.Num() == numCells;
+	const bool bHasCompact = CostField.Num() == numCells && HeightField.Num() == numCells;
+
+	TArray<int32> DirtyIndices;
+
+	for (TConstSetBitIterator<> It(Dirty); It; ++It)
+	{
+		DirtyIndices.Add(It.GetIndex());
+	}
+
+	QueryCells(InitialCellsArray, DirtyIndices);
+
+	for (const int32 Index : DirtyIndices)
+	{
+		const FCellStruct& NewCell = InitialCellsArray[Index];
+
+		if (bHasCurrent)
+		{
+			FCellStruct& Cell = CurrentCellsArray[Index];
+			Cell.cost = NewCell.cost;
+			Cell.type = NewCell.type;
+			Cell.worldLoc = NewCell.worldLoc;
+			Cell.normal = NewCell.normal;
+		}
+
+		if (bHasCompact)
+		{
+			CostField[Index] = uint8(FMath::Clamp(NewCell.cost, 0, 255));
+			HeightField[Index] = float(NewCell.worldLoc.Z);
+		}
+
+		if (OutDirty)
+		{
+			(*OutDirty)[Index] = true;
+		}
+	}
+}
+
+bool AFlowField::CanRepairFlowField() const
+{
+	const int32 numCells = xNum * yNum;
+
+	if (!bIncrementalRepair || bIsBeginPlay || bIsGridDirty) return false;
+
+	if (InitialCellsArray.Num() != numCells || CurrentCellsArray.Num() != numCells) return false;
+
+	if (CostField.Num() != numCells || HeightField.Num() != numCells || DistField.Num() != numCells || GoalField.Num() != numCells) return false;
+
+	// moved goals change the whole field
+	return GoalGridCoords == LastGoalGridCoords;
+}
+
+bool AFlowField::RepairFlowField()
+{
+	if (!CanRepairFlowField()) return false;
+
+	// nothing changed since the last refresh
+	if (DirtyCellRects.IsEmpty()) return true;
+
+	TBitArray<> Changed(false, xNum * yNum);
+
+	RequeryDirtyCells(&Changed);
+
+	RepairCells(CurrentCellsArray, Changed);
+
+	return true;
+}
+
+void AFlowField::RepairCells(TArray<FCellStruct>& InCellsArray, TBitArray<>& Changed)
+{
+	using namespace FlowFieldIntegration;
+
+	TRACE_CPUPROFILER_EVENT_SCOPE_STR("RepairFlowField");
+
+	const int32 numCells = xNum * yNum;
+
+	auto ForEachNeighbor = [this](const int32 Index, auto&& Func)
+		{
+			const int32 X = Index / yNum;
+			const int32 Y = Index % yNum;
+
+			for (int32 dx = -1; dx <= 1; ++dx)
+			{
+				for (int32 dy = -1; dy <= 1; ++dy)
 				{
-					currentCell.dir = UKismetMathLibrary::GetDirectionUnitVector(
-						currentCell.worldLoc,
-						bestCell.worldLoc
-					);
+					if (dx == 0 && dy == 0) continue;
+
+					const int32 NeighborX = X + dx;
+					const int32 NeighborY = Y + dy;
+
+					if (NeighborX < 0 || NeighborX >= xNum || NeighborY < 0 || NeighborY >= yNum) continue;
+
+					Func(NeighborX * yNum + NeighborY);
 				}
-				else
+			}
+		};
+
+	// 1. invalidate the changed cells, their neighbors (diagonal guards and slopes depend on them)
+	// and every cell whose distance may have flowed through them
+	TBitArray<> Invalid(false, numCells);
+	TArray<int32> Stack;
+
+	for (TConstSetBitIterator<> It(Changed); It; ++It)
+	{
+		const int32 Index = It.GetIndex();
+
+		if (!Invalid[Index])
+		{
+			Invalid[Index] = true;
+			Stack.Add(Index);
+		}
+
+		ForEachNeighbor(Index, [&](const int32 NeighborIndex)
+			{
+				if (!Invalid[NeighborIndex])
+				{
+					Invalid[NeighborIndex] = true;
+					Stack.Add(NeighborIndex);
+				}
+			});
+	}
+
+	while (Stack.Num() > 0)
+	{
+		const int32 Index = Stack.Pop(EAllowShrinking::No);
+		const uint32 Dist = DistField[Index];
+
+		if (Dist == Unreached) continue;
+
+		ForEachNeighbor(Index, [&](const int32 NeighborIndex)
+			{
+				// a tight edge means the neighbor may have been reached through this cell
+				if (!Invalid[NeighborIndex] && DistField[NeighborIndex] != Unreached && DistField[NeighborIndex] == Dist + CostField[NeighborIndex])
+				{
+					Invalid[NeighborIndex] = true;
+					Stack.Add(NeighborIndex);
+				}
+			});
+	}
+
+	// 2. reset the invalidated cells and re-propagate from the valid cells around them
+	TArray<int32> Sources;
+	TBitArray<> IsSource(false, numCells);
+
+	for (TConstSetBitIterator<> It(Invalid); It; ++It)
+	{
+		const int32 Index = It.GetIndex();
+		DistField[Index] = Unreached;
+		GoalField[Index] = INDEX_NONE;
+		Changed[Index] = true;
+	}
+
+	for (int32 GoalIndex = 0; GoalIndex < GoalGridCoords.Num(); ++GoalIndex)
+	{
+		const int32 Index = CoordToIndex(GoalGridCoords[GoalIndex]);
+
+		if (Invalid[Index] && !IsSource[Index])
+		{
+			DistField[Index] = 0;
+			GoalField[Index] = GoalIndex;
+			IsSource[Index] = true;
+			Sources.Add(Index);
+		}
+	}
+
+	for (TConstSetBitIterator<> It(Invalid); It; ++It)
+	{
+		ForEachNeighbor(It.GetIndex(), [&](const int32 NeighborIndex)
+			{
+				if (!Invalid[NeighborIndex] && !IsSource[NeighborIndex] && DistField[NeighborIndex] != Unreached)
+				{
+					IsSource[NeighborIndex] = true;
+					Sources.Add(NeighborIndex);
+				}
+			});
+	}
+
+	PropagateIntegrationField(DistField, GoalField, Sources, &Changed);
+
+	// 3. write back the changed cells and recompute directions around them
+	TArray<int32> DirCells;
+	TBitArray<> IsDirCell(false, numCells);
+
+	for (TConstSetBitIterator<> It(Changed); It; ++It)
+	{
+		const int32 Index = It.GetIndex();
+		FCellStruct& Cell = InCellsArray[Index];
+
+		if (GoalField[Index] == INDEX_NONE)
+		{
+			Cell.dist = int32(Unreached);
+			Cell.goalCoord = FVector2D(0, 0);
+		}
+		else
+		{
+			Cell.dist = int32(DistField[Index]);
+			Cell.goalCoord = GoalGridCoords[GoalField[Index]];
+		}
+
+		if (!IsDirCell[Index])
+		{
+			IsDirCell[Index] = true;
+			DirCells.Add(Index);
+		}
+
+		ForEachNeighbor(Index, [&](const int32 NeighborIndex)
+			{
+				if (!IsDirCell[NeighborIndex])
 				{
-					currentCell.dir = FVector::ZeroVector;
+					IsDirCell[NeighborIndex] = true;
+					DirCells.Add(NeighborIndex);
 				}
 			});
 	}
+
+	ParallelFor(DirCells.Num(), [&](int32 i)
+		{
+			CalculateCellDirection(InCellsArray, DirCells[i]);
+		});
+}
+
+FFlowFieldGoalLayerHandle AFlowField::AcquireGoalLayer(const TArray<FVector>& GoalWorldLocations)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE_STR("AcquireGoalLayer");
+
+	FFlowFieldGoalLayerHandle Handle;
+
+	if (bIsBeginPlay || GoalWorldLocations.IsEmpty()) return Handle;
+
+	// layers share the compact fields and the bucket ring with the background refresh
+	if (PendingUpdate.IsValid())
+	{
+		PendingUpdate.Wait();
+		FinishAsyncUpdate();
+	}
+
+	// quantize the goals into the cache key
+	const int32 Quantization = FMath::Max(GoalLayerQuantization, 1);
+	TArray<FIntPoint> GoalCells;
+
+	for (const FVector& Location : GoalWorldLocations)
+	{
+		FVector2D GridCoord;
+		WorldToGrid(Location, GridCoord);
+
+		const int32 X = FMath::Min(int32(GridCoord.X) / Quantization * Quantization + Quantization / 2, xNum - 1);
+		const int32 Y = FMath::Min(int32(GridCoord.Y) / Quantization * Quantization + Quantization / 2, yNum - 1);
+
+		GoalCells.AddUnique(FIntPoint(X, Y));
+	}
+
+	GoalCells.Sort([](const FIntPoint& A, const FIntPoint& B) { return A.X != B.X ? A.X < B.X : A.Y < B.Y; });
+
+	FFlowFieldGoalLayer* Layer = nullptr;
+
+	for (const TUniquePtr<FFlowFieldGoalLayer>& CachedLayer : GoalLayers)
+	{
+		if (CachedLayer->GoalCells == GoalCells)
+		{
+			Layer = CachedLayer.Get();
+			break;
+		}
+	}
+
+	if (!Layer)
+	{
+		Layer = GoalLayers.Add_GetRef(MakeUnique<FFlowFieldGoalLayer>()).Get();
+		Layer->LayerId = NextGoalLayerId++;
+		Layer->GoalCells = MoveTemp(GoalCells);
+	}
+
+	Layer->LastUsed.Store(GoalLayerClock, EMemoryOrder::Relaxed);
+
+	if (Layer->FieldVersion != FieldVersion || Layer->DirField.Num() != CurrentCellsArray.Num())
+	{
+		BuildGoalLayer(*Layer);
+	}
+
+	EvictGoalLayers(Layer);
+
+	Handle.LayerId = Layer->LayerId;
+
+	return Handle;
+}
+
+void AFlowField::ReleaseGoalLayer(const FFlowFieldGoalLayerHandle& Handle)
+{
+	GoalLayers.RemoveAllSwap([&Handle](const TUniquePtr<FFlowFieldGoalLayer>& Layer) { return Layer->LayerId == Handle.LayerId; });
+}
+
+void AFlowField::BuildGoalLayer(FFlowFieldGoalLayer& Layer)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE_STR("BuildGoalLayer");
+
+	using namespace FlowFieldIntegration;
+
+	const int32 numCells = xNum * yNum;
+
+	Layer.FieldVersion = FieldVersion;
+
+	if (numCells == 0 || CurrentCellsArray.Num() != numCells || CostField.Num() != numCells || HeightField.Num() != numCells)
+	{
+		Layer.DistField.Empty();
+		Layer.GoalField.Empty();
+		Layer.DirField.Empty();
+		return;
+	}
+
+	Layer.DistField.Init(Unreached, numCells);
+	Layer.GoalField.Init(INDEX_NONE, numCells);
+
+	TArray<int32> Sources;
+
+	for (int32 GoalIndex = 0; GoalIndex < Layer.GoalCells.Num(); ++GoalIndex)
+	{
+		const int32 Index = Layer.GoalCells[GoalIndex].X * yNum + Layer.GoalCells[GoalIndex].Y;
+		Layer.DistField[Index] = 0;
+		Layer.GoalField[Index] = GoalIndex;
+		Sources.Add(Index);
+	}
+
+	PropagateIntegrationField(Layer.DistField, Layer.GoalField, Sources, nullptr);
+
+	Layer.DirField.SetNumUninitialized(numCells);
+
+	ParallelFor(numCells, [&](int32 Index)
+		{
+			CalculateLayerDirection(Layer, Index);
+		});
+}
+
+void AFlowField::RefreshGoalLayers()
+{
+	// layers looked up since the last refresh follow the new field right away, idle ones when they are used again
+	for (const TUniquePtr<FFlowFieldGoalLayer>& Layer : GoalLayers)
+	{
+		if (Layer->LastUsed.Load(EMemoryOrder::Relaxed) == GoalLayerClock && Layer->FieldVersion != FieldVersion)
+		{
+			BuildGoalLayer(*Layer);
+		}
+	}
+
+	++GoalLayerClock;
+}
+
+void AFlowField::EvictGoalLayers(const FFlowFieldGoalLayer* LayerToKeep)
+{
+	const SIZE_T Budget = SIZE_T(FMath::Max(GoalLayerBudgetMB, 0.f) * 1024.f * 1024.f);
+
+	SIZE_T TotalSize = 0;
+
+	for (const TUniquePtr<FFlowFieldGoalLayer>& Layer : GoalLayers)
+	{
+		TotalSize += Layer->GetAllocatedSize();
+	}
+
+	// least recently used first, the layer just acquired always stays
+	while (TotalSize > Budget && GoalLayers.Num() > 1)
+	{
+		int32 OldestIndex = INDEX_NONE;
+		uint32 OldestUse = MAX_uint32;
+
+		for (int32 i = 0; i < GoalLayers.Num(); ++i)
+		{
+			const uint32 LastUsed = GoalLayers[i]->LastUsed.Load(EMemoryOrder::Relaxed);
+
+			if (GoalLayers[i].Get() != LayerToKeep && LastUsed < OldestUse)
+			{
+				OldestIndex = i;
+				OldestUse = LastUsed;
+			}
+		}
+
+		if (OldestIndex == INDEX_NONE) break;
+
+		TotalSize -= GoalLayers[OldestIndex]->GetAllocatedSize();
+		GoalLayers.RemoveAtSwap(OldestIndex);
+	}
+}
+
+void AFlowField::CalculateLayerDirection(FFlowFieldGoalLayer& Layer, const int32 CellIndex) const
+{
+	using namespace FlowFieldIntegration;
+
+	// same neighbor order and diagonal guards as CalculateCellDirection
+	static const FNeighborOffset DirectionOffsets[8] = {
+		{ 0,-1,-1,-1 }, { 1, 0,-1,-1 }, { 0, 1,-1,-1 }, {-1, 0,-1,-1 },
+		{ 1,-1, 0, 1 }, { 1, 1, 1, 2 }, {-1, 1, 2, 3 }, {-1,-1, 3, 0 }
+	};
+
+	const float MaxSlope = maxWalkableAngle >= 90.f ? FLT_MAX : FMath::Tan(FMath::DegreesToRadians(maxWalkableAngle));
+
+	const int32 CurrentX = CellIndex / yNum;
+	const int32 CurrentY = CellIndex % yNum;
+	const bool bCurrentIsObstacle = CostField[CellIndex] == 255;
+	const float CurrentHeight = HeightField[CellIndex];
+
+	auto IsBlockedAt = [&](const FNeighborOffset& Offset) -> bool
+		{
+			const int32 X = CurrentX + Offset.X;
+			const int32 Y = CurrentY + Offset.Y;
+			return X >= 0 && X < xNum && Y >= 0 && Y < yNum && CostField[X * yNum + Y] == 255;
+		};
+
+	int32 BestIndex = INDEX_NONE;
+	uint32 BestDist = Layer.DistField[CellIndex];
+
+	for (const FNeighborOffset& Offset : DirectionOffsets)
+	{
+		const int32 NeighborX = CurrentX + Offset.X;
+		const int32 NeighborY = CurrentY + Offset.Y;
+
+		if (NeighborX < 0 || NeighborX >= xNum || NeighborY < 0 || NeighborY >= yNum) continue;
+
+		const int32 NeighborIndex = NeighborX * yNum + NeighborY;
+
+		if (bIgnoreInternalObstacleCells && CostField[NeighborIndex] == 255) continue;
+
+		if (!bCurrentIsObstacle && Offset.GuardA != INDEX_NONE && (IsBlockedAt(DirectionOffsets[Offset.GuardA]) || IsBlockedAt(DirectionOffsets[Offset.GuardB]))) continue;
+
+		const float MaxRise = cellSize * ((Offset.X != 0 && Offset.Y != 0) ? UE_SQRT_2 : 1.f) * MaxSlope;
+
+		if (FMath::Abs(CurrentHeight - HeightField[NeighborIndex]) > MaxRise && !bCurrentIsObstacle) continue;
+
+		if (Layer.DistField[NeighborIndex] < BestDist)
+		{
+			BestIndex = NeighborIndex;
+			BestDist = Layer.DistField[NeighborIndex];
+		}
+	}
+
+	Layer.DirField[CellIndex] = BestIndex == INDEX_NONE
+		? FVector3f::ZeroVector
+		: FVector3f((CurrentCellsArray[BestIndex].worldLoc - CurrentCellsArray[CellIndex].worldLoc).GetSafeNormal());
+}
+
+void AFlowField::BuildPackedField()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE_STR("BuildPackedField");
+
+	const int32 numCells = CurrentCellsArray.Num();
+
+	// grid neighbor of each direction index, turned into world space
+	static const FIntPoint DirOffsets[8] = { {0,-1}, {1,0}, {0,1}, {-1,0}, {1,-1}, {1,1}, {-1,1}, {-1,-1} };
+
+	for (int32 i = 0; i < 8; ++i)
+	{
+		PackedDirTable[i] = FVector3f(FVector(DirOffsets[i].X, DirOffsets[i].Y, 0).RotateAngleAxis(actorRot.Yaw, FVector(0, 0, 1)).GetSafeNormal());
+	}
+
+	float MinHeight = FLT_MAX;
+	float MaxHeight = -FLT_MAX;
+
+	for (const FCellStruct& Cell : CurrentCellsArray)
+	{
+		if (Cell.type == ECellType::Empty) continue;
+
+		MinHeight = FMath::Min(MinHeight, float(Cell.worldLoc.Z));
+		MaxHeight = FMath::Max(MaxHeight, float(Cell.worldLoc.Z));
+	}
+
+	PackedHeightMin = MinHeight <= MaxHeight ? MinHeight : 0.f;
+	PackedHeightStep = MinHeight < MaxHeight ? (MaxHeight - MinHeight) / float(PackedEmptyHeight - 1) : 1.f;
+
+	PackedHeights.SetNumUninitialized(numCells);
+	PackedNormals.SetNumUninitialized(numCells);
+	PackedDirs.SetNumUninitialized(numCells);
+
+	ParallelFor(numCells, [&](int32 Index)
+		{
+			const FCellStruct& Cell = CurrentCellsArray[Index];
+
+			PackedHeights[Index] = Cell.type == ECellType::Empty
+				? PackedEmptyHeight
+				: uint16(FMath::Clamp(FMath::RoundToInt((float(Cell.worldLoc.Z) - PackedHeightMin) / PackedHeightStep), 0, PackedEmptyHeight - 1));
+
+			// octahedral encode, 8 bits per axis
+			FVector3f Normal = FVector3f(Cell.normal);
+			Normal /= FMath::Max(FMath::Abs(Normal.X) + FMath::Abs(Normal.Y) + FMath::Abs(Normal.Z), UE_SMALL_NUMBER);
+
+			if (Normal.Z < 0.f)
+			{
+				const float X = Normal.X;
+				Normal.X = (1.f - FMath::Abs(Normal.Y)) * (X >= 0.f ? 1.f : -1.f);
+				Normal.Y = (1.f - FMath::Abs(X)) * (Normal.Y >= 0.f ? 1.f : -1.f);
+			}
+
+			const uint16 OctX = uint16(FMath::Clamp(FMath::RoundToInt((Normal.X + 1.f) * 127.5f), 0, 255));
+			const uint16 OctY = uint16(FMath::Clamp(FMath::RoundToInt((Normal.Y + 1.f) * 127.5f), 0, 255));
+			PackedNormals[Index] = OctX | (OctY << 8);
+
+			// directions always point at one of the 8 neighbors, so an index is enough
+			const FVector GridDir = Cell.dir.RotateAngleAxis(-actorRot.Yaw, FVector(0, 0, 1)).GetSafeNormal2D();
+
+			if (GridDir.IsNearlyZero())
+			{
+				PackedDirs[Index] = PackedNoDir;
+				return;
+			}
+
+			// sin(22.5)
+			const int32 dx = GridDir.X > 0.38268f ? 1 : (GridDir.X < -0.38268f ? -1 : 0);
+			const int32 dy = GridDir.Y > 0.38268f ? 1 : (GridDir.Y < -0.38268f ? -1 : 0);
+
+			PackedDirs[Index] = PackedNoDir;
+
+			for (int32 i = 0; i < 8; ++i)
+			{
+				if (DirOffsets[i].X == dx && DirOffsets[i].Y == dy)
+				{
+					PackedDirs[Index] = uint8(i);
+					break;
+				}
+			}
+		});
+}
+
+void AFlowField::SampleBatch(TConstArrayView<FVector> Locations, const float AngleThreshold, TArrayView<FFlowFieldSample> OutSamples) const
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE_STR("SampleBatch");
+
+	check(OutSamples.Num() >= Locations.Num());
+
+	const int32 numCells = xNum * yNum;
+
+	if (bIsBeginPlay || numCells == 0 || PackedHeights.Num() != numCells)
+	{
+		for (int32 i = 0; i < Locations.Num(); ++i)
+		{
+			OutSamples[i] = FFlowFieldSample();
+		}
+
+		return;
+	}
+
+	const float Yaw = FMath::DegreesToRadians(float(actorRot.Yaw));
+	const float CosYaw = FMath::Cos(Yaw);
+	const float SinYaw = FMath::Sin(Yaw);
+	const float InvCellSize = 1.f / cellSize;
+	const float MaxSlope = AngleThreshold >= 90.f ? FLT_MAX : FMath::Tan(FMath::DegreesToRadians(FMath::Max(AngleThreshold, 0.f)));
+
+	// grid = (rotate(-yaw, location - actorLoc) + offsetLoc - cellRadius) / cellSize
+	const VectorRegister4Float VCos = VectorSetFloat1(CosYaw);
+	const VectorRegister4Float VSin = VectorSetFloat1(SinYaw);
+	const VectorRegister4Float VInvCellSize = VectorSetFloat1(InvCellSize);
+	const VectorRegister4Float VOffsetX = VectorSetFloat1((float(offsetLoc.X) - cellSize * 0.5f) * InvCellSize);
+	const VectorRegister4Float VOffsetY = VectorSetFloat1((float(offsetLoc.Y) - cellSize * 0.5f) * InvCellSize);
+
+	for (int32 Begin = 0; Begin < Locations.Num(); Begin += 4)
+	{
+		const int32 NumLanes = FMath::Min(4, Locations.Num() - Begin);
+
+		alignas(16) float RelX[4];
+		alignas(16) float RelY[4];
+
+		// relative to the actor in double, the rest fits in float. tail lanes repeat the last location
+		for (int32 Lane = 0; Lane < 4; ++Lane)
+		{
+			const FVector& Location = Locations[Begin + FMath::Min(Lane, NumLanes - 1)];
+			RelX[Lane] = float(Location.X - actorLoc.X);
+			RelY[Lane] = float(Location.Y - actorLoc.Y);
+		}
+
+		const VectorRegister4Float VRelX = VectorLoadAligned(RelX);
+		const VectorRegister4Float VRelY = VectorLoadAligned(RelY);
+
+		const VectorRegister4Float VGridX = VectorMultiplyAdd(VectorAdd(VectorMultiply(VRelX, VCos), VectorMultiply(VRelY, VSin)), VInvCellSize, VOffsetX);
+		const VectorRegister4Float VGridY = VectorMultiplyAdd(VectorSubtract(VectorMultiply(VRelY, VCos), VectorMultiply(VRelX, VSin)), VInvCellSize, VOffsetY);
+
+		const VectorRegister4Float VBaseX = VectorFloor(VGridX);
+		const VectorRegister4Float VBaseY = VectorFloor(VGridY);
+		const VectorRegister4Float VFracX = VectorSubtract(VGridX, VBaseX);
+		const VectorRegister4Float VFracY = VectorSubtract(VGridY, VBaseY);
+
+		alignas(16) float GridX[4];
+		alignas(16) float GridY[4];
+		alignas(16) float BaseX[4];
+		alignas(16) float BaseY[4];
+		VectorStoreAligned(VGridX, GridX);
+		VectorStoreAligned(VGridY, GridY);
+		VectorStoreAligned(VBaseX, BaseX);
+		VectorStoreAligned(VBaseY, BaseY);
+
+		// gather the four corners of every lane
+		alignas(16) float H00[4];
+		alignas(16) float H10[4];
+		alignas(16) float H01[4];
+		alignas(16) float H11[4];
+		bool bIsInside[4];
+
+		for (int32 Lane = 0; Lane < 4; ++Lane)
+		{
+			const int32 X = int32(BaseX[Lane]);
+			const int32 Y = int32(BaseY[Lane]);
+
+			bIsInside[Lane] = X >= 0 && X + 1 < xNum && Y >= 0 && Y + 1 < yNum;
+
+			if (!bIsInside[Lane])
+			{
+				H00[Lane] = H10[Lane] = H01[Lane] = H11[Lane] = 0.f;
+				continue;
+			}
+
+			const int32 Index00 = X * yNum + Y;
+			const uint16 Q[4] = { PackedHeights[Index00], PackedHeights[Index00 + yNum], PackedHeights[Index00 + 1], PackedHeights[Index00 + yNum + 1] };
+
+			// empty cells have no ground
+			bIsInside[Lane] = Q[0] != PackedEmptyHeight && Q[1] != PackedEmptyHeight && Q[2] != PackedEmptyHeight && Q[3] != PackedEmptyHeight;
+
+			H00[Lane] = PackedHeightMin + float(Q[0]) * PackedHeightStep;
+			H10[Lane] = PackedHeightMin + float(Q[1]) * PackedHeightStep;
+			H01[Lane] = PackedHeightMin + float(Q[2]) * PackedHeightStep;
+			H11[Lane] = PackedHeightMin + float(Q[3]) * PackedHeightStep;
+		}
+
+		const VectorRegister4Float V00 = VectorLoadAligned(H00);
+		const VectorRegister4Float V10 = VectorLoadAligned(H10);
+		const VectorRegister4Float V01 = VectorLoadAligned(H01);
+		const VectorRegister4Float V11 = VectorLoadAligned(H11);
+
+		const VectorRegister4Float VBottom = VectorMultiplyAdd(VectorSubtract(V10, V00), VFracX, V00);
+		const VectorRegister4Float VTop = VectorMultiplyAdd(VectorSubtract(V11, V01), VFracX, V01);
+		const VectorRegister4Float VHeight = VectorMultiplyAdd(VectorSubtract(VTop, VBottom), VFracY, VBottom);
+
+		alignas(16) float Height[4];
+		alignas(16) float FracX[4];
+		alignas(16) float FracY[4];
+		VectorStoreAligned(VHeight, Height);
+		VectorStoreAligned(VFracX, FracX);
+		VectorStoreAligned(VFracY, FracY);
+
+		for (int32 Lane = 0; Lane < NumLanes; ++Lane)
+		{
+			const FVector& Location = Locations[Begin + Lane];
+			FFlowFieldSample& Sample = OutSamples[Begin + Lane];
+
+			const int32 NearestIndex = FMath::Clamp(FMath::RoundToInt(GridX[Lane]), 0, xNum - 1) * yNum + FMath::Clamp(FMath::RoundToInt(GridY[Lane]), 0, yNum - 1);
+
+			Sample.GroundLocation = FVector(Location.X, Location.Y, Height[Lane]);
+			Sample.Direction = GetPackedDirection(NearestIndex);
+			Sample.Normal = GetPackedNormal(NearestIndex);
+			Sample.bIsValid = bIsInside[Lane];
+
+			if (!Sample.bIsValid) continue;
+
+			// steepest slope towards the four corners
+			const float Corners[4] = { H00[Lane], H10[Lane], H01[Lane], H11[Lane] };
+			const float CornerFracX[4] = { FracX[Lane], 1.f - FracX[Lane], FracX[Lane], 1.f - FracX[Lane] };
+			const float CornerFracY[4] = { FracY[Lane], FracY[Lane], 1.f - FracY[Lane], 1.f - FracY[Lane] };
+
+			for (int32 Corner = 0; Corner < 4; ++Corner)
+			{
+				const float HorizontalDistance = cellSize * FMath::Sqrt(FMath::Square(CornerFracX[Corner]) + FMath::Square(CornerFracY[Corner]));
+
+				if (FMath::Abs(Corners[Corner] - Height[Lane]) > HorizontalDistance * MaxSlope)
+				{
+					Sample.bIsValid = false;
+					break;
+				}
+			}
+		}
+	}
 }
 
 void AFlowField::DrawCells(EInitMode InitMode)
@@ -634,9 +1877,7 @@ FCellStruct AFlowField::EnvQuery(const FVector2D gridCoord)
 
 	newCell.gridCoord = gridCoord;
 
-	FVector2D worldLoc2D = FVector2D(gridCoord.X * cellSize + relativeLoc.X + (cellSize / 2.f), gridCoord.Y * cellSize + relativeLoc.Y + (cellSize / 2.f));
-	FVector worldLoc = FVector(worldLoc2D, actorLoc.Z);
-	worldLoc = (worldLoc - actorLoc).RotateAngleAxis(actorRot.Yaw, FVector(0, 0, 1)) + actorLoc;
+	FVector worldLoc = GridToWorld(gridCoord);
 
 	// Array of actors for trace to ignore
 	TArray<TObjectPtr<AActor>> IgnoreActors;
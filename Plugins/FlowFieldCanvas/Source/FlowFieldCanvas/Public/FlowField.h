@@ -16,10 +16,12 @@
 #include "Engine/World.h"
 #include "Async/ParallelFor.h"
 #include "Templates/Atomic.h"
+#include "Async/Future.h"
 #include "Components/InstancedStaticMeshComponent.h"
 #include "Components/DecalComponent.h"
 #include "Components/BillboardComponent.h"
 #include "Components/BoxComponent.h"
+#include "FlowFieldBakeData.h"
 
 
 #include "FlowField.generated.h"
@@ -56,6 +58,13 @@ enum class EDigitType : uint8
 	Dist UMETA(DisplayName = "Dist")
 };
 
+UENUM(BlueprintType)
+enum class EIntegrationMode : uint8
+{
+	PriorityQueue UMETA(DisplayName = "PriorityQueue"),
+	BucketQueue UMETA(DisplayName = "BucketQueue")
+};
+
 //--------------------------Struct-----------------------------
 
 USTRUCT(BlueprintType) struct FCellStruct
@@ -90,6 +99,51 @@ USTRUCT(BlueprintType) struct FCellStruct
 
 };
 
+USTRUCT(BlueprintType) struct FFlowFieldGoalLayerHandle
+{
+	GENERATED_BODY()
+
+	public:
+
+	UPROPERTY(BlueprintReadOnly, VisibleAnywhere, Category = "FFCanvas", meta = (ToolTip = "Id of the cached goal layer. Becomes invalid once the layer is evicted, acquire it again then"))
+	int32 LayerId = INDEX_NONE;
+
+	FORCEINLINE bool IsValid() const { return LayerId != INDEX_NONE; }
+};
+
+// integration and direction layer of one goal set, calculated over the shared cost field
+struct FFlowFieldGoalLayer
+{
+	int32 LayerId = INDEX_NONE;
+
+	// quantized and sorted, this is the cache key
+	TArray<FIntPoint> GoalCells;
+
+	TArray<uint32> DistField;
+	TArray<int32> GoalField;
+	TArray<FVector3f> DirField;
+
+	// field version the layer was calculated against
+	uint32 FieldVersion = MAX_uint32;
+
+	// lookups run on worker threads
+	mutable TAtomic<uint32> LastUsed{ 0 };
+
+	SIZE_T GetAllocatedSize() const
+	{
+		return GoalCells.GetAllocatedSize() + DistField.GetAllocatedSize() + GoalField.GetAllocatedSize() + DirField.GetAllocatedSize();
+	}
+};
+
+// one result of AFlowField::SampleBatch
+struct FFlowFieldSample
+{
+	FVector GroundLocation = FVector::ZeroVector;
+	FVector Direction = FVector::ZeroVector;
+	FVector Normal = FVector(0, 0, 1);
+	bool bIsValid = false;
+};
+
 
 //--------------------------FlowFieldClass-----------------------------
 
@@ -104,16 +158,38 @@ public:
 
 	AFlowField();
 	virtual void OnConstruction(const FTransform& Transform) override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 	UFUNCTION(CallInEditor, BlueprintCallable, Category = "FFCanvas")
 	void DrawDebug();
 
+	UFUNCTION(CallInEditor, BlueprintCallable, Category = "FFCanvas|EnvQuery", meta = (ToolTip = "Trace the whole grid and store the result in BakedEnvironment. Save the asset afterwards"))
+	void BakeEnvironment();
+
 	UFUNCTION(BlueprintCallable, Category = "FFCanvas", meta = (ToolTip = "Recalculate flow field"))
 	void UpdateFlowField();
 
 	UFUNCTION(BlueprintCallable, Category = "FFCanvas", meta = (ToolTip = "Recalculate flow field periodically by timer"))
 	void TickFlowField();
 
+	UFUNCTION(BlueprintPure, Category = "FFCanvas", meta = (ToolTip = "Incremented every time a new flow field is published. Compare it to know when cached lookups are outdated"))
+	int32 GetFieldVersion() const { return int32(FieldVersion); }
+
+	UFUNCTION(BlueprintCallable, Category = "FFCanvas|GoalLayers", meta = (ToolTip = "Get a cached flow field towards the given goals, sharing this actor's cost field. It is calculated on first use and kept up to date while it is used"))
+	FFlowFieldGoalLayerHandle AcquireGoalLayer(const TArray<FVector>& GoalWorldLocations);
+
+	UFUNCTION(BlueprintCallable, Category = "FFCanvas|GoalLayers", meta = (ToolTip = "Drop a cached goal layer right away instead of waiting for it to be evicted"))
+	void ReleaseGoalLayer(const FFlowFieldGoalLayerHandle& Handle);
+
+	UFUNCTION(BlueprintCallable, Category = "FFCanvas|GoalLayers", meta = (ToolTip = "Get the goal layer direction and the goal it leads to at the given world location"))
+	FVector GetLayerDirectionBP(const FFlowFieldGoalLayerHandle& Handle, UPARAM(ref) const FVector& Location, FVector& GoalLocation, bool& bOutIsValid);
+
+	UFUNCTION(BlueprintCallable, Category = "FFCanvas|GoalLayers", meta = (ToolTip = "Get the average goal layer direction at the given world location within radius"))
+	FVector GetLayerAverageDirectionBP(const FFlowFieldGoalLayerHandle& Handle, UPARAM(ref) const FVector& Location, const float Radius, bool& bOutIsValid);
+
+	UFUNCTION(BlueprintCallable, Category = "FFCanvas", meta = (ToolTip = "Mark the cells inside the box as changed. They are re-queried and the flow field is repaired around them on the next refresh"))
+	void MarkRegionDirty(const FBox& WorldBox);
+
 	UFUNCTION(BlueprintCallable, Category = "FFCanvas", meta = (ToolTip = "Get the grid coordinate at the given world location"))
 	bool WorldToGridBP(UPARAM(ref) const FVector& Location, FVector2D& gridCoord);
 
@@ -171,6 +247,13 @@ public:
 		return GridCoord.X * yNum + GridCoord.Y;
 	};
 
+	// world location of the cell center at the bottom of the volume
+	FORCEINLINE FVector GridToWorld(const FVector2D& GridCoord) const
+	{
+		const FVector worldLoc = FVector(GridCoord.X * cellSize + relativeLoc.X + (cellSize / 2.f), GridCoord.Y * cellSize + relativeLoc.Y + (cellSize / 2.f), actorLoc.Z);
+		return (worldLoc - actorLoc).RotateAngleAxis(actorRot.Yaw, FVector(0, 0, 1)) + actorLoc;
+	}
+
 	FORCEINLINE FCellStruct& GetCellAtLocation(const FVector& Location, bool& bOutIsValid)
 	{
 		if (!bIsBeginPlay)
@@ -224,6 +307,25 @@ public:
 	}
 
 	FORCEINLINE FVector GetAverageDirection(const FVector& Location, const float Radius, bool& bOutIsValid)
+	{
+		return GetAverageDirection(Location, Radius, bOutIsValid, [this](const int32 Index) { return CurrentCellsArray[Index].dir; });
+	}
+
+	FORCEINLINE FVector GetAverageDirection(const FFlowFieldGoalLayerHandle& Handle, const FVector& Location, const float Radius, bool& bOutIsValid)
+	{
+		const FFlowFieldGoalLayer* Layer = FindGoalLayer(Handle);
+
+		if (!Layer)
+		{
+			bOutIsValid = false;
+			return FVector::ZeroVector;
+		}
+
+		return GetAverageDirection(Location, Radius, bOutIsValid, [Layer](const int32 Index) { return FVector(Layer->DirField[Index]); });
+	}
+
+	template<typename FDirAt>
+	FORCEINLINE FVector GetAverageDirection(const FVector& Location, const float Radius, bool& bOutIsValid, FDirAt&& DirAt)
 	{
 		bOutIsValid = false;
 
@@ -280,7 +382,7 @@ public:
 
 					if (DistSq <= RadiusSq)
 					{
-						TotalDir += Cell.dir;
+						TotalDir += DirAt(Index);
 						++ValidCellCount;
 					}
 				}
@@ -305,11 +407,101 @@ public:
 		return FVector::ZeroVector;
 	}
 
+	// whether the packed mirror matches the published field
+	FORCEINLINE bool HasPackedField() const
+	{
+		return !bIsBeginPlay && PackedDirs.Num() == CurrentCellsArray.Num();
+	}
+
+	// decoders of the packed mirror, Index must be a valid cell index
+	FORCEINLINE FVector GetPackedDirection(const int32 Index) const
+	{
+		const uint8 DirIndex = PackedDirs[Index];
+		return DirIndex == PackedNoDir ? FVector::ZeroVector : FVector(PackedDirTable[DirIndex]);
+	}
+
+	FORCEINLINE FVector GetPackedNormal(const int32 Index) const
+	{
+		// octahedral decode
+		const float X = float(PackedNormals[Index] & 0xFF) / 127.5f - 1.f;
+		const float Y = float(PackedNormals[Index] >> 8) / 127.5f - 1.f;
+		const float Z = 1.f - FMath::Abs(X) - FMath::Abs(Y);
+		const float T = FMath::Max(-Z, 0.f);
+
+		return FVector(X + (X >= 0.f ? -T : T), Y + (Y >= 0.f ? -T : T), Z).GetSafeNormal();
+	}
+
+	// bilinear ground height, nearest direction and normal for many locations at once, four per SIMD pass.
+	// heights are quantized to uint16 over the field's height range, so they may differ from the cell locations by half a step
+	void SampleBatch(TConstArrayView<FVector> Locations, const float AngleThreshold, TArrayView<FFlowFieldSample> OutSamples) const;
+
+	// nullptr if the handle was evicted or the layer does not match the current grid
+	FORCEINLINE const FFlowFieldGoalLayer* FindGoalLayer(const FFlowFieldGoalLayerHandle& Handle) const
+	{
+		if (!Handle.IsValid() || bIsBeginPlay) return nullptr;
+
+		for (const TUniquePtr<FFlowFieldGoalLayer>& Layer : GoalLayers)
+		{
+			if (Layer->LayerId != Handle.LayerId) continue;
+
+			if (Layer->DirField.IsEmpty() || Layer->DirField.Num() != CurrentCellsArray.Num()) return nullptr;
+
+			// keeps the layer alive and up to date
+			if (Layer->LastUsed.Load(EMemoryOrder::Relaxed) != GoalLayerClock)
+			{
+				Layer->LastUsed.Store(GoalLayerClock, EMemoryOrder::Relaxed);
+			}
+
+			return Layer.Get();
+		}
+
+		return nullptr;
+	}
+
+	FORCEINLINE FVector GetLayerDirection(const FFlowFieldGoalLayerHandle& Handle, const FVector& Location, FVector2D& OutGoalCoord, bool& bOutIsValid)
+	{
+		bOutIsValid = false;
+		OutGoalCoord = FVector2D(0, 0);
+
+		const FFlowFieldGoalLayer* Layer = FindGoalLayer(Handle);
+
+		if (!Layer) return FVector::ZeroVector;
+
+		int32 Index;
+		const bool bIsInside = WorldToIndex(Location, Index);
+		const int32 GoalIndex = Layer->GoalField[Index];
+
+		// cells no goal can reach have no direction, callers fall back to the base field
+		if (!bIsInside || GoalIndex == INDEX_NONE) return FVector::ZeroVector;
+
+		OutGoalCoord = FVector2D(Layer->GoalCells[GoalIndex]);
+		bOutIsValid = true;
+
+		return FVector(Layer->DirField[Index]);
+	}
+
 
 	void InitFlowField(EInitMode InitMode);
 	void GetGoalLocation();
 	void CreateGrid();
+	void QueryCells(TArray<FCellStruct>& OutCells, const TArray<int32>& CellIndices);
+	bool LoadBakedEnvironment();
 	void CalculateFlowField(TArray<FCellStruct>& InCurrentCellsArray);
+	void CalculateIntegrationFieldDial(TArray<FCellStruct>& InCurrentCellsArray);
+	void PropagateIntegrationField(TArray<uint32>& InDistField, TArray<int32>& InGoalField, TArray<int32>& Sources, TBitArray<>* OutChanged);
+	void SyncIntegrationFields(const TArray<FCellStruct>& InCurrentCellsArray);
+	void CalculateCellDirection(TArray<FCellStruct>& InCurrentCellsArray, const int32 CellIndex);
+	void RequeryDirtyCells(TBitArray<>* OutDirty);
+	bool RepairFlowField();
+	bool CanRepairFlowField() const;
+	void RepairCells(TArray<FCellStruct>& InCellsArray, TBitArray<>& Changed);
+	void StartAsyncUpdate();
+	void FinishAsyncUpdate();
+	void BuildGoalLayer(FFlowFieldGoalLayer& Layer);
+	void RefreshGoalLayers();
+	void EvictGoalLayers(const FFlowFieldGoalLayer* LayerToKeep);
+	void CalculateLayerDirection(FFlowFieldGoalLayer& Layer, const int32 CellIndex) const;
+	void BuildPackedField();
 	void DrawCells(EInitMode InitMode);
 	void DrawArrows(EInitMode InitMode);
 	void UpdateTimer();
@@ -365,12 +557,36 @@ public:
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "FFCanvas|EnvQuery", meta = (ToolTip = "Cell inclination over this limit will be recognized as obstacle."))
 	float maxWalkableAngle = 45.f;
 
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "FFCanvas|EnvQuery", meta = (ToolTip = "If True: Cells are traced in chunks on worker threads"))
+	bool bParallelEnvQuery = true;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "FFCanvas|EnvQuery", meta = (ClampMin = "1", ToolTip = "How many cells one worker traces in a row"))
+	int32 EnvQueryChunkSize = 256;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "FFCanvas|EnvQuery", meta = (ToolTip = "Baked cost, height and normal grid. While it matches this flow field, the grid is loaded from it instead of traced. Fill it with BakeEnvironment"))
+	TObjectPtr<UFlowFieldBakeData> BakedEnvironment;
+
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "FFCanvas|Performance", meta = (ToolTip = "How long until next update in seconds during runtime"))
 	float RefreshInterval = 0.5f;
 
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "FFCanvas|Performance", meta = (ToolTip = "Skip cells inside obstacles during calculation"))
 	bool bIgnoreInternalObstacleCells = false;
 
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "FFCanvas|Performance", meta = (ToolTip = "How the integration field is calculated. BucketQueue uses the integer 0-255 costs and compact arrays, much faster on large fields"))
+	EIntegrationMode IntegrationMode = EIntegrationMode::BucketQueue;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "FFCanvas|Performance", meta = (ToolTip = "If True: When only some regions were marked dirty and the goals did not move, repair the flow field around them instead of recalculating everything"))
+	bool bIncrementalRepair = true;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "FFCanvas|Performance", meta = (ToolTip = "If True: Runtime refreshes by TickFlowField recalculate the flow field on a background task into a back buffer, which is swapped in on a later tick"))
+	bool bAsyncUpdate = false;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "FFCanvas|GoalLayers", meta = (ClampMin = "1", ToolTip = "Goals are snapped to blocks of this many cells, so nearby goal sets share one layer"))
+	int32 GoalLayerQuantization = 1;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "FFCanvas|GoalLayers", meta = (ClampMin = "0", ToolTip = "Memory budget of the goal layer cache in MB. The least recently used layers are evicted above it"))
+	float GoalLayerBudgetMB = 32.f;
+
 
 	//--------------------------------------------------------Not Exposed Settings-----------------------------------------------------------------
 
@@ -444,6 +660,38 @@ public:
 
 	TAtomic<int32> TraceRemaining{ 0 };
 
+	// compact integration scratch, reused between refreshes
+	TArray<uint8> CostField;
+	TArray<float> HeightField;
+	TArray<uint32> DistField;
+	TArray<int32> GoalField;
+	TArray<TArray<int32>> DistBuckets;
+
+	TArray<FIntRect> DirtyCellRects;
+	TArray<FVector2D> LastGoalGridCoords;
+
+	// async refresh, CurrentCellsArray is only swapped on the game thread between ticks
+	TArray<FCellStruct> BackCellsArray;
+	TFuture<void> PendingUpdate;
+	bool bAsyncUpdateQueued = false;
+	uint32 FieldVersion = 0;
+
+	// packed mirror of CurrentCellsArray for the sampling hot paths, rebuilt whenever a field is published
+	static constexpr uint16 PackedEmptyHeight = MAX_uint16;
+	static constexpr uint8 PackedNoDir = MAX_uint8;
+
+	TArray<uint16> PackedHeights;
+	TArray<uint16> PackedNormals;
+	TArray<uint8> PackedDirs;
+	float PackedHeightMin = 0.f;
+	float PackedHeightStep = 0.f;
+	FVector3f PackedDirTable[8];
+
+	// goal layer cache, every layer reuses the compact cost and height fields above
+	TArray<TUniquePtr<FFlowFieldGoalLayer>> GoalLayers;
+	int32 NextGoalLayerId = 0;
+	uint32 GoalLayerClock = 1;
+
 	FCellStruct DefaultCell = FCellStruct();
 
 };
\ No newline at end of file
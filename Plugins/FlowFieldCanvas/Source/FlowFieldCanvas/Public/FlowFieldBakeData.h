@@ -0,0 +1,73 @@
+// LeroyWorks 2024 All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "Engine/EngineTypes.h"
+
+#include "FlowFieldBakeData.generated.h"
+
+// baked environment of one flow field: cost, height and ground normal per cell
+UCLASS(BlueprintType)
+class FLOWFIELDCANVAS_API UFlowFieldBakeData : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+
+	// the grid the data was baked for, a flow field that no longer matches it traces instead
+
+	UPROPERTY(VisibleAnywhere, Category = "FFCanvas")
+	int32 xNum = 0;
+
+	UPROPERTY(VisibleAnywhere, Category = "FFCanvas")
+	int32 yNum = 0;
+
+	UPROPERTY(VisibleAnywhere, Category = "FFCanvas")
+	float cellSize = 0.f;
+
+	UPROPERTY(VisibleAnywhere, Category = "FFCanvas")
+	FVector flowFieldSize = FVector::ZeroVector;
+
+	UPROPERTY(VisibleAnywhere, Category = "FFCanvas")
+	FVector actorLoc = FVector::ZeroVector;
+
+	UPROPERTY(VisibleAnywhere, Category = "FFCanvas")
+	float actorYaw = 0.f;
+
+	// the environment query settings the data was baked with
+
+	UPROPERTY(VisibleAnywhere, Category = "FFCanvas")
+	int32 initialCost = -1;
+
+	UPROPERTY(VisibleAnywhere, Category = "FFCanvas")
+	float maxWalkableAngle = -1.f;
+
+	UPROPERTY(VisibleAnywhere, Category = "FFCanvas")
+	bool traceGround = false;
+
+	UPROPERTY(VisibleAnywhere, Category = "FFCanvas")
+	bool traceObstacles = false;
+
+	UPROPERTY(VisibleAnywhere, Category = "FFCanvas")
+	TArray<TEnumAsByte<EObjectTypeQuery>> groundObjectType;
+
+	UPROPERTY(VisibleAnywhere, Category = "FFCanvas")
+	TArray<TEnumAsByte<EObjectTypeQuery>> obstacleObjectType;
+
+	// one entry per cell, same order as AFlowField::InitialCellsArray
+
+	UPROPERTY()
+	TArray<uint8> Costs;
+
+	UPROPERTY()
+	TArray<uint8> Types;
+
+	UPROPERTY()
+	TArray<float> Heights;
+
+	UPROPERTY()
+	TArray<FVector3f> Normals;
+
+};
@@ -12,6 +12,7 @@
 #include "NavigationSystem.h"
 #include "SkelotComponent.h"
 #include "AntTest/AntTest.h"
+#include "Components/AntSkelotBridgeComponent.h"
 #include "Components/BillboardComponent.h"
 
 /**
@@ -32,6 +33,9 @@ AAntSkelotActor::AAntSkelotActor()
 	SoldierSkelotComponent->SetupAttachment(GetRootComponent());
 	SoldierSkelotComponent->bReceivesDecals = false;
 
+	// 创建Ant与Skelot同步组件
+	SkelotBridgeComponent = CreateDefaultSubobject<UAntSkelotBridgeComponent>(TEXT("SkelotBridge"));
+
 	// 创建广告牌组件用于编辑器显示
 	SkelotBillboardComponent = CreateDefaultSubobject<UBillboardComponent>(TEXT("SkelotBillboard"));
 	SkelotBillboardComponent->SetupAttachment(GetRootComponent());
@@ -51,6 +55,9 @@ void AAntSkelotActor::BeginPlay()
 	// 初始化骨骼数据
 	InitSkelotData();
 
+	// 同步组件写入士兵骨骼组件
+	SkelotBridgeComponent->SetSkelotComponent(SoldierSkelotComponent);
+
 	// 设置延迟生成计时器
 	if (GetWorld())
 	{
@@ -61,17 +68,14 @@ void AAntSkelotActor::BeginPlay()
 /**
  * @brief 每帧更新函数
  * @param DeltaTime 帧间隔时间
- * @details 更新骨骼动画组件的变换数据
+ * @details 控制同步组件是否更新骨骼动画组件的变换数据
  */
 void AAntSkelotActor::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
 
-	// 如果存在骨骼组件且有士兵句柄且未播放欢呼动画，则更新变换
-	if (SoldierSkelotComponent && SoldierAntHandles.Num() > 0 && !bIsPlayCheerAnim)
-	{
-		UAntHelperFunctionLibrary::CopyEnemyTranformsToSkelot_New(this, SoldierSkelotComponent, SoldierAntHandles);
-	}
+	// 变换由同步组件批量写入，播放欢呼动画时暂停同步
+	SkelotBridgeComponent->SetComponentTickEnabled(!bIsPlayCheerAnim);
 }
 
 /**
@@ -185,6 +189,13 @@ void AAntSkelotActor::SpawnAntHandle()
 				// 将单位数据设置到Ant句柄
 				UAntFunctionLibrary::SetAgentCustomInstancedStruct(this, AntHandle, InstancedStruct);
 				SoldierAntHandles.Add(AntHandle);
+
+				// 登记到同步组件
+				FAntSkelotBridgeAnims BridgeAnims;
+				BridgeAnims.IdleAnim = Data->IdleAnim;
+				BridgeAnims.WalkAnim = Data->RunAnim;
+				BridgeAnims.CheerAnim = Data->CheerAnim;
+				SkelotBridgeComponent->AddAgent(AntHandle, InstanceIndex, BridgeAnims);
 			}
 		}
 	}
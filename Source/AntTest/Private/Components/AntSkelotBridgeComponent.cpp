@@ -0,0 +1,210 @@
+/**
+ * @file AntSkelotBridgeComponent.cpp
+ * @brief Ant与Skelot批量同步组件实现文件
+ * @details 该文件实现了Ant代理到Skelot实例的并行变换写入和批量动画切换
+ * @author AntTest Team
+ * @date 2024
+ */
+
+#include "Components/AntSkelotBridgeComponent.h"
+
+#include "AntTest.h"
+#include "AntMath.h"
+#include "AntSubsystem.h"
+#include "SkelotComponent.h"
+#include "Async/ParallelFor.h"
+
+/**
+ * @brief 构造函数
+ * @details 启用组件Tick
+ */
+UAntSkelotBridgeComponent::UAntSkelotBridgeComponent()
+{
+	PrimaryComponentTick.bCanEverTick = true;
+}
+
+/**
+ * @brief 每帧更新函数
+ * @param DeltaTime 帧间隔时间
+ * @param TickType Tick类型
+ * @param ThisTickFunction Tick函数
+ * @details 同步所有已登记的代理
+ */
+void UAntSkelotBridgeComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	Sync();
+}
+
+/**
+ * @brief 设置目标Skelot组件
+ * @param InSkelotComponent 接收变换和动画的Skelot组件
+ */
+void UAntSkelotBridgeComponent::SetSkelotComponent(USkelotComponent* InSkelotComponent)
+{
+	SkelotComponent = InSkelotComponent;
+}
+
+/**
+ * @brief 登记一个代理
+ * @param AgentHandle Ant代理句柄
+ * @param InstanceIndex 对应的Skelot实例索引
+ * @param InAnims 该代理使用的动画集合
+ * @details 已登记的代理只更新实例索引和动画集合
+ */
+void UAntSkelotBridgeComponent::AddAgent(FAntHandle AgentHandle, int32 InstanceIndex, const FAntSkelotBridgeAnims& InAnims)
+{
+	// 已登记的代理直接覆盖
+	if (const int32* Entry = HandleToEntry.Find(AgentHandle.Idx))
+	{
+		Handles[*Entry] = AgentHandle;
+		InstanceIndices[*Entry] = InstanceIndex;
+		Anims[*Entry] = InAnims;
+		return;
+	}
+
+	HandleToEntry.Add(AgentHandle.Idx, Handles.Num());
+	Handles.Add(AgentHandle);
+	InstanceIndices.Add(InstanceIndex);
+	Anims.Add(InAnims);
+}
+
+/**
+ * @brief 移除一个代理
+ * @param AgentHandle Ant代理句柄
+ * @details 与末尾元素交换后删除，保持表稠密
+ */
+void UAntSkelotBridgeComponent::RemoveAgent(FAntHandle AgentHandle)
+{
+	int32 Entry = INDEX_NONE;
+	if (!HandleToEntry.RemoveAndCopyValue(AgentHandle.Idx, Entry))
+	{
+		return;
+	}
+
+	// 末尾元素移动到被删除的位置
+	const int32 LastEntry = Handles.Num() - 1;
+	if (Entry != LastEntry)
+	{
+		HandleToEntry[Handles[LastEntry].Idx] = Entry;
+	}
+
+	Handles.RemoveAtSwap(Entry, 1, EAllowShrinking::No);
+	InstanceIndices.RemoveAtSwap(Entry, 1, EAllowShrinking::No);
+	Anims.RemoveAtSwap(Entry, 1, EAllowShrinking::No);
+}
+
+/**
+ * @brief 设置代理是否播放欢呼动画
+ * @param AgentHandle Ant代理句柄
+ * @param bCheer 为true时代理停下后播放欢呼动画
+ * @details 写入欢呼状态列，同时同步代理FUnitData中的bIsPlayCheerAnim，只在状态改变时调用
+ */
+void UAntSkelotBridgeComponent::SetAgentCheer(FAntHandle AgentHandle, bool bCheer)
+{
+	UAntSubsystem* AntSubsystem = GetWorld() ? GetWorld()->GetSubsystem<UAntSubsystem>() : nullptr;
+
+	if (!AntSubsystem || !AntSubsystem->IsValidAgent(AgentHandle)) return;
+
+	AntSubsystem->RegisterAgentUserColumn<FAntSkelotCheerState>()[AntSubsystem->GetAgentIndex(AgentHandle)].bCheer = bCheer;
+
+	// 与CopyEnemyTranformsToSkelot_New读取的FUnitData保持一致
+	if (FUnitData* UnitData = AntSubsystem->GetAgentUserData(AgentHandle).GetMutablePtr<FUnitData>())
+	{
+		UnitData->bIsPlayCheerAnim = bCheer;
+	}
+}
+
+/**
+ * @brief 同步所有已登记的代理
+ * @details 并行写入位置、旋转和实例矩阵，串行执行动画切换，已失效的代理自动移出表；
+ *          是否播放欢呼动画在并行阶段读取FAntSkelotCheerState列
+ */
+void UAntSkelotBridgeComponent::Sync()
+{
+	UAntSubsystem* AntSubsystem = GetWorld() ? GetWorld()->GetSubsystem<UAntSubsystem>() : nullptr;
+
+	if (!AntSubsystem || !SkelotComponent || Handles.IsEmpty()) return;
+
+	USkelotComponent* Skelot = SkelotComponent;
+	FSkelotInstancesData& InstancesData = Skelot->InstancesData;
+	PendingAnims.SetNumUninitialized(Handles.Num());
+
+	// 欢呼状态列按代理索引连续存放，并行阶段直接读取，不需要逐个查找用户数据
+	const TConstArrayView<FAntSkelotCheerState> CheerColumn = AntSubsystem->RegisterAgentUserColumn<FAntSkelotCheerState>();
+
+	// 每个代理只写自己的实例，可以安全并行；动画切换只记录，不在这里执行
+	ParallelFor(Handles.Num(), [&](int32 Entry)
+	{
+		const FAntHandle& Handle = Handles[Entry];
+		const int32 InstanceIndex = InstanceIndices[Entry];
+
+		if (!AntSubsystem->IsValidAgent(Handle) || !Skelot->IsInstanceValid(InstanceIndex))
+		{
+			PendingAnims[Entry] = EPendingAnim::Invalid;
+			return;
+		}
+
+		const FAntAgentData& AgentData = AntSubsystem->GetAgentData(Handle);
+		InstancesData.Locations[InstanceIndex] = AgentData.GetLocationLerped();
+		InstancesData.Rotations[InstanceIndex] = FQuat4f(FVector3f::UpVector, AgentData.FaceAngle - RAD_90);
+		Skelot->OnInstanceTransformChange(InstanceIndex);
+
+		// 与CopyEnemyTranformsToSkelot_New相同的动画选择规则
+		const FAntSkelotBridgeAnims& EntryAnims = Anims[Entry];
+		const bool bMoving = AgentData.GetVelocity() != FVector3f::ZeroVector;
+		const UAnimSequenceBase* CurrentAnim = Skelot->GetInstanceCurrentAnimSequence(InstanceIndex);
+
+		EPendingAnim Pending = EPendingAnim::None;
+		if (CheerColumn[AntSubsystem->GetAgentIndex(Handle)].bCheer)
+		{
+			if (!bMoving && CurrentAnim != EntryAnims.CheerAnim) Pending = EPendingAnim::Cheer;
+		}
+		else if (bMoving && CurrentAnim != EntryAnims.WalkAnim)
+		{
+			Pending = EPendingAnim::Walk;
+		}
+		else if (!bMoving && CurrentAnim != EntryAnims.IdleAnim)
+		{
+			Pending = EPendingAnim::Idle;
+		}
+
+		PendingAnims[Entry] = Pending;
+	}, Handles.Num() < MinParallelAgents ? EParallelForFlags::ForceSingleThread : EParallelForFlags::None);
+
+	// 批量执行动画切换，倒序遍历以便直接移除失效的代理
+	for (int32 Entry = Handles.Num() - 1; Entry >= 0; --Entry)
+	{
+		const int32 InstanceIndex = InstanceIndices[Entry];
+		const FAntSkelotBridgeAnims& EntryAnims = Anims[Entry];
+
+		switch (PendingAnims[Entry])
+		{
+		case EPendingAnim::Idle:
+			Skelot->InstancePlayAnimation(InstanceIndex, EntryAnims.IdleAnim, true, 0, 1, 0.4f);
+			break;
+
+		case EPendingAnim::Walk:
+			Skelot->InstancePlayAnimation(InstanceIndex, EntryAnims.WalkAnim, true, 0, 1, 0.0f);
+			break;
+
+		case EPendingAnim::Cheer:
+			Skelot->InstancePlayAnimation(InstanceIndex, EntryAnims.CheerAnim, false, 0, 1, 0.0f);
+			break;
+
+		case EPendingAnim::Invalid:
+			RemoveAgent(Handles[Entry]);
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	// 所有实例写完后统一标记一次，包围盒在发送渲染变换时重新计算
+	if (!Skelot->IsRenderTransformDirty())
+	{
+		Skelot->MarkRenderTransformDirty();
+	}
+}
@@ -20,6 +20,7 @@
 // 前向声明
 class USkelotComponent;
 class USkelotAnimCollection;
+class UAntSkelotBridgeComponent;
 
 /**
  * @brief 骨骼动画角色类
@@ -48,7 +49,7 @@ protected:
 	/**
 	 * @brief 每帧更新函数
 	 * @param DeltaTime 帧间隔时间
-	 * @details 更新骨骼动画组件的变换数据
+	 * @details 控制同步组件是否更新骨骼动画组件的变换数据
 	 */
 	virtual void Tick(float DeltaTime) override;
 
@@ -84,6 +85,10 @@ private:
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Skelot", meta = (AllowPrivateAccess = "true"))
 	USkelotComponent* SoldierSkelotComponent;
 
+	/** @brief Ant与Skelot同步组件，批量写入士兵实例的变换和动画 */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Skelot", meta = (AllowPrivateAccess = "true"))
+	UAntSkelotBridgeComponent* SkelotBridgeComponent;
+
 	/** @brief 骨骼广告牌组件，用于在编辑器中显示标识 */
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Skelot", meta = (AllowPrivateAccess = "true"))
 	UBillboardComponent* SkelotBillboardComponent;
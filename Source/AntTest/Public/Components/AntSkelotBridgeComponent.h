@@ -0,0 +1,158 @@
+/**
+ * @file AntSkelotBridgeComponent.h
+ * @brief Ant与Skelot批量同步组件头文件
+ * @details 定义了把Ant代理的位置、朝向和动画状态批量同步到Skelot实例的组件
+ * @author AntTest Team
+ * @date 2024
+ */
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AntHandle.h"
+#include "Components/ActorComponent.h"
+#include "AntSkelotBridgeComponent.generated.h"
+
+// 前向声明
+class USkelotComponent;
+class UAnimSequenceBase;
+
+/**
+ * @brief 单个代理使用的动画集合
+ * @details 与FUnitData中的待机、行走和欢呼动画对应
+ */
+USTRUCT(BlueprintType)
+struct FAntSkelotBridgeAnims
+{
+	GENERATED_BODY()
+
+	/** @brief 待机动画序列 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	UAnimSequenceBase* IdleAnim = nullptr;
+
+	/** @brief 行走动画序列 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	UAnimSequenceBase* WalkAnim = nullptr;
+
+	/** @brief 欢呼动画序列 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	UAnimSequenceBase* CheerAnim = nullptr;
+};
+
+/**
+ * @brief 代理的欢呼状态
+ * @details 作为Ant类型化用户数据列注册，每个代理一个元素，桥接组件在并行阶段直接按代理索引读取
+ */
+USTRUCT()
+struct FAntSkelotCheerState
+{
+	GENERATED_BODY()
+
+	/** @brief 为true时代理停下后播放欢呼动画 */
+	UPROPERTY()
+	bool bCheer = false;
+};
+
+/**
+ * @brief Ant与Skelot批量同步组件
+ * @details 用稠密表把Ant句柄映射到Skelot实例索引，每帧并行写入InstancesData的位置和旋转，
+ *          统一标记渲染变换脏，并把动画切换收集后批量执行，替代逐个代理的CopyEnemyTranformsToSkelot_New
+ */
+UCLASS(ClassGroup = (Ant), meta = (BlueprintSpawnableComponent))
+class ANTTEST_API UAntSkelotBridgeComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	/**
+	 * @brief 构造函数
+	 * @details 启用组件Tick
+	 */
+	UAntSkelotBridgeComponent();
+
+	/**
+	 * @brief 每帧更新函数
+	 * @details 调用Sync同步所有已登记的代理
+	 */
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+	/**
+	 * @brief 设置目标Skelot组件
+	 * @param InSkelotComponent 接收变换和动画的Skelot组件
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Ant Skelot Bridge")
+	void SetSkelotComponent(USkelotComponent* InSkelotComponent);
+
+	/**
+	 * @brief 登记一个代理
+	 * @param AgentHandle Ant代理句柄
+	 * @param InstanceIndex 对应的Skelot实例索引
+	 * @param InAnims 该代理使用的动画集合
+	 * @details 已登记的代理只更新实例索引和动画集合
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Ant Skelot Bridge")
+	void AddAgent(FAntHandle AgentHandle, int32 InstanceIndex, const FAntSkelotBridgeAnims& InAnims);
+
+	/**
+	 * @brief 移除一个代理
+	 * @param AgentHandle Ant代理句柄
+	 * @details 与末尾元素交换后删除，保持表稠密
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Ant Skelot Bridge")
+	void RemoveAgent(FAntHandle AgentHandle);
+
+	/**
+	 * @brief 设置代理是否播放欢呼动画
+	 * @param AgentHandle Ant代理句柄
+	 * @param bCheer 为true时代理停下后播放欢呼动画
+	 * @details 写入欢呼状态列，同时同步代理FUnitData中的bIsPlayCheerAnim，只在状态改变时调用
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Ant Skelot Bridge")
+	void SetAgentCheer(FAntHandle AgentHandle, bool bCheer);
+
+	/**
+	 * @brief 同步所有已登记的代理
+	 * @details 并行写入位置、旋转和实例矩阵，串行执行动画切换，已失效的代理自动移出表；
+	 *          是否播放欢呼动画在并行阶段读取FAntSkelotCheerState列
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Ant Skelot Bridge")
+	void Sync();
+
+	/** @brief 已登记的代理数量 */
+	FORCEINLINE int32 Num() const { return Handles.Num(); }
+
+	/** @brief 少于该数量的代理在游戏线程单线程同步 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Ant Skelot Bridge")
+	int32 MinParallelAgents = 512;
+
+private:
+	/** @brief 每帧需要执行的动画切换 */
+	enum class EPendingAnim : uint8
+	{
+		None,
+		Idle,
+		Walk,
+		Cheer,
+		Invalid
+	};
+
+	/** @brief 目标Skelot组件 */
+	UPROPERTY()
+	TObjectPtr<USkelotComponent> SkelotComponent;
+
+	/** @brief 稠密表：Ant句柄 */
+	TArray<FAntHandle> Handles;
+
+	/** @brief 稠密表：Skelot实例索引 */
+	TArray<int32> InstanceIndices;
+
+	/** @brief 稠密表：动画集合 */
+	UPROPERTY()
+	TArray<FAntSkelotBridgeAnims> Anims;
+
+	/** @brief 句柄索引到稠密表位置的映射 */
+	TMap<int32, int32> HandleToEntry;
+
+	/** @brief 并行阶段写出的动画切换，串行阶段统一执行 */
+	TArray<EPendingAnim> PendingAnims;
+};